@@ -311,7 +311,7 @@ static inline int wolfsentry_action_list_append_1(
     struct wolfsentry_action_list_ent *new;
     if (wolfsentry_action_list_find_1(WOLFSENTRY_CONTEXT_ARGS_OUT, action_list, action, NULL /* action_list_ent */) >= 0)
         WOLFSENTRY_ERROR_RETURN(ITEM_ALREADY_PRESENT);
-    if ((new  = (struct wolfsentry_action_list_ent *)WOLFSENTRY_MALLOC(sizeof *new)) == NULL)
+    if ((new  = (struct wolfsentry_action_list_ent *)WOLFSENTRY_SLAB_ALLOC(sizeof *new)) == NULL)
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     new->action = action;
     wolfsentry_list_ent_append(&action_list->header, &new->header);
@@ -348,7 +348,7 @@ static inline int wolfsentry_action_list_prepend_1(
     struct wolfsentry_action_list_ent *new;
     if (wolfsentry_action_list_find_1(WOLFSENTRY_CONTEXT_ARGS_OUT, action_list, action, NULL /* action_list_ent */) >= 0)
         WOLFSENTRY_ERROR_RETURN(ITEM_ALREADY_PRESENT);
-    if ((new  = (struct wolfsentry_action_list_ent *)WOLFSENTRY_MALLOC(sizeof *new)) == NULL)
+    if ((new  = (struct wolfsentry_action_list_ent *)WOLFSENTRY_SLAB_ALLOC(sizeof *new)) == NULL)
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     new->action = action;
     wolfsentry_list_ent_prepend(&action_list->header, &new->header);
@@ -388,7 +388,7 @@ static inline wolfsentry_errcode_t wolfsentry_action_list_insert_after_1(
         WOLFSENTRY_ERROR_RETURN(ITEM_ALREADY_PRESENT);
     if ((ret = wolfsentry_action_list_find_1(WOLFSENTRY_CONTEXT_ARGS_OUT, action_list, point_action, &point)) < 0)
         WOLFSENTRY_ERROR_RERETURN(ret);
-    if ((new  = (struct wolfsentry_action_list_ent *)WOLFSENTRY_MALLOC(sizeof *new)) == NULL)
+    if ((new  = (struct wolfsentry_action_list_ent *)WOLFSENTRY_SLAB_ALLOC(sizeof *new)) == NULL)
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     new->action = action;
     wolfsentry_list_ent_insert_after(&action_list->header, &point->header, &new->header);
@@ -454,7 +454,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_action_list_clone(
             goto out;
         }
 
-        if ((new_ale = (struct wolfsentry_action_list_ent *)WOLFSENTRY_MALLOC_1(dest_context->hpi.allocator, sizeof *new_ale)) == NULL) {
+        if ((new_ale = (struct wolfsentry_action_list_ent *)WOLFSENTRY_SLAB_ALLOC_1(dest_context, sizeof *new_ale)) == NULL) {
             ret = WOLFSENTRY_ERROR_ENCODE(SYS_RESOURCE_FAILED);
             goto out;
         }
@@ -505,7 +505,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_action_list_delete(
 
     wolfsentry_list_ent_delete(&action_list->header, i);
     WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_action_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, ((struct wolfsentry_action_list_ent *)i)->action, NULL /* action_results */));
-    WOLFSENTRY_FREE(i);
+    WOLFSENTRY_SLAB_FREE(i, sizeof(struct wolfsentry_action_list_ent));
 
     WOLFSENTRY_UNLOCK_AND_RETURN_OK;
 }
@@ -527,7 +527,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_action_list_delete_all(
 
         wolfsentry_list_ent_delete(&action_list->header, i);
         WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_action_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, ((struct wolfsentry_action_list_ent *)i)->action, NULL /* action_results */));
-        WOLFSENTRY_FREE(i);
+        WOLFSENTRY_SLAB_FREE(i, sizeof(struct wolfsentry_action_list_ent));
     }
 
     WOLFSENTRY_UNLOCK_AND_RETURN_OK;
@@ -620,7 +620,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_action_list_dispatch(
         if (WOLFSENTRY_CHECK_BITS(i->action->flags, WOLFSENTRY_ACTION_FLAG_DISABLED))
             continue;
         if (! (rule_route->flags & WOLFSENTRY_ROUTE_FLAG_DONT_COUNT_HITS))
-            WOLFSENTRY_ATOMIC_INCREMENT(i->action->header.hitcount, 1);
+            WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT_WRAPPING(&i->action->header);
 #ifdef WOLFSENTRY_DEBUG_ACTIONS
         fprintf(stderr,"calling action %s for event %s and action type %u\n", wolfsentry_action_get_label(i->action), wolfsentry_event_get_label(trigger_event), action_type);
 #endif
@@ -156,7 +156,9 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_addr_family_insert(
         goto out;
 #ifdef WOLFSENTRY_PROTOCOL_NAMES
     if ((ret = wolfsentry_table_ent_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, &byname->header, &bynumber_table->byname_table->header, 1 /* unique_p */)) < 0) {
+        /* wolfsentry_table_ent_delete_1() also unlinks it from the ID index. */
         WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_table_ent_delete_1(WOLFSENTRY_CONTEXT_ARGS_OUT, &bynumber->header));
+        bynumber->header.id = WOLFSENTRY_ENT_ID_NONE;
         goto out;
     }
 #endif
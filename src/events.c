@@ -52,6 +52,140 @@ static int wolfsentry_event_key_cmp_generic(const struct wolfsentry_table_ent_he
         ((const struct wolfsentry_event *)right)->label_len);
 }
 
+/* FNV-1a.  labels are configuration, not traffic, so there's no call for a
+ * keyed hash here.
+ */
+static uint32_t wolfsentry_event_label_hash(const char *label, unsigned int label_len) {
+    uint32_t hash = 0x811c9dc5U;
+    unsigned int i;
+    for (i = 0; i < label_len; ++i) {
+        hash ^= (byte)label[i];
+        hash *= 0x01000193U;
+    }
+    return hash;
+}
+
+static void wolfsentry_event_label_index_link(
+    struct wolfsentry_event_table *event_table,
+    struct wolfsentry_event *event)
+{
+    struct wolfsentry_event **bucket = &event_table->label_buckets[event->label_hash & (event_table->n_label_buckets - 1U)];
+    event->label_index_next = *bucket;
+    *bucket = event;
+}
+
+/* rebuilds the index from the tree, so that it's complete even if an earlier
+ * allocation failed.  on failure, the existing index (if any) is left as is.
+ */
+static void wolfsentry_event_label_index_grow(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_event_table *event_table)
+{
+    uint32_t new_n_buckets = event_table->n_label_buckets ? event_table->n_label_buckets << 1U : WOLFSENTRY_EVENT_LABEL_INDEX_INITIAL_BUCKETS;
+    struct wolfsentry_event **new_buckets;
+    struct wolfsentry_table_ent_header *i;
+
+    if (new_n_buckets < event_table->n_label_buckets)
+        WOLFSENTRY_RETURN_VOID;
+    if ((new_buckets = (struct wolfsentry_event **)WOLFSENTRY_MALLOC(new_n_buckets * sizeof *new_buckets)) == NULL)
+        WOLFSENTRY_RETURN_VOID;
+    memset(new_buckets, 0, new_n_buckets * sizeof *new_buckets);
+
+    if (event_table->label_buckets != NULL)
+        WOLFSENTRY_FREE(event_table->label_buckets);
+    event_table->label_buckets = new_buckets;
+    event_table->n_label_buckets = new_n_buckets;
+
+    for (i = event_table->header.head; i; i = i->next)
+        wolfsentry_event_label_index_link(event_table, (struct wolfsentry_event *)i);
+
+    WOLFSENTRY_RETURN_VOID;
+}
+
+/* called after event has been linked into event_table->header. */
+WOLFSENTRY_LOCAL_VOID wolfsentry_event_label_index_insert(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_event_table *event_table,
+    struct wolfsentry_event *event)
+{
+    event->label_hash = wolfsentry_event_label_hash(event->label, event->label_len);
+    event->label_index_next = NULL;
+    if ((event_table->label_buckets == NULL) || (event_table->header.n_ents > event_table->n_label_buckets)) {
+        /* the rebuild links event too, since it's already in the tree. */
+        uint32_t n_label_buckets_before = event_table->n_label_buckets;
+        wolfsentry_event_label_index_grow(WOLFSENTRY_CONTEXT_ARGS_OUT, event_table);
+        if (event_table->n_label_buckets != n_label_buckets_before)
+            WOLFSENTRY_RETURN_VOID;
+        if (event_table->label_buckets == NULL)
+            WOLFSENTRY_RETURN_VOID;
+    }
+    wolfsentry_event_label_index_link(event_table, event);
+    WOLFSENTRY_RETURN_VOID;
+}
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_event_label_index_delete(
+    struct wolfsentry_event_table *event_table,
+    struct wolfsentry_event *event)
+{
+    struct wolfsentry_event **i;
+    if (event_table->label_buckets == NULL)
+        WOLFSENTRY_RETURN_VOID;
+    for (i = &event_table->label_buckets[event->label_hash & (event_table->n_label_buckets - 1U)];
+         *i;
+         i = &(*i)->label_index_next)
+    {
+        if (*i == event) {
+            *i = event->label_index_next;
+            break;
+        }
+    }
+    event->label_index_next = NULL;
+    WOLFSENTRY_RETURN_VOID;
+}
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_event_label_index_reset(
+    struct wolfsentry_event_table *event_table)
+{
+    if (event_table->label_buckets != NULL)
+        memset(event_table->label_buckets, 0, event_table->n_label_buckets * sizeof *event_table->label_buckets);
+    WOLFSENTRY_RETURN_VOID;
+}
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_event_label_index_free(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_event_table *event_table)
+{
+    if (event_table->label_buckets != NULL) {
+        WOLFSENTRY_FREE(event_table->label_buckets);
+        event_table->label_buckets = NULL;
+        event_table->n_label_buckets = 0;
+    }
+    WOLFSENTRY_RETURN_VOID;
+}
+
+/* returns zero if the index isn't available, in which case the caller falls
+ * back to the tree.  otherwise *found is the event, or null if it's absent.
+ */
+static int wolfsentry_event_label_index_get(
+    const struct wolfsentry_event_table *event_table,
+    const char *label,
+    unsigned int label_len,
+    struct wolfsentry_event **found)
+{
+    uint32_t hash;
+    struct wolfsentry_event *i;
+
+    if (event_table->label_buckets == NULL)
+        return 0;
+    hash = wolfsentry_event_label_hash(label, label_len);
+    for (i = event_table->label_buckets[hash & (event_table->n_label_buckets - 1U)]; i; i = i->label_index_next) {
+        if ((i->label_hash == hash) && (i->label_len == label_len) && (memcmp(i->label, label, label_len) == 0))
+            break;
+    }
+    *found = i;
+    return 1;
+}
+
 static wolfsentry_errcode_t wolfsentry_event_init_1(const char *label, int label_len, wolfsentry_priority_t priority, const struct wolfsentry_eventconfig *config, struct wolfsentry_event *event, size_t event_size) {
     if (label_len <= 0)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
@@ -86,7 +220,7 @@ static void wolfsentry_event_free(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_
     WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_action_list_delete_all(WOLFSENTRY_CONTEXT_ARGS_OUT, &event->decision_action_list));
     if (event->config)
         WOLFSENTRY_FREE(event->config);
-    WOLFSENTRY_FREE(event);
+    WOLFSENTRY_SLAB_FREE(event, sizeof *event + (size_t)event->label_len + 1);
     WOLFSENTRY_RETURN_VOID;
 }
 
@@ -104,14 +238,16 @@ static wolfsentry_errcode_t wolfsentry_event_new_1(WOLFSENTRY_CONTEXT_ARGS_IN, c
 
     new_size = sizeof **event + (size_t)label_len + 1;
 
-    if ((*event = (struct wolfsentry_event *)WOLFSENTRY_MALLOC(new_size)) == NULL)
+    if ((*event = (struct wolfsentry_event *)WOLFSENTRY_SLAB_ALLOC(new_size)) == NULL)
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
 
     memset(*event, 0, new_size);
+    /* wolfsentry_event_free() needs it to recover new_size. */
+    (*event)->label_len = (byte)label_len;
 
     if (config) {
         if (((*event)->config = (struct wolfsentry_eventconfig_internal *)WOLFSENTRY_MALLOC(sizeof *((*event)->config))) == NULL) {
-            WOLFSENTRY_FREE(*event);
+            WOLFSENTRY_SLAB_FREE(*event, new_size);
             WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
         }
     }
@@ -144,7 +280,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_event_clone_bare(
     (void)src_context;
     (void)flags;
 
-    if ((*new_event = WOLFSENTRY_MALLOC_1(dest_context->hpi.allocator, new_size)) == NULL)
+    if ((*new_event = (struct wolfsentry_event *)WOLFSENTRY_SLAB_ALLOC_1(dest_context, new_size)) == NULL)
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     memcpy(*new_event, src_event, new_size);
     WOLFSENTRY_TABLE_ENT_HEADER_RESET(**new_ent);
@@ -160,7 +296,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_event_clone_bare(
 
     if (src_event->config) {
         if (((*new_event)->config = WOLFSENTRY_MALLOC_1(dest_context->hpi.allocator, sizeof *(*new_event)->config)) == NULL) {
-            WOLFSENTRY_FREE_1(dest_context->hpi.allocator, *new_event);
+            WOLFSENTRY_SLAB_FREE_1(dest_context, *new_event, new_size);
             WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
         }
         memcpy((*new_event)->config, src_event->config, sizeof *(*new_event)->config);
@@ -330,6 +466,14 @@ static wolfsentry_errcode_t wolfsentry_event_get_1(WOLFSENTRY_CONTEXT_ARGS_IN, c
     if (label_len > WOLFSENTRY_MAX_LABEL_BYTES)
         WOLFSENTRY_ERROR_RETURN(STRING_ARG_TOO_LONG);
 
+    WOLFSENTRY_HAVE_A_LOCK_OR_RETURN();
+
+    if (wolfsentry_event_label_index_get(wolfsentry->events, label, (unsigned int)label_len, event)) {
+        if (*event == NULL)
+            WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
+        WOLFSENTRY_RETURN_OK;
+    }
+
     ret = wolfsentry_event_init_1(label, label_len, 0, NULL, &target.event, sizeof target);
     WOLFSENTRY_RERETURN_IF_ERROR(ret);
 
@@ -365,6 +509,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_event_update_config(WOLFSENTRY_CO
     ret = wolfsentry_event_get_1(WOLFSENTRY_CONTEXT_ARGS_OUT, label, label_len, &event);
     WOLFSENTRY_RERETURN_IF_ERROR(ret);
 
+    /* the action_res filter bits in the config gate route matching. */
+    wolfsentry_route_table_generation_bump(wolfsentry->routes);
+
     if (event->config == NULL) {
         if ((event->config = (struct wolfsentry_eventconfig_internal *)WOLFSENTRY_MALLOC(sizeof *event->config)) == NULL)
             WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(SYS_RESOURCE_FAILED);
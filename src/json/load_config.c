@@ -31,6 +31,14 @@
 #define MAX_IPV6_ADDR_BITS (sizeof(struct in6_addr) * BITS_PER_BYTE)
 #define MAX_MAC_ADDR_BITS 64
 
+/* once a static-routes-insert array reaches this many routes, the rest of it
+ * is collected with wolfsentry_route_bulk_insert_add() and inserted with a
+ * single sort when the array ends.
+ */
+#ifndef WOLFSENTRY_CONFIG_JSON_BULK_ROUTE_THRESHOLD
+#define WOLFSENTRY_CONFIG_JSON_BULK_ROUTE_THRESHOLD 64
+#endif
+
 #ifdef WOLFSENTRY_LWIP
 #include "lwip/sockets.h"
 #else
@@ -170,6 +178,9 @@ struct wolfsentry_json_process_state {
     wolfsentry_action_res_t default_policy;
     struct wolfsentry_event *default_event;
 
+    unsigned int n_routes_in_section;
+    struct wolfsentry_route_bulk_insert *route_bulk;
+
     JSON_PARSER parser;
     struct wolfsentry_context *wolfsentry_actual, *wolfsentry;
 #ifdef WOLFSENTRY_HAVE_JSON_DOM
@@ -562,6 +573,10 @@ static wolfsentry_errcode_t handle_eventconfig_clause(struct wolfsentry_json_pro
         WOLFSENTRY_ERROR_RERETURN(convert_eventconfig_flag(type, &eventconfig->flags, WOLFSENTRY_EVENTCONFIG_FLAG_DEROGATORY_THRESHOLD_IGNORE_COMMENDABLE));
     if (! strcmp(jps->cur_keyname, "commendable-clears-derogatory"))
         WOLFSENTRY_ERROR_RERETURN(convert_eventconfig_flag(type, &eventconfig->flags, WOLFSENTRY_EVENTCONFIG_FLAG_COMMENDABLE_CLEARS_DEROGATORY));
+    if (! strcmp(jps->cur_keyname, "no-opportunistic-purge"))
+        WOLFSENTRY_ERROR_RERETURN(convert_eventconfig_flag(type, &eventconfig->flags, WOLFSENTRY_EVENTCONFIG_FLAG_NO_OPPORTUNISTIC_PURGE));
+    if (! strcmp(jps->cur_keyname, "coarse-time"))
+        WOLFSENTRY_ERROR_RERETURN(convert_eventconfig_flag(type, &eventconfig->flags, WOLFSENTRY_EVENTCONFIG_FLAG_COARSE_TIME));
 
     if (! strcmp(jps->cur_keyname, "max-purgeable-routes")) {
         struct wolfsentry_route_table *route_table;
@@ -889,7 +904,23 @@ static wolfsentry_errcode_t handle_route_clause(struct wolfsentry_json_process_s
         wolfsentry_action_res_t action_results;
         if (WOLFSENTRY_CHECK_BITS(jps->load_flags, WOLFSENTRY_CONFIG_LOAD_FLAG_NO_ROUTES_OR_EVENTS))
             ret = WOLFSENTRY_ERROR_ENCODE(OK);
-        else
+        else if ((jps->route_bulk != NULL) ||
+                 (jps->n_routes_in_section >= WOLFSENTRY_CONFIG_JSON_BULK_ROUTE_THRESHOLD))
+        {
+            if (jps->route_bulk == NULL)
+                ret = wolfsentry_route_bulk_insert_begin(JPS_WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* route_table */, jps->n_routes_in_section, &jps->route_bulk);
+            else
+                ret = WOLFSENTRY_ERROR_ENCODE(OK);
+            if (ret >= 0)
+                ret = wolfsentry_route_bulk_insert_add(
+                    JPS_WOLFSENTRY_CONTEXT_ARGS_OUT,
+                    jps->route_bulk,
+                    (const struct wolfsentry_sockaddr *)&jps->o_u_c.route.remote,
+                    (const struct wolfsentry_sockaddr *)&jps->o_u_c.route.local,
+                    jps->o_u_c.route.flags,
+                    (jps->o_u_c.route.event_label_len > 0) ? jps->o_u_c.route.event_label : NULL,
+                    jps->o_u_c.route.event_label_len);
+        } else
             ret = wolfsentry_route_insert(
                 JPS_WOLFSENTRY_CONTEXT_ARGS_OUT,
                 jps->o_u_c.route.caller_arg,
@@ -900,6 +931,7 @@ static wolfsentry_errcode_t handle_route_clause(struct wolfsentry_json_process_s
                 jps->o_u_c.route.event_label_len,
                 &id,
                 &action_results);
+        ++jps->n_routes_in_section;
         reset_o_u_c(jps);
         WOLFSENTRY_ERROR_RERETURN(ret);
     }
@@ -1542,6 +1574,12 @@ static wolfsentry_errcode_t json_process(
     if (jps->table_under_construction == T_U_C_STATIC_ROUTES) {
         if ((jps->cur_depth == 1) && (type == JSON_ARRAY_END)) {
             jps->table_under_construction = T_U_C_NONE;
+            jps->n_routes_in_section = 0;
+            if (jps->route_bulk != NULL) {
+                wolfsentry_action_res_t action_results;
+                ret = wolfsentry_route_bulk_insert_commit(JPS_WOLFSENTRY_CONTEXT_ARGS_OUT, &jps->route_bulk, NULL /* caller_arg */, NULL /* n_inserted */, &action_results);
+                goto out;
+            }
             WOLFSENTRY_RETURN_OK;
         }
         ret = handle_route_clause(jps, type, data, data_size);
@@ -1837,6 +1875,10 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_config_json_fini(
     if ((jps == NULL) || (*jps == NULL))
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
 
+    /* a static-routes-insert array left open by a parse error. */
+    if ((*jps)->route_bulk != NULL)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_route_bulk_insert_abort(JPSP_WOLFSENTRY_CONTEXT_ARGS_OUT, &(*jps)->route_bulk));
+
     if (WOLFSENTRY_CHECK_BITS((*jps)->load_flags, WOLFSENTRY_CONFIG_LOAD_FLAG_FINI)) {
         if ((*jps)->fini_ret < 0) {
             ret = wolfsentry_centijson_errcode_translate((*jps)->fini_ret);
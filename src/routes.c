@@ -36,7 +36,16 @@
 #include <netdb.h>
 #endif
 
-static inline int cmp_addrs(
+/* the prefix compare below is the one call site of the word-at-a-time
+ * wolfsentry_addr_common_prefix() in this file.  cmp_addrs() and
+ * addr_prefix_match_size() are left to the compiler to inline, as inlining
+ * every use of them at -O3 can exhaust the unit growth budget (-Winline).
+ */
+static unsigned int route_addr_common_prefix(const byte *a, const byte *b, unsigned int n_bits) {
+    return wolfsentry_addr_common_prefix(a, b, n_bits);
+}
+
+static int cmp_addrs(
     const byte *left_addr,
     int left_addr_len,
     const byte *right_addr,
@@ -45,8 +54,8 @@ static inline int cmp_addrs(
     int match_subnets_p,
     int *inexact_p)
 {
-    int cmp;
     int min_addr_len = (left_addr_len < right_addr_len) ? left_addr_len : right_addr_len;
+    unsigned int cmp_bits, common;
 
     *inexact_p = 0;
 
@@ -64,75 +73,181 @@ static inline int cmp_addrs(
     }
 
     if (left_addr_len != right_addr_len) {
-        if (wildcard_p)
+        if (wildcard_p) {
             *inexact_p = 1;
-        else if (match_subnets_p) {
-            size_t min_bytes = WOLFSENTRY_BITS_TO_BYTES((size_t)min_addr_len);
-            if ((min_addr_len & 0x7) == 0) {
-                if ((cmp = memcmp(left_addr, right_addr, min_bytes)))
-                    return cmp;
-                else
-                    *inexact_p = 1;
-            } else {
-                if (min_bytes > 1) {
-                    if ((cmp = memcmp(left_addr, right_addr, min_bytes - 1)))
-                        return cmp;
-                }
-                if ((left_addr[min_bytes - 1] >> (min_addr_len & 0x7)) ==
-                    (right_addr[min_bytes - 1] >> (min_addr_len & 0x7)))
-                    *inexact_p = 1;
-                else if (left_addr[min_bytes - 1] < right_addr[min_bytes - 1])
-                    return -1;
-                else
-                    return 1;
-            }
-        } else {
-            if ((cmp = memcmp(left_addr, right_addr, WOLFSENTRY_BITS_TO_BYTES((size_t)min_addr_len))))
-                return cmp;
-            else if (left_addr_len < right_addr_len)
-                return -1;
-            else
-                return 1;
+            return 0;
         }
-    } else {
-        if ((cmp = memcmp(left_addr, right_addr, WOLFSENTRY_BITS_TO_BYTES((size_t)left_addr_len)))) {
-            if (wildcard_p)
-                *inexact_p = 1;
-            else
-                return cmp;
+        /* a subnet match compares only the shorter prefix.  otherwise, the
+         * ordering is bytewise over the bytes the shorter prefix occupies,
+         * then by length.
+         */
+        if (match_subnets_p)
+            cmp_bits = (unsigned int)min_addr_len;
+        else
+            cmp_bits = WOLFSENTRY_BITS_TO_BYTES((unsigned int)min_addr_len) * BITS_PER_BYTE;
+    } else
+        cmp_bits = WOLFSENTRY_BITS_TO_BYTES((unsigned int)left_addr_len) * BITS_PER_BYTE; /* pad bits are zero. */
+
+    common = route_addr_common_prefix(left_addr, right_addr, cmp_bits);
+    if (common < cmp_bits) {
+        if (wildcard_p) {
+            *inexact_p = 1;
+            return 0;
         }
+        /* the first differing bit orders the addresses. */
+        return (left_addr[common >> 3U] & (0x80U >> (common & 7U))) ? 1 : -1;
+    }
+
+    if (left_addr_len != right_addr_len) {
+        if (match_subnets_p) {
+            *inexact_p = 1;
+            return 0;
+        } else if (left_addr_len < right_addr_len)
+            return -1;
+        else
+            return 1;
     }
     return 0;
 }
 
-static inline int addr_prefix_match_size(
+static int addr_prefix_match_size(
     const byte *a,
     int a_len,
     const byte *b,
     int b_len)
 {
     int min_len = (a_len < b_len) ? a_len : b_len;
-    int min_len_whole_bytes = min_len >> 3;
-    int ret;
 
     if (min_len == 0)
         return 0;
 
-    for (ret = 0; ret < min_len_whole_bytes; ++ret) {
-        if (a[ret] != b[ret])
-            break;
+    return (int)route_addr_common_prefix(a, b, (unsigned int)min_len);
+}
+
+/* compares the whole bytes that lie inside both prefixes and inside the
+ * routes' addr heads.  a nonzero return has the sign cmp_addrs() would return
+ * without wildcard_p, because every path through it begins with a memcmp() of
+ * at least those bytes.  zero means undecided.
+ */
+static inline int cmp_addr_heads(
+    const byte *left_head,
+    int left_addr_len,
+    const byte *right_head,
+    int right_addr_len)
+{
+    int min_addr_len = (left_addr_len < right_addr_len) ? left_addr_len : right_addr_len;
+    size_t n = (size_t)min_addr_len >> 3;
+    if (n > WOLFSENTRY_ROUTE_ADDR_HEAD_BYTES)
+        n = WOLFSENTRY_ROUTE_ADDR_HEAD_BYTES;
+    for (; n > 0; --n, ++left_head, ++right_head) {
+        if (*left_head != *right_head)
+            return (*left_head < *right_head) ? -1 : 1;
     }
+    return 0;
+}
 
-    ret <<= 3;
+#ifdef WOLFSENTRY_ROUTE_SORT_KEYS
 
-    for (; ret < min_len; ++ret) {
-        int byte_number = ret / 8;
-        int bit_number = ret % 8;
-        if ((a[byte_number] & (1U << bit_number)) != (b[byte_number] & (1U << bit_number)))
-            break;
+/* the width each address is padded to in the sort key, or 0 if the family
+ * has no sort keys.  the width must depend on the family alone, so that the
+ * keys of two routes in the same family line up field for field.
+ */
+static inline size_t wolfsentry_route_sort_key_addr_bytes(wolfsentry_addr_family_t sa_family) {
+    switch (sa_family) {
+    case WOLFSENTRY_AF_INET:
+        return 4;
+    case WOLFSENTRY_AF_INET6:
+        return 16;
+    default:
+        return 0;
     }
+}
 
-    return ret;
+static inline byte *wolfsentry_route_sort_key_put_be(byte *p, uint32_t value, size_t n_bytes) {
+    while (n_bytes-- > 0)
+        *p++ = (byte)(value >> (n_bytes * BITS_PER_BYTE));
+    return p;
+}
+
+/* padding the shorter of two addresses with zeros, and following each with
+ * its length, orders them exactly as cmp_addrs() does without wildcards or
+ * subnet matching -- bytewise over the bytes of the shorter prefix, then by
+ * length -- because the pad bytes sort at or below whatever the longer address
+ * has in their place.
+ */
+static inline byte *wolfsentry_route_sort_key_put_addr(byte *p, const byte *addr, wolfsentry_addr_bits_t addr_len, size_t width) {
+    size_t addr_bytes = WOLFSENTRY_BITS_TO_BYTES((size_t)addr_len);
+    memcpy(p, addr, addr_bytes);
+    memset(p + addr_bytes, 0, width - addr_bytes);
+    return wolfsentry_route_sort_key_put_be(p + width, addr_len, sizeof addr_len);
+}
+
+static void wolfsentry_route_update_sort_key(struct wolfsentry_route *route) {
+    size_t width = wolfsentry_route_sort_key_addr_bytes(route->sa_family);
+    byte *p = route->sort_key;
+
+    if ((width == 0) ||
+        (WOLFSENTRY_ROUTE_REMOTE_ADDR_BYTES(route) > width) ||
+        (WOLFSENTRY_ROUTE_LOCAL_ADDR_BYTES(route) > width))
+    {
+        route->sort_key_len = 0;
+        return;
+    }
+
+    p = wolfsentry_route_sort_key_put_be(p, route->sa_family, sizeof route->sa_family);
+    p = wolfsentry_route_sort_key_put_addr(p, WOLFSENTRY_ROUTE_REMOTE_ADDR(route), route->remote.addr_len, width);
+    p = wolfsentry_route_sort_key_put_be(p, route->sa_proto, sizeof route->sa_proto);
+    p = wolfsentry_route_sort_key_put_be(p, route->local.sa_port, sizeof route->local.sa_port);
+    p = wolfsentry_route_sort_key_put_addr(p, WOLFSENTRY_ROUTE_LOCAL_ADDR(route), route->local.addr_len, width);
+    p = wolfsentry_route_sort_key_put_be(p, route->remote.sa_port, sizeof route->remote.sa_port);
+    *p++ = route->remote.interface;
+    *p++ = route->local.interface;
+    p = wolfsentry_route_sort_key_put_be(p, (uint32_t)(route->flags & WOLFSENTRY_ROUTE_IMMUTABLE_FLAGS), sizeof(uint32_t));
+    route->sort_key_len = (byte)(p - route->sort_key);
+}
+
+#endif /* WOLFSENTRY_ROUTE_SORT_KEYS */
+
+/* refreshes the copies of the key fields kept in the route's key block.  must
+ * be called after any change to the addresses, ports, proto, family,
+ * interfaces, or immutable flags.
+ */
+static void wolfsentry_route_update_key_copies(struct wolfsentry_route *route) {
+    size_t remote_bytes = WOLFSENTRY_ROUTE_REMOTE_ADDR_BYTES(route);
+    size_t local_bytes = WOLFSENTRY_ROUTE_LOCAL_ADDR_BYTES(route);
+    memset(route->remote_addr_head, 0, sizeof route->remote_addr_head);
+    memset(route->local_addr_head, 0, sizeof route->local_addr_head);
+    memcpy(route->remote_addr_head, WOLFSENTRY_ROUTE_REMOTE_ADDR(route), (remote_bytes < sizeof route->remote_addr_head) ? remote_bytes : sizeof route->remote_addr_head);
+    memcpy(route->local_addr_head, WOLFSENTRY_ROUTE_LOCAL_ADDR(route), (local_bytes < sizeof route->local_addr_head) ? local_bytes : sizeof route->local_addr_head);
+
+#ifdef WOLFSENTRY_IPV4_FAST_ROUTES
+    /* the words are packed in the order wolfsentry_route_key_cmp_1() visits
+     * the fields, with the addresses in network order in the high bits, so
+     * that comparing them as integers orders IPv4 host routes exactly as the
+     * generic comparison does.
+     */
+    if ((route->sa_family == WOLFSENTRY_AF_INET) && (route->remote.addr_len == 32) && (route->local.addr_len == 32)) {
+        const byte *remote_addr = WOLFSENTRY_ROUTE_REMOTE_ADDR(route);
+        const byte *local_addr = WOLFSENTRY_ROUTE_LOCAL_ADDR(route);
+        route->ipv4_key[0] =
+            ((uint64_t)remote_addr[0] << 56U) | ((uint64_t)remote_addr[1] << 48U) | ((uint64_t)remote_addr[2] << 40U) | ((uint64_t)remote_addr[3] << 32U) |
+            ((uint64_t)route->sa_proto << 16U) |
+            (uint64_t)route->local.sa_port;
+        route->ipv4_key[1] =
+            ((uint64_t)local_addr[0] << 56U) | ((uint64_t)local_addr[1] << 48U) | ((uint64_t)local_addr[2] << 40U) | ((uint64_t)local_addr[3] << 32U) |
+            ((uint64_t)route->remote.sa_port << 16U) |
+            ((uint64_t)route->remote.interface << 8U) |
+            (uint64_t)route->local.interface;
+        route->ipv4_key_p = 1;
+    } else {
+        route->ipv4_key[0] = route->ipv4_key[1] = 0;
+        route->ipv4_key_p = 0;
+    }
+#endif
+
+#ifdef WOLFSENTRY_ROUTE_SORT_KEYS
+    wolfsentry_route_update_sort_key(route);
+#endif
 }
 
 static int wolfsentry_route_key_cmp_1(
@@ -147,6 +262,34 @@ static int wolfsentry_route_key_cmp_1(
     if (inexact_matches)
         *inexact_matches = WOLFSENTRY_ROUTE_FLAG_NONE;
 
+#ifdef WOLFSENTRY_ROUTE_SORT_KEYS
+    /* in table order, the sort keys decide everything up to the parent event.
+     * keys from different families differ in their first bytes, and keys from
+     * the same family have the same length.
+     */
+    if ((! match_wildcards_p) && left->sort_key_len && right->sort_key_len) {
+        cmp = memcmp(left->sort_key, right->sort_key, (left->sort_key_len < right->sort_key_len) ? left->sort_key_len : right->sort_key_len);
+        if (cmp)
+            WOLFSENTRY_RETURN_VALUE((cmp < 0) ? -1 : 1);
+        goto key_and_flags_equal;
+    }
+#endif
+
+#ifdef WOLFSENTRY_IPV4_FAST_ROUTES
+    /* two IPv4 host routes with no wildcarded key fields in play compare as
+     * a pair of integers, through the interfaces.
+     */
+    if (left->ipv4_key_p && right->ipv4_key_p &&
+        ((! match_wildcards_p) || (! (wildcard_flags & WOLFSENTRY_ROUTE_WILDCARD_FLAGS))))
+    {
+        if (left->ipv4_key[0] != right->ipv4_key[0])
+            WOLFSENTRY_RETURN_VALUE((left->ipv4_key[0] < right->ipv4_key[0]) ? -1 : 1);
+        if (left->ipv4_key[1] != right->ipv4_key[1])
+            WOLFSENTRY_RETURN_VALUE((left->ipv4_key[1] < right->ipv4_key[1]) ? -1 : 1);
+        goto key_fields_equal;
+    }
+#endif
+
     if (left->sa_family != right->sa_family) {
         if (match_wildcards_p && (wildcard_flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD)) {
             if (inexact_matches)
@@ -157,6 +300,11 @@ static int wolfsentry_route_key_cmp_1(
             WOLFSENTRY_RETURN_VALUE(1);
     }
 
+    if (! (match_wildcards_p && (wildcard_flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD))) {
+        if ((cmp = cmp_addr_heads(left->remote_addr_head, left->remote.addr_len,
+                                  right->remote_addr_head, right->remote.addr_len)))
+            WOLFSENTRY_RETURN_VALUE(cmp);
+    }
     cmp = cmp_addrs(WOLFSENTRY_ROUTE_REMOTE_ADDR(left), left->remote.addr_len,
                     WOLFSENTRY_ROUTE_REMOTE_ADDR(right), right->remote.addr_len,
                     match_wildcards_p && (wildcard_flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD),
@@ -187,6 +335,11 @@ static int wolfsentry_route_key_cmp_1(
             WOLFSENTRY_RETURN_VALUE(1);
     }
 
+    if (! (match_wildcards_p && (wildcard_flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD))) {
+        if ((cmp = cmp_addr_heads(left->local_addr_head, left->local.addr_len,
+                                  right->local_addr_head, right->local.addr_len)))
+            WOLFSENTRY_RETURN_VALUE(cmp);
+    }
     cmp = cmp_addrs(WOLFSENTRY_ROUTE_LOCAL_ADDR(left), left->local.addr_len,
                     WOLFSENTRY_ROUTE_LOCAL_ADDR(right), right->local.addr_len,
                     match_wildcards_p && (wildcard_flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD),
@@ -227,6 +380,10 @@ static int wolfsentry_route_key_cmp_1(
             WOLFSENTRY_RETURN_VALUE(1);
     }
 
+#ifdef WOLFSENTRY_IPV4_FAST_ROUTES
+  key_fields_equal:
+#endif
+
     /* when match_wildcards_p, caller is responsible for comparing/interpreting
      * flags.
      */
@@ -241,6 +398,10 @@ static int wolfsentry_route_key_cmp_1(
         }
     }
 
+#ifdef WOLFSENTRY_ROUTE_SORT_KEYS
+  key_and_flags_equal:
+#endif
+
     {
         /* treat null parent_event as maximum priority, for unsurprising results on simple routes. */
         int left_effective_priority = left->parent_event ? left->parent_event->priority : 0;
@@ -308,152 +469,1002 @@ static int wolfsentry_route_key_cmp(const struct wolfsentry_table_ent_header *le
     return wolfsentry_route_key_cmp_1((struct wolfsentry_route *)left, (struct wolfsentry_route *)right, 0 /* match_wildcards_p */, NULL /* inexact_matches */);
 }
 
-static void wolfsentry_route_update_flags_1(
-    struct wolfsentry_route *route,
-    wolfsentry_route_flags_t flags_to_set,
-    wolfsentry_route_flags_t flags_to_clear,
-    wolfsentry_route_flags_t *flags_before,
-    wolfsentry_route_flags_t *flags_after);
+/* tuple-space classification of routes.
+ *
+ * each route not indexed by address prefix (see wolfsentry_route_trie_key()
+ * below) is filed in the tuple matching its wildcard flags and address
+ * prefix lengths, hashed on the fields that aren't wildcarded.  addresses
+ * are hashed only over the route's prefix length, truncated the same way
+ * cmp_addrs() truncates a subnet match, so that a target with an address at
+ * least as long as the prefix hashes to the same bucket as every route it
+ * can match in that tuple.  candidates found in the bucket are confirmed with
+ * wolfsentry_route_key_cmp_1().
+ */
 
-static void wolfsentry_route_free_1(
+static inline uint32_t wolfsentry_route_tuple_hash_bytes(uint32_t hash, const byte *bytes, size_t len) {
+    /* FNV-1a */
+    while (len-- > 0) {
+        hash ^= *bytes++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static inline uint32_t wolfsentry_route_tuple_hash_addr(uint32_t hash, const byte *addr, wolfsentry_addr_bits_t addr_len) {
+    size_t addr_bytes = WOLFSENTRY_BITS_TO_BYTES((size_t)addr_len);
+    if ((addr_len & 0x7) == 0)
+        return wolfsentry_route_tuple_hash_bytes(hash, addr, addr_bytes);
+    else {
+        byte last_byte = (byte)(addr[addr_bytes - 1] & (0xffU << (8 - (addr_len & 0x7))));
+        hash = wolfsentry_route_tuple_hash_bytes(hash, addr, addr_bytes - 1);
+        return wolfsentry_route_tuple_hash_bytes(hash, &last_byte, 1);
+    }
+}
+
+static uint32_t wolfsentry_route_tuple_hash(const struct wolfsentry_route_tuple *tuple, const struct wolfsentry_route *route) {
+    uint32_t hash = 2166136261U;
+    if (tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD)
+        hash = wolfsentry_route_tuple_hash_bytes(hash, (const byte *)&route->sa_family, sizeof route->sa_family);
+    if (tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD)
+        hash = wolfsentry_route_tuple_hash_addr(hash, WOLFSENTRY_ROUTE_REMOTE_ADDR(route), tuple->remote_addr_len);
+    if (tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_SA_PROTO_WILDCARD)
+        hash = wolfsentry_route_tuple_hash_bytes(hash, (const byte *)&route->sa_proto, sizeof route->sa_proto);
+    if (tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_PORT_WILDCARD)
+        hash = wolfsentry_route_tuple_hash_bytes(hash, (const byte *)&route->local.sa_port, sizeof route->local.sa_port);
+    if (tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD)
+        hash = wolfsentry_route_tuple_hash_addr(hash, WOLFSENTRY_ROUTE_LOCAL_ADDR(route), tuple->local_addr_len);
+    if (tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_PORT_WILDCARD)
+        hash = wolfsentry_route_tuple_hash_bytes(hash, (const byte *)&route->remote.sa_port, sizeof route->remote.sa_port);
+    if (tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_REMOTE_INTERFACE_WILDCARD)
+        hash = wolfsentry_route_tuple_hash_bytes(hash, &route->remote.interface, sizeof route->remote.interface);
+    if (tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_LOCAL_INTERFACE_WILDCARD)
+        hash = wolfsentry_route_tuple_hash_bytes(hash, &route->local.interface, sizeof route->local.interface);
+    return hash;
+}
+
+/* a target can be found by a single probe only if it supplies every hashed
+ * field, with addresses at least as long as the tuple's prefixes.
+ */
+static inline int wolfsentry_route_tuple_probeable(const struct wolfsentry_route_tuple *tuple, const struct wolfsentry_route *target) {
+    if (target->flags & tuple->hashed_fields)
+        return 0;
+    if ((tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD) && (target->remote.addr_len < tuple->remote_addr_len))
+        return 0;
+    if ((tuple->hashed_fields & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD) && (target->local.addr_len < tuple->local_addr_len))
+        return 0;
+    return 1;
+}
+
+static void wolfsentry_route_tuple_grow(
     WOLFSENTRY_CONTEXT_ARGS_IN,
-    struct wolfsentry_eventconfig_internal *config,
-    struct wolfsentry_route *route)
+    struct wolfsentry_route_tuple *tuple)
 {
-    if (config->config.route_private_data_alignment == 0)
-        WOLFSENTRY_FREE(route);
-    else
-        WOLFSENTRY_FREE_ALIGNED(route);
+    uint32_t new_n_buckets = tuple->n_buckets << 1U;
+    struct wolfsentry_route **new_buckets;
+    uint32_t i;
+
+    if (new_n_buckets == 0)
+        WOLFSENTRY_RETURN_VOID;
+    /* failure to grow is harmless -- the chains just get longer. */
+    if ((new_buckets = (struct wolfsentry_route **)WOLFSENTRY_MALLOC(sizeof *new_buckets * new_n_buckets)) == NULL)
+        WOLFSENTRY_RETURN_VOID;
+    memset(new_buckets, 0, sizeof *new_buckets * new_n_buckets);
+    for (i = 0; i < tuple->n_buckets; ++i) {
+        struct wolfsentry_route *route, *next;
+        for (route = tuple->buckets[i]; route; route = next) {
+            next = route->index_next;
+            route->index_next = new_buckets[route->tuple_hash & (new_n_buckets - 1U)];
+            new_buckets[route->tuple_hash & (new_n_buckets - 1U)] = route;
+        }
+    }
+    WOLFSENTRY_FREE(tuple->buckets);
+    tuple->buckets = new_buckets;
+    tuple->n_buckets = new_n_buckets;
     WOLFSENTRY_RETURN_VOID;
 }
 
-static wolfsentry_errcode_t wolfsentry_route_drop_reference_1(
+static wolfsentry_errcode_t wolfsentry_route_tuple_insert(
     WOLFSENTRY_CONTEXT_ARGS_IN,
-    struct wolfsentry_route *route,
-    wolfsentry_action_res_t *action_results)
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route)
 {
-    struct wolfsentry_eventconfig_internal *config = (route->parent_event && route->parent_event->config) ? route->parent_event->config : &wolfsentry->config;
-    wolfsentry_errcode_t ret;
-    wolfsentry_refcount_t refs_left;
-    if (route->header.refcount <= 0)
-        WOLFSENTRY_ERROR_RETURN(INTERNAL_CHECK_FATAL);
-    if ((route->header.parent_table != NULL) &&
-        (route->header.parent_table->ent_type != WOLFSENTRY_OBJECT_TYPE_ROUTE))
-        WOLFSENTRY_ERROR_RETURN(WRONG_OBJECT);
-    WOLFSENTRY_REFCOUNT_DECREMENT(route->header.refcount, refs_left, ret);
-    WOLFSENTRY_RERETURN_IF_ERROR(ret);
-    if (refs_left > 0)
-        WOLFSENTRY_RETURN_OK;
-    if (route->parent_event)
-        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, route->parent_event, NULL /* action_results */));
-    wolfsentry_route_free_1(WOLFSENTRY_CONTEXT_ARGS_OUT, config, route);
-    if (action_results)
-        WOLFSENTRY_SET_BITS(*action_results, WOLFSENTRY_ACTION_RES_DEALLOCATED);
+    wolfsentry_route_flags_t wildcard_flags = route->flags & WOLFSENTRY_ROUTE_WILDCARD_FLAGS;
+    wolfsentry_addr_bits_t remote_addr_len = (wildcard_flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD) ? 0 : route->remote.addr_len;
+    wolfsentry_addr_bits_t local_addr_len = (wildcard_flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD) ? 0 : route->local.addr_len;
+    struct wolfsentry_list_ent_header *i;
+    struct wolfsentry_route_tuple *tuple = NULL;
+    struct wolfsentry_route **bucket;
+
+    for (wolfsentry_list_ent_get_first(&route_table->tuples, &i); i; i = i->next) {
+        struct wolfsentry_route_tuple *t = container_of(i, struct wolfsentry_route_tuple, header);
+        if ((t->wildcard_flags == wildcard_flags) &&
+            (t->remote_addr_len == remote_addr_len) &&
+            (t->local_addr_len == local_addr_len))
+        {
+            tuple = t;
+            break;
+        }
+    }
+
+    if (tuple == NULL) {
+        if ((tuple = (struct wolfsentry_route_tuple *)WOLFSENTRY_MALLOC(sizeof *tuple)) == NULL)
+            WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+        memset(tuple, 0, sizeof *tuple);
+        if ((tuple->buckets = (struct wolfsentry_route **)WOLFSENTRY_MALLOC(sizeof *tuple->buckets * WOLFSENTRY_ROUTE_TUPLE_INITIAL_BUCKETS)) == NULL) {
+            WOLFSENTRY_FREE(tuple);
+            WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+        }
+        memset(tuple->buckets, 0, sizeof *tuple->buckets * WOLFSENTRY_ROUTE_TUPLE_INITIAL_BUCKETS);
+        tuple->n_buckets = WOLFSENTRY_ROUTE_TUPLE_INITIAL_BUCKETS;
+        tuple->wildcard_flags = wildcard_flags;
+        tuple->remote_addr_len = remote_addr_len;
+        tuple->local_addr_len = local_addr_len;
+        tuple->hashed_fields = ~wildcard_flags & WOLFSENTRY_ROUTE_WILDCARD_FLAGS;
+        if (remote_addr_len == 0)
+            WOLFSENTRY_CLEAR_BITS(tuple->hashed_fields, WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD);
+        if (local_addr_len == 0)
+            WOLFSENTRY_CLEAR_BITS(tuple->hashed_fields, WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD);
+        wolfsentry_list_ent_append(&route_table->tuples, &tuple->header);
+    }
+
+    if (tuple->n_routes >= tuple->n_buckets)
+        wolfsentry_route_tuple_grow(WOLFSENTRY_CONTEXT_ARGS_OUT, tuple);
+
+    route->tuple = tuple;
+    route->tuple_hash = wolfsentry_route_tuple_hash(tuple, route);
+    bucket = &tuple->buckets[route->tuple_hash & (tuple->n_buckets - 1U)];
+    route->index_next = *bucket;
+    *bucket = route;
+    ++tuple->n_routes;
+
     WOLFSENTRY_RETURN_OK;
 }
 
-WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_drop_reference(
+static void wolfsentry_route_tuple_free(
     WOLFSENTRY_CONTEXT_ARGS_IN,
-    struct wolfsentry_route *route,
-    wolfsentry_action_res_t *action_results)
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route_tuple *tuple)
 {
-    if (action_results)
-        WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
-    WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, route, action_results));
+    wolfsentry_list_ent_delete(&route_table->tuples, &tuple->header);
+    WOLFSENTRY_FREE(tuple->buckets);
+    WOLFSENTRY_FREE(tuple);
+    WOLFSENTRY_RETURN_VOID;
 }
 
-static wolfsentry_errcode_t wolfsentry_route_drop_reference_generic(
+static void wolfsentry_route_tuple_delete(
     WOLFSENTRY_CONTEXT_ARGS_IN,
-    struct wolfsentry_table_ent_header *route,
-    wolfsentry_action_res_t *action_results)
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route)
 {
-    if (action_results)
-        WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
-    WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, (struct wolfsentry_route *)route, action_results));
-}
+    struct wolfsentry_route_tuple *tuple = route->tuple;
+    struct wolfsentry_route **i;
 
-static wolfsentry_errcode_t wolfsentry_route_init(
-    struct wolfsentry_event *parent_event,
-    const struct wolfsentry_sockaddr *remote,
-    const struct wolfsentry_sockaddr *local,
-    wolfsentry_route_flags_t flags,
-    int data_addr_offset,
-    size_t data_addr_size,
-    struct wolfsentry_route *new)
-{
-    if (data_addr_size < WOLFSENTRY_BITS_TO_BYTES(remote->addr_len) + WOLFSENTRY_BITS_TO_BYTES(local->addr_len))
-        WOLFSENTRY_ERROR_RETURN(BUFFER_TOO_SMALL);
-    if (data_addr_size > MAX_UINT_OF(uint16_t))
-        WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
-    if ((unsigned)data_addr_offset > MAX_UINT_OF(uint16_t))
-        WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
-    if (! (flags & (WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN | WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT)))
-        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    if (tuple == NULL)
+        WOLFSENTRY_RETURN_VOID;
 
-    /* make sure wildcards are sensical. */
-    if (((flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD) &&
-         ((! (flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD)) ||
-          (! (flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD)) ||
-          (! (flags & WOLFSENTRY_ROUTE_FLAG_SA_PROTO_WILDCARD)))) ||
-        ((flags & WOLFSENTRY_ROUTE_FLAG_SA_PROTO_WILDCARD) &&
-         ((! (flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_PORT_WILDCARD)) ||
-          (! (flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_PORT_WILDCARD)))))
-        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    for (i = &tuple->buckets[route->tuple_hash & (tuple->n_buckets - 1U)]; *i; i = &(*i)->index_next) {
+        if (*i == route) {
+            *i = route->index_next;
+            break;
+        }
+    }
+    route->tuple = NULL;
+    route->index_next = NULL;
 
-    memset(new, 0, offsetof(struct wolfsentry_route, data));
+    if (--tuple->n_routes == 0)
+        wolfsentry_route_tuple_free(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, tuple);
 
-    new->parent_event = parent_event;
-    new->flags = flags;
-    new->sa_family = remote->sa_family;
-    new->sa_proto = remote->sa_proto;
-    new->remote.sa_port = remote->sa_port;
-    new->remote.addr_len = remote->addr_len;
-    new->remote.interface = remote->interface;
-    new->local.sa_port = local->sa_port;
-    new->local.addr_len = local->addr_len;
-    new->local.interface = local->interface;
-    new->data_addr_offset = (uint16_t)data_addr_offset;
-    new->data_addr_size = (uint16_t)data_addr_size;
+    WOLFSENTRY_RETURN_VOID;
+}
 
-    if (data_addr_offset > 0)
-        memset(new->data, 0, (size_t)data_addr_offset); /* zero private data. */
+/* returns nonzero if route i is a candidate for target_route at all,
+ * independent of key comparison.
+ */
+static inline int wolfsentry_route_lookup_eligible(
+    const struct wolfsentry_route *i,
+    const struct wolfsentry_route *target_route,
+    const wolfsentry_action_res_t *action_results)
+{
+    if (WOLFSENTRY_CHECK_BITS(i->flags, WOLFSENTRY_ROUTE_FLAG_PENDING_DELETE))
+        return 0;
+    /* ignore routes that don't cover the direction of the target. */
+    if (! (i->flags & WOLFSENTRY_MASKIN_BITS(target_route->flags, WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN|WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT)))
+        return 0;
+    /* ignore routes that don't meet actions_results constraints. */
+    if (action_results && i->parent_event && i->parent_event->config &&
+        (((*action_results & i->parent_event->config->config.action_res_filter_bits_set) != i->parent_event->config->config.action_res_filter_bits_set) ||
+         ((~(*action_results) & i->parent_event->config->config.action_res_filter_bits_unset) != i->parent_event->config->config.action_res_filter_bits_unset)))
+    {
+        return 0;
+    }
+    /* if *action_results has _EXCLUDE_REJECT_ROUTES set on entry to
+     * wolfsentry_route_lookup_0(), it was set via
+     * wolfsentry_route_event_dispatch_with_inited_result() for a
+     * bind/listen query that should succeed if any routes can succeed.
+     * this requires ignoring routes with _PENALTYBOXED/_PORT_RESET set.
+     */
+    if (action_results &&
+        WOLFSENTRY_CHECK_BITS(*action_results, WOLFSENTRY_ACTION_RES_EXCLUDE_REJECT_ROUTES) &&
+        WOLFSENTRY_MASKIN_BITS(i->flags, WOLFSENTRY_ROUTE_FLAG_PENALTYBOXED|WOLFSENTRY_ROUTE_FLAG_PORT_RESET))
+    {
+        return 0;
+    }
+    return 1;
+}
 
-    if (remote->addr_len > 0)
-        memcpy(WOLFSENTRY_ROUTE_REMOTE_ADDR(new), remote->addr, WOLFSENTRY_BITS_TO_BYTES(remote->addr_len));
-    if (local->addr_len > 0)
-        memcpy(WOLFSENTRY_ROUTE_LOCAL_ADDR(new), local->addr, WOLFSENTRY_BITS_TO_BYTES(local->addr_len));
+struct wolfsentry_route_index_search_state {
+    struct wolfsentry_route *best;
+    wolfsentry_route_flags_t best_inexact_matches;
+    int best_priority;
+};
 
-    /* make sure the pad bits in the addresses are zero. */
-    {
-        int left_over_bits = remote->addr_len % BITS_PER_BYTE;
-        if (left_over_bits) {
-            byte *remote_lsb = WOLFSENTRY_ROUTE_REMOTE_ADDR(new) + WOLFSENTRY_BITS_TO_BYTES(remote->addr_len) - 1;
-            if (*remote_lsb & (0xffU >> (BITS_PER_BYTE - left_over_bits)))
-                *remote_lsb = (byte)(*remote_lsb & (0xffU << left_over_bits));
+static void wolfsentry_route_index_search_chain(
+    struct wolfsentry_route *chain,
+    const struct wolfsentry_route *target_route,
+    const wolfsentry_action_res_t *action_results,
+    int probed_p,
+    uint32_t target_hash,
+    struct wolfsentry_route_index_search_state *state)
+{
+    struct wolfsentry_route *i;
+    wolfsentry_route_flags_t inexact_matches;
+
+    for (i = chain; i; i = i->index_next) {
+        int effective_priority;
+        if (probed_p && (i->tuple_hash != target_hash))
+            continue;
+        if (! wolfsentry_route_lookup_eligible(i, target_route, action_results))
+            continue;
+        if (wolfsentry_route_key_cmp_1(i, target_route, 1 /* match_wildcards_p */, &inexact_matches) != 0)
+            continue;
+        /* preference is a match with the highest-priority event, with null
+         * events having highest priority, and ties broken using
+         * compare_match_exactness(), then by table order, favoring the later
+         * route.
+         */
+        effective_priority = i->parent_event ? i->parent_event->priority : 0;
+        if (state->best != NULL) {
+            int cmp;
+            if (effective_priority > state->best_priority)
+                continue;
+            if (effective_priority == state->best_priority) {
+                cmp = compare_match_exactness(target_route, i, inexact_matches, state->best, state->best_inexact_matches);
+                if (cmp > 0)
+                    continue;
+                if ((cmp == 0) && (wolfsentry_route_key_cmp(&i->header, &state->best->header) < 0))
+                    continue;
+            }
         }
+        state->best = i;
+        state->best_inexact_matches = inexact_matches;
+        state->best_priority = effective_priority;
     }
-    {
-        int left_over_bits = local->addr_len % BITS_PER_BYTE;
-        if (left_over_bits) {
-            byte *local_lsb = WOLFSENTRY_ROUTE_LOCAL_ADDR(new) + WOLFSENTRY_BITS_TO_BYTES(local->addr_len) - 1;
-            if (*local_lsb & (0xffU >> (BITS_PER_BYTE - left_over_bits)))
-                *local_lsb = (byte)(*local_lsb & (0xffU << left_over_bits));
+}
+
+static void wolfsentry_route_tuple_search(
+    const struct wolfsentry_route_table *table,
+    const struct wolfsentry_route *target_route,
+    const wolfsentry_action_res_t *action_results,
+    struct wolfsentry_route_index_search_state *state)
+{
+    struct wolfsentry_list_ent_header *i;
+
+    for (i = table->tuples.head; i; i = i->next) {
+        const struct wolfsentry_route_tuple *tuple = container_of(i, struct wolfsentry_route_tuple, header);
+        if (wolfsentry_route_tuple_probeable(tuple, target_route)) {
+            uint32_t target_hash = wolfsentry_route_tuple_hash(tuple, target_route);
+            wolfsentry_route_index_search_chain(tuple->buckets[target_hash & (tuple->n_buckets - 1U)], target_route, action_results, 1 /* probed_p */, target_hash, state);
+        } else {
+            uint32_t bucket;
+            for (bucket = 0; bucket < tuple->n_buckets; ++bucket)
+                wolfsentry_route_index_search_chain(tuple->buckets[bucket], target_route, action_results, 0 /* probed_p */, 0 /* target_hash */, state);
         }
     }
+}
 
-    new->header.refcount = 1;
-    new->header.id = WOLFSENTRY_ENT_ID_NONE;
+/* prefix-trie indexing of routes with a literal remote address, or failing
+ * that, a literal local address.  a lookup walks the target address down the
+ * trie for its family, visiting only nodes whose prefixes cover it, plus the
+ * whole subtree at the target's own length, since cmp_addrs() also matches
+ * routes with prefixes longer than the target.  as with the tuple space,
+ * candidates are confirmed with wolfsentry_route_key_cmp_1().
+ */
 
-    WOLFSENTRY_RETURN_OK;
+static inline unsigned int wolfsentry_route_trie_bit(const byte *addr, unsigned int bit) {
+    return ((unsigned int)addr[bit >> 3] >> (7U - (bit & 7U))) & 1U;
 }
 
-static wolfsentry_errcode_t wolfsentry_route_init_by_exports(
-    struct wolfsentry_event *parent_event,
-    const struct wolfsentry_route_exports *route_exports,
-    size_t data_addr_offset,
-    size_t data_addr_size,
-    struct wolfsentry_route *new)
-{
+static inline wolfsentry_addr_bits_t wolfsentry_route_trie_common_prefix(const byte *a, wolfsentry_addr_bits_t a_len, const byte *b, wolfsentry_addr_bits_t b_len) {
+    return (wolfsentry_addr_bits_t)route_addr_common_prefix(a, b, (a_len < b_len) ? a_len : b_len);
+}
+
+/* returns the address the route is keyed on in its family trie, or null if
+ * the route belongs in the tuple space.
+ */
+static const byte *wolfsentry_route_trie_key(const struct wolfsentry_route *route, wolfsentry_addr_bits_t *addr_len, int *remote_p) {
+    if (route->flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD)
+        return NULL;
+    if ((! (route->flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD)) && (route->remote.addr_len > 0)) {
+        *addr_len = route->remote.addr_len;
+        *remote_p = 1;
+        return WOLFSENTRY_ROUTE_REMOTE_ADDR(route);
+    }
+    if ((! (route->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD)) && (route->local.addr_len > 0)) {
+        *addr_len = route->local.addr_len;
+        *remote_p = 0;
+        return WOLFSENTRY_ROUTE_LOCAL_ADDR(route);
+    }
+    return NULL;
+}
+
+static wolfsentry_errcode_t wolfsentry_route_trie_node_new(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    const byte *prefix,
+    wolfsentry_addr_bits_t prefix_len,
+    struct wolfsentry_route_trie_node **node)
+{
+    size_t prefix_bytes = WOLFSENTRY_BITS_TO_BYTES((size_t)prefix_len);
+
+    if ((*node = (struct wolfsentry_route_trie_node *)WOLFSENTRY_MALLOC(offsetof(struct wolfsentry_route_trie_node, prefix) + prefix_bytes)) == NULL)
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+    memset(*node, 0, offsetof(struct wolfsentry_route_trie_node, prefix));
+    memcpy((*node)->prefix, prefix, prefix_bytes);
+    (*node)->prefix_len = prefix_len;
+    WOLFSENTRY_RETURN_OK;
+}
+
+static void wolfsentry_route_trie_nodes_free(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_trie_node *node)
+{
+    while (node) {
+        struct wolfsentry_route_trie_node *next = node->child[1];
+        wolfsentry_route_trie_nodes_free(WOLFSENTRY_CONTEXT_ARGS_OUT, node->child[0]);
+        WOLFSENTRY_FREE(node);
+        node = next;
+    }
+    WOLFSENTRY_RETURN_VOID;
+}
+
+static void wolfsentry_route_trie_free(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route_trie *trie)
+{
+    wolfsentry_list_ent_delete(&route_table->tries, &trie->header);
+    wolfsentry_route_trie_nodes_free(WOLFSENTRY_CONTEXT_ARGS_OUT, trie->remote_root);
+    wolfsentry_route_trie_nodes_free(WOLFSENTRY_CONTEXT_ARGS_OUT, trie->local_root);
+    WOLFSENTRY_FREE(trie);
+    WOLFSENTRY_RETURN_VOID;
+}
+
+static struct wolfsentry_route_trie *wolfsentry_route_trie_find(
+    const struct wolfsentry_route_table *route_table,
+    wolfsentry_addr_family_t sa_family)
+{
+    struct wolfsentry_list_ent_header *i;
+    for (i = route_table->tries.head; i; i = i->next) {
+        struct wolfsentry_route_trie *trie = container_of(i, struct wolfsentry_route_trie, header);
+        if (trie->sa_family == sa_family)
+            return trie;
+    }
+    return NULL;
+}
+
+static wolfsentry_errcode_t wolfsentry_route_trie_insert(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route,
+    const byte *addr,
+    wolfsentry_addr_bits_t addr_len,
+    int remote_p)
+{
+    struct wolfsentry_route_trie *trie = wolfsentry_route_trie_find(route_table, route->sa_family);
+    struct wolfsentry_route_trie_node **node_p, *node, *parent = NULL, *new_node = NULL, *branch_node = NULL;
+    wolfsentry_errcode_t ret;
+
+    if (trie == NULL) {
+        if ((trie = (struct wolfsentry_route_trie *)WOLFSENTRY_MALLOC(sizeof *trie)) == NULL)
+            WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+        memset(trie, 0, sizeof *trie);
+        trie->sa_family = route->sa_family;
+        wolfsentry_list_ent_append(&route_table->tries, &trie->header);
+    }
+
+    node_p = remote_p ? &trie->remote_root : &trie->local_root;
+    for (;;) {
+        wolfsentry_addr_bits_t common;
+
+        node = *node_p;
+        if (node == NULL) {
+            if ((ret = wolfsentry_route_trie_node_new(WOLFSENTRY_CONTEXT_ARGS_OUT, addr, addr_len, &new_node)) < 0)
+                goto out;
+            new_node->parent = parent;
+            *node_p = node = new_node;
+            break;
+        }
+
+        common = wolfsentry_route_trie_common_prefix(node->prefix, node->prefix_len, addr, addr_len);
+        if (common == node->prefix_len) {
+            if (addr_len == node->prefix_len)
+                break;
+            parent = node;
+            node_p = &node->child[wolfsentry_route_trie_bit(addr, node->prefix_len)];
+            continue;
+        }
+
+        /* the new prefix is either a proper prefix of node's, or diverges
+         * from it, in which case a bare branch node goes in at the divergence.
+         */
+        if ((ret = wolfsentry_route_trie_node_new(WOLFSENTRY_CONTEXT_ARGS_OUT, addr, addr_len, &new_node)) < 0)
+            goto out;
+        if (common == addr_len) {
+            new_node->parent = node->parent;
+            new_node->child[wolfsentry_route_trie_bit(node->prefix, addr_len)] = node;
+            node->parent = new_node;
+            *node_p = new_node;
+        } else {
+            if ((ret = wolfsentry_route_trie_node_new(WOLFSENTRY_CONTEXT_ARGS_OUT, addr, common, &branch_node)) < 0) {
+                WOLFSENTRY_FREE(new_node);
+                goto out;
+            }
+            branch_node->parent = node->parent;
+            branch_node->child[wolfsentry_route_trie_bit(addr, common)] = new_node;
+            branch_node->child[wolfsentry_route_trie_bit(node->prefix, common)] = node;
+            new_node->parent = node->parent = branch_node;
+            *node_p = branch_node;
+        }
+        node = new_node;
+        break;
+    }
+
+    route->trie_node = node;
+    route->index_next = node->routes;
+    node->routes = route;
+    ret = WOLFSENTRY_ERROR_ENCODE(OK);
+
+  out:
+
+    if ((trie->remote_root == NULL) && (trie->local_root == NULL))
+        wolfsentry_route_trie_free(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, trie);
+
+    WOLFSENTRY_ERROR_RERETURN(ret);
+}
+
+static void wolfsentry_route_trie_delete(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route)
+{
+    struct wolfsentry_route_trie_node *node = route->trie_node;
+    struct wolfsentry_route_trie *trie = wolfsentry_route_trie_find(route_table, route->sa_family);
+    struct wolfsentry_route **i;
+
+    for (i = &node->routes; *i; i = &(*i)->index_next) {
+        if (*i == route) {
+            *i = route->index_next;
+            break;
+        }
+    }
+    route->trie_node = NULL;
+    route->index_next = NULL;
+
+    /* nodes without routes are kept only as branches, so prune back up the
+     * trie until reaching one that still has routes or two children.
+     */
+    while (node && (node->routes == NULL) && ((node->child[0] == NULL) || (node->child[1] == NULL))) {
+        struct wolfsentry_route_trie_node *parent = node->parent;
+        struct wolfsentry_route_trie_node *only_child = node->child[0] ? node->child[0] : node->child[1];
+        if (parent)
+            parent->child[parent->child[1] == node] = only_child;
+        else if (trie->remote_root == node)
+            trie->remote_root = only_child;
+        else
+            trie->local_root = only_child;
+        if (only_child)
+            only_child->parent = parent;
+        WOLFSENTRY_FREE(node);
+        node = parent;
+    }
+
+    if ((trie->remote_root == NULL) && (trie->local_root == NULL))
+        wolfsentry_route_trie_free(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, trie);
+
+    WOLFSENTRY_RETURN_VOID;
+}
+
+static void wolfsentry_route_trie_search_subtree(
+    const struct wolfsentry_route_trie_node *node,
+    const struct wolfsentry_route *target_route,
+    const wolfsentry_action_res_t *action_results,
+    struct wolfsentry_route_index_search_state *state)
+{
+    for (; node; node = node->child[1]) {
+        wolfsentry_route_index_search_chain(node->routes, target_route, action_results, 0 /* probed_p */, 0 /* target_hash */, state);
+        wolfsentry_route_trie_search_subtree(node->child[0], target_route, action_results, state);
+    }
+}
+
+static void wolfsentry_route_trie_search_1(
+    const struct wolfsentry_route_trie_node *node,
+    const byte *addr,
+    wolfsentry_addr_bits_t addr_len,
+    int wildcard_p,
+    const struct wolfsentry_route *target_route,
+    const wolfsentry_action_res_t *action_results,
+    struct wolfsentry_route_index_search_state *state)
+{
+    if (wildcard_p) {
+        wolfsentry_route_trie_search_subtree(node, target_route, action_results, state);
+        return;
+    }
+
+    while (node) {
+        wolfsentry_addr_bits_t common = wolfsentry_route_trie_common_prefix(node->prefix, node->prefix_len, addr, addr_len);
+        if (node->prefix_len > addr_len) {
+            if (common == addr_len)
+                wolfsentry_route_trie_search_subtree(node, target_route, action_results, state);
+            return;
+        }
+        if (common < node->prefix_len)
+            return;
+        wolfsentry_route_index_search_chain(node->routes, target_route, action_results, 0 /* probed_p */, 0 /* target_hash */, state);
+        if (node->prefix_len == addr_len) {
+            wolfsentry_route_trie_search_subtree(node->child[0], target_route, action_results, state);
+            wolfsentry_route_trie_search_subtree(node->child[1], target_route, action_results, state);
+            return;
+        }
+        node = node->child[wolfsentry_route_trie_bit(addr, node->prefix_len)];
+    }
+}
+
+static void wolfsentry_route_trie_search(
+    const struct wolfsentry_route_table *table,
+    const struct wolfsentry_route *target_route,
+    const wolfsentry_action_res_t *action_results,
+    struct wolfsentry_route_index_search_state *state)
+{
+    struct wolfsentry_list_ent_header *i;
+
+    for (i = table->tries.head; i; i = i->next) {
+        const struct wolfsentry_route_trie *trie = container_of(i, struct wolfsentry_route_trie, header);
+        if ((! (target_route->flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD)) && (trie->sa_family != target_route->sa_family))
+            continue;
+        wolfsentry_route_trie_search_1(trie->remote_root, WOLFSENTRY_ROUTE_REMOTE_ADDR(target_route), target_route->remote.addr_len,
+                                       (target_route->flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD) != 0,
+                                       target_route, action_results, state);
+        wolfsentry_route_trie_search_1(trie->local_root, WOLFSENTRY_ROUTE_LOCAL_ADDR(target_route), target_route->local.addr_len,
+                                       (target_route->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD) != 0,
+                                       target_route, action_results, state);
+    }
+}
+
+/* the negative filter is a blocked Bloom filter with one key per route: the
+ * family and remote address prefix if the route has both as literals, else
+ * the family and local address prefix, else the family and local port.
+ * while every route in the table has one of these keys, a target that misses
+ * the filter on all three, at each prefix length in use for its family, can't
+ * match anything, and the lookup ends without visiting the indexes.
+ * deletions leave their bits behind, which only costs false positives, until
+ * enough accumulate to warrant a rebuild.
+ */
+
+enum wolfsentry_route_negative_filter_key {
+    WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_NONE = 0,
+    WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_REMOTE_ADDR = 1,
+    WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_ADDR = 2,
+    WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_PORT = 3
+};
+
+static enum wolfsentry_route_negative_filter_key wolfsentry_route_negative_filter_key(const struct wolfsentry_route *route) {
+    if (route->flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD)
+        return WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_NONE;
+    if ((! (route->flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD)) &&
+        (route->remote.addr_len > 0) &&
+        (route->remote.addr_len <= WOLFSENTRY_MAX_ADDR_BITS))
+    {
+        return WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_REMOTE_ADDR;
+    }
+    if ((! (route->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD)) &&
+        (route->local.addr_len > 0) &&
+        (route->local.addr_len <= WOLFSENTRY_MAX_ADDR_BITS))
+    {
+        return WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_ADDR;
+    }
+    if (! (route->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_PORT_WILDCARD))
+        return WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_PORT;
+    return WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_NONE;
+}
+
+/* prefix lengths are counted separately for IPv4, IPv6, and everything else,
+ * so that long prefixes in one family don't defeat the filter for another.
+ */
+static inline unsigned int wolfsentry_route_negative_filter_family_index(wolfsentry_addr_family_t sa_family) {
+    switch (sa_family) {
+    case WOLFSENTRY_AF_INET:
+        return 0;
+    case WOLFSENTRY_AF_INET6:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+/* a local port key is hashed as a prefix of all the port's bits. */
+static inline uint32_t wolfsentry_route_negative_filter_hash(enum wolfsentry_route_negative_filter_key key, wolfsentry_addr_family_t sa_family, const byte *addr, wolfsentry_addr_bits_t prefix_len) {
+    uint32_t hash = 2166136261U;
+    byte key_byte = (byte)key;
+    hash = wolfsentry_route_tuple_hash_bytes(hash, &key_byte, sizeof key_byte);
+    hash = wolfsentry_route_tuple_hash_bytes(hash, (const byte *)&sa_family, sizeof sa_family);
+    hash = wolfsentry_route_tuple_hash_bytes(hash, (const byte *)&prefix_len, sizeof prefix_len);
+    return wolfsentry_route_tuple_hash_addr(hash, addr, prefix_len);
+}
+
+/* the block is picked with the low bits of the hash, and the 3 bits within
+ * it with a remix of the full hash.
+ */
+static inline uint64_t wolfsentry_route_negative_filter_mask(uint32_t hash) {
+    hash ^= hash >> 16U;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13U;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16U;
+    return ((uint64_t)1 << (hash & 63U)) | ((uint64_t)1 << ((hash >> 6U) & 63U)) | ((uint64_t)1 << ((hash >> 12U) & 63U));
+}
+
+static inline int wolfsentry_route_negative_filter_has(const struct wolfsentry_route_negative_filter *filter, uint32_t hash) {
+    uint64_t mask = wolfsentry_route_negative_filter_mask(hash);
+    return (filter->blocks[hash & (filter->n_blocks - 1U)] & mask) == mask;
+}
+
+static void wolfsentry_route_negative_filter_add(struct wolfsentry_route_negative_filter *filter, const struct wolfsentry_route *route, enum wolfsentry_route_negative_filter_key key) {
+    const byte *addr;
+    wolfsentry_addr_bits_t addr_len;
+    uint32_t hash;
+    switch (key) {
+    case WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_REMOTE_ADDR:
+        addr = WOLFSENTRY_ROUTE_REMOTE_ADDR(route);
+        addr_len = route->remote.addr_len;
+        break;
+    case WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_ADDR:
+        addr = WOLFSENTRY_ROUTE_LOCAL_ADDR(route);
+        addr_len = route->local.addr_len;
+        break;
+    case WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_PORT:
+        addr = (const byte *)&route->local.sa_port;
+        addr_len = (wolfsentry_addr_bits_t)(sizeof route->local.sa_port * BITS_PER_BYTE);
+        break;
+    case WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_NONE:
+    default:
+        return;
+    }
+    hash = wolfsentry_route_negative_filter_hash(key, route->sa_family, addr, addr_len);
+    filter->blocks[hash & (filter->n_blocks - 1U)] |= wolfsentry_route_negative_filter_mask(hash);
+    ++filter->n_keys;
+}
+
+static void wolfsentry_route_negative_filter_rebuild(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table)
+{
+    struct wolfsentry_route_negative_filter *filter = route_table->negative_filter;
+    struct wolfsentry_table_ent_header *i;
+    uint32_t n_blocks = WOLFSENTRY_ROUTE_NEGATIVE_FILTER_MIN_BLOCKS;
+
+    while ((n_blocks * WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEYS_PER_BLOCK < route_table->n_filterable_routes * 2U) && (n_blocks < (1U << 24U)))
+        n_blocks <<= 1U;
+
+    if ((filter == NULL) || (filter->n_blocks != n_blocks)) {
+        filter = (struct wolfsentry_route_negative_filter *)WOLFSENTRY_MALLOC(offsetof(struct wolfsentry_route_negative_filter, blocks) + (n_blocks * sizeof filter->blocks[0]));
+        if (route_table->negative_filter != NULL)
+            WOLFSENTRY_FREE(route_table->negative_filter);
+        route_table->negative_filter = filter;
+        /* without a filter, lookups just take the long way. */
+        if (filter == NULL)
+            WOLFSENTRY_RETURN_VOID;
+        filter->n_blocks = n_blocks;
+    }
+    memset(filter->blocks, 0, n_blocks * sizeof filter->blocks[0]);
+    filter->n_keys = filter->n_stale = 0;
+
+    for (i = route_table->header.head; i; i = i->next)
+        wolfsentry_route_negative_filter_add(filter, (struct wolfsentry_route *)i, wolfsentry_route_negative_filter_key((struct wolfsentry_route *)i));
+
+    WOLFSENTRY_RETURN_VOID;
+}
+
+/* called with delta 1 after the route is linked into the table, and -1 after
+ * it is unlinked.  the counts decide which probes a lookup makes.
+ */
+static void wolfsentry_route_negative_filter_update(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route,
+    int delta)
+{
+    struct wolfsentry_route_negative_filter *filter = route_table->negative_filter;
+    enum wolfsentry_route_negative_filter_key key = wolfsentry_route_negative_filter_key(route);
+    unsigned int family_index = wolfsentry_route_negative_filter_family_index(route->sa_family);
+
+    switch (key) {
+    case WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_REMOTE_ADDR:
+        route_table->remote_prefix_len_counts[family_index][route->remote.addr_len] += (uint32_t)delta;
+        break;
+    case WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_ADDR:
+        route_table->local_prefix_len_counts[family_index][route->local.addr_len] += (uint32_t)delta;
+        break;
+    case WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_PORT:
+        route_table->n_local_port_keyed_routes[family_index] += (uint32_t)delta;
+        break;
+    case WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_NONE:
+    default:
+        route_table->n_unfilterable_routes += (uint32_t)delta;
+        WOLFSENTRY_RETURN_VOID;
+    }
+    route_table->n_filterable_routes += (uint32_t)delta;
+
+    if (delta > 0) {
+        if ((filter == NULL) || (filter->n_keys >= filter->n_blocks * WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEYS_PER_BLOCK))
+            wolfsentry_route_negative_filter_rebuild(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table);
+        else
+            wolfsentry_route_negative_filter_add(filter, route, key);
+    } else if ((filter != NULL) && (++filter->n_stale > (filter->n_keys >> 1U)))
+        wolfsentry_route_negative_filter_rebuild(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table);
+
+    WOLFSENTRY_RETURN_VOID;
+}
+
+/* returns nonzero if the filter holds the target's address at some prefix
+ * length in use for its family, if the target's address is a wildcard and any
+ * prefix length is in use, or if a route prefix longer than the target
+ * address, which can match it as a subnet, is in use.  for the catch-all
+ * family index, the lengths are shared by every other family, so any longer
+ * prefix is taken to be in the target's family.
+ */
+static int wolfsentry_route_negative_filter_addr_may_match(
+    const struct wolfsentry_route_negative_filter *filter,
+    const uint32_t *prefix_len_counts,
+    enum wolfsentry_route_negative_filter_key key,
+    wolfsentry_addr_family_t sa_family,
+    const byte *addr,
+    wolfsentry_addr_bits_t addr_len,
+    int wildcard_p)
+{
+    unsigned int prefix_len;
+
+    for (prefix_len = 1; prefix_len <= WOLFSENTRY_MAX_ADDR_BITS; ++prefix_len) {
+        if (prefix_len_counts[prefix_len] == 0)
+            continue;
+        if (wildcard_p || (prefix_len > addr_len))
+            return 1;
+        if (wolfsentry_route_negative_filter_has(filter, wolfsentry_route_negative_filter_hash(key, sa_family, addr, (wolfsentry_addr_bits_t)prefix_len)))
+            return 1;
+    }
+    return 0;
+}
+
+/* returns nonzero only if no route in the table can match the target. */
+static int wolfsentry_route_negative_filter_excludes(
+    const struct wolfsentry_route_table *route_table,
+    const struct wolfsentry_route *target_route)
+{
+    const struct wolfsentry_route_negative_filter *filter = route_table->negative_filter;
+    unsigned int family_index;
+    int remote_p;
+
+    if ((filter == NULL) || (route_table->n_unfilterable_routes > 0))
+        return 0;
+    if (target_route->flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD)
+        return 0;
+    family_index = wolfsentry_route_negative_filter_family_index(target_route->sa_family);
+
+    for (remote_p = 1; remote_p >= 0; --remote_p) {
+        if (wolfsentry_route_negative_filter_addr_may_match(
+                filter,
+                remote_p ? route_table->remote_prefix_len_counts[family_index] : route_table->local_prefix_len_counts[family_index],
+                remote_p ? WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_REMOTE_ADDR : WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_ADDR,
+                target_route->sa_family,
+                remote_p ? WOLFSENTRY_ROUTE_REMOTE_ADDR(target_route) : WOLFSENTRY_ROUTE_LOCAL_ADDR(target_route),
+                remote_p ? target_route->remote.addr_len : target_route->local.addr_len,
+                (target_route->flags & (remote_p ? WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD : WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD)) != 0))
+        {
+            return 0;
+        }
+    }
+
+    if (route_table->n_local_port_keyed_routes[family_index] > 0) {
+        if (target_route->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_PORT_WILDCARD)
+            return 0;
+        if (wolfsentry_route_negative_filter_has(filter, wolfsentry_route_negative_filter_hash(WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEY_LOCAL_PORT, target_route->sa_family, (const byte *)&target_route->local.sa_port, (wolfsentry_addr_bits_t)(sizeof target_route->local.sa_port * BITS_PER_BYTE))))
+            return 0;
+    }
+
+    return 1;
+}
+
+WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_index_insert(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route)
+{
+    wolfsentry_addr_bits_t addr_len = 0;
+    int remote_p = 0;
+    const byte *addr = wolfsentry_route_trie_key(route, &addr_len, &remote_p);
+
+    wolfsentry_errcode_t ret;
+
+    wolfsentry_route_table_generation_bump(route_table);
+    if (addr)
+        ret = wolfsentry_route_trie_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route, addr, addr_len, remote_p);
+    else
+        ret = wolfsentry_route_tuple_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route);
+    WOLFSENTRY_RERETURN_IF_ERROR(ret);
+    wolfsentry_route_negative_filter_update(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route, 1);
+    WOLFSENTRY_RETURN_OK;
+}
+
+static void wolfsentry_route_index_delete(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route)
+{
+    wolfsentry_route_table_generation_bump(route_table);
+    if (route->trie_node)
+        wolfsentry_route_trie_delete(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route);
+    else if (route->tuple)
+        wolfsentry_route_tuple_delete(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route);
+    wolfsentry_route_negative_filter_update(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route, -1);
+    WOLFSENTRY_RETURN_VOID;
+}
+
+static void wolfsentry_route_update_flags_1(
+    struct wolfsentry_route *route,
+    wolfsentry_route_flags_t flags_to_set,
+    wolfsentry_route_flags_t flags_to_clear,
+    wolfsentry_route_flags_t *flags_before,
+    wolfsentry_route_flags_t *flags_after);
+
+static void wolfsentry_route_free_1(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route *route,
+    size_t size,
+    int aligned)
+{
+    if (! aligned)
+        WOLFSENTRY_SLAB_FREE_ROUTE(route, size);
+    else
+        WOLFSENTRY_FREE_ALIGNED(route);
+    WOLFSENTRY_RETURN_VOID;
+}
+
+static wolfsentry_errcode_t wolfsentry_route_drop_reference_1(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route *route,
+    wolfsentry_action_res_t *action_results)
+{
+    wolfsentry_errcode_t ret;
+    wolfsentry_refcount_t refs_left;
+    if (route->header.refcount <= 0)
+        WOLFSENTRY_ERROR_RETURN(INTERNAL_CHECK_FATAL);
+    if ((route->header.parent_table != NULL) &&
+        (route->header.parent_table->ent_type != WOLFSENTRY_OBJECT_TYPE_ROUTE))
+        WOLFSENTRY_ERROR_RETURN(WRONG_OBJECT);
+    WOLFSENTRY_REFCOUNT_DECREMENT(route->header.refcount, refs_left, ret);
+    WOLFSENTRY_RERETURN_IF_ERROR(ret);
+    if (refs_left > 0)
+        WOLFSENTRY_RETURN_OK;
+    if (route->parent_event)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, route->parent_event, NULL /* action_results */));
+    wolfsentry_route_free_1(WOLFSENTRY_CONTEXT_ARGS_OUT, route, offsetof(struct wolfsentry_route, data) + route->data_addr_size, route->allocated_aligned);
+    if (action_results)
+        WOLFSENTRY_SET_BITS(*action_results, WOLFSENTRY_ACTION_RES_DEALLOCATED);
+    WOLFSENTRY_RETURN_OK;
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_drop_reference(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route *route,
+    wolfsentry_action_res_t *action_results)
+{
+    if (action_results)
+        WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, route, action_results));
+}
+
+static wolfsentry_errcode_t wolfsentry_route_drop_reference_generic(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_table_ent_header *route,
+    wolfsentry_action_res_t *action_results)
+{
+    if (action_results)
+        WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, (struct wolfsentry_route *)route, action_results));
+}
+
+static wolfsentry_errcode_t wolfsentry_route_init(
+    struct wolfsentry_event *parent_event,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    int data_addr_offset,
+    size_t data_addr_size,
+    struct wolfsentry_route *new)
+{
+    if (data_addr_size < WOLFSENTRY_BITS_TO_BYTES(remote->addr_len) + WOLFSENTRY_BITS_TO_BYTES(local->addr_len))
+        WOLFSENTRY_ERROR_RETURN(BUFFER_TOO_SMALL);
+    if (data_addr_size > MAX_UINT_OF(uint16_t))
+        WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
+    if ((unsigned)data_addr_offset > MAX_UINT_OF(uint16_t))
+        WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
+    if (! (flags & (WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN | WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT)))
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+
+    /* make sure wildcards are sensical. */
+    if (((flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD) &&
+         ((! (flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD)) ||
+          (! (flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD)) ||
+          (! (flags & WOLFSENTRY_ROUTE_FLAG_SA_PROTO_WILDCARD)))) ||
+        ((flags & WOLFSENTRY_ROUTE_FLAG_SA_PROTO_WILDCARD) &&
+         ((! (flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_PORT_WILDCARD)) ||
+          (! (flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_PORT_WILDCARD)))))
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+
+    memset(new, 0, offsetof(struct wolfsentry_route, data));
+
+    new->parent_event = parent_event;
+    new->flags = flags;
+    new->sa_family = remote->sa_family;
+    new->sa_proto = remote->sa_proto;
+    new->remote.sa_port = remote->sa_port;
+    new->remote.addr_len = remote->addr_len;
+    new->remote.interface = remote->interface;
+    new->local.sa_port = local->sa_port;
+    new->local.addr_len = local->addr_len;
+    new->local.interface = local->interface;
+    new->data_addr_offset = (uint16_t)data_addr_offset;
+    new->data_addr_size = (uint16_t)data_addr_size;
+
+    if (data_addr_offset > 0)
+        memset(new->data, 0, (size_t)data_addr_offset); /* zero private data. */
+
+    if (remote->addr_len > 0)
+        memcpy(WOLFSENTRY_ROUTE_REMOTE_ADDR(new), remote->addr, WOLFSENTRY_BITS_TO_BYTES(remote->addr_len));
+    if (local->addr_len > 0)
+        memcpy(WOLFSENTRY_ROUTE_LOCAL_ADDR(new), local->addr, WOLFSENTRY_BITS_TO_BYTES(local->addr_len));
+
+    /* make sure the pad bits in the addresses are zero. */
+    {
+        int left_over_bits = remote->addr_len % BITS_PER_BYTE;
+        if (left_over_bits) {
+            byte *remote_lsb = WOLFSENTRY_ROUTE_REMOTE_ADDR(new) + WOLFSENTRY_BITS_TO_BYTES(remote->addr_len) - 1;
+            if (*remote_lsb & (0xffU >> left_over_bits))
+                *remote_lsb = (byte)(*remote_lsb & (0xffU << (BITS_PER_BYTE - left_over_bits)));
+        }
+    }
+    {
+        int left_over_bits = local->addr_len % BITS_PER_BYTE;
+        if (left_over_bits) {
+            byte *local_lsb = WOLFSENTRY_ROUTE_LOCAL_ADDR(new) + WOLFSENTRY_BITS_TO_BYTES(local->addr_len) - 1;
+            if (*local_lsb & (0xffU >> left_over_bits))
+                *local_lsb = (byte)(*local_lsb & (0xffU << (BITS_PER_BYTE - left_over_bits)));
+        }
+    }
+
+    wolfsentry_route_update_key_copies(new);
+
+    new->header.refcount = 1;
+    new->header.id = WOLFSENTRY_ENT_ID_NONE;
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+static wolfsentry_errcode_t wolfsentry_route_init_by_exports(
+    struct wolfsentry_event *parent_event,
+    const struct wolfsentry_route_exports *route_exports,
+    size_t data_addr_offset,
+    size_t data_addr_size,
+    struct wolfsentry_route *new)
+{
     if (route_exports->private_data_size > data_addr_offset)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
     if (data_addr_size < WOLFSENTRY_BITS_TO_BYTES(route_exports->remote.addr_len) + WOLFSENTRY_BITS_TO_BYTES(route_exports->local.addr_len))
@@ -520,19 +1531,21 @@ static wolfsentry_errcode_t wolfsentry_route_init_by_exports(
         int left_over_bits = route_exports->remote.addr_len % BITS_PER_BYTE;
         if (left_over_bits) {
             byte *remote_lsb = WOLFSENTRY_ROUTE_REMOTE_ADDR(new) + WOLFSENTRY_BITS_TO_BYTES(route_exports->remote.addr_len) - 1;
-            if (*remote_lsb & (0xffU >> (BITS_PER_BYTE - left_over_bits)))
-                *remote_lsb = (byte)(*remote_lsb & (0xffU << left_over_bits));
+            if (*remote_lsb & (0xffU >> left_over_bits))
+                *remote_lsb = (byte)(*remote_lsb & (0xffU << (BITS_PER_BYTE - left_over_bits)));
         }
     }
     {
         int left_over_bits = route_exports->local.addr_len % BITS_PER_BYTE;
         if (left_over_bits) {
             byte *local_lsb = WOLFSENTRY_ROUTE_LOCAL_ADDR(new) + WOLFSENTRY_BITS_TO_BYTES(route_exports->local.addr_len) - 1;
-            if (*local_lsb & (0xffU >> (BITS_PER_BYTE - left_over_bits)))
-                *local_lsb = (byte)(*local_lsb & (0xffU << left_over_bits));
+            if (*local_lsb & (0xffU >> left_over_bits))
+                *local_lsb = (byte)(*local_lsb & (0xffU << (BITS_PER_BYTE - left_over_bits)));
         }
     }
 
+    wolfsentry_route_update_key_copies(new);
+
     new->header.refcount = 1;
     new->header.id = WOLFSENTRY_ENT_ID_NONE;
 
@@ -554,23 +1567,21 @@ static wolfsentry_errcode_t wolfsentry_route_new(
     new_size = WOLFSENTRY_BITS_TO_BYTES(remote->addr_len) + WOLFSENTRY_BITS_TO_BYTES(local->addr_len);
     if (new_size > (size_t)(uint16_t)~0UL)
         WOLFSENTRY_ERROR_RETURN(STRING_ARG_TOO_LONG);
-    new_size += offsetof(struct wolfsentry_route, data);
-    new_size += config->config.route_private_data_size;
-    if (new_size & 1)
-        ++new_size;
+    new_size = WOLFSENTRY_ROUTE_ALLOC_SIZE(new_size, config->config.route_private_data_size);
     /* extra_ports storage will go here. */
 
     if (config->config.route_private_data_alignment == 0)
-        *new = (struct wolfsentry_route *)WOLFSENTRY_MALLOC(new_size);
+        *new = (struct wolfsentry_route *)WOLFSENTRY_SLAB_ALLOC_ROUTE(new_size);
     else
         *new = WOLFSENTRY_MEMALIGN(config->config.route_private_data_alignment, new_size);
     if (*new == NULL)
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     ret = wolfsentry_route_init(parent_event, remote, local, flags, (int)config->config.route_private_data_size, new_size - offsetof(struct wolfsentry_route, data), *new);
     if (ret < 0) {
-        wolfsentry_route_free_1(WOLFSENTRY_CONTEXT_ARGS_OUT, config, *new);
+        wolfsentry_route_free_1(WOLFSENTRY_CONTEXT_ARGS_OUT, *new, new_size, config->config.route_private_data_alignment != 0);
         *new = NULL;
     } else {
+        (*new)->allocated_aligned = (config->config.route_private_data_alignment != 0);
         if (parent_event != NULL) {
             WOLFSENTRY_REFCOUNT_INCREMENT(parent_event->header.refcount, ret);
         }
@@ -579,6 +1590,85 @@ static wolfsentry_errcode_t wolfsentry_route_new(
     WOLFSENTRY_ERROR_RERETURN(ret);
 }
 
+#ifndef WOLFSENTRY_ROUTE_TRANSIENT_PRIVATE_DATA_MAX
+#define WOLFSENTRY_ROUTE_TRANSIENT_PRIVATE_DATA_MAX 64
+#endif
+
+/* caller-supplied storage for a short-lived route, e.g. the target of an event
+ * dispatch.  private data up to WOLFSENTRY_ROUTE_TRANSIENT_PRIVATE_DATA_MAX
+ * bytes (after alignment padding), at an alignment up to the same size, fits
+ * without a heap allocation.  the route may start past &route to satisfy
+ * route_private_data_alignment.  this saves only the target route's own
+ * allocation -- a dispatch is allocation-free only when it matches a rule
+ * route, or falls through to the table's fallthrough route with no post
+ * actions.  otherwise, the interim rule route is still cloned on the heap, and
+ * the dispatch may insert a new route.
+ */
+struct wolfsentry_route_transient {
+    struct wolfsentry_route route;
+    byte buf[(WOLFSENTRY_ROUTE_TRANSIENT_PRIVATE_DATA_MAX * 2) + (WOLFSENTRY_MAX_ADDR_BYTES * 2) + 1];
+};
+
+#define WOLFSENTRY_ROUTE_IS_TRANSIENT(storage, r) \
+    (((const byte *)(r) >= (const byte *)(storage)) && ((const byte *)(r) < (const byte *)((storage) + 1)))
+
+/* like wolfsentry_route_new(), but builds the route in *storage if it fits,
+ * falling back to the heap otherwise.  a route built in *storage holds no
+ * reference to parent_event, so the caller must hold one for the life of the
+ * route, and must dispose of the route with wolfsentry_route_drop_transient()
+ * rather than wolfsentry_route_drop_reference_1().  it is marked
+ * WOLFSENTRY_TABLE_ENT_FLAG_TRANSIENT, so wolfsentry_object_checkout() and
+ * wolfsentry_route_insert_1() refuse it.
+ */
+static wolfsentry_errcode_t wolfsentry_route_new_transient(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_event *parent_event,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    struct wolfsentry_route_transient *storage,
+    struct wolfsentry_route **new)
+{
+    size_t new_size;
+    byte *start = (byte *)&storage->route;
+    wolfsentry_errcode_t ret;
+    struct wolfsentry_eventconfig_internal *config = (parent_event && parent_event->config) ? parent_event->config : &wolfsentry->config;
+
+    new_size = WOLFSENTRY_ROUTE_ALLOC_SIZE(WOLFSENTRY_BITS_TO_BYTES(remote->addr_len) + WOLFSENTRY_BITS_TO_BYTES(local->addr_len), config->config.route_private_data_size);
+
+    if (config->config.route_private_data_alignment > 0)
+        start += (config->config.route_private_data_alignment - ((uintptr_t)start & (config->config.route_private_data_alignment - 1))) & (config->config.route_private_data_alignment - 1);
+
+    if ((new_size > sizeof *storage) || (start + new_size > (byte *)(storage + 1)))
+        WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_new(WOLFSENTRY_CONTEXT_ARGS_OUT, parent_event, remote, local, flags, new));
+
+    *new = (struct wolfsentry_route *)(void *)start;
+    ret = wolfsentry_route_init(parent_event, remote, local, flags, (int)config->config.route_private_data_size, new_size - offsetof(struct wolfsentry_route, data), *new);
+    if (ret < 0)
+        *new = NULL;
+    else
+        (*new)->header.ent_flags |= WOLFSENTRY_TABLE_ENT_FLAG_TRANSIENT;
+
+    WOLFSENTRY_ERROR_RERETURN(ret);
+}
+
+/* a route built in *storage can't outlive it.  retention is refused at
+ * checkout, so a leftover reference here means that check was bypassed.
+ */
+static wolfsentry_errcode_t wolfsentry_route_drop_transient(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_transient *storage,
+    struct wolfsentry_route *route)
+{
+    if (! WOLFSENTRY_ROUTE_IS_TRANSIENT(storage, route)) {
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, route, NULL /* action_results */));
+        WOLFSENTRY_RETURN_OK;
+    }
+    if (route->header.refcount != 1)
+        WOLFSENTRY_ERROR_RETURN(INTERNAL_CHECK_FATAL);
+    WOLFSENTRY_RETURN_OK;
+}
+
 static wolfsentry_errcode_t wolfsentry_route_new_by_exports(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     struct wolfsentry_event *parent_event,
@@ -595,23 +1685,21 @@ static wolfsentry_errcode_t wolfsentry_route_new_by_exports(
     new_size = WOLFSENTRY_BITS_TO_BYTES(route_exports->remote.addr_len) + WOLFSENTRY_BITS_TO_BYTES(route_exports->local.addr_len);
     if (new_size > (size_t)(uint16_t)~0UL)
         WOLFSENTRY_ERROR_RETURN(STRING_ARG_TOO_LONG);
-    new_size += offsetof(struct wolfsentry_route, data);
-    new_size += config->config.route_private_data_size;
-    if (new_size & 1)
-        ++new_size;
+    new_size = WOLFSENTRY_ROUTE_ALLOC_SIZE(new_size, config->config.route_private_data_size);
     /* extra_ports storage will go here. */
 
     if (config->config.route_private_data_alignment == 0)
-        *new = (struct wolfsentry_route *)WOLFSENTRY_MALLOC(new_size);
+        *new = (struct wolfsentry_route *)WOLFSENTRY_SLAB_ALLOC_ROUTE(new_size);
     else
         *new = WOLFSENTRY_MEMALIGN(config->config.route_private_data_alignment, new_size);
     if (*new == NULL)
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     ret = wolfsentry_route_init_by_exports(parent_event, route_exports, config->config.route_private_data_size, new_size - offsetof(struct wolfsentry_route, data), *new);
     if (ret < 0) {
-        wolfsentry_route_free_1(WOLFSENTRY_CONTEXT_ARGS_OUT, config, *new);
+        wolfsentry_route_free_1(WOLFSENTRY_CONTEXT_ARGS_OUT, *new, new_size, config->config.route_private_data_alignment != 0);
         *new = NULL;
     } else {
+        (*new)->allocated_aligned = (config->config.route_private_data_alignment != 0);
         if (parent_event != NULL) {
             WOLFSENTRY_REFCOUNT_INCREMENT(parent_event->header.refcount, ret);
         }
@@ -689,16 +1777,21 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_clone(
     new_size = WOLFSENTRY_BITS_TO_BYTES((size_t)src_route->remote.addr_len) + WOLFSENTRY_BITS_TO_BYTES((size_t)src_route->local.addr_len);
     if (new_size > (size_t)(uint16_t)~0UL)
         WOLFSENTRY_ERROR_RETURN(STRING_ARG_TOO_LONG);
-    new_size += offsetof(struct wolfsentry_route, data);
-    new_size += config->config.route_private_data_size;
-    if (new_size & 1)
-        ++new_size;
+    new_size = WOLFSENTRY_ROUTE_ALLOC_SIZE(new_size, config->config.route_private_data_size);
     /* extra_ports storage will go here. */
 
-    if ((*new_route = WOLFSENTRY_MALLOC_1(dest_context->hpi.allocator, new_size)) == NULL)
+    if (config->config.route_private_data_alignment == 0)
+        *new_route = (struct wolfsentry_route *)WOLFSENTRY_SLAB_ALLOC_ROUTE_1(dest_context, new_size);
+    else
+        *new_route = (struct wolfsentry_route *)WOLFSENTRY_MEMALIGN_1(dest_context->hpi.allocator, config->config.route_private_data_alignment, new_size);
+    if (*new_route == NULL)
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     memcpy(*new_route, src_route, new_size);
+    (*new_route)->allocated_aligned = (config->config.route_private_data_alignment != 0);
     WOLFSENTRY_TABLE_ENT_HEADER_RESET(**new_ent);
+    (*new_route)->tuple = NULL;
+    (*new_route)->trie_node = NULL;
+    (*new_route)->index_next = NULL;
 
     if (src_route->parent_event) {
         (*new_route)->parent_event = src_route->parent_event;
@@ -707,7 +1800,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_clone(
 #ifdef WOLFSENTRY_THREADSAFE
                                     thread,
 #endif
-                                    config, *new_route);
+                                    *new_route, new_size, config->config.route_private_data_alignment != 0);
             WOLFSENTRY_ERROR_RERETURN(ret);
         }
         WOLFSENTRY_REFCOUNT_INCREMENT((*new_route)->parent_event->header.refcount, ret);
@@ -739,6 +1832,49 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_check_flags_sensical(wolfse
     WOLFSENTRY_RETURN_OK;
 }
 
+/* applies the eventconfig's on-insert flag edits and zeroes wildcarded fields,
+ * leaving route_to_insert in the form it will have in the table.  idempotent.
+ */
+static wolfsentry_errcode_t wolfsentry_route_normalize_for_insert(
+    const struct wolfsentry_eventconfig_internal *config,
+    struct wolfsentry_route *route_to_insert)
+{
+    wolfsentry_errcode_t ret;
+
+    if (config->config.route_flags_to_clear_on_insert != 0)
+        WOLFSENTRY_CLEAR_BITS(route_to_insert->flags, config->config.route_flags_to_clear_on_insert);
+
+    if (config->config.route_flags_to_add_on_insert != 0)
+        WOLFSENTRY_SET_BITS(route_to_insert->flags, config->config.route_flags_to_add_on_insert);
+
+    ret = wolfsentry_route_check_flags_sensical(route_to_insert->flags);
+    WOLFSENTRY_RERETURN_IF_ERROR(ret);
+
+    /* fields marked as wildcards must be zeroed before insertion to meet
+     * assumptions of table lookup logic.
+     */
+    if ((route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD) && (route_to_insert->remote.addr_len != 0))
+        memset(WOLFSENTRY_ROUTE_REMOTE_ADDR(route_to_insert), 0, WOLFSENTRY_ROUTE_REMOTE_ADDR_BYTES(route_to_insert));
+    if ((route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD) && (route_to_insert->local.addr_len != 0))
+        memset(WOLFSENTRY_ROUTE_LOCAL_ADDR(route_to_insert), 0, WOLFSENTRY_ROUTE_LOCAL_ADDR_BYTES(route_to_insert));
+    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD)
+        route_to_insert->sa_family = 0;
+    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_PROTO_WILDCARD)
+        route_to_insert->sa_proto = 0;
+    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_PORT_WILDCARD)
+        route_to_insert->remote.sa_port = 0;
+    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_REMOTE_INTERFACE_WILDCARD)
+        route_to_insert->remote.interface = 0;
+    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_PORT_WILDCARD)
+        route_to_insert->local.sa_port = 0;
+    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_LOCAL_INTERFACE_WILDCARD)
+        route_to_insert->local.interface = 0;
+
+    wolfsentry_route_update_key_copies(route_to_insert);
+
+    WOLFSENTRY_RETURN_OK;
+}
+
 static wolfsentry_errcode_t wolfsentry_route_insert_1(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     void *caller_arg, /* passed to action callback(s) as the caller_arg. */
@@ -751,13 +1887,10 @@ static wolfsentry_errcode_t wolfsentry_route_insert_1(
     wolfsentry_errcode_t ret;
     struct wolfsentry_eventconfig_internal *config = (route_to_insert->parent_event && route_to_insert->parent_event->config) ? route_to_insert->parent_event->config : &wolfsentry->config;
 
-    if (config->config.route_flags_to_clear_on_insert != 0)
-        WOLFSENTRY_CLEAR_BITS(route_to_insert->flags, config->config.route_flags_to_clear_on_insert);
-
-    if (config->config.route_flags_to_add_on_insert != 0)
-        WOLFSENTRY_SET_BITS(route_to_insert->flags, config->config.route_flags_to_add_on_insert);
+    if (route_to_insert->header.ent_flags & WOLFSENTRY_TABLE_ENT_FLAG_TRANSIENT)
+        WOLFSENTRY_ERROR_RETURN(INCOMPATIBLE_STATE);
 
-    ret = wolfsentry_route_check_flags_sensical(route_to_insert->flags);
+    ret = wolfsentry_route_normalize_for_insert(config, route_to_insert);
     WOLFSENTRY_RERETURN_IF_ERROR(ret);
 
     if (WOLFSENTRY_CHECK_BITS(route_to_insert->flags, WOLFSENTRY_ROUTE_FLAG_IN_TABLE))
@@ -769,26 +1902,6 @@ static wolfsentry_errcode_t wolfsentry_route_insert_1(
     if ((route_to_insert->meta.purge_after != 0) && (route_to_insert->meta.purge_after <= route_to_insert->meta.insert_time))
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
 
-    /* fields marked as wildcards must be zeroed before insertion to meet
-     * assumptions of table lookup logic.
-     */
-    if ((route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD) && (route_to_insert->remote.addr_len != 0))
-        memset(WOLFSENTRY_ROUTE_REMOTE_ADDR(route_to_insert), 0, WOLFSENTRY_ROUTE_REMOTE_ADDR_BYTES(route_to_insert));
-    if ((route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD) && (route_to_insert->local.addr_len != 0))
-        memset(WOLFSENTRY_ROUTE_LOCAL_ADDR(route_to_insert), 0, WOLFSENTRY_ROUTE_LOCAL_ADDR_BYTES(route_to_insert));
-    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD)
-        route_to_insert->sa_family = 0;
-    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_PROTO_WILDCARD)
-        route_to_insert->sa_proto = 0;
-    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_PORT_WILDCARD)
-        route_to_insert->remote.sa_port = 0;
-    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_REMOTE_INTERFACE_WILDCARD)
-        route_to_insert->remote.interface = 0;
-    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_PORT_WILDCARD)
-        route_to_insert->local.sa_port = 0;
-    if (route_to_insert->flags & WOLFSENTRY_ROUTE_FLAG_LOCAL_INTERFACE_WILDCARD)
-        route_to_insert->local.interface = 0;
-
     if (*action_results & WOLFSENTRY_ACTION_RES_DEROGATORY)
         ++route_to_insert->meta.derogatory_count;
     if (*action_results & WOLFSENTRY_ACTION_RES_COMMENDABLE)
@@ -806,7 +1919,7 @@ static wolfsentry_errcode_t wolfsentry_route_insert_1(
             WOLFSENTRY_ERROR_RERETURN(ret);
 
         if ((max_purgeable_routes > 0) &&
-            (route_table->purge_list.len >= max_purgeable_routes))
+            (route_table->purge_wheel.len >= max_purgeable_routes))
         {
             ret = wolfsentry_route_stale_purge_one_unconditionally(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, NULL /* action_results */);
             WOLFSENTRY_RERETURN_IF_ERROR(ret);
@@ -822,11 +1935,17 @@ static wolfsentry_errcode_t wolfsentry_route_insert_1(
         route_to_insert->header.id = WOLFSENTRY_ENT_ID_NONE;
         WOLFSENTRY_ERROR_RERETURN(ret);
     }
+    if ((ret = wolfsentry_route_index_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route_to_insert)) < 0) {
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_table_ent_delete_1(WOLFSENTRY_CONTEXT_ARGS_OUT, &route_to_insert->header));
+        WOLFSENTRY_CLEAR_BITS(route_to_insert->flags, WOLFSENTRY_ROUTE_FLAG_IN_TABLE);
+        route_to_insert->header.id = WOLFSENTRY_ENT_ID_NONE;
+        WOLFSENTRY_ERROR_RERETURN(ret);
+    }
 
     WOLFSENTRY_SET_BITS(*action_results, WOLFSENTRY_ACTION_RES_INSERTED); /* signals to _dispatch_0() that counts were assigned to the newly inserted route. */
 
     if (route_to_insert->meta.purge_after)
-        wolfsentry_route_purge_list_insert(route_table, route_to_insert);
+        wolfsentry_route_purge_wheel_insert(route_table, route_to_insert);
 
     if (route_to_insert->parent_event && (wolfsentry_list_ent_get_len(&route_to_insert->parent_event->insert_action_list.header) > 0)) {
         ret = wolfsentry_action_list_dispatch(
@@ -842,6 +1961,7 @@ static wolfsentry_errcode_t wolfsentry_route_insert_1(
         if (ret < 0) {
             wolfsentry_route_flags_t flags_before, flags_after;
             WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_table_ent_delete_1(WOLFSENTRY_CONTEXT_ARGS_OUT, &route_to_insert->header));
+            wolfsentry_route_index_delete(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route_to_insert);
             wolfsentry_route_update_flags_1(route_to_insert, WOLFSENTRY_ROUTE_FLAG_NONE, WOLFSENTRY_ROUTE_FLAG_IN_TABLE, &flags_before, &flags_after);
         }
     } else {
@@ -1019,57 +2139,535 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_insert(
             action_results));
 }
 
-WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_insert_into_table_and_check_out(
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_insert_into_table_and_check_out(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    const char *event_label,
+    int event_label_len,
+    struct wolfsentry_route **route,
+    wolfsentry_action_res_t *action_results)
+{
+    wolfsentry_errcode_t ret;
+    struct wolfsentry_event *event = NULL;
+
+    WOLFSENTRY_MUTEX_OR_RETURN();
+
+    if (event_label) {
+        if ((ret = wolfsentry_event_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event_label, event_label_len, &event)) < 0)
+            WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+    }
+    WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
+    ret = wolfsentry_route_insert_2(WOLFSENTRY_CONTEXT_ARGS_OUT, caller_arg, route_table, remote, local, flags, event, NULL /* id */, route, action_results);
+    if (event != NULL)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event, NULL /* action_results */));
+    WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_insert_and_check_out(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    const char *event_label,
+    int event_label_len,
+    struct wolfsentry_route **route,
+    wolfsentry_action_res_t *action_results)
+{
+    WOLFSENTRY_ERROR_RERETURN(
+        wolfsentry_route_insert_into_table_and_check_out(
+            WOLFSENTRY_CONTEXT_ARGS_OUT,
+            wolfsentry->routes,
+            caller_arg,
+            remote,
+            local,
+            flags,
+            event_label,
+            event_label_len,
+            route,
+            action_results));
+}
+
+/* bulk route loading.  routes are constructed as they're added, and at commit
+ * are sorted once, checked for duplicates in a single pass, and inserted in
+ * ascending order, so that each insert links at the tail of the table (see
+ * wolfsentry_table_ent_insert()) rather than descending the tree.
+ */
+struct wolfsentry_route_bulk_insert {
+    struct wolfsentry_route_table *route_table; /* null for the main table. */
+    struct wolfsentry_route **routes;
+    unsigned int n_routes;
+    unsigned int n_routes_alloced;
+};
+
+static void wolfsentry_route_bulk_insert_sift_down(struct wolfsentry_route **routes, unsigned int i, unsigned int n) {
+    for (;;) {
+        unsigned int child = (i * 2U) + 1U;
+        struct wolfsentry_route *swap;
+        if (child >= n)
+            return;
+        if ((child + 1U < n) &&
+            (wolfsentry_route_key_cmp(&routes[child]->header, &routes[child + 1U]->header) < 0))
+        {
+            ++child;
+        }
+        if (wolfsentry_route_key_cmp(&routes[i]->header, &routes[child]->header) >= 0)
+            return;
+        swap = routes[i];
+        routes[i] = routes[child];
+        routes[child] = swap;
+        i = child;
+    }
+}
+
+/* in-place heapsort, to keep commit free of allocations beyond the routes
+ * themselves.
+ */
+static void wolfsentry_route_bulk_insert_sort(struct wolfsentry_route **routes, unsigned int n) {
+    unsigned int i;
+    struct wolfsentry_route *swap;
+
+    if (n < 2)
+        return;
+    for (i = n / 2U; i > 0; --i)
+        wolfsentry_route_bulk_insert_sift_down(routes, i - 1U, n);
+    for (i = n - 1U; i > 0; --i) {
+        swap = routes[0];
+        routes[0] = routes[i];
+        routes[i] = swap;
+        wolfsentry_route_bulk_insert_sift_down(routes, 0, i);
+    }
+}
+
+static void wolfsentry_route_bulk_insert_free(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_bulk_insert *bulk,
+    unsigned int first_unconsumed)
+{
+    unsigned int i;
+    for (i = first_unconsumed; i < bulk->n_routes; ++i)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, bulk->routes[i], NULL /* action_results */));
+    if (bulk->routes != NULL)
+        WOLFSENTRY_FREE(bulk->routes);
+    WOLFSENTRY_FREE(bulk);
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_bulk_insert_begin(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    unsigned int n_routes_hint,
+    struct wolfsentry_route_bulk_insert **bulk)
+{
+    if (bulk == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    if ((*bulk = (struct wolfsentry_route_bulk_insert *)WOLFSENTRY_MALLOC(sizeof **bulk)) == NULL)
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+    memset(*bulk, 0, sizeof **bulk);
+    (*bulk)->route_table = route_table;
+    if (n_routes_hint > 0) {
+        if (n_routes_hint > (unsigned int)(MAX_SINT_OF(int) / sizeof *(*bulk)->routes)) {
+            WOLFSENTRY_FREE(*bulk);
+            *bulk = NULL;
+            WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
+        }
+        if (((*bulk)->routes = (struct wolfsentry_route **)WOLFSENTRY_MALLOC(n_routes_hint * sizeof *(*bulk)->routes)) == NULL) {
+            WOLFSENTRY_FREE(*bulk);
+            *bulk = NULL;
+            WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+        }
+        (*bulk)->n_routes_alloced = n_routes_hint;
+    }
+    WOLFSENTRY_RETURN_OK;
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_bulk_insert_add(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_bulk_insert *bulk,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    const char *event_label,
+    int event_label_len)
+{
+    wolfsentry_errcode_t ret;
+    struct wolfsentry_event *event = NULL;
+    struct wolfsentry_route *new = NULL;
+
+    if (bulk == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    if ((remote->sa_family != local->sa_family) ||
+        (remote->sa_proto != local->sa_proto))
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+
+    WOLFSENTRY_MUTEX_OR_RETURN();
+
+    if (bulk->n_routes == bulk->n_routes_alloced) {
+        unsigned int new_n_alloced = bulk->n_routes_alloced ? bulk->n_routes_alloced * 2U : 16U;
+        struct wolfsentry_route **new_routes;
+        if (new_n_alloced > (unsigned int)(MAX_SINT_OF(int) / sizeof *bulk->routes))
+            WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(NUMERIC_ARG_TOO_BIG);
+        if (bulk->routes == NULL)
+            new_routes = (struct wolfsentry_route **)WOLFSENTRY_MALLOC(new_n_alloced * sizeof *bulk->routes);
+        else
+            new_routes = (struct wolfsentry_route **)WOLFSENTRY_REALLOC(bulk->routes, new_n_alloced * sizeof *bulk->routes);
+        if (new_routes == NULL)
+            WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(SYS_RESOURCE_FAILED);
+        bulk->routes = new_routes;
+        bulk->n_routes_alloced = new_n_alloced;
+    }
+
+    if (event_label) {
+        if ((ret = wolfsentry_event_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event_label, event_label_len, &event)) < 0)
+            WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+    }
+
+    if ((ret = wolfsentry_route_new(WOLFSENTRY_CONTEXT_ARGS_OUT, event, remote, local, flags, &new)) < 0)
+        goto out;
+
+    /* normalize now, so that the sort at commit sees the keys as they will be
+     * in the table.
+     */
+    ret = wolfsentry_route_normalize_for_insert((event && event->config) ? event->config : &wolfsentry->config, new);
+    if (ret < 0) {
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, new, NULL /* action_results */));
+        goto out;
+    }
+
+    bulk->routes[bulk->n_routes++] = new;
+
+  out:
+
+    if (event != NULL)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event, NULL /* action_results */));
+    WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_bulk_insert_commit(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_bulk_insert **bulk,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    unsigned int *n_inserted,
+    wolfsentry_action_res_t *action_results)
+{
+    wolfsentry_errcode_t ret;
+    struct wolfsentry_route_table *route_table;
+    unsigned int i;
+
+    if ((bulk == NULL) || (*bulk == NULL) || (action_results == NULL))
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+
+    WOLFSENTRY_MUTEX_OR_RETURN();
+
+    route_table = (*bulk)->route_table ? (*bulk)->route_table : wolfsentry->routes;
+    WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
+    if (n_inserted)
+        *n_inserted = 0;
+
+    wolfsentry_route_bulk_insert_sort((*bulk)->routes, (*bulk)->n_routes);
+
+    /* reject duplicates, within the batch or against the table, before
+     * anything is inserted.
+     */
+    for (i = 0; i < (*bulk)->n_routes; ++i) {
+        struct wolfsentry_table_ent_header *dup = &(*bulk)->routes[i]->header;
+        if ((i > 0) && (wolfsentry_route_key_cmp(&(*bulk)->routes[i - 1]->header, dup) == 0)) {
+            ret = WOLFSENTRY_ERROR_ENCODE(ITEM_ALREADY_PRESENT);
+            i = 0;
+            goto out;
+        }
+        if (wolfsentry_table_ent_get(WOLFSENTRY_CONTEXT_ARGS_OUT, &route_table->header, &dup) >= 0) {
+            ret = WOLFSENTRY_ERROR_ENCODE(ITEM_ALREADY_PRESENT);
+            i = 0;
+            goto out;
+        }
+    }
+
+    for (i = 0; i < (*bulk)->n_routes; ++i) {
+        struct wolfsentry_route *route = (*bulk)->routes[i];
+        wolfsentry_action_res_t route_action_results = WOLFSENTRY_ACTION_RES_NONE;
+        ret = wolfsentry_route_insert_1(WOLFSENTRY_CONTEXT_ARGS_OUT, caller_arg, NULL /* target_route */, route_table, route, route->parent_event, &route_action_results);
+        WOLFSENTRY_SET_BITS(*action_results, route_action_results);
+        if (ret < 0)
+            goto out;
+        if (n_inserted)
+            ++*n_inserted;
+    }
+
+    ret = WOLFSENTRY_ERROR_ENCODE(OK);
+
+  out:
+
+    /* routes at and after the failure point were not inserted, and are
+     * dropped here.  routes already inserted stay in the table.
+     */
+    wolfsentry_route_bulk_insert_free(WOLFSENTRY_CONTEXT_ARGS_OUT, *bulk, i);
+    *bulk = NULL;
+
+    WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_bulk_insert_abort(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_bulk_insert **bulk)
+{
+    if ((bulk == NULL) || (*bulk == NULL))
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+
+    WOLFSENTRY_MUTEX_OR_RETURN();
+
+    wolfsentry_route_bulk_insert_free(WOLFSENTRY_CONTEXT_ARGS_OUT, *bulk, 0);
+    *bulk = NULL;
+
+    WOLFSENTRY_UNLOCK_AND_RETURN_OK;
+}
+
+/* moves rule_route's purge_after out to reflect its last_hit_time.  the route
+ * stays where it's filed in the purge wheel, and is refiled when that slot
+ * comes due, so this needs no mutex.
+ */
+static void wolfsentry_route_purge_after_refresh(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route *rule_route,
+    const struct wolfsentry_eventconfig_internal *config)
+{
+    wolfsentry_time_t purge_margin, new_purge_after;
+
+    WOLFSENTRY_CONTEXT_ARGS_THREAD_NOT_USED;
+
+    if (! rule_route->meta.purge_after)
+        return;
+
+    /* use the purge_margin to limit how often the route is written. */
+    WOLFSENTRY_FROM_EPOCH_TIME(WOLFSENTRY_ROUTE_PURGE_MARGIN_SECONDS, 0 /* epoch_nsecs */, &purge_margin);
+    new_purge_after = rule_route->meta.last_hit_time + config->config.route_idle_time_for_purge + purge_margin;
+    if (new_purge_after - rule_route->meta.purge_after >= purge_margin)
+        rule_route->meta.purge_after = new_purge_after;
+}
+
+#ifdef WOLFSENTRY_THREADSAFE
+
+static wolfsentry_errcode_t wolfsentry_route_write_behind_new(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    unsigned int n_logs,
+    struct wolfsentry_route_write_behind **write_behind)
+{
+    uint32_t rounded_n_logs = 1;
+    size_t log_stride, alloc_size;
+    uintptr_t misalignment;
+
+    if (n_logs > WOLFSENTRY_ROUTE_WRITE_BEHIND_MAX_LOGS)
+        WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
+    while (rounded_n_logs < n_logs)
+        rounded_n_logs <<= 1U;
+    log_stride = (sizeof(struct wolfsentry_route_write_behind_log) + WOLFSENTRY_CACHE_LINE_SIZE - 1) & ~(size_t)(WOLFSENTRY_CACHE_LINE_SIZE - 1);
+    alloc_size = (rounded_n_logs * log_stride) + WOLFSENTRY_CACHE_LINE_SIZE - 1;
+
+    if ((*write_behind = (struct wolfsentry_route_write_behind *)WOLFSENTRY_MALLOC(sizeof **write_behind)) == NULL)
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+    if (((*write_behind)->logs_alloc = WOLFSENTRY_MALLOC(alloc_size)) == NULL) {
+        WOLFSENTRY_FREE(*write_behind);
+        *write_behind = NULL;
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+    }
+    memset((*write_behind)->logs_alloc, 0, alloc_size);
+    misalignment = (uintptr_t)(*write_behind)->logs_alloc & (WOLFSENTRY_CACHE_LINE_SIZE - 1);
+    (*write_behind)->logs = (byte *)(*write_behind)->logs_alloc + (misalignment ? WOLFSENTRY_CACHE_LINE_SIZE - misalignment : 0);
+    (*write_behind)->n_logs = rounded_n_logs;
+    (*write_behind)->log_stride = log_stride;
+    WOLFSENTRY_RETURN_OK;
+}
+
+static void wolfsentry_route_write_behind_free(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_write_behind *write_behind)
+{
+    WOLFSENTRY_FREE(write_behind->logs_alloc);
+    WOLFSENTRY_FREE(write_behind);
+}
+
+static inline struct wolfsentry_route_write_behind_log *wolfsentry_route_write_behind_log_at(
+    const struct wolfsentry_route_write_behind *write_behind,
+    unsigned int i)
+{
+    return (struct wolfsentry_route_write_behind_log *)(void *)((byte *)write_behind->logs + (i * write_behind->log_stride));
+}
+
+/* metadata updates are deferred while the table has write-behind logs and the
+ * caller doesn't hold the mutex.
+ */
+static inline int wolfsentry_route_write_behind_deferring(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    const struct wolfsentry_route_table *route_table)
+{
+    return (route_table != NULL) &&
+        (route_table->write_behind != NULL) &&
+        (wolfsentry_lock_have_mutex(&wolfsentry->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE) < 0);
+}
+
+/* adds hits, and a hit at hit_time if nonzero, to route's entry in the
+ * caller's log.  returns nonzero if logged, or zero if the logs the caller
+ * may use are busy or full, in which case the caller applies the update
+ * itself.
+ */
+static int wolfsentry_route_write_behind_log_hit(
+    struct wolfsentry_thread_context *thread,
+    struct wolfsentry_route_write_behind *write_behind,
+    const struct wolfsentry_route *route,
+    wolfsentry_hitcount_t hits,
+    wolfsentry_time_t hit_time)
+{
+    uint64_t h = (uint64_t)(uintptr_t)WOLFSENTRY_THREAD_GET_ID * 0x9e3779b97f4a7c15ULL;
+    unsigned int start = (unsigned int)(h >> 32U);
+    unsigned int probe;
+
+    for (probe = 0; (probe < WOLFSENTRY_ROUTE_WRITE_BEHIND_PROBES) && (probe < write_behind->n_logs); ++probe) {
+        struct wolfsentry_route_write_behind_log *wb_log = wolfsentry_route_write_behind_log_at(write_behind, (start + probe) & (write_behind->n_logs - 1U));
+        struct wolfsentry_route_write_behind_ent *ent = NULL;
+        uint32_t busy = 0;
+        uint32_t i;
+
+        if (! WOLFSENTRY_ATOMIC_TEST_AND_SET(wb_log->busy, busy, 1U))
+            continue;
+        /* repeat hits on a route tend to come back to back, so search from the end. */
+        for (i = wb_log->n_ents; i > 0; --i) {
+            if (wb_log->ents[i - 1U].route_id == route->header.id) {
+                ent = &wb_log->ents[i - 1U];
+                break;
+            }
+        }
+        if ((ent == NULL) && (wb_log->n_ents < WOLFSENTRY_ROUTE_WRITE_BEHIND_LOG_ENTS)) {
+            ent = &wb_log->ents[wb_log->n_ents++];
+            ent->route_id = route->header.id;
+            ent->hits = 0;
+            ent->last_hit_time = 0;
+        }
+        if (ent != NULL) {
+            if (MAX_UINT_OF(ent->hits) - ent->hits < hits)
+                ent->hits = (wolfsentry_hitcount_t)MAX_UINT_OF(ent->hits);
+            else
+                ent->hits = (wolfsentry_hitcount_t)(ent->hits + hits);
+            if (hit_time > ent->last_hit_time)
+                ent->last_hit_time = hit_time;
+        }
+        WOLFSENTRY_ATOMIC_STORE(wb_log->busy, 0U);
+        if (ent != NULL)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* applies and empties the write-behind logs.  caller must hold the mutex, so
+ * that no thread is appending to them.
+ */
+static void wolfsentry_route_write_behind_apply(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table)
+{
+    struct wolfsentry_route_write_behind *write_behind = route_table->write_behind;
+    unsigned int i;
+    uint32_t j;
+
+    if (write_behind == NULL)
+        return;
+
+    for (i = 0; i < write_behind->n_logs; ++i) {
+        struct wolfsentry_route_write_behind_log *wb_log = wolfsentry_route_write_behind_log_at(write_behind, i);
+        for (j = 0; j < wb_log->n_ents; ++j) {
+            const struct wolfsentry_route_write_behind_ent *ent = &wb_log->ents[j];
+            struct wolfsentry_table_ent_header *route_header;
+            struct wolfsentry_route *route;
+
+            /* routes deleted since the hit are skipped. */
+            if (wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, ent->route_id, &route_header) < 0)
+                continue;
+            if (route_header->parent_table != &route_table->header)
+                continue;
+            route = (struct wolfsentry_route *)route_header;
+
+            if ((ent->hits > 0) && (! (route->flags & WOLFSENTRY_ROUTE_FLAG_DONT_COUNT_HITS))) {
+                wolfsentry_hitcount_t post_hitcount;
+                WOLFSENTRY_ATOMIC_INCREMENT_UNSIGNED_SAFELY(route->header.hitcount, ent->hits, post_hitcount);
+                if (post_hitcount == 0) {
+                    wolfsentry_route_flags_t flags_before, flags_after;
+                    wolfsentry_action_res_t action_results = WOLFSENTRY_ACTION_RES_NONE;
+                    WOLFSENTRY_ATOMIC_STORE(route->header.hitcount, (wolfsentry_hitcount_t)MAX_UINT_OF(route->header.hitcount));
+                    WOLFSENTRY_WARN_ON_FAILURE(
+                        wolfsentry_route_update_flags(
+                            WOLFSENTRY_CONTEXT_ARGS_OUT,
+                            route,
+                            WOLFSENTRY_ROUTE_FLAG_DONT_COUNT_HITS,
+                            WOLFSENTRY_ROUTE_FLAG_NONE,
+                            &flags_before,
+                            &flags_after,
+                            &action_results));
+                }
+            }
+
+            if (ent->last_hit_time > route->meta.last_hit_time) {
+                struct wolfsentry_event *parent_event = route->parent_event ? route->parent_event : route_table->default_event;
+                route->meta.last_hit_time = ent->last_hit_time;
+                wolfsentry_route_purge_after_refresh(
+                    WOLFSENTRY_CONTEXT_ARGS_OUT,
+                    route,
+                    (parent_event && parent_event->config) ? parent_event->config : &wolfsentry->config);
+            }
+        }
+        wb_log->n_ents = 0;
+    }
+}
+
+#endif /* WOLFSENTRY_THREADSAFE */
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_write_behind_configure(
     WOLFSENTRY_CONTEXT_ARGS_IN,
-    struct wolfsentry_route_table *route_table,
-    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
-    const struct wolfsentry_sockaddr *remote,
-    const struct wolfsentry_sockaddr *local,
-    wolfsentry_route_flags_t flags,
-    const char *event_label,
-    int event_label_len,
-    struct wolfsentry_route **route,
-    wolfsentry_action_res_t *action_results)
+    struct wolfsentry_route_table *table,
+    unsigned int n_logs)
 {
+#ifdef WOLFSENTRY_THREADSAFE
+    struct wolfsentry_route_write_behind *write_behind = NULL;
     wolfsentry_errcode_t ret;
-    struct wolfsentry_event *event = NULL;
 
     WOLFSENTRY_MUTEX_OR_RETURN();
 
-    if (event_label) {
-        if ((ret = wolfsentry_event_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event_label, event_label_len, &event)) < 0)
-            WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+    if (n_logs > 0) {
+        ret = wolfsentry_route_write_behind_new(WOLFSENTRY_CONTEXT_ARGS_OUT, n_logs, &write_behind);
+        WOLFSENTRY_UNLOCK_AND_RERETURN_IF_ERROR(ret);
     }
-    WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
-    ret = wolfsentry_route_insert_2(WOLFSENTRY_CONTEXT_ARGS_OUT, caller_arg, route_table, remote, local, flags, event, NULL /* id */, route, action_results);
-    if (event != NULL)
-        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event, NULL /* action_results */));
-    WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+
+    if (table->write_behind != NULL) {
+        wolfsentry_route_write_behind_apply(WOLFSENTRY_CONTEXT_ARGS_OUT, table);
+        wolfsentry_route_write_behind_free(WOLFSENTRY_CONTEXT_ARGS_OUT, table->write_behind);
+    }
+    table->write_behind = write_behind;
+
+    WOLFSENTRY_UNLOCK_AND_RETURN_OK;
+#else
+    (void)wolfsentry;
+    (void)table;
+    if (n_logs > 0)
+        WOLFSENTRY_ERROR_RETURN(IMPLEMENTATION_MISSING);
+    WOLFSENTRY_RETURN_OK;
+#endif
 }
 
-WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_insert_and_check_out(
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_write_behind_flush(
     WOLFSENTRY_CONTEXT_ARGS_IN,
-    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
-    const struct wolfsentry_sockaddr *remote,
-    const struct wolfsentry_sockaddr *local,
-    wolfsentry_route_flags_t flags,
-    const char *event_label,
-    int event_label_len,
-    struct wolfsentry_route **route,
-    wolfsentry_action_res_t *action_results)
+    struct wolfsentry_route_table *table)
 {
-    WOLFSENTRY_ERROR_RERETURN(
-        wolfsentry_route_insert_into_table_and_check_out(
-            WOLFSENTRY_CONTEXT_ARGS_OUT,
-            wolfsentry->routes,
-            caller_arg,
-            remote,
-            local,
-            flags,
-            event_label,
-            event_label_len,
-            route,
-            action_results));
+#ifdef WOLFSENTRY_THREADSAFE
+    WOLFSENTRY_MUTEX_OR_RETURN();
+    wolfsentry_route_write_behind_apply(WOLFSENTRY_CONTEXT_ARGS_OUT, table);
+    WOLFSENTRY_UNLOCK_AND_RETURN_OK;
+#else
+    (void)wolfsentry;
+    (void)table;
+    WOLFSENTRY_RETURN_OK;
+#endif
 }
 
 static void wolfsentry_route_increment_hitcount(
@@ -1079,7 +2677,15 @@ static void wolfsentry_route_increment_hitcount(
 {
     if (! (route->flags & WOLFSENTRY_ROUTE_FLAG_DONT_COUNT_HITS)) {
         wolfsentry_hitcount_t post_hitcount;
-        WOLFSENTRY_ATOMIC_INCREMENT_UNSIGNED_SAFELY_BY_ONE(route->header.hitcount, post_hitcount);
+#ifdef WOLFSENTRY_THREADSAFE
+        struct wolfsentry_route_table *route_table = (struct wolfsentry_route_table *)route->header.parent_table;
+        if (wolfsentry_route_write_behind_deferring(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table) &&
+            wolfsentry_route_write_behind_log_hit(thread, route_table->write_behind, route, 1 /* hits */, 0 /* hit_time */))
+        {
+            WOLFSENTRY_RETURN_VOID;
+        }
+#endif
+        WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT(&route->header, post_hitcount);
         if (post_hitcount == 0) {
             wolfsentry_route_flags_t flags_before, flags_after;
             WOLFSENTRY_WARN_ON_FAILURE(
@@ -1096,26 +2702,335 @@ static void wolfsentry_route_increment_hitcount(
     WOLFSENTRY_RETURN_VOID;
 }
 
+/* the flow cache memoizes !exact_p lookups, keyed on the normalized target.
+ * entries are validated against route_table->generation, which is bumped by
+ * every insert, delete, or flag change that can alter a lookup result, so a
+ * stale entry is never served, and its route pointer is never dereferenced
+ * (short of 2^32 table changes landing between fill and reuse of a slot).
+ * slots are filled under the shared lock, so in threadsafe builds each slot
+ * is guarded by a sequence counter, and a reader that races a writer just
+ * takes the miss path.
+ */
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_route_table_generation_bump(
+    struct wolfsentry_route_table *route_table)
+{
+    /* 0 is reserved to mark empty slots. */
+    if (WOLFSENTRY_ATOMIC_INCREMENT_BY_ONE(route_table->generation) == 0)
+        WOLFSENTRY_ATOMIC_INCREMENT_BY_ONE(route_table->generation);
+    WOLFSENTRY_RETURN_VOID;
+}
+
+#define WOLFSENTRY_ROTL32(x, b) (uint32_t)(((x) << (b)) | ((x) >> (32 - (b))))
+
+#define WOLFSENTRY_HALFSIPROUND(v0, v1, v2, v3) do {                    \
+        (v0) += (v1); (v1) = WOLFSENTRY_ROTL32(v1, 5); (v1) ^= (v0);    \
+        (v0) = WOLFSENTRY_ROTL32(v0, 16);                               \
+        (v2) += (v3); (v3) = WOLFSENTRY_ROTL32(v3, 8); (v3) ^= (v2);    \
+        (v0) += (v3); (v3) = WOLFSENTRY_ROTL32(v3, 7); (v3) ^= (v0);    \
+        (v2) += (v1); (v1) = WOLFSENTRY_ROTL32(v1, 13); (v1) ^= (v2);   \
+        (v2) = WOLFSENTRY_ROTL32(v2, 16);                               \
+    } while (0)
+
+/* HalfSipHash-1-3 over the key words.  the key is secret, so an attacker
+ * choosing addresses and ports can't aim traffic at a single slot.
+ */
+static uint32_t wolfsentry_route_flow_cache_hash(
+    const uint32_t hash_key[2],
+    const struct wolfsentry_route_flow_cache_key *key)
+{
+    uint32_t v0 = hash_key[0];
+    uint32_t v1 = hash_key[1];
+    uint32_t v2 = 0x6c796765U ^ hash_key[0];
+    uint32_t v3 = 0x74656462U ^ hash_key[1];
+    const byte *in = (const byte *)key;
+    size_t i;
+    uint32_t m;
+
+    for (i = 0; i + sizeof m <= sizeof *key; i += sizeof m) {
+        memcpy(&m, in + i, sizeof m);
+        v3 ^= m;
+        WOLFSENTRY_HALFSIPROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    m = (uint32_t)sizeof *key << 24U;
+    v3 ^= m;
+    WOLFSENTRY_HALFSIPROUND(v0, v1, v2, v3);
+    v0 ^= m;
+    v2 ^= 0xffU;
+    WOLFSENTRY_HALFSIPROUND(v0, v1, v2, v3);
+    WOLFSENTRY_HALFSIPROUND(v0, v1, v2, v3);
+    WOLFSENTRY_HALFSIPROUND(v0, v1, v2, v3);
+    return v1 ^ v3;
+}
+
+/* returns nonzero if the target is cacheable, with *key filled in. */
+static int wolfsentry_route_flow_cache_key_init(
+    const struct wolfsentry_route *target_route,
+    wolfsentry_action_res_t action_results,
+    struct wolfsentry_route_flow_cache_key *key)
+{
+    size_t remote_bytes = WOLFSENTRY_ROUTE_REMOTE_ADDR_BYTES(target_route);
+    size_t local_bytes = WOLFSENTRY_ROUTE_LOCAL_ADDR_BYTES(target_route);
+
+    if ((target_route->remote.extra_port_count != 0) || (target_route->local.extra_port_count != 0))
+        return 0;
+    if (remote_bytes + local_bytes > sizeof key->addrs)
+        return 0;
+
+    memset(key, 0, sizeof *key);
+    key->flags = (uint32_t)(target_route->flags &
+                            (WOLFSENTRY_ROUTE_WILDCARD_FLAGS |
+                             WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD |
+                             WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN |
+                             WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT));
+    key->action_results = (uint32_t)action_results;
+    key->sa_family = target_route->sa_family;
+    key->sa_proto = target_route->sa_proto;
+    key->remote_port = target_route->remote.sa_port;
+    key->local_port = target_route->local.sa_port;
+    key->remote_addr_len = target_route->remote.addr_len;
+    key->local_addr_len = target_route->local.addr_len;
+    key->remote_interface = target_route->remote.interface;
+    key->local_interface = target_route->local.interface;
+    memcpy(key->addrs, WOLFSENTRY_ROUTE_REMOTE_ADDR(target_route), remote_bytes);
+    memcpy(key->addrs + remote_bytes, WOLFSENTRY_ROUTE_LOCAL_ADDR(target_route), local_bytes);
+    return 1;
+}
+
+/* returns nonzero on a hit.  the slot is read with acquire loads throughout,
+ * rather than plain loads and an acquire fence before the recheck of seq,
+ * because -fsanitize=thread doesn't support standalone fences.
+ */
+static int wolfsentry_route_flow_cache_get(
+    struct wolfsentry_route_flow_cache_ent *ent,
+    uint32_t generation,
+    const struct wolfsentry_route_flow_cache_key *key,
+    struct wolfsentry_route **route,
+    wolfsentry_route_flags_t *inexact_matches)
+{
+    size_t i;
+    uint32_t key_word;
+#ifdef WOLFSENTRY_THREADSAFE
+    uint32_t seq = WOLFSENTRY_ATOMIC_LOAD_ACQUIRE(ent->seq);
+    if (seq & 1U)
+        return 0;
+#endif
+    if (WOLFSENTRY_ATOMIC_LOAD_ACQUIRE(ent->generation) != generation)
+        return 0;
+    for (i = 0; i < length_of_array(ent->u.key_words); ++i) {
+        memcpy(&key_word, (const byte *)key + (i * sizeof key_word), sizeof key_word);
+        if (WOLFSENTRY_ATOMIC_LOAD_ACQUIRE(ent->u.key_words[i]) != key_word)
+            return 0;
+    }
+    *route = WOLFSENTRY_ATOMIC_LOAD_ACQUIRE(ent->route);
+    *inexact_matches = WOLFSENTRY_ATOMIC_LOAD_ACQUIRE(ent->inexact_matches);
+#ifdef WOLFSENTRY_THREADSAFE
+    if (WOLFSENTRY_ATOMIC_LOAD(ent->seq) != seq)
+        return 0;
+#endif
+    return 1;
+}
+
+static void wolfsentry_route_flow_cache_put(
+    struct wolfsentry_route_table *table,
+    struct wolfsentry_route_flow_cache_ent *ent,
+    uint32_t generation,
+    const struct wolfsentry_route_flow_cache_key *key,
+    struct wolfsentry_route *route,
+    wolfsentry_route_flags_t inexact_matches)
+{
+    size_t i;
+    uint32_t key_word;
+#ifdef WOLFSENTRY_THREADSAFE
+    uint32_t seq = WOLFSENTRY_ATOMIC_LOAD(ent->seq);
+    /* if another thread is filling the slot, let it win. */
+    if (seq & 1U)
+        WOLFSENTRY_RETURN_VOID;
+    if (! WOLFSENTRY_ATOMIC_TEST_AND_SET(ent->seq, seq, seq + 1U))
+        WOLFSENTRY_RETURN_VOID;
+#endif
+    if ((ent->generation == WOLFSENTRY_ATOMIC_LOAD(table->generation)) &&
+        (memcmp(&ent->u.key, key, sizeof *key) != 0))
+    {
+        WOLFSENTRY_ATOMIC_INCREMENT_BY_ONE(table->flow_cache_evictions);
+    }
+    /* concurrent readers load the slot atomically, so it's stored atomically. */
+    WOLFSENTRY_ATOMIC_STORE(ent->generation, generation);
+    for (i = 0; i < length_of_array(ent->u.key_words); ++i) {
+        memcpy(&key_word, (const byte *)key + (i * sizeof key_word), sizeof key_word);
+        WOLFSENTRY_ATOMIC_STORE(ent->u.key_words[i], key_word);
+    }
+    WOLFSENTRY_ATOMIC_STORE(ent->route, route);
+    WOLFSENTRY_ATOMIC_STORE(ent->inexact_matches, inexact_matches);
+#ifdef WOLFSENTRY_THREADSAFE
+    WOLFSENTRY_ATOMIC_STORE(ent->seq, seq + 2U);
+#endif
+    WOLFSENTRY_RETURN_VOID;
+}
+
+/* a flow cache key and its hash, computed ahead of a dispatch.
+ * wolfsentry_route_lookup_0() uses the hash, rather than rehashing, if its
+ * own key for the target is identical.
+ */
+struct wolfsentry_route_flow_cache_hint {
+    struct wolfsentry_route_flow_cache_key key;
+    uint32_t hash;
+};
+
+/* computes the key wolfsentry_route_lookup_0() will compute for a target
+ * built from remote, local, and flags, without building the target, and
+ * pulls in the flow cache slot it will consult, so that it's in cache by the
+ * time the dispatch gets there.  returns nonzero, with *hint filled in, if the
+ * target is cacheable.
+ */
+static int wolfsentry_route_flow_cache_prefetch(
+    const struct wolfsentry_route_table *table,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    wolfsentry_action_res_t action_results,
+    struct wolfsentry_route_flow_cache_hint *hint)
+{
+    struct wolfsentry_route_flow_cache *flow_cache = table->flow_cache;
+    size_t remote_bytes = WOLFSENTRY_BITS_TO_BYTES(remote->addr_len);
+    size_t local_bytes = WOLFSENTRY_BITS_TO_BYTES(local->addr_len);
+
+    if (flow_cache == NULL)
+        return 0;
+    if (remote_bytes + local_bytes > sizeof hint->key.addrs)
+        return 0;
+
+    /* as in wolfsentry_route_flow_cache_key_init(), after the target is built
+     * by wolfsentry_route_init(), and its parent event wildcarded by
+     * wolfsentry_route_lookup_0().
+     */
+    memset(&hint->key, 0, sizeof hint->key);
+    hint->key.flags = (uint32_t)((flags | WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD) &
+                                 (WOLFSENTRY_ROUTE_WILDCARD_FLAGS |
+                                  WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD |
+                                  WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN |
+                                  WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT));
+    hint->key.action_results = (uint32_t)action_results;
+    hint->key.sa_family = remote->sa_family;
+    hint->key.sa_proto = remote->sa_proto;
+    hint->key.remote_port = remote->sa_port;
+    hint->key.local_port = local->sa_port;
+    hint->key.remote_addr_len = remote->addr_len;
+    hint->key.local_addr_len = local->addr_len;
+    hint->key.remote_interface = remote->interface;
+    hint->key.local_interface = local->interface;
+    if (remote_bytes > 0) {
+        memcpy(hint->key.addrs, remote->addr, remote_bytes);
+        if (remote->addr_len % BITS_PER_BYTE)
+            hint->key.addrs[remote_bytes - 1] = (byte)(hint->key.addrs[remote_bytes - 1] & (0xffU << (BITS_PER_BYTE - (remote->addr_len % BITS_PER_BYTE))));
+    }
+    if (local_bytes > 0) {
+        memcpy(hint->key.addrs + remote_bytes, local->addr, local_bytes);
+        if (local->addr_len % BITS_PER_BYTE)
+            hint->key.addrs[remote_bytes + local_bytes - 1] = (byte)(hint->key.addrs[remote_bytes + local_bytes - 1] & (0xffU << (BITS_PER_BYTE - (local->addr_len % BITS_PER_BYTE))));
+    }
+
+    hint->hash = wolfsentry_route_flow_cache_hash(flow_cache->hash_key, &hint->key);
+    WOLFSENTRY_PREFETCH(&flow_cache->slots[hint->hash & (flow_cache->n_slots - 1U)]);
+    return 1;
+}
+
+static wolfsentry_errcode_t wolfsentry_route_flow_cache_new(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    unsigned int n_slots,
+    const uint32_t *hash_key,
+    struct wolfsentry_route_flow_cache **flow_cache)
+{
+    size_t alloc_size;
+    uint32_t rounded_n_slots = 1;
+
+    if (n_slots > WOLFSENTRY_ROUTE_FLOW_CACHE_MAX_SLOTS)
+        WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
+    while (rounded_n_slots < n_slots)
+        rounded_n_slots <<= 1U;
+    alloc_size = offsetof(struct wolfsentry_route_flow_cache, slots) + (rounded_n_slots * sizeof (*flow_cache)->slots[0]);
+    if ((*flow_cache = (struct wolfsentry_route_flow_cache *)WOLFSENTRY_MALLOC(alloc_size)) == NULL)
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+    memset(*flow_cache, 0, alloc_size);
+    (*flow_cache)->n_slots = rounded_n_slots;
+    if (hash_key != NULL) {
+        (*flow_cache)->hash_key[0] = hash_key[0];
+        (*flow_cache)->hash_key[1] = hash_key[1];
+    } else {
+        /* no entropy source is available here, so derive a key that at
+         * least varies per process and per instance.  callers facing
+         * hostile traffic should supply their own.
+         */
+        wolfsentry_time_t now = 0;
+        WOLFSENTRY_WARN_ON_FAILURE(WOLFSENTRY_GET_TIME(&now));
+        (*flow_cache)->hash_key[0] = (uint32_t)now ^ (uint32_t)((uint64_t)now >> 32U) ^ (uint32_t)(uintptr_t)*flow_cache;
+        (*flow_cache)->hash_key[1] = (uint32_t)(uintptr_t)&now ^ (uint32_t)((uint64_t)(uintptr_t)wolfsentry >> 16U) ^ 0x9e3779b9U;
+    }
+    WOLFSENTRY_RETURN_OK;
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_flow_cache_configure(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *table,
+    unsigned int n_slots,
+    const uint32_t *hash_key)
+{
+    struct wolfsentry_route_flow_cache *flow_cache = NULL;
+    wolfsentry_errcode_t ret;
+
+    WOLFSENTRY_MUTEX_OR_RETURN();
+
+    if (n_slots > 0) {
+        ret = wolfsentry_route_flow_cache_new(WOLFSENTRY_CONTEXT_ARGS_OUT, n_slots, hash_key, &flow_cache);
+        WOLFSENTRY_UNLOCK_AND_RERETURN_IF_ERROR(ret);
+    }
+
+    if (table->flow_cache != NULL)
+        WOLFSENTRY_FREE(table->flow_cache);
+    table->flow_cache = flow_cache;
+    table->flow_cache_hits = table->flow_cache_misses = table->flow_cache_evictions = 0;
+
+    WOLFSENTRY_UNLOCK_AND_RETURN_OK;
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_flow_cache_stats_get(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *table,
+    struct wolfsentry_route_flow_cache_stats *stats)
+{
+    WOLFSENTRY_SHARED_OR_RETURN();
+    if (table->flow_cache == NULL) {
+        memset(stats, 0, sizeof *stats);
+        WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(ITEM_NOT_FOUND);
+    }
+    stats->n_slots = table->flow_cache->n_slots;
+    stats->hits = WOLFSENTRY_ATOMIC_LOAD(table->flow_cache_hits);
+    stats->misses = WOLFSENTRY_ATOMIC_LOAD(table->flow_cache_misses);
+    stats->evictions = WOLFSENTRY_ATOMIC_LOAD(table->flow_cache_evictions);
+    WOLFSENTRY_UNLOCK_AND_RETURN_OK;
+}
+
 static wolfsentry_errcode_t wolfsentry_route_lookup_0(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     const struct wolfsentry_route_table *table,
     struct wolfsentry_route *target_route,
     int exact_p,
+    const struct wolfsentry_route_flow_cache_hint *flow_cache_hint,
     wolfsentry_route_flags_t *inexact_matches,
     struct wolfsentry_route **found_route,
     wolfsentry_action_res_t *action_results)
 {
     struct wolfsentry_cursor cursor;
     int cursor_position;
-    struct wolfsentry_route *i;
-    int highest_priority_seen = 0;
-    struct wolfsentry_route *highest_priority_match_seen = NULL;
-    wolfsentry_route_flags_t highest_priority_inexact_matches = 0;
+    struct wolfsentry_route_index_search_state search_state;
     wolfsentry_errcode_t ret;
-    int contiguous_search;
     wolfsentry_route_flags_t inexact_matches_buf;
+    struct wolfsentry_route_flow_cache_key flow_cache_key;
+    struct wolfsentry_route_flow_cache_ent *flow_cache_ent = NULL;
+    uint32_t generation = 0;
 #ifdef DEBUG_ROUTE_LOOKUP
-    struct wolfsentry_route *i_prev = NULL;
+    struct wolfsentry_route *i, *i_prev = NULL;
 #endif
 
 #ifdef DEBUG_ROUTE_LOOKUP
@@ -1153,8 +3068,37 @@ static wolfsentry_errcode_t wolfsentry_route_lookup_0(
     if (! exact_p)
         WOLFSENTRY_SET_BITS(target_route->flags, WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD);
 
-    /* if the target has wildcard holes in it (not strictly prefix-matching),
-     * then seek to the tail and skip straight to reverse iteration.
+    if ((! exact_p) && (table->flow_cache != NULL) && (action_results != NULL) &&
+        wolfsentry_route_flow_cache_key_init(target_route, *action_results, &flow_cache_key))
+    {
+        struct wolfsentry_route_flow_cache *flow_cache = table->flow_cache;
+        uint32_t hash;
+        if ((flow_cache_hint != NULL) && (memcmp(&flow_cache_hint->key, &flow_cache_key, sizeof flow_cache_key) == 0))
+            hash = flow_cache_hint->hash;
+        else
+            hash = wolfsentry_route_flow_cache_hash(flow_cache->hash_key, &flow_cache_key);
+        generation = WOLFSENTRY_ATOMIC_LOAD(table->generation);
+        flow_cache_ent = &flow_cache->slots[hash & (flow_cache->n_slots - 1U)];
+        if (wolfsentry_route_flow_cache_get(flow_cache_ent, generation, &flow_cache_key, found_route, inexact_matches)) {
+            WOLFSENTRY_ATOMIC_INCREMENT_BY_ONE(((struct wolfsentry_route_table *)table)->flow_cache_hits);
+            flow_cache_ent = NULL;
+            if (*found_route)
+                ret = WOLFSENTRY_ERROR_ENCODE(OK);
+            else
+                ret = WOLFSENTRY_ERROR_ENCODE(ITEM_NOT_FOUND);
+            goto out;
+        }
+        WOLFSENTRY_ATOMIC_INCREMENT_BY_ONE(((struct wolfsentry_route_table *)table)->flow_cache_misses);
+    }
+
+    if ((! exact_p) && wolfsentry_route_negative_filter_excludes(table, target_route)) {
+        WOLFSENTRY_ATOMIC_INCREMENT_BY_ONE(((struct wolfsentry_route_table *)table)->negative_filter_hits);
+        ret = WOLFSENTRY_ERROR_ENCODE(ITEM_NOT_FOUND);
+        goto out;
+    }
+
+    /* if the target has no wildcard holes in it (strictly prefix-matching),
+     * an exact hit at the seek point can short circuit the tuple search.
      *
      * the test for this depends on the wildcard bits in the flag word being
      * crowded at the bottom of the word, in order (lsb is leftmost search
@@ -1163,138 +3107,62 @@ static wolfsentry_errcode_t wolfsentry_route_lookup_0(
      * the flag bits must be inverted, so that a no-wildcard lookup has all 1's
      * in the positions masked by WOLFSENTRY_ROUTE_WILDCARD_FLAGS.
      */
-    if (exact_p) {
-        /* secondary search will be skipped. */
-    } else if (((~target_route->flags & WOLFSENTRY_ROUTE_WILDCARD_FLAGS) + 1) & (~target_route->flags & WOLFSENTRY_ROUTE_WILDCARD_FLAGS)) {
-        contiguous_search = 0;
-        /* skip primary search for now -- once the table is a red-black tree, it
-         * will be worth constructing a target_route_contiguous_wildcards and
-         * doing both, avoiding the need to traverse the entire table.
-         */
-        goto just_seek_to_tail;
-    } else
-        contiguous_search = 1;
-
-    if ((ret = wolfsentry_table_cursor_seek(&table->header, &target_route->header, &cursor, &cursor_position)) < 0)
-        goto out;
+    if (exact_p ||
+        ! (((~target_route->flags & WOLFSENTRY_ROUTE_WILDCARD_FLAGS) + 1) & (~target_route->flags & WOLFSENTRY_ROUTE_WILDCARD_FLAGS)))
+    {
+        if ((ret = wolfsentry_table_cursor_seek(&table->header, &target_route->header, &cursor, &cursor_position)) < 0)
+            goto out;
 
 #ifdef DEBUG_ROUTE_LOOKUP
-    fprintf(stderr,"cursor.point: ");
-    if (cursor.point) {
-        if (wolfsentry_route_render(WOLFSENTRY_CONTEXT_ARGS_OUT, (struct wolfsentry_route *)cursor.point, stderr) < 0) {}
-    } else
-        fprintf(stderr, "(null)\n");
-    fprintf(stderr,"  res: %d\n",cursor_position);
+        fprintf(stderr,"cursor.point: ");
+        if (cursor.point) {
+            if (wolfsentry_route_render(WOLFSENTRY_CONTEXT_ARGS_OUT, (struct wolfsentry_route *)cursor.point, stderr) < 0) {}
+        } else
+            fprintf(stderr, "(null)\n");
+        fprintf(stderr,"  res: %d\n",cursor_position);
 #endif
 
-    if (exact_p) {
-        if (cursor_position == 0) {
-            *inexact_matches = WOLFSENTRY_ROUTE_FLAG_NONE;
-            *found_route = (struct wolfsentry_route *)cursor.point;
-            ret = WOLFSENTRY_ERROR_ENCODE(OK);
-        } else {
-            ret = WOLFSENTRY_ERROR_ENCODE(ITEM_NOT_FOUND);
-        }
-        goto out;
-    }
-
-    /* short circuit if we know there can't be a higher priority
-     * match elsewhere in the table.
-     */
-    if (cursor_position == 0) {
-        struct wolfsentry_event *parent_event = ((struct wolfsentry_route *)cursor.point)->parent_event ? ((struct wolfsentry_route *)cursor.point)->parent_event : NULL;
-        if ((action_results == NULL) || (parent_event == NULL) || (parent_event->config == NULL) ||
-            (((*action_results & parent_event->config->config.action_res_filter_bits_set) == parent_event->config->config.action_res_filter_bits_set) &&
-             ((~(*action_results) & parent_event->config->config.action_res_filter_bits_unset) == parent_event->config->config.action_res_filter_bits_unset)))
-        {
-            int effective_priority = parent_event ? parent_event->priority : 0;
-            if (effective_priority <= table->highest_priority_route_in_table) {
-                if (inexact_matches != NULL)
-                    *inexact_matches = WOLFSENTRY_ROUTE_FLAG_NONE;
+        if (exact_p) {
+            if (cursor_position == 0) {
+                *inexact_matches = WOLFSENTRY_ROUTE_FLAG_NONE;
                 *found_route = (struct wolfsentry_route *)cursor.point;
                 ret = WOLFSENTRY_ERROR_ENCODE(OK);
-                goto out;
+            } else {
+                ret = WOLFSENTRY_ERROR_ENCODE(ITEM_NOT_FOUND);
             }
+            goto out;
         }
-    }
 
-    if (cursor_position == -1) {
-    just_seek_to_tail:
-        wolfsentry_table_cursor_seek_to_tail(&table->header, &cursor);
-    }
-
-    for (i = (struct wolfsentry_route *)wolfsentry_table_cursor_current(&cursor);
-         i;
-         i = (struct wolfsentry_route *)wolfsentry_table_cursor_prev(&cursor))
-    {
-        if (WOLFSENTRY_CHECK_BITS(i->flags, WOLFSENTRY_ROUTE_FLAG_PENDING_DELETE))
-            continue;
-        /* ignore routes that don't cover the direction of the target. */
-        if (! (i->flags & WOLFSENTRY_MASKIN_BITS(target_route->flags, WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN|WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT)))
-            continue;
-        /* ignore routes that don't meet actions_results constraints. */
-        if (action_results && i->parent_event && i->parent_event->config &&
-            (((*action_results & i->parent_event->config->config.action_res_filter_bits_set) != i->parent_event->config->config.action_res_filter_bits_set) ||
-             ((~(*action_results) & i->parent_event->config->config.action_res_filter_bits_unset) != i->parent_event->config->config.action_res_filter_bits_unset)))
-        {
-            continue;
-        }
-        /* if *action_results has _EXCLUDE_REJECT_ROUTES set on entry to
-         * wolfsentry_route_lookup_0(), it was set via
-         * wolfsentry_route_event_dispatch_with_inited_result() for a
-         * bind/listen query that should succeed if any routes can succeed.
-         * this requires ignoring routes with _PENALTYBOXED/_PORT_RESET set.
+        /* short circuit if we know there can't be a higher priority
+         * match elsewhere in the table.
          */
-        if (action_results &&
-            WOLFSENTRY_CHECK_BITS(*action_results, WOLFSENTRY_ACTION_RES_EXCLUDE_REJECT_ROUTES) &&
-            WOLFSENTRY_MASKIN_BITS(i->flags, WOLFSENTRY_ROUTE_FLAG_PENALTYBOXED|WOLFSENTRY_ROUTE_FLAG_PORT_RESET))
-        {
-            continue;
-        }
-
-        cursor_position = wolfsentry_route_key_cmp_1(i, target_route, 1 /* match_wildcards_p */, inexact_matches);
-
-#ifdef DEBUG_ROUTE_LOOKUP
-        fprintf(stderr,"i: ");
-        if (wolfsentry_route_render(WOLFSENTRY_CONTEXT_ARGS_OUT, i, stderr) < 0) {}
-        fprintf(stderr,"\n  res: %d\n",cursor_position);
-        fputs("  inexact_matches: ", stderr);
-        if (wolfsentry_route_render_flags(*inexact_matches, stderr) < 0) {}
-        fputc('\n', stderr);
-#endif
-
         if (cursor_position == 0) {
-            /* preference is a match with the highest-priority event, with null
-             * events having highest priority, and ties broken using
-             * compare_match_exactness().
-             */
-            int effective_priority = i->parent_event ? i->parent_event->priority : 0;
-            if ((highest_priority_match_seen == NULL) ||
-                (effective_priority < highest_priority_seen) ||
-                ((effective_priority == highest_priority_seen) &&
-                 (compare_match_exactness(target_route, i, *inexact_matches, highest_priority_match_seen, highest_priority_inexact_matches) < 0)))
+            struct wolfsentry_event *parent_event = ((struct wolfsentry_route *)cursor.point)->parent_event ? ((struct wolfsentry_route *)cursor.point)->parent_event : NULL;
+            if ((action_results == NULL) || (parent_event == NULL) || (parent_event->config == NULL) ||
+                (((*action_results & parent_event->config->config.action_res_filter_bits_set) == parent_event->config->config.action_res_filter_bits_set) &&
+                 ((~(*action_results) & parent_event->config->config.action_res_filter_bits_unset) == parent_event->config->config.action_res_filter_bits_unset)))
             {
-                highest_priority_match_seen = i;
-                highest_priority_inexact_matches = *inexact_matches;
-                highest_priority_seen = effective_priority;
+                int effective_priority = parent_event ? parent_event->priority : 0;
+                if (effective_priority <= table->highest_priority_route_in_table) {
+                    if (inexact_matches != NULL)
+                        *inexact_matches = WOLFSENTRY_ROUTE_FLAG_NONE;
+                    *found_route = (struct wolfsentry_route *)cursor.point;
+                    ret = WOLFSENTRY_ERROR_ENCODE(OK);
+                    goto out;
+                }
             }
         }
-
-        /* short circuit if we know there can't be a higher priority
-         * match in a later iteration.
-         */
-        if (contiguous_search &&
-            highest_priority_match_seen &&
-            ((highest_priority_inexact_matches & WOLFSENTRY_ROUTE_WILDCARD_FLAGS) == 0) &&
-            (highest_priority_seen <= table->highest_priority_route_in_table))
-        {
-            break;
-        }
     }
 
-    if (highest_priority_match_seen) {
-        *found_route = highest_priority_match_seen;
-        *inexact_matches = highest_priority_inexact_matches;
+    search_state.best = NULL;
+    search_state.best_inexact_matches = WOLFSENTRY_ROUTE_FLAG_NONE;
+    search_state.best_priority = 0;
+    wolfsentry_route_tuple_search(table, target_route, action_results, &search_state);
+    wolfsentry_route_trie_search(table, target_route, action_results, &search_state);
+
+    if (search_state.best) {
+        *found_route = search_state.best;
+        *inexact_matches = search_state.best_inexact_matches;
         ret = WOLFSENTRY_ERROR_ENCODE(OK);
     } else {
         ret = WOLFSENTRY_ERROR_ENCODE(ITEM_NOT_FOUND);
@@ -1302,6 +3170,9 @@ static wolfsentry_errcode_t wolfsentry_route_lookup_0(
 
   out:
 
+    if ((flow_cache_ent != NULL) && ((ret >= 0) || WOLFSENTRY_ERROR_CODE_IS(ret, ITEM_NOT_FOUND)))
+        wolfsentry_route_flow_cache_put((struct wolfsentry_route_table *)table, flow_cache_ent, generation, &flow_cache_key, *found_route, *inexact_matches);
+
     if (action_results && WOLFSENTRY_CHECK_BITS(*action_results, WOLFSENTRY_ACTION_RES_EXCLUDE_REJECT_ROUTES))
         WOLFSENTRY_CLEAR_BITS(*action_results, WOLFSENTRY_ACTION_RES_EXCLUDE_REJECT_ROUTES);
 
@@ -1347,7 +3218,7 @@ static wolfsentry_errcode_t wolfsentry_route_lookup_1(
     if ((ret = wolfsentry_route_init(parent_event, remote, local, flags, 0 /* data_addr_offset */, sizeof target.buf, &target.route)) < 0)
         WOLFSENTRY_ERROR_RERETURN(ret);
 
-    ret = wolfsentry_route_lookup_0(WOLFSENTRY_CONTEXT_ARGS_OUT, table, &target.route, exact_p, inexact_matches, found_route, action_results);
+    ret = wolfsentry_route_lookup_0(WOLFSENTRY_CONTEXT_ARGS_OUT, table, &target.route, exact_p, NULL /* flow_cache_hint */, inexact_matches, found_route, action_results);
     WOLFSENTRY_ERROR_RERETURN(ret);
 }
 
@@ -1401,7 +3272,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_max_purgeable_routes_
     int need_purge_now = 0;
 
     if (WOLFSENTRY_ATOMIC_LOAD(table->max_purgeable_routes) > max_purgeable_routes) {
-        if (table->purge_list.len > max_purgeable_routes)
+        if (table->purge_wheel.len > max_purgeable_routes)
             need_purge_now = 1;
     }
 
@@ -1455,8 +3326,10 @@ static inline wolfsentry_errcode_t wolfsentry_route_delete_0(
     if ((ret = wolfsentry_table_ent_delete_1(WOLFSENTRY_CONTEXT_ARGS_OUT, &route->header)) < 0)
         WOLFSENTRY_ERROR_RERETURN(ret);
 
+    wolfsentry_route_index_delete(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, route);
+
     if (route->meta.purge_after)
-        wolfsentry_list_ent_delete(&route_table->purge_list, &route->purge_links);
+        wolfsentry_route_purge_wheel_delete(route_table, route);
 
     {
         wolfsentry_route_flags_t flags_before, flags_after;
@@ -1644,6 +3517,9 @@ static wolfsentry_errcode_t wolfsentry_route_event_dispatch_0(
     struct wolfsentry_event *parent_event;
     struct wolfsentry_eventconfig_internal *config;
     wolfsentry_route_flags_t current_rule_route_flags;
+    int defer_p = 0;
+    wolfsentry_time_t now = 0;
+    wolfsentry_errcode_t now_ret;
     wolfsentry_errcode_t ret;
 
     if ((target_route == NULL) || (route_table == NULL) || (rule_route == NULL) || (action_results == NULL))
@@ -1654,32 +3530,50 @@ static wolfsentry_errcode_t wolfsentry_route_event_dispatch_0(
 
     WOLFSENTRY_HAVE_A_LOCK_OR_RETURN();
 
-    current_rule_route_flags = WOLFSENTRY_ATOMIC_LOAD(rule_route->flags);
+    /* one clock reading serves the whole dispatch. */
+    if (WOLFSENTRY_CHECK_BITS(config->config.flags, WOLFSENTRY_EVENTCONFIG_FLAG_COARSE_TIME))
+        now_ret = WOLFSENTRY_GET_TIME_COARSE(&now);
+    else
+        now_ret = WOLFSENTRY_GET_TIME(&now);
+    WOLFSENTRY_WARN_ON_FAILURE(now_ret);
 
-    WOLFSENTRY_WARN_ON_FAILURE(WOLFSENTRY_GET_TIME(&rule_route->meta.last_hit_time));
+    current_rule_route_flags = WOLFSENTRY_ATOMIC_LOAD(rule_route->flags);
 
-    if (rule_route->meta.purge_after) {
-        wolfsentry_time_t purge_margin, new_purge_after;
-        /* use the purge_margin to reduce mutex burden. */
-        WOLFSENTRY_FROM_EPOCH_TIME(WOLFSENTRY_ROUTE_PURGE_MARGIN_SECONDS, 0 /* epoch_nsecs */, &purge_margin);
-        new_purge_after = rule_route->meta.last_hit_time + config->config.route_idle_time_for_purge + purge_margin;
-        if (new_purge_after - rule_route->meta.purge_after >= purge_margin) {
-            rule_route->meta.purge_after = new_purge_after;
-            if (route_table->purge_list.tail != &rule_route->purge_links) {
 #ifdef WOLFSENTRY_THREADSAFE
-                if ((wolfsentry_lock_have_mutex(&wolfsentry->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE) >= 0) ||
-                    (wolfsentry_lock_shared2mutex(&wolfsentry->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE) >= 0))
+    /* with write-behind, a caller without the mutex only appends to its log,
+     * and the mutex holder applies everything logged so far.
+     */
+    if (route_table->write_behind != NULL) {
+        if (wolfsentry_lock_have_mutex(&wolfsentry->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE) >= 0)
+            wolfsentry_route_write_behind_apply(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table);
+        else
+            defer_p = 1;
+    }
 #endif
-                {
-                    wolfsentry_list_ent_delete(&route_table->purge_list, &rule_route->purge_links);
-                    wolfsentry_route_purge_list_insert(route_table, rule_route);
-                }
-            }
+
+    if (defer_p) {
+#ifdef WOLFSENTRY_THREADSAFE
+        /* a rule_route outside the table (the interim clone, or the target
+         * standing in for it) has no ID for the log to apply to, and may be
+         * on the caller's stack, so it gets no last-hit update.
+         */
+        if ((now_ret >= 0) &&
+            WOLFSENTRY_CHECK_BITS(current_rule_route_flags, WOLFSENTRY_ROUTE_FLAG_IN_TABLE) &&
+            (! wolfsentry_route_write_behind_log_hit(thread, route_table->write_behind, rule_route, 0 /* hits */, now)))
+        {
+            rule_route->meta.last_hit_time = now;
+            wolfsentry_route_purge_after_refresh(WOLFSENTRY_CONTEXT_ARGS_OUT, rule_route, config);
         }
-    }
+#endif
+    } else {
+        if (now_ret >= 0)
+            rule_route->meta.last_hit_time = now;
+        wolfsentry_route_purge_after_refresh(WOLFSENTRY_CONTEXT_ARGS_OUT, rule_route, config);
 
-    /* opportunistic garbage collection. */
-    (void)wolfsentry_route_stale_purge_one_opportunistically(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, NULL /* action_results */);
+        /* opportunistic garbage collection. */
+        if (! WOLFSENTRY_CHECK_BITS(wolfsentry->config.config.flags, WOLFSENTRY_EVENTCONFIG_FLAG_NO_OPPORTUNISTIC_PURGE))
+            (void)wolfsentry_route_stale_purge_one_opportunistically(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, NULL /* action_results */);
+    }
 
     if (trigger_event && (wolfsentry_list_ent_get_len(&trigger_event->post_action_list.header) > 0)) {
         /* for dynamic blocking, e.g. of a port scanner, one of the plugins in
@@ -1783,9 +3677,8 @@ static wolfsentry_errcode_t wolfsentry_route_event_dispatch_0(
     if (((current_rule_route_flags & WOLFSENTRY_ROUTE_FLAG_PENALTYBOXED)) &&
         ((config->config.penaltybox_duration > 0) && (rule_route->meta.last_penaltybox_time != 0)))
     {
-        wolfsentry_time_t now;
-        ret = WOLFSENTRY_GET_TIME(&now);
-        if (ret < 0) {
+        if (now_ret < 0) {
+            ret = now_ret;
             *action_results |= WOLFSENTRY_ACTION_RES_ERROR | WOLFSENTRY_ACTION_RES_REJECT;
             goto done;
         }
@@ -1890,42 +3783,35 @@ static wolfsentry_errcode_t wolfsentry_route_event_dispatch_0(
     WOLFSENTRY_ERROR_RERETURN(ret);
 }
 
-static wolfsentry_errcode_t wolfsentry_route_event_dispatch_1(
+/* dispatch one target, with the lock held and trigger_event (if any) already
+ * resolved and referenced by the caller.
+ */
+static wolfsentry_errcode_t wolfsentry_route_event_dispatch_2(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     struct wolfsentry_route_table *route_table,
+    struct wolfsentry_event *trigger_event,
     const struct wolfsentry_sockaddr *remote,
     const struct wolfsentry_sockaddr *local,
     wolfsentry_route_flags_t flags,
-    const char *event_label,
-    int event_label_len,
+    const struct wolfsentry_route_flow_cache_hint *flow_cache_hint,
     void *caller_arg, /* passed to action callback(s) as the caller_arg. */
     wolfsentry_ent_id_t *id,
     wolfsentry_route_flags_t *inexact_matches,
     wolfsentry_action_res_t *action_results
     )
 {
+    struct wolfsentry_route_transient target_route_storage;
     struct wolfsentry_route *target_route = NULL;
     struct wolfsentry_route *rule_route = NULL;
-    struct wolfsentry_event *trigger_event = NULL;
-    wolfsentry_errcode_t ret;
-
-    WOLFSENTRY_SHARED_OR_RETURN();
-
-    if (event_label) {
-        if (((ret = wolfsentry_event_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event_label, event_label_len, &trigger_event)) < 0)
-            && (! (flags & WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD)))
-        {
-            WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
-        }
-    }
+    wolfsentry_errcode_t ret, drop_ret;
 
     if (id)
         *id = WOLFSENTRY_ENT_ID_NONE;
 
-    if ((ret = wolfsentry_route_new(WOLFSENTRY_CONTEXT_ARGS_OUT, trigger_event, remote, local, flags, &target_route)) < 0)
+    if ((ret = wolfsentry_route_new_transient(WOLFSENTRY_CONTEXT_ARGS_OUT, trigger_event, remote, local, flags, &target_route_storage, &target_route)) < 0)
         goto just_free_resources;
 
-    if ((ret = wolfsentry_route_lookup_0(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, target_route, 0 /* exact_p */, inexact_matches, &rule_route, action_results)) >= 0) {
+    if ((ret = wolfsentry_route_lookup_0(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, target_route, 0 /* exact_p */, flow_cache_hint, inexact_matches, &rule_route, action_results)) >= 0) {
         /* continue */
     }
     else if (trigger_event || route_table->default_event) {
@@ -1939,17 +3825,30 @@ static wolfsentry_errcode_t wolfsentry_route_event_dispatch_1(
 
     if (rule_route == NULL) {
         *action_results |= WOLFSENTRY_ACTION_RES_FALLTHROUGH;
-        if ((ret = wolfsentry_route_clone(
+        /* if there's a fallthrough route, and no post actions to see the
+         * interim rule route, wolfsentry_route_event_dispatch_0() only uses the
+         * interim rule route for its parent event, so the target route itself
+         * can stand in for it, and the clone can be skipped.  otherwise the
+         * clone is a heap copy without WOLFSENTRY_TABLE_ENT_FLAG_TRANSIENT, so
+         * post actions can retain or insert it.
+         */
+        if ((route_table->fallthrough_route != NULL) &&
+            ((trigger_event == NULL) || (wolfsentry_list_ent_get_len(&trigger_event->post_action_list.header) == 0)))
+        {
+            rule_route = target_route;
+        }
+        else if ((ret = wolfsentry_route_clone(
                  WOLFSENTRY_CONTEXT_ARGS_OUT,
                  &target_route->header,
                  wolfsentry,
                  (struct wolfsentry_table_ent_header **)&rule_route,
                  WOLFSENTRY_CLONE_FLAG_NONE)) < 0)
             goto just_free_resources;
-        if ((rule_route->parent_event == NULL) && (route_table->default_event != NULL)) {
+        else if ((rule_route->parent_event == NULL) && (route_table->default_event != NULL)) {
             rule_route->parent_event = route_table->default_event;
             WOLFSENTRY_REFCOUNT_INCREMENT(rule_route->parent_event->header.refcount, ret);
-            WOLFSENTRY_UNLOCK_AND_RERETURN_IF_ERROR(ret);
+            if (ret < 0)
+                goto just_free_resources;
         }
     }
 
@@ -1960,23 +3859,58 @@ static wolfsentry_errcode_t wolfsentry_route_event_dispatch_1(
 
   just_free_resources:
 
-    if ((rule_route != NULL) && (! WOLFSENTRY_CHECK_BITS(rule_route->flags, WOLFSENTRY_ROUTE_FLAG_IN_TABLE)))
+    if ((rule_route != NULL) && (rule_route != target_route) && (! WOLFSENTRY_CHECK_BITS(rule_route->flags, WOLFSENTRY_ROUTE_FLAG_IN_TABLE)))
         WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, rule_route, NULL /* action_results */));
 
-    if (target_route != NULL)
-        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_route_drop_reference_1(WOLFSENTRY_CONTEXT_ARGS_OUT, target_route, NULL /* action_results */));
-
-    if (trigger_event != NULL)
-        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, trigger_event, NULL /* action_results */));
+    if ((target_route != NULL) &&
+        ((drop_ret = wolfsentry_route_drop_transient(WOLFSENTRY_CONTEXT_ARGS_OUT, &target_route_storage, target_route)) < 0))
+    {
+        WOLFSENTRY_ERROR_RERETURN(drop_ret);
+    }
 
     if (rule_route == NULL) {
         if (inexact_matches)
             *inexact_matches = WOLFSENTRY_ROUTE_WILDCARD_FLAGS | WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD;
         if (action_results)
             *action_results = route_table->default_policy;
-        WOLFSENTRY_SUCCESS_UNLOCK_AND_RETURN(USED_FALLBACK);
+        WOLFSENTRY_SUCCESS_RETURN(USED_FALLBACK);
+    }
+
+    WOLFSENTRY_ERROR_RERETURN(ret);
+}
+
+static wolfsentry_errcode_t wolfsentry_route_event_dispatch_1(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    const char *event_label,
+    int event_label_len,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    wolfsentry_ent_id_t *id,
+    wolfsentry_route_flags_t *inexact_matches,
+    wolfsentry_action_res_t *action_results
+    )
+{
+    struct wolfsentry_event *trigger_event = NULL;
+    wolfsentry_errcode_t ret;
+
+    WOLFSENTRY_SHARED_OR_RETURN();
+
+    if (event_label) {
+        if (((ret = wolfsentry_event_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event_label, event_label_len, &trigger_event)) < 0)
+            && (! (flags & WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD)))
+        {
+            WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+        }
     }
 
+    ret = wolfsentry_route_event_dispatch_2(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, trigger_event, remote, local, flags, NULL /* flow_cache_hint */, caller_arg, id, inexact_matches, action_results);
+
+    if (trigger_event != NULL)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, trigger_event, NULL /* action_results */));
+
     WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
 }
 
@@ -2064,6 +3998,150 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_with_inited_
     WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_event_dispatch_1(WOLFSENTRY_CONTEXT_ARGS_OUT, wolfsentry->routes, remote, local, flags, event_label, event_label_len, caller_arg, id, inexact_matches, action_results));
 }
 
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_batch(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    const struct wolfsentry_sockaddr * const *remotes,
+    const struct wolfsentry_sockaddr * const *locals,
+    const wolfsentry_route_flags_t *flags,
+    unsigned int n_targets,
+    const char *event_label,
+    int event_label_len,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    wolfsentry_ent_id_t *ids,
+    wolfsentry_route_flags_t *inexact_matches,
+    wolfsentry_action_res_t *action_results,
+    wolfsentry_errcode_t *results)
+{
+    struct wolfsentry_event *trigger_event = NULL;
+    wolfsentry_errcode_t event_ret = WOLFSENTRY_ERROR_ENCODE(OK);
+    wolfsentry_errcode_t ret, first_error = WOLFSENTRY_ERROR_ENCODE(OK);
+    struct wolfsentry_route_flow_cache_hint flow_cache_hints[2];
+    int flow_cache_hint_p[2];
+    unsigned int i;
+
+    if ((remotes == NULL) || (locals == NULL) || (flags == NULL) || (action_results == NULL))
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+
+    WOLFSENTRY_SHARED_OR_RETURN();
+
+    if (route_table == NULL)
+        route_table = wolfsentry->routes;
+
+    /* the event is resolved once for the whole batch.  if it's missing,
+     * targets with WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD are still
+     * dispatched, and the rest fail with the lookup error, as they would in
+     * wolfsentry_route_event_dispatch().
+     */
+    if (event_label) {
+        if ((event_ret = wolfsentry_event_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, event_label, event_label_len, &trigger_event)) < 0)
+            trigger_event = NULL;
+    }
+
+    /* each target's flow cache slot is prefetched, and its key hashed, one
+     * target ahead of its dispatch, which reuses the hash.
+     */
+    if (n_targets > 0)
+        flow_cache_hint_p[0] = wolfsentry_route_flow_cache_prefetch(route_table, remotes[0], locals[0], flags[0], WOLFSENTRY_ACTION_RES_NONE, &flow_cache_hints[0]);
+
+    for (i = 0; i < n_targets; ++i) {
+        WOLFSENTRY_CLEAR_ALL_BITS(action_results[i]);
+
+        if (i + 1 < n_targets)
+            flow_cache_hint_p[(i + 1) & 1U] = wolfsentry_route_flow_cache_prefetch(route_table, remotes[i + 1], locals[i + 1], flags[i + 1], WOLFSENTRY_ACTION_RES_NONE, &flow_cache_hints[(i + 1) & 1U]);
+
+        if ((event_ret < 0) && (! (flags[i] & WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD))) {
+            if (ids)
+                ids[i] = WOLFSENTRY_ENT_ID_NONE;
+            ret = event_ret;
+        } else {
+            ret = wolfsentry_route_event_dispatch_2(
+                WOLFSENTRY_CONTEXT_ARGS_OUT,
+                route_table,
+                trigger_event,
+                remotes[i],
+                locals[i],
+                flags[i],
+                flow_cache_hint_p[i & 1U] ? &flow_cache_hints[i & 1U] : NULL,
+                caller_arg,
+                ids ? &ids[i] : NULL,
+                inexact_matches ? &inexact_matches[i] : NULL,
+                &action_results[i]);
+        }
+
+        if (results)
+            results[i] = ret;
+        if ((ret < 0) && (first_error >= 0))
+            first_error = ret;
+    }
+
+    if (trigger_event != NULL)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, trigger_event, NULL /* action_results */));
+
+    WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(first_error);
+}
+
+/* the caller holds a reference to trigger_event for as long as it uses the
+ * handle, so there's no label lookup or refcount traffic per dispatch.
+ */
+static wolfsentry_errcode_t wolfsentry_route_event_dispatch_with_event_1(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    struct wolfsentry_event *trigger_event,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    wolfsentry_ent_id_t *id,
+    wolfsentry_route_flags_t *inexact_matches,
+    wolfsentry_action_res_t *action_results
+    )
+{
+    wolfsentry_errcode_t ret;
+
+    if ((trigger_event != NULL) && (trigger_event->header.refcount <= 0))
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+
+    WOLFSENTRY_SHARED_OR_RETURN();
+
+    ret = wolfsentry_route_event_dispatch_2(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, trigger_event, remote, local, flags, NULL /* flow_cache_hint */, caller_arg, id, inexact_matches, action_results);
+
+    WOLFSENTRY_ERROR_UNLOCK_AND_RERETURN(ret);
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_with_table_with_event(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    struct wolfsentry_event *trigger_event,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    wolfsentry_ent_id_t *id,
+    wolfsentry_route_flags_t *inexact_matches,
+    wolfsentry_action_res_t *action_results
+    )
+{
+    WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_event_dispatch_with_event_1(WOLFSENTRY_CONTEXT_ARGS_OUT, route_table, remote, local, flags, trigger_event, caller_arg, id, inexact_matches, action_results));
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_with_event(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    struct wolfsentry_event *trigger_event,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    wolfsentry_ent_id_t *id,
+    wolfsentry_route_flags_t *inexact_matches,
+    wolfsentry_action_res_t *action_results
+    )
+{
+    WOLFSENTRY_CLEAR_ALL_BITS(*action_results);
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_event_dispatch_with_event_1(WOLFSENTRY_CONTEXT_ARGS_OUT, wolfsentry->routes, remote, local, flags, trigger_event, caller_arg, id, inexact_matches, action_results));
+}
+
 static wolfsentry_errcode_t wolfsentry_route_event_dispatch_by_id_1(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     wolfsentry_ent_id_t id,
@@ -2189,20 +4267,197 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_by_route_wit
     WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_event_dispatch_by_route_1(WOLFSENTRY_CONTEXT_ARGS_OUT, route, event_label, event_label_len, caller_arg, action_results));
 }
 
-/* purge_list: least stale at the head, most stale at the tail. */
+/* the purge wheel -- see struct wolfsentry_route_purge_wheel. */
 
-WOLFSENTRY_LOCAL_VOID wolfsentry_route_purge_list_insert(struct wolfsentry_route_table *route_table, struct wolfsentry_route *route_to_insert) {
-    struct wolfsentry_list_ent_header *point_ent;
+static inline uint64_t wolfsentry_route_purge_wheel_tick(wolfsentry_time_t t) {
+    return (t > 0) ? ((uint64_t)t >> WOLFSENTRY_ROUTE_PURGE_WHEEL_TICK_SHIFT) : 0;
+}
 
-    for (wolfsentry_list_ent_get_first(&route_table->purge_list, &point_ent); point_ent; point_ent = point_ent->next) {
-        struct wolfsentry_route *point_route = WOLFSENTRY_ROUTE_PURGE_HEADER_TO_TABLE_ENT_HEADER(point_ent);
-        if (point_route->meta.purge_after < route_to_insert->meta.purge_after)
+static void wolfsentry_route_purge_wheel_file(struct wolfsentry_route_purge_wheel *wheel, struct wolfsentry_route *route) {
+    uint64_t tick = wolfsentry_route_purge_wheel_tick(route->meta.purge_after);
+    uint64_t delta;
+    unsigned int level, slot;
+
+    /* anything already due goes in the current slot. */
+    if (tick < wheel->current_tick)
+        tick = wheel->current_tick;
+    delta = tick - wheel->current_tick;
+    for (level = 0; level < WOLFSENTRY_ROUTE_PURGE_WHEEL_LEVELS - 1; ++level) {
+        if (delta < ((uint64_t)1 << ((level + 1U) * WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS)))
             break;
     }
-    wolfsentry_list_ent_insert_before(&route_table->purge_list, point_ent, &route_to_insert->purge_links);
+    /* deadlines past the top level wait in its furthest slot, and are refiled
+     * each time it cascades.
+     */
+    if (delta >= ((uint64_t)1 << (WOLFSENTRY_ROUTE_PURGE_WHEEL_LEVELS * WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS)))
+        tick = wheel->current_tick + ((uint64_t)1 << (WOLFSENTRY_ROUTE_PURGE_WHEEL_LEVELS * WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS)) - 1U;
+    slot = (unsigned int)(tick >> (level * WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS)) & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U);
+
+    wolfsentry_list_ent_append(&wheel->slots[level][slot], &route->purge_links);
+    wheel->occupied[level] |= (uint64_t)1 << slot;
+    route->purge_wheel_slot = (uint16_t)((level * WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS) + slot);
+}
+
+static void wolfsentry_route_purge_wheel_unfile(struct wolfsentry_route_purge_wheel *wheel, struct wolfsentry_route *route) {
+    unsigned int level = route->purge_wheel_slot / WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS;
+    unsigned int slot = route->purge_wheel_slot % WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS;
+
+    wolfsentry_list_ent_delete(&wheel->slots[level][slot], &route->purge_links);
+    if (wheel->slots[level][slot].len == 0)
+        wheel->occupied[level] &= ~((uint64_t)1 << slot);
+}
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_route_purge_wheel_insert(struct wolfsentry_route_table *route_table, struct wolfsentry_route *route_to_insert) {
+    struct wolfsentry_route_purge_wheel *wheel = &route_table->purge_wheel;
+    uint64_t insert_tick = wolfsentry_route_purge_wheel_tick(route_to_insert->meta.insert_time);
+
+    /* an empty wheel can jump to the present, rather than later stepping
+     * through every tick since it was last advanced.
+     */
+    if ((wheel->len == 0) && (insert_tick > wheel->current_tick))
+        wheel->current_tick = insert_tick;
+    wolfsentry_route_purge_wheel_file(wheel, route_to_insert);
+    ++wheel->len;
+    WOLFSENTRY_RETURN_VOID;
+}
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_route_purge_wheel_delete(struct wolfsentry_route_table *route_table, struct wolfsentry_route *route_to_delete) {
+    wolfsentry_route_purge_wheel_unfile(&route_table->purge_wheel, route_to_delete);
+    --route_table->purge_wheel.len;
     WOLFSENTRY_RETURN_VOID;
 }
 
+/* refiles everything in a higher-level slot whose span current_tick has just
+ * entered.
+ */
+static void wolfsentry_route_purge_wheel_cascade(struct wolfsentry_route_purge_wheel *wheel, unsigned int level, unsigned int slot) {
+    struct wolfsentry_list_header pending = wheel->slots[level][slot];
+    struct wolfsentry_list_ent_header *i;
+
+    WOLFSENTRY_LIST_HEADER_RESET(wheel->slots[level][slot]);
+    wheel->occupied[level] &= ~((uint64_t)1 << slot);
+    while ((i = pending.head) != NULL) {
+        wolfsentry_list_ent_delete(&pending, i);
+        wolfsentry_route_purge_wheel_file(wheel, WOLFSENTRY_ROUTE_PURGE_HEADER_TO_TABLE_ENT_HEADER(i));
+    }
+}
+
+/* returns a filed route whose purge_after is at or before now, advancing the
+ * wheel toward now as needed, or null if there are none.  the work done is
+ * proportional to the routes that expire or have been hit since filing, plus
+ * the level 0 spans stepped through.  caller must hold the mutex.
+ */
+static struct wolfsentry_route *wolfsentry_route_purge_wheel_next_expired(struct wolfsentry_route_purge_wheel *wheel, wolfsentry_time_t now) {
+    uint64_t target_tick = wolfsentry_route_purge_wheel_tick(now);
+
+    if (wheel->len == 0) {
+        if (target_tick > wheel->current_tick)
+            wheel->current_tick = target_tick;
+        return NULL;
+    }
+
+    for (;;) {
+        unsigned int slot = (unsigned int)wheel->current_tick & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U);
+        struct wolfsentry_list_ent_header *i, *next_i;
+        uint64_t later_slots, next_tick;
+
+        for (i = wheel->slots[0][slot].head; i; i = next_i) {
+            struct wolfsentry_route *route = WOLFSENTRY_ROUTE_PURGE_HEADER_TO_TABLE_ENT_HEADER(i);
+            next_i = i->next;
+            if (route->meta.purge_after <= now)
+                return route;
+            /* hits have moved purge_after out since the route was filed. */
+            if (wolfsentry_route_purge_wheel_tick(route->meta.purge_after) > wheel->current_tick) {
+                wolfsentry_route_purge_wheel_unfile(wheel, route);
+                wolfsentry_route_purge_wheel_file(wheel, route);
+            }
+        }
+
+        if (wheel->current_tick >= target_tick)
+            return NULL;
+
+        /* skip to the next occupied slot in this turn of level 0, or else to
+         * the start of the next turn.
+         */
+        later_slots = wheel->occupied[0] & ~(((uint64_t)2 << slot) - 1U);
+        if (later_slots != 0)
+            next_tick = (wheel->current_tick & ~(uint64_t)(WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U)) | (uint64_t)ctz64(later_slots);
+        else
+            next_tick = (wheel->current_tick | (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U)) + 1U;
+        if (next_tick > target_tick)
+            next_tick = target_tick;
+        wheel->current_tick = next_tick;
+
+        if ((next_tick & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U)) == 0) {
+            unsigned int level;
+            for (level = 1; level < WOLFSENTRY_ROUTE_PURGE_WHEEL_LEVELS; ++level) {
+                unsigned int level_slot = (unsigned int)(next_tick >> (level * WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS)) & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U);
+                wolfsentry_route_purge_wheel_cascade(wheel, level, level_slot);
+                if (level_slot != 0)
+                    break;
+            }
+        }
+    }
+}
+
+#ifdef WOLFSENTRY_THREADSAFE
+/* whether _next_expired() would find anything.  doesn't modify the wheel, so
+ * it's safe under a shared lock.
+ */
+static int wolfsentry_route_purge_wheel_due(const struct wolfsentry_route_purge_wheel *wheel, wolfsentry_time_t now) {
+    uint64_t target_tick = wolfsentry_route_purge_wheel_tick(now);
+    unsigned int slot = (unsigned int)wheel->current_tick & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U);
+    const struct wolfsentry_list_ent_header *i;
+
+    if (wheel->len == 0)
+        return 0;
+    if (target_tick > wheel->current_tick) {
+        /* a cascade may be due. */
+        if ((target_tick >> WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS) != (wheel->current_tick >> WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS))
+            return 1;
+        /* so may slots between here and target_tick. */
+        if ((wheel->occupied[0] & ~(((uint64_t)2 << slot) - 1U) & (((uint64_t)2 << (target_tick & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U))) - 1U)) != 0)
+            return 1;
+    }
+    for (i = wheel->slots[0][slot].head; i; i = i->next) {
+        if (WOLFSENTRY_ROUTE_PURGE_HEADER_TO_TABLE_ENT_HEADER(i)->meta.purge_after <= now)
+            return 1;
+    }
+    return 0;
+}
+#endif
+
+/* the filed route with the earliest deadline, for forced purges.  exact,
+ * except that hits since filing can leave a route looking older than it is.
+ */
+static struct wolfsentry_route *wolfsentry_route_purge_wheel_earliest(const struct wolfsentry_route_purge_wheel *wheel) {
+    unsigned int level;
+
+    for (level = 0; level < WOLFSENTRY_ROUTE_PURGE_WHEEL_LEVELS; ++level) {
+        unsigned int start = (unsigned int)(wheel->current_tick >> (level * WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS)) & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U);
+        uint64_t rotated;
+        const struct wolfsentry_list_ent_header *i;
+        struct wolfsentry_route *earliest = NULL;
+
+        if (wheel->occupied[level] == 0)
+            continue;
+        /* above level 0, the current slot was emptied when current_tick
+         * entered its span, so anything in it now is a whole turn out.
+         */
+        if (level > 0)
+            start = (start + 1U) & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U);
+        rotated = (start == 0) ? wheel->occupied[level] : ((wheel->occupied[level] >> start) | (wheel->occupied[level] << (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - start)));
+        for (i = wheel->slots[level][(start + (unsigned int)ctz64(rotated)) & (WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS - 1U)].head; i; i = i->next) {
+            struct wolfsentry_route *route = WOLFSENTRY_ROUTE_PURGE_HEADER_TO_TABLE_ENT_HEADER(i);
+            if ((earliest == NULL) || (route->meta.purge_after < earliest->meta.purge_after))
+                earliest = route;
+        }
+        return earliest;
+    }
+
+    return NULL;
+}
+
 static wolfsentry_errcode_t wolfsentry_route_stale_purge_1(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     struct wolfsentry_route_table *table,
@@ -2218,8 +4473,9 @@ static wolfsentry_errcode_t wolfsentry_route_stale_purge_1(
     int got_lock = 0;
 #endif
 
+    /* purge deadlines don't need better than the coarse clock. */
     if (mode != 3) {
-        if ((ret = WOLFSENTRY_GET_TIME(&now)) < 0)
+        if ((ret = WOLFSENTRY_GET_TIME_COARSE(&now)) < 0)
             WOLFSENTRY_ERROR_RERETURN(ret);
     }
 
@@ -2246,14 +4502,24 @@ static wolfsentry_errcode_t wolfsentry_route_stale_purge_1(
         }
     } else
         have_mutex = 1;
+
+    /* logged hits can push purge_after out, so they have to land before
+     * anything is judged stale.
+     */
+    if (have_mutex)
+        wolfsentry_route_write_behind_apply(WOLFSENTRY_CONTEXT_ARGS_OUT, table);
 #endif
 
-    while (table->purge_list.tail) {
-        struct wolfsentry_route *route = WOLFSENTRY_ROUTE_PURGE_HEADER_TO_TABLE_ENT_HEADER(table->purge_list.tail);
-        if ((mode != 3) && (route->meta.purge_after > now))
-            break;
+    for (;;) {
+        struct wolfsentry_route *route;
 #ifdef WOLFSENTRY_THREADSAFE
         if (! have_mutex) {
+            if ((mode == 3) ?
+                (table->purge_wheel.len == 0) :
+                (! wolfsentry_route_purge_wheel_due(&table->purge_wheel, now)))
+            {
+                break;
+            }
             if (mode == 2)
                 ret = wolfsentry_lock_shared2mutex_timed(&wolfsentry->lock, thread, 0 /* max_wait */, WOLFSENTRY_LOCK_FLAG_NONE);
             else
@@ -2264,8 +4530,15 @@ static wolfsentry_errcode_t wolfsentry_route_stale_purge_1(
                 WOLFSENTRY_ERROR_RERETURN(ret);
             }
             have_mutex = 1;
+            wolfsentry_route_write_behind_apply(WOLFSENTRY_CONTEXT_ARGS_OUT, table);
         }
 #endif
+        if (mode == 3)
+            route = wolfsentry_route_purge_wheel_earliest(&table->purge_wheel);
+        else
+            route = wolfsentry_route_purge_wheel_next_expired(&table->purge_wheel, now);
+        if (route == NULL)
+            break;
         ret = wolfsentry_route_delete_0(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, table, NULL /* trigger_event */, route, action_results);
         if (ret < 0) {
 #ifdef WOLFSENTRY_THREADSAFE
@@ -2322,6 +4595,67 @@ static wolfsentry_errcode_t wolfsentry_route_stale_purge_one_unconditionally(
     WOLFSENTRY_ERROR_RERETURN(wolfsentry_route_stale_purge_1(WOLFSENTRY_CONTEXT_ARGS_OUT, table, action_results, 3));
 }
 
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_maintenance_run(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    wolfsentry_time_t budget,
+    wolfsentry_hitcount_t max_items,
+    struct wolfsentry_maintenance_report *report)
+{
+    wolfsentry_errcode_t ret;
+    wolfsentry_time_t start, now;
+    wolfsentry_action_res_t action_results = WOLFSENTRY_ACTION_RES_NONE;
+
+    if (report == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    memset(report, 0, sizeof *report);
+
+    if ((ret = WOLFSENTRY_GET_TIME(&start)) < 0)
+        WOLFSENTRY_ERROR_RERETURN(ret);
+    now = start;
+
+    for (;;) {
+        struct wolfsentry_route_table *table;
+        unsigned int n_in_slice;
+
+        WOLFSENTRY_MUTEX_OR_RETURN();
+        ++report->slices;
+        /* looked up each slice, as wolfsentry_context_exchange() may have swapped it. */
+        table = wolfsentry->routes;
+
+#ifdef WOLFSENTRY_THREADSAFE
+        wolfsentry_route_write_behind_apply(WOLFSENTRY_CONTEXT_ARGS_OUT, table);
+#endif
+
+        for (n_in_slice = 0; n_in_slice < WOLFSENTRY_MAINTENANCE_SLICE_ITEMS; ++n_in_slice) {
+            struct wolfsentry_route *route;
+            if ((max_items > 0) && (report->routes_purged >= max_items))
+                break;
+            if ((route = wolfsentry_route_purge_wheel_next_expired(&table->purge_wheel, now)) == NULL) {
+                report->complete = 1;
+                break;
+            }
+            ret = wolfsentry_route_delete_0(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, table, NULL /* trigger_event */, route, &action_results);
+            WOLFSENTRY_UNLOCK_AND_RERETURN_IF_ERROR(ret);
+            WOLFSENTRY_CLEAR_BITS(action_results, WOLFSENTRY_ACTION_RES_STOP);
+            ++report->routes_purged;
+        }
+
+        WOLFSENTRY_UNLOCK_FOR_RETURN();
+
+        if ((ret = WOLFSENTRY_GET_TIME(&now)) < 0)
+            WOLFSENTRY_ERROR_RERETURN(ret);
+        if (report->complete ||
+            ((max_items > 0) && (report->routes_purged >= max_items)) ||
+            ((budget > 0) && (WOLFSENTRY_DIFF_TIME(now, start) >= budget)))
+        {
+            break;
+        }
+    }
+
+    report->elapsed = WOLFSENTRY_DIFF_TIME(now, start);
+    WOLFSENTRY_RETURN_OK;
+}
+
 struct route_delete_filter_args {
     WOLFSENTRY_CONTEXT_ELEMENTS;
 };
@@ -2466,6 +4800,8 @@ static void wolfsentry_route_update_flags_1(
     wolfsentry_route_flags_t *flags_after)
 {
     WOLFSENTRY_ATOMIC_UPDATE_FLAGS(route->flags, flags_to_set, flags_to_clear, flags_before, flags_after);
+    if ((*flags_before != *flags_after) && (route->header.parent_table != NULL))
+        wolfsentry_route_table_generation_bump((struct wolfsentry_route_table *)route->header.parent_table);
     WOLFSENTRY_RETURN_VOID;
 }
 
@@ -2620,6 +4956,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_set_wildcard(
         route->local.sa_port = 0;
     }
 
+    wolfsentry_route_update_key_copies(route);
+
     WOLFSENTRY_RETURN_OK;
 }
 
@@ -2637,7 +4975,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_get_metadata(
     metadata->connection_count = WOLFSENTRY_ATOMIC_LOAD(route->meta.connection_count);
     metadata->derogatory_count = WOLFSENTRY_ATOMIC_LOAD(route->meta.derogatory_count);
     metadata->commendable_count = WOLFSENTRY_ATOMIC_LOAD(route->meta.commendable_count);
-    metadata->hit_count = WOLFSENTRY_ATOMIC_LOAD(route->header.hitcount);
+    metadata->hit_count = WOLFSENTRY_TABLE_ENT_HITCOUNT_GET(&route->header);
     WOLFSENTRY_RETURN_OK;
 }
 
@@ -3621,6 +5959,9 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_table_init(
     route_table->header.free_fn = wolfsentry_route_drop_reference_generic;
     route_table->header.ent_type = WOLFSENTRY_OBJECT_TYPE_ROUTE;
     route_table->highest_priority_route_in_table = MAX_UINT_OF(wolfsentry_priority_t);
+    route_table->generation = 1;
+    WOLFSENTRY_LIST_HEADER_RESET(route_table->tuples);
+    WOLFSENTRY_LIST_HEADER_RESET(route_table->tries);
     WOLFSENTRY_RETURN_OK;
 }
 
@@ -3642,6 +5983,8 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_table_clone_header(
         ((struct wolfsentry_route_table *)src_table)->max_purgeable_routes;
     ((struct wolfsentry_route_table *)dest_table)->default_policy =
         ((struct wolfsentry_route_table *)src_table)->default_policy;
+    ((struct wolfsentry_route_table *)dest_table)->purge_wheel.current_tick =
+        ((struct wolfsentry_route_table *)src_table)->purge_wheel.current_tick;
 
     if (((struct wolfsentry_route_table *)src_table)->default_event != NULL) {
         struct wolfsentry_event *default_event;
@@ -3674,6 +6017,33 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_table_clone_header(
         WOLFSENTRY_RERETURN_IF_ERROR(ret);
     }
 
+    if (((struct wolfsentry_route_table *)src_table)->flow_cache != NULL) {
+        struct wolfsentry_route_flow_cache *flow_cache;
+        if ((ret = wolfsentry_route_flow_cache_new(
+                 WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context),
+                 ((struct wolfsentry_route_table *)src_table)->flow_cache->n_slots,
+                 ((struct wolfsentry_route_table *)src_table)->flow_cache->hash_key,
+                 &flow_cache)) < 0)
+            WOLFSENTRY_ERROR_RERETURN(ret);
+        if (((struct wolfsentry_route_table *)dest_table)->flow_cache != NULL)
+            WOLFSENTRY_FREE_1(dest_context->hpi.allocator, ((struct wolfsentry_route_table *)dest_table)->flow_cache);
+        ((struct wolfsentry_route_table *)dest_table)->flow_cache = flow_cache;
+    }
+
+#ifdef WOLFSENTRY_THREADSAFE
+    if (((struct wolfsentry_route_table *)src_table)->write_behind != NULL) {
+        struct wolfsentry_route_write_behind *write_behind;
+        if ((ret = wolfsentry_route_write_behind_new(
+                 WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context),
+                 ((struct wolfsentry_route_table *)src_table)->write_behind->n_logs,
+                 &write_behind)) < 0)
+            WOLFSENTRY_ERROR_RERETURN(ret);
+        if (((struct wolfsentry_route_table *)dest_table)->write_behind != NULL)
+            wolfsentry_route_write_behind_free(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context), ((struct wolfsentry_route_table *)dest_table)->write_behind);
+        ((struct wolfsentry_route_table *)dest_table)->write_behind = write_behind;
+    }
+#endif
+
     if (WOLFSENTRY_CHECK_BITS(flags, WOLFSENTRY_CLONE_FLAG_NO_ROUTES))
         WOLFSENTRY_RETURN_OK;
 
@@ -3695,6 +6065,24 @@ WOLFSENTRY_LOCAL_VOID wolfsentry_route_table_free(
         WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, (*route_table)->default_event, NULL /* action_results */));
         (*route_table)->default_event = NULL;
     }
+    if ((*route_table)->flow_cache != NULL) {
+        WOLFSENTRY_FREE((*route_table)->flow_cache);
+        (*route_table)->flow_cache = NULL;
+    }
+    if ((*route_table)->negative_filter != NULL) {
+        WOLFSENTRY_FREE((*route_table)->negative_filter);
+        (*route_table)->negative_filter = NULL;
+    }
+#ifdef WOLFSENTRY_THREADSAFE
+    if ((*route_table)->write_behind != NULL) {
+        wolfsentry_route_write_behind_free(WOLFSENTRY_CONTEXT_ARGS_OUT, (*route_table)->write_behind);
+        (*route_table)->write_behind = NULL;
+    }
+#endif
+    while ((*route_table)->tuples.head != NULL)
+        wolfsentry_route_tuple_free(WOLFSENTRY_CONTEXT_ARGS_OUT, *route_table, container_of((*route_table)->tuples.head, struct wolfsentry_route_tuple, header));
+    while ((*route_table)->tries.head != NULL)
+        wolfsentry_route_trie_free(WOLFSENTRY_CONTEXT_ARGS_OUT, *route_table, container_of((*route_table)->tries.head, struct wolfsentry_route_trie, header));
 
     WOLFSENTRY_FREE(*route_table);
     *route_table = NULL;
@@ -3711,6 +6099,10 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_copy_metadata(
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN();
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN_EX(dest_context);
 
+#ifdef WOLFSENTRY_THREADSAFE
+    wolfsentry_route_write_behind_apply(WOLFSENTRY_CONTEXT_ARGS_OUT, from_table);
+#endif
+
     for (from_i = (struct wolfsentry_route *)from_table->header.head,
              to_i = (struct wolfsentry_route *)to_table->header.head;
          from_i && to_i;
@@ -3718,7 +6110,12 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_copy_metadata(
     {
         if (from_i->header.id == to_i->header.id) {
             to_i->flags = from_i->flags;
+            /* refile, since purge_after may move earlier. */
+            if (to_i->meta.purge_after)
+                wolfsentry_route_purge_wheel_delete(to_table, to_i);
             to_i->meta = from_i->meta;
+            if (to_i->meta.purge_after)
+                wolfsentry_route_purge_wheel_insert(to_table, to_i);
         } else {
             int cmpret = wolfsentry_route_key_cmp_1(from_i, to_i, 0 /* match_wildcards_p */, NULL /* inexact_matches */);
             if (cmpret < 0) {
@@ -24,47 +24,303 @@
 
 #define WOLFSENTRY_SOURCE_ID WOLFSENTRY_SOURCE_ID_WOLFSENTRY_INTERNAL_C
 
+/* red-black tree primitives.  the tree orders ents by table->cmp_fn, and the
+ * prev/next links thread the tree in order, so that cursor traversal and
+ * head/tail access remain O(1).  nil leaves are represented by NULL, and are
+ * black.
+ */
+
+#define WOLFSENTRY_RB_IS_RED(ent) (((ent) != NULL) && (ent)->rb_red)
+
+static void wolfsentry_table_rb_rotate_left(struct wolfsentry_table_header *table, struct wolfsentry_table_ent_header *x) {
+    struct wolfsentry_table_ent_header *y = x->rb_right;
+    x->rb_right = y->rb_left;
+    if (y->rb_left)
+        y->rb_left->rb_parent = x;
+    y->rb_parent = x->rb_parent;
+    if (x->rb_parent == NULL)
+        table->root = y;
+    else if (x == x->rb_parent->rb_left)
+        x->rb_parent->rb_left = y;
+    else
+        x->rb_parent->rb_right = y;
+    y->rb_left = x;
+    x->rb_parent = y;
+}
+
+static void wolfsentry_table_rb_rotate_right(struct wolfsentry_table_header *table, struct wolfsentry_table_ent_header *x) {
+    struct wolfsentry_table_ent_header *y = x->rb_left;
+    x->rb_left = y->rb_right;
+    if (y->rb_right)
+        y->rb_right->rb_parent = x;
+    y->rb_parent = x->rb_parent;
+    if (x->rb_parent == NULL)
+        table->root = y;
+    else if (x == x->rb_parent->rb_right)
+        x->rb_parent->rb_right = y;
+    else
+        x->rb_parent->rb_left = y;
+    y->rb_right = x;
+    x->rb_parent = y;
+}
+
+/* links ent into the tree as the left or right child of parent (which must
+ * have no child on that side), threads it into the in-order list, and
+ * rebalances.  parent is NULL iff the table is empty.
+ */
+static void wolfsentry_table_rb_link(struct wolfsentry_table_header *table, struct wolfsentry_table_ent_header *parent, int left_p, struct wolfsentry_table_ent_header *ent) {
+    struct wolfsentry_table_ent_header *z = ent;
+
+    ent->rb_parent = parent;
+    ent->rb_left = ent->rb_right = NULL;
+    ent->rb_red = 1;
+
+    if (parent == NULL) {
+        table->root = table->head = table->tail = ent;
+        ent->prev = ent->next = NULL;
+    } else if (left_p) {
+        parent->rb_left = ent;
+        ent->next = parent;
+        ent->prev = parent->prev;
+        if (parent->prev)
+            parent->prev->next = ent;
+        else
+            table->head = ent;
+        parent->prev = ent;
+    } else {
+        parent->rb_right = ent;
+        ent->prev = parent;
+        ent->next = parent->next;
+        if (parent->next)
+            parent->next->prev = ent;
+        else
+            table->tail = ent;
+        parent->next = ent;
+    }
+
+    while (WOLFSENTRY_RB_IS_RED(z->rb_parent)) {
+        struct wolfsentry_table_ent_header *p = z->rb_parent, *g = p->rb_parent, *u;
+        if (p == g->rb_left) {
+            u = g->rb_right;
+            if (WOLFSENTRY_RB_IS_RED(u)) {
+                p->rb_red = u->rb_red = 0;
+                g->rb_red = 1;
+                z = g;
+                continue;
+            }
+            if (z == p->rb_right) {
+                z = p;
+                wolfsentry_table_rb_rotate_left(table, z);
+                p = z->rb_parent;
+            }
+            p->rb_red = 0;
+            g->rb_red = 1;
+            wolfsentry_table_rb_rotate_right(table, g);
+        } else {
+            u = g->rb_left;
+            if (WOLFSENTRY_RB_IS_RED(u)) {
+                p->rb_red = u->rb_red = 0;
+                g->rb_red = 1;
+                z = g;
+                continue;
+            }
+            if (z == p->rb_left) {
+                z = p;
+                wolfsentry_table_rb_rotate_right(table, z);
+                p = z->rb_parent;
+            }
+            p->rb_red = 0;
+            g->rb_red = 1;
+            wolfsentry_table_rb_rotate_left(table, g);
+        }
+    }
+    table->root->rb_red = 0;
+}
+
+/* appends ent after the current tail -- used when building a table from an
+ * already-sorted source.
+ */
+static void wolfsentry_table_rb_append(struct wolfsentry_table_header *table, struct wolfsentry_table_ent_header *ent) {
+    wolfsentry_table_rb_link(table, table->tail, 0 /* left_p */, ent);
+}
+
+static void wolfsentry_table_rb_transplant(struct wolfsentry_table_header *table, struct wolfsentry_table_ent_header *u, struct wolfsentry_table_ent_header *v) {
+    if (u->rb_parent == NULL)
+        table->root = v;
+    else if (u == u->rb_parent->rb_left)
+        u->rb_parent->rb_left = v;
+    else
+        u->rb_parent->rb_right = v;
+    if (v)
+        v->rb_parent = u->rb_parent;
+}
+
+static void wolfsentry_table_rb_unlink(struct wolfsentry_table_header *table, struct wolfsentry_table_ent_header *z) {
+    struct wolfsentry_table_ent_header *x, *x_parent, *w;
+    int removed_red = z->rb_red;
+
+    if (z->rb_left == NULL) {
+        x = z->rb_right;
+        x_parent = z->rb_parent;
+        wolfsentry_table_rb_transplant(table, z, x);
+    } else if (z->rb_right == NULL) {
+        x = z->rb_left;
+        x_parent = z->rb_parent;
+        wolfsentry_table_rb_transplant(table, z, x);
+    } else {
+        /* z has two children, so its in-order successor is the minimum of its
+         * right subtree, which is z->next.
+         */
+        struct wolfsentry_table_ent_header *y = z->next;
+        removed_red = y->rb_red;
+        x = y->rb_right;
+        if (y->rb_parent == z)
+            x_parent = y;
+        else {
+            x_parent = y->rb_parent;
+            wolfsentry_table_rb_transplant(table, y, x);
+            y->rb_right = z->rb_right;
+            y->rb_right->rb_parent = y;
+        }
+        wolfsentry_table_rb_transplant(table, z, y);
+        y->rb_left = z->rb_left;
+        y->rb_left->rb_parent = y;
+        y->rb_red = z->rb_red;
+    }
+
+    if (! removed_red) {
+        while ((x != table->root) && (! WOLFSENTRY_RB_IS_RED(x))) {
+            if (x == x_parent->rb_left) {
+                w = x_parent->rb_right;
+                if (w->rb_red) {
+                    w->rb_red = 0;
+                    x_parent->rb_red = 1;
+                    wolfsentry_table_rb_rotate_left(table, x_parent);
+                    w = x_parent->rb_right;
+                }
+                if ((! WOLFSENTRY_RB_IS_RED(w->rb_left)) && (! WOLFSENTRY_RB_IS_RED(w->rb_right))) {
+                    w->rb_red = 1;
+                    x = x_parent;
+                    x_parent = x->rb_parent;
+                } else {
+                    if (! WOLFSENTRY_RB_IS_RED(w->rb_right)) {
+                        w->rb_left->rb_red = 0;
+                        w->rb_red = 1;
+                        wolfsentry_table_rb_rotate_right(table, w);
+                        w = x_parent->rb_right;
+                    }
+                    w->rb_red = x_parent->rb_red;
+                    x_parent->rb_red = 0;
+                    if (w->rb_right)
+                        w->rb_right->rb_red = 0;
+                    wolfsentry_table_rb_rotate_left(table, x_parent);
+                    x = table->root;
+                }
+            } else {
+                w = x_parent->rb_left;
+                if (w->rb_red) {
+                    w->rb_red = 0;
+                    x_parent->rb_red = 1;
+                    wolfsentry_table_rb_rotate_right(table, x_parent);
+                    w = x_parent->rb_left;
+                }
+                if ((! WOLFSENTRY_RB_IS_RED(w->rb_left)) && (! WOLFSENTRY_RB_IS_RED(w->rb_right))) {
+                    w->rb_red = 1;
+                    x = x_parent;
+                    x_parent = x->rb_parent;
+                } else {
+                    if (! WOLFSENTRY_RB_IS_RED(w->rb_left)) {
+                        w->rb_right->rb_red = 0;
+                        w->rb_red = 1;
+                        wolfsentry_table_rb_rotate_left(table, w);
+                        w = x_parent->rb_left;
+                    }
+                    w->rb_red = x_parent->rb_red;
+                    x_parent->rb_red = 0;
+                    if (w->rb_left)
+                        w->rb_left->rb_red = 0;
+                    wolfsentry_table_rb_rotate_right(table, x_parent);
+                    x = table->root;
+                }
+            }
+        }
+        if (x)
+            x->rb_red = 0;
+    }
+
+    if (z->prev)
+        z->prev->next = z->next;
+    else
+        table->head = z->next;
+    if (z->next)
+        z->next->prev = z->prev;
+    else
+        table->tail = z->prev;
+
+    z->rb_parent = z->rb_left = z->rb_right = NULL;
+    z->prev = z->next = NULL;
+    z->rb_red = 0;
+}
+
+/* returns the first ent in the table that compares >= ent, or NULL if there is
+ * none, with the result of the comparison in *cmpret.
+ */
+static struct wolfsentry_table_ent_header *wolfsentry_table_rb_lower_bound(const struct wolfsentry_table_header *table, const struct wolfsentry_table_ent_header *ent, int *cmpret) {
+    struct wolfsentry_table_ent_header *i = table->root, *ret = NULL;
+    while (i) {
+        int c = table->cmp_fn(i, ent);
+        if (c >= 0) {
+            ret = i;
+            *cmpret = c;
+            if (c == 0)
+                break;
+            i = i->rb_left;
+        } else
+            i = i->rb_right;
+    }
+    return ret;
+}
+
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_insert(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_ent_header *ent, struct wolfsentry_table_header *table, int unique_p) {
-    struct wolfsentry_table_ent_header *i = table->head;
-    int cmpret;
+    struct wolfsentry_table_ent_header *i = table->root, *parent = NULL;
+    int left_p = 0;
 
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN();
 
     if (ent->id == WOLFSENTRY_ENT_ID_NONE)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
 
-    while (i) {
-        if ((cmpret = table->cmp_fn(i, ent)) >= 0)
-            break;
-        i = i->next;
-    }
-    if (i) {
-        if ((cmpret == 0) && unique_p) {
-            if (ent->id != WOLFSENTRY_ENT_ID_NONE)
-                WOLFSENTRY_RERETURN_IF_ERROR(wolfsentry_table_ent_delete_by_id_1(WOLFSENTRY_CONTEXT_ARGS_OUT, ent));
-            WOLFSENTRY_ERROR_RETURN(ITEM_ALREADY_PRESENT);
-        }
-        ent->prev = i->prev;
-        ent->next = i;
-        if (i->prev) {
-            i->prev->next = ent;
-        } else {
-            table->head = ent;
+    /* an ent that sorts after the current tail (e.g. the next of a sorted
+     * bulk load) links as the tail's right child without a descent.
+     */
+    if ((table->tail != NULL) && (table->cmp_fn(table->tail, ent) < 0))
+        parent = table->tail;
+    else {
+        while (i) {
+            int cmpret = table->cmp_fn(i, ent);
+            parent = i;
+            if (cmpret >= 0) {
+                /* the caller unlinks ent from the ID index on failure. */
+                if ((cmpret == 0) && unique_p)
+                    WOLFSENTRY_ERROR_RETURN(ITEM_ALREADY_PRESENT);
+                left_p = 1;
+                i = i->rb_left;
+            } else {
+                left_p = 0;
+                i = i->rb_right;
+            }
         }
-        i->prev = ent;
-    } else if (table->tail) {
-        table->tail->next = ent;
-        ent->prev = table->tail;
-        ent->next = NULL;
-        table->tail = ent;
-    } else {
-        table->head = table->tail = ent;
-        ent->prev = ent->next = NULL;
     }
+
+    wolfsentry_table_rb_link(table, parent, left_p, ent);
+
     ++table->n_ents;
     ++table->n_inserts;
     ent->parent_table = table;
 
+    if (table->ent_type == WOLFSENTRY_OBJECT_TYPE_EVENT)
+        wolfsentry_event_label_index_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, (struct wolfsentry_event_table *)table, (struct wolfsentry_event *)ent);
+
     WOLFSENTRY_RETURN_OK;
 }
 
@@ -107,7 +363,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_clone(
 {
     wolfsentry_errcode_t ret;
     wolfsentry_table_ent_clone_fn_t clone_fn = NULL;
-    struct wolfsentry_table_ent_header *prev = NULL, *new = NULL, *i;
+    struct wolfsentry_table_ent_header *new = NULL, *i;
 
     WOLFSENTRY_HAVE_A_LOCK_OR_RETURN();
 #ifdef WOLFSENTRY_THREADSAFE
@@ -172,23 +428,27 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_clone(
     {
         if ((ret = clone_fn(WOLFSENTRY_CONTEXT_ARGS_OUT, i, dest_context, &new, flags)) < 0)
             goto out;
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+        /* the clone starts over in dest_table with the folded count. */
+        new->hitcount = wolfsentry_table_ent_hitcount_get(i);
+        new->hitcount_slot = 0;
+#endif
         new->parent_table = dest_table;
-        new->prev = prev;
-        if (prev)
-            prev->next = new;
-        else
-            dest_table->head = new;
-        prev = new;
+        /* the source table is already sorted, so each new ent goes at the tail. */
+        wolfsentry_table_rb_append(dest_table, new);
         if ((ret = wolfsentry_table_ent_insert_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context), new)) < 0)
             goto out;
 
-        if ((src_table->ent_type == WOLFSENTRY_OBJECT_TYPE_ROUTE) &&
-            ((struct wolfsentry_route *)new)->meta.purge_after)
-        {
-            wolfsentry_route_purge_list_insert((struct wolfsentry_route_table *)dest_table, (struct wolfsentry_route *)new);
+        if (src_table->ent_type == WOLFSENTRY_OBJECT_TYPE_EVENT)
+            wolfsentry_event_label_index_insert(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context), (struct wolfsentry_event_table *)dest_table, (struct wolfsentry_event *)new);
+
+        if (src_table->ent_type == WOLFSENTRY_OBJECT_TYPE_ROUTE) {
+            if ((ret = wolfsentry_route_index_insert(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context), (struct wolfsentry_route_table *)dest_table, (struct wolfsentry_route *)new)) < 0)
+                goto out;
+            if (((struct wolfsentry_route *)new)->meta.purge_after)
+                wolfsentry_route_purge_wheel_insert((struct wolfsentry_route_table *)dest_table, (struct wolfsentry_route *)new);
         }
     }
-    dest_table->tail = new;
 
     dest_table->n_ents = src_table->n_ents;
 
@@ -217,7 +477,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_coupled_table_clone(
 {
     wolfsentry_errcode_t ret;
     wolfsentry_coupled_table_ent_clone_fn_t clone_fn = NULL;
-    struct wolfsentry_table_ent_header *prev = NULL, *new1 = NULL, *new2 = NULL, *i;
+    struct wolfsentry_table_ent_header *new1 = NULL, *new2 = NULL, *i;
 
     WOLFSENTRY_HAVE_A_LOCK_OR_RETURN();
 #ifdef WOLFSENTRY_THREADSAFE
@@ -269,11 +529,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_coupled_table_clone(
             goto out;
         new1->parent_table = dest_table1;
         new2->parent_table = dest_table2;
-        if (prev)
-            prev->next = new1;
-        else
-            dest_table1->head = new1;
-        prev = new1;
+        wolfsentry_table_rb_append(dest_table1, new1);
         if ((ret = wolfsentry_table_ent_insert_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context), new1)) < 0)
             goto out;
         if ((ret = wolfsentry_table_ent_insert_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context), new2)) < 0)
@@ -281,7 +537,6 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_coupled_table_clone(
         if ((ret = wolfsentry_table_ent_insert(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(dest_context), new2, dest_table2, 1 /* unique_p */)) < 0)
             goto out;
     }
-    dest_table1->tail = new1;
 
     dest_table1->n_ents = src_table1->n_ents;
 
@@ -296,13 +551,64 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_coupled_table_clone(
 }
 #endif /* WOLFSENTRY_PROTOCOL_NAMES */
 
-static inline int wolfsentry_ent_id_cmp(struct wolfsentry_table_ent_header *left, wolfsentry_ent_id_t right_id) {
-    if (left->id < right_id)
-        return -1;
-    else if (left->id > right_id)
-        return 1;
-    else
-        return 0;
+/* the built-in ID counter is monotonic, so live IDs are nearly dense, and
+ * indexing the bucket array directly by the low bits of the ID spreads them
+ * without collisions until the live range outgrows the array.  IDs from a
+ * caller-supplied mk_id_cb have no such guarantee, so they're mixed first.
+ */
+static inline uint32_t wolfsentry_ent_id_hash(const struct wolfsentry_context *wolfsentry, wolfsentry_ent_id_t id) {
+    uint32_t hash = (uint32_t)id;
+    if (sizeof id > sizeof hash)
+        hash ^= (uint32_t)((uint64_t)id >> 32U);
+    if (wolfsentry->mk_id_cb != NULL) {
+        hash ^= hash >> 16U;
+        hash *= 0x85ebca6bU;
+        hash ^= hash >> 13U;
+        hash *= 0xc2b2ae35U;
+        hash ^= hash >> 16U;
+    }
+    return hash;
+}
+
+static inline struct wolfsentry_table_ent_header **wolfsentry_ent_id_bucket(const struct wolfsentry_context *wolfsentry, wolfsentry_ent_id_t id) {
+    return &wolfsentry->ents_by_id.buckets[wolfsentry_ent_id_hash(wolfsentry, id) & (wolfsentry->ents_by_id.n_buckets - 1U)];
+}
+
+/* failure just leaves the chains longer. */
+static void wolfsentry_ent_id_index_grow(WOLFSENTRY_CONTEXT_ARGS_IN) {
+    struct wolfsentry_ent_id_index *index = &wolfsentry->ents_by_id;
+    uint32_t new_n_buckets = index->n_buckets ? index->n_buckets << 1U : WOLFSENTRY_ENT_ID_INDEX_INITIAL_BUCKETS;
+    struct wolfsentry_table_ent_header **new_buckets;
+    struct wolfsentry_table_ent_header **old_buckets = index->buckets;
+    uint32_t old_n_buckets = index->n_buckets;
+    uint32_t i;
+
+    if (new_n_buckets < index->n_buckets)
+        WOLFSENTRY_RETURN_VOID;
+    if ((new_buckets = (struct wolfsentry_table_ent_header **)WOLFSENTRY_MALLOC(new_n_buckets * sizeof *new_buckets)) == NULL)
+        WOLFSENTRY_RETURN_VOID;
+    memset(new_buckets, 0, new_n_buckets * sizeof *new_buckets);
+
+    index->buckets = new_buckets;
+    index->n_buckets = new_n_buckets;
+
+    for (i = 0; i < old_n_buckets; ++i) {
+        struct wolfsentry_table_ent_header *ent, *next;
+        for (ent = old_buckets[i]; ent; ent = next) {
+            struct wolfsentry_table_ent_header **bucket = wolfsentry_ent_id_bucket(wolfsentry, ent->id);
+            next = ent->next_by_id;
+            ent->prev_by_id = NULL;
+            ent->next_by_id = *bucket;
+            if (*bucket)
+                (*bucket)->prev_by_id = ent;
+            *bucket = ent;
+        }
+    }
+
+    if (old_buckets != NULL)
+        WOLFSENTRY_FREE(old_buckets);
+
+    WOLFSENTRY_RETURN_VOID;
 }
 
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_id_allocate(
@@ -328,6 +634,10 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_id_allocate(
             break;
     }
 
+    /* leave no ID behind for the caller's cleanup to unlink. */
+    if (ret < 0)
+        ent->id = WOLFSENTRY_ENT_ID_NONE;
+
     WOLFSENTRY_ERROR_RERETURN(ret);
 }
 
@@ -346,39 +656,31 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_label_is_builtin(const char *la
 }
 
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_insert_by_id(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_ent_header *ent) {
-    struct wolfsentry_table_ent_header *i = wolfsentry->ents_by_id.head;
-    int cmpret;
+    struct wolfsentry_table_ent_header **bucket, *i;
 
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN();
 
     if (ent->id == WOLFSENTRY_ENT_ID_NONE)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
 
-    while (i) {
-        if ((cmpret = wolfsentry_ent_id_cmp(i, ent->id)) >= 0)
-            break;
-        i = i->next_by_id;
+    if (wolfsentry->ents_by_id.n_ents >= wolfsentry->ents_by_id.n_buckets) {
+        wolfsentry_ent_id_index_grow(WOLFSENTRY_CONTEXT_ARGS_OUT);
+        if (wolfsentry->ents_by_id.n_buckets == 0)
+            WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     }
-    if (i) {
-        if (cmpret == 0)
+
+    bucket = wolfsentry_ent_id_bucket(wolfsentry, ent->id);
+    for (i = *bucket; i; i = i->next_by_id) {
+        if (i->id == ent->id)
             WOLFSENTRY_ERROR_RETURN(ITEM_ALREADY_PRESENT);
-        ent->prev_by_id = i->prev_by_id;
-        ent->next_by_id = i;
-        if (i->prev_by_id) {
-            i->prev_by_id->next_by_id = ent;
-        } else {
-            wolfsentry->ents_by_id.head = ent;
-        }
-        i->prev_by_id = ent;
-    } else if (wolfsentry->ents_by_id.tail) {
-        wolfsentry->ents_by_id.tail->next_by_id = ent;
-        ent->prev_by_id = wolfsentry->ents_by_id.tail;
-        ent->next_by_id = NULL;
-        wolfsentry->ents_by_id.tail = ent;
-    } else {
-        wolfsentry->ents_by_id.head = wolfsentry->ents_by_id.tail = ent;
-        ent->prev_by_id = ent->next_by_id = NULL;
     }
+
+    ent->prev_by_id = NULL;
+    ent->next_by_id = *bucket;
+    if (*bucket)
+        (*bucket)->prev_by_id = ent;
+    *bucket = ent;
+
     ++wolfsentry->ents_by_id.n_ents;
     ++wolfsentry->ents_by_id.n_inserts;
     WOLFSENTRY_RETURN_OK;
@@ -392,30 +694,40 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_table_ent_get_by_id(WOLFSENTRY_CO
     if (id == WOLFSENTRY_ENT_ID_NONE)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
 
-    for (i = wolfsentry->ents_by_id.head; i; i = i->next_by_id) {
-        int c = wolfsentry_ent_id_cmp(i, id);
-        if (c >= 0) {
-            if (c == 0) {
-                *ent = i;
-                WOLFSENTRY_RETURN_OK;
-            }
-            WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
+    if (wolfsentry->ents_by_id.n_buckets == 0)
+        WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
+
+    for (i = *wolfsentry_ent_id_bucket(wolfsentry, id); i; i = i->next_by_id) {
+        if (i->id == id) {
+            *ent = i;
+            WOLFSENTRY_RETURN_OK;
         }
     }
     WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
 }
 
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_delete_by_id_1(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_ent_header *ent) {
+    struct wolfsentry_table_ent_header **bucket;
+
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN();
 
+    if (wolfsentry->ents_by_id.n_buckets == 0)
+        WOLFSENTRY_RETURN_OK;
+
+    bucket = wolfsentry_ent_id_bucket(wolfsentry, ent->id);
+
+    /* an ent that isn't at the head of its bucket must have a predecessor --
+     * anything else means it was already unlinked.
+     */
+    if ((ent->prev_by_id == NULL) && (*bucket != ent))
+        WOLFSENTRY_ERROR_RETURN(INTERNAL_CHECK_FATAL);
+
     if (ent->prev_by_id)
         ent->prev_by_id->next_by_id = ent->next_by_id;
     else
-        wolfsentry->ents_by_id.head = ent->next_by_id;
+        *bucket = ent->next_by_id;
     if (ent->next_by_id)
         ent->next_by_id->prev_by_id = ent->prev_by_id;
-    else
-        wolfsentry->ents_by_id.tail = ent->prev_by_id;
     ent->prev_by_id = ent->next_by_id = NULL;
     --wolfsentry->ents_by_id.n_ents;
     ++wolfsentry->ents_by_id.n_deletes;
@@ -432,48 +744,490 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_delete_by_id(WOLFSENT
 
     if ((ret = wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, id, ent)) < 0)
         WOLFSENTRY_ERROR_RERETURN(ret);
-    ret = wolfsentry_table_ent_delete_by_id_1(WOLFSENTRY_CONTEXT_ARGS_OUT, *ent);
-    WOLFSENTRY_RERETURN_IF_ERROR(ret);
+    /* wolfsentry_table_ent_delete_1() unlinks from the ID index too. */
     if ((*ent)->parent_table)
         ret = wolfsentry_table_ent_delete_1(WOLFSENTRY_CONTEXT_ARGS_OUT, *ent);
+    else
+        ret = wolfsentry_table_ent_delete_by_id_1(WOLFSENTRY_CONTEXT_ARGS_OUT, *ent);
 
     WOLFSENTRY_ERROR_RERETURN(ret);
 }
 
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_get(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_header *table, struct wolfsentry_table_ent_header **ent) {
-    struct wolfsentry_table_ent_header *i = table->head;
+    struct wolfsentry_table_ent_header *i;
+    int c = -1;
 
     WOLFSENTRY_HAVE_A_LOCK_OR_RETURN();
 
-    while (i) {
-        int c = table->cmp_fn(i, *ent);
-        if (c >= 0) {
-            if (c == 0) {
-                *ent = i;
-                WOLFSENTRY_RETURN_OK;
+    i = wolfsentry_table_rb_lower_bound(table, *ent, &c);
+    if ((i == NULL) || (c != 0))
+        WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
+    *ent = i;
+    WOLFSENTRY_RETURN_OK;
+}
+
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+
+/* a thread always counts in the same row of a slab.  threads that hash to the
+ * same shard share its counters, which costs contention but not accuracy.
+ */
+static inline unsigned int wolfsentry_hitcount_shard(struct wolfsentry_thread_context *thread) {
+    uint64_t h = (uint64_t)(uintptr_t)WOLFSENTRY_THREAD_GET_ID * 0x9e3779b97f4a7c15ULL;
+    return (unsigned int)(h >> 32U) & (WOLFSENTRY_HITCOUNT_SHARDS - 1U);
+}
+
+WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_hitcount_slab_init(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_header *table) {
+    struct wolfsentry_hitcount_slab *slab;
+    size_t alloc_size = ((size_t)WOLFSENTRY_HITCOUNT_SHARDS * WOLFSENTRY_HITCOUNT_SHARD_SLOTS * sizeof *slab->counters) + WOLFSENTRY_CACHE_LINE_SIZE - 1;
+    uintptr_t misalignment;
+
+    if ((slab = (struct wolfsentry_hitcount_slab *)WOLFSENTRY_MALLOC(sizeof *slab)) == NULL)
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+    memset(slab, 0, sizeof *slab);
+    if ((slab->counters_alloc = WOLFSENTRY_MALLOC(alloc_size)) == NULL) {
+        WOLFSENTRY_FREE(slab);
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+    }
+    memset(slab->counters_alloc, 0, alloc_size);
+    misalignment = (uintptr_t)slab->counters_alloc & (WOLFSENTRY_CACHE_LINE_SIZE - 1);
+    slab->counters = (wolfsentry_hitcount_t *)(void *)
+        ((byte *)slab->counters_alloc + (misalignment ? WOLFSENTRY_CACHE_LINE_SIZE - misalignment : 0));
+    table->hitcount_slab = slab;
+    WOLFSENTRY_RETURN_OK;
+}
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_table_hitcount_slab_free(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_header *table) {
+    if (table->hitcount_slab == NULL)
+        WOLFSENTRY_RETURN_VOID;
+    WOLFSENTRY_FREE(table->hitcount_slab->counters_alloc);
+    WOLFSENTRY_FREE(table->hitcount_slab);
+    table->hitcount_slab = NULL;
+    WOLFSENTRY_RETURN_VOID;
+}
+
+static void wolfsentry_hitcount_slab_assign(struct wolfsentry_hitcount_slab *slab, struct wolfsentry_table_ent_header *ent) {
+    unsigned int i;
+
+    for (i = 0; i < WOLFSENTRY_HITCOUNT_SHARD_SLOTS / 32U; ++i) {
+        uint32_t word = WOLFSENTRY_ATOMIC_LOAD(slab->slots_in_use[i]);
+        while (word != ~(uint32_t)0) {
+            unsigned int bit = (unsigned int)__builtin_ctz(~word);
+            /* on failure, _TEST_AND_SET() reloads word. */
+            if (WOLFSENTRY_ATOMIC_TEST_AND_SET(slab->slots_in_use[i], word, word | ((uint32_t)1 << bit))) {
+                WOLFSENTRY_ATOMIC_STORE(ent->hitcount_slot, (uint16_t)((i * 32U) + bit + 1U));
+                return;
             }
-            WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
         }
-        i = i->next;
     }
-    WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
+    /* every slot is taken -- ent keeps counting directly in its header. */
+}
+
+/* action hit counts wrap, as they do unsharded.  route hit counts saturate, so
+ * that wolfsentry_route_increment_hitcount() can set _DONT_COUNT_HITS.
+ */
+static inline int wolfsentry_hitcount_wraps(const struct wolfsentry_table_ent_header *ent) {
+    return (ent->parent_table != NULL) && (ent->parent_table->ent_type == WOLFSENTRY_OBJECT_TYPE_ACTION);
+}
+
+/* moves the hits pending in counter into the ent header. */
+static void wolfsentry_hitcount_fold(struct wolfsentry_table_ent_header *ent, wolfsentry_hitcount_t *counter) {
+    wolfsentry_hitcount_t pending, post;
+
+    WOLFSENTRY_ATOMIC_RESET(*counter, &pending);
+    if (pending == 0)
+        return;
+    if (wolfsentry_hitcount_wraps(ent)) {
+        WOLFSENTRY_ATOMIC_INCREMENT(ent->hitcount, pending);
+        return;
+    }
+    WOLFSENTRY_ATOMIC_INCREMENT_UNSIGNED_SAFELY(ent->hitcount, pending, post);
+    if (post == 0)
+        WOLFSENTRY_ATOMIC_STORE(ent->hitcount, (wolfsentry_hitcount_t)MAX_UINT_OF(ent->hitcount));
+}
+
+/* an ent starts out counting directly in its header, and is given a slot in
+ * the slab on its _PROMOTE_AT'th hit.  returns 0 iff the count is saturated,
+ * as for WOLFSENTRY_ATOMIC_INCREMENT_UNSIGNED_SAFELY_BY_ONE(), which a
+ * wrapping count never is.
+ */
+WOLFSENTRY_LOCAL wolfsentry_hitcount_t wolfsentry_table_ent_hitcount_increment(struct wolfsentry_thread_context *thread, struct wolfsentry_table_ent_header *ent) {
+    unsigned int slot = WOLFSENTRY_ATOMIC_LOAD(ent->hitcount_slot);
+    wolfsentry_hitcount_t *counter;
+    wolfsentry_hitcount_t post;
+
+    if (slot == 0) {
+        if (wolfsentry_hitcount_wraps(ent)) {
+            if ((post = WOLFSENTRY_ATOMIC_INCREMENT(ent->hitcount, 1U)) == 0)
+                post = 1; /* wrapped, not saturated. */
+        } else
+            WOLFSENTRY_ATOMIC_INCREMENT_UNSIGNED_SAFELY_BY_ONE(ent->hitcount, post);
+        if ((post == WOLFSENTRY_HITCOUNT_SHARD_PROMOTE_AT) &&
+            (ent->parent_table != NULL) &&
+            (ent->parent_table->hitcount_slab != NULL))
+        {
+            wolfsentry_hitcount_slab_assign(ent->parent_table->hitcount_slab, ent);
+        }
+        WOLFSENTRY_RETURN_VALUE(post);
+    }
+
+    counter = &ent->parent_table->hitcount_slab->counters[(wolfsentry_hitcount_shard(thread) * WOLFSENTRY_HITCOUNT_SHARD_SLOTS) + slot - 1U];
+    if (WOLFSENTRY_ATOMIC_INCREMENT(*counter, 1U) >= WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT) {
+        wolfsentry_hitcount_fold(ent, counter);
+        if ((! wolfsentry_hitcount_wraps(ent)) && (WOLFSENTRY_ATOMIC_LOAD(ent->hitcount) == MAX_UINT_OF(ent->hitcount)))
+            WOLFSENTRY_RETURN_VALUE(0);
+    }
+    WOLFSENTRY_RETURN_VALUE(1);
+}
+
+/* the header count plus the pending count in each shard, wrapping or
+ * saturating like the ent's increments.  with only a shared lock, a fold in
+ * progress can make the sum momentarily short.
+ */
+WOLFSENTRY_LOCAL wolfsentry_hitcount_t wolfsentry_table_ent_hitcount_get(const struct wolfsentry_table_ent_header *ent) {
+    unsigned int slot = WOLFSENTRY_ATOMIC_LOAD(ent->hitcount_slot);
+    wolfsentry_hitcount_t total = WOLFSENTRY_ATOMIC_LOAD(ent->hitcount);
+    const wolfsentry_hitcount_t *counter;
+    unsigned int shard;
+
+    if (slot == 0)
+        WOLFSENTRY_RETURN_VALUE(total);
+
+    for (shard = 0, counter = &ent->parent_table->hitcount_slab->counters[slot - 1U];
+         shard < WOLFSENTRY_HITCOUNT_SHARDS;
+         ++shard, counter += WOLFSENTRY_HITCOUNT_SHARD_SLOTS)
+    {
+        wolfsentry_hitcount_t pending = WOLFSENTRY_ATOMIC_LOAD(*counter);
+        if ((MAX_UINT_OF(total) - total < pending) && (! wolfsentry_hitcount_wraps(ent)))
+            WOLFSENTRY_RETURN_VALUE((wolfsentry_hitcount_t)MAX_UINT_OF(total));
+        total = (wolfsentry_hitcount_t)(total + pending);
+    }
+    WOLFSENTRY_RETURN_VALUE(total);
+}
+
+/* folds the ent's pending hits into its header and frees its slot.  caller
+ * must hold the mutex, so that no hits on ent are being counted concurrently.
+ */
+WOLFSENTRY_LOCAL_VOID wolfsentry_table_ent_hitcount_release(struct wolfsentry_table_ent_header *ent) {
+    struct wolfsentry_hitcount_slab *slab;
+    unsigned int slot = ent->hitcount_slot;
+    unsigned int shard;
+
+    if (slot == 0)
+        WOLFSENTRY_RETURN_VOID;
+    slab = ent->parent_table->hitcount_slab;
+    for (shard = 0; shard < WOLFSENTRY_HITCOUNT_SHARDS; ++shard)
+        wolfsentry_hitcount_fold(ent, &slab->counters[(shard * WOLFSENTRY_HITCOUNT_SHARD_SLOTS) + slot - 1U]);
+    WOLFSENTRY_ATOMIC_STORE(ent->hitcount_slot, 0);
+    --slot;
+    slab->slots_in_use[slot / 32U] &= ~((uint32_t)1 << (slot % 32U));
+    WOLFSENTRY_RETURN_VOID;
+}
+
+#endif /* WOLFSENTRY_SHARDED_HITCOUNTS */
+
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+
+#ifdef WOLFSENTRY_THREADSAFE
+
+/* magazine and depot critical sections are a few loads and stores, so they
+ * spin rather than sleep.
+ */
+static inline void wolfsentry_slab_spin_lock(volatile int *busy) {
+    for (;;) {
+        int expected = 0;
+        if (WOLFSENTRY_ATOMIC_TEST_AND_SET(*busy, expected, 1))
+            return;
+        while (WOLFSENTRY_ATOMIC_LOAD(*busy) != 0)
+            ;
+    }
+}
+
+static inline void wolfsentry_slab_spin_unlock(volatile int *busy) {
+    WOLFSENTRY_ATOMIC_STORE(*busy, 0);
+}
+
+/* a thread always uses the same magazine of a class, hashed as in
+ * wolfsentry_hitcount_shard().
+ */
+static inline struct wolfsentry_slab_magazine *wolfsentry_slab_magazine(struct wolfsentry_thread_context *thread, struct wolfsentry_slab_class *slab_class) {
+    uint64_t h = (uint64_t)(uintptr_t)WOLFSENTRY_THREAD_GET_ID * 0x9e3779b97f4a7c15ULL;
+    return &slab_class->magazines[(unsigned int)(h >> 32U) & (WOLFSENTRY_SLAB_MAGAZINES - 1U)];
+}
+
+#define WOLFSENTRY_SLAB_MAGAZINE(slab_class) wolfsentry_slab_magazine(thread, slab_class)
+
+#else /* !WOLFSENTRY_THREADSAFE */
+
+#define wolfsentry_slab_spin_lock(busy) (void)(busy)
+#define wolfsentry_slab_spin_unlock(busy) (void)(busy)
+#define WOLFSENTRY_SLAB_MAGAZINE(slab_class) (&(slab_class)->magazines[0])
+
+#endif /* WOLFSENTRY_THREADSAFE */
+
+/* free objects and pages are chained through their first word. */
+#define WOLFSENTRY_SLAB_NEXT(obj) (*(void **)(void *)(obj))
+
+static size_t wolfsentry_slab_page_bytes(const struct wolfsentry_slab_class *slab_class) {
+    /* the first WOLFSENTRY_SLAB_OBJECT_ALIGNMENT bytes of each page hold its
+     * link in slab_class->pages, and the first object starts at the next
+     * multiple of object_alignment.
+     */
+    if (slab_class->object_size > WOLFSENTRY_SLAB_PAGE_BYTES - slab_class->object_alignment)
+        return slab_class->object_size + slab_class->object_alignment;
+    else
+        return WOLFSENTRY_SLAB_PAGE_BYTES;
+}
+
+/* the smallest class that holds size bytes at the required alignment.  a
+ * class of the right size but lesser alignment is passed over, so that
+ * routes are never carved from an event or action class.
+ */
+static inline struct wolfsentry_slab_class *wolfsentry_slab_class_for(struct wolfsentry_slab *slab, size_t size, size_t alignment) {
+    unsigned int i;
+    if (slab == NULL)
+        return NULL;
+    for (i = 0; i < slab->n_classes; ++i) {
+        if ((size <= slab->classes[i].object_size) && (alignment <= slab->classes[i].object_alignment))
+            return &slab->classes[i];
+    }
+    return NULL;
 }
 
+/* tops magazine up to half full from the depot, carving a new page if the
+ * depot is empty.  called with the magazine held.  returns 0 if a page is
+ * needed and the allocator fails.
+ */
+static int wolfsentry_slab_refill(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_slab_class *slab_class, struct wolfsentry_slab_magazine *magazine) {
+    size_t page_bytes, offset;
+    byte *page;
+    void *chain = NULL, *chain_tail = NULL;
+
+    wolfsentry_slab_spin_lock(&slab_class->depot_busy);
+    while ((magazine->n_rounds < WOLFSENTRY_SLAB_MAGAZINE_ROUNDS / 2) && (slab_class->depot != NULL)) {
+        magazine->rounds[magazine->n_rounds++] = slab_class->depot;
+        slab_class->depot = WOLFSENTRY_SLAB_NEXT(slab_class->depot);
+    }
+    wolfsentry_slab_spin_unlock(&slab_class->depot_busy);
+    if (magazine->n_rounds > 0)
+        return 1;
+
+    page_bytes = wolfsentry_slab_page_bytes(slab_class);
+    if ((page = (byte *)WOLFSENTRY_MALLOC(page_bytes)) == NULL)
+        return 0;
+    offset = WOLFSENTRY_SLAB_OBJECT_ALIGNMENT + ((0U - ((uintptr_t)page + WOLFSENTRY_SLAB_OBJECT_ALIGNMENT)) & (slab_class->object_alignment - 1));
+    for (; offset + slab_class->object_size <= page_bytes; offset += slab_class->object_size) {
+        if (magazine->n_rounds < WOLFSENTRY_SLAB_MAGAZINE_ROUNDS / 2) {
+            magazine->rounds[magazine->n_rounds++] = page + offset;
+            continue;
+        }
+        if (chain_tail == NULL)
+            chain = page + offset;
+        else
+            WOLFSENTRY_SLAB_NEXT(chain_tail) = page + offset;
+        chain_tail = page + offset;
+    }
+
+    wolfsentry_slab_spin_lock(&slab_class->depot_busy);
+    WOLFSENTRY_SLAB_NEXT(page) = slab_class->pages;
+    slab_class->pages = page;
+    ++slab_class->n_pages;
+    if (chain_tail != NULL) {
+        WOLFSENTRY_SLAB_NEXT(chain_tail) = slab_class->depot;
+        slab_class->depot = chain;
+    }
+    wolfsentry_slab_spin_unlock(&slab_class->depot_busy);
+
+    return 1;
+}
+
+/* returns the older half of a full magazine to the depot.  called with the
+ * magazine held.
+ */
+static void wolfsentry_slab_flush(struct wolfsentry_slab_class *slab_class, struct wolfsentry_slab_magazine *magazine) {
+    void *chain = NULL;
+    unsigned int i;
+
+    for (i = 0; i < WOLFSENTRY_SLAB_MAGAZINE_ROUNDS / 2; ++i) {
+        WOLFSENTRY_SLAB_NEXT(magazine->rounds[i]) = chain;
+        chain = magazine->rounds[i];
+    }
+    /* rounds[0] is the tail of chain. */
+    wolfsentry_slab_spin_lock(&slab_class->depot_busy);
+    WOLFSENTRY_SLAB_NEXT(magazine->rounds[0]) = slab_class->depot;
+    slab_class->depot = chain;
+    wolfsentry_slab_spin_unlock(&slab_class->depot_busy);
+
+    memmove(magazine->rounds, magazine->rounds + (WOLFSENTRY_SLAB_MAGAZINE_ROUNDS / 2), (magazine->n_rounds - (WOLFSENTRY_SLAB_MAGAZINE_ROUNDS / 2)) * sizeof magazine->rounds[0]);
+    magazine->n_rounds -= WOLFSENTRY_SLAB_MAGAZINE_ROUNDS / 2;
+}
+
+WOLFSENTRY_LOCAL void *wolfsentry_slab_alloc(WOLFSENTRY_CONTEXT_ARGS_IN, size_t size, size_t alignment) {
+    struct wolfsentry_slab_class *slab_class = wolfsentry_slab_class_for(wolfsentry->slab, size, alignment);
+    struct wolfsentry_slab_magazine *magazine;
+    void *ret;
+
+    if (slab_class == NULL) {
+        if (wolfsentry->slab != NULL)
+            WOLFSENTRY_ATOMIC_INCREMENT_BY_ONE(wolfsentry->slab->heap_allocs);
+        return WOLFSENTRY_MALLOC(size);
+    }
+
+    magazine = WOLFSENTRY_SLAB_MAGAZINE(slab_class);
+    wolfsentry_slab_spin_lock(&magazine->busy);
+    if ((magazine->n_rounds == 0) && (! wolfsentry_slab_refill(WOLFSENTRY_CONTEXT_ARGS_OUT, slab_class, magazine))) {
+        wolfsentry_slab_spin_unlock(&magazine->busy);
+        return NULL;
+    }
+    ret = magazine->rounds[--magazine->n_rounds];
+    ++magazine->allocs;
+    wolfsentry_slab_spin_unlock(&magazine->busy);
+
+    return ret;
+}
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_slab_free(WOLFSENTRY_CONTEXT_ARGS_IN, void *ptr, size_t size, size_t alignment) {
+    struct wolfsentry_slab_class *slab_class = wolfsentry_slab_class_for(wolfsentry->slab, size, alignment);
+    struct wolfsentry_slab_magazine *magazine;
+
+    if (slab_class == NULL) {
+        if (wolfsentry->slab != NULL)
+            WOLFSENTRY_ATOMIC_INCREMENT_BY_ONE(wolfsentry->slab->heap_frees);
+        WOLFSENTRY_FREE(ptr);
+        WOLFSENTRY_RETURN_VOID;
+    }
+
+    magazine = WOLFSENTRY_SLAB_MAGAZINE(slab_class);
+    wolfsentry_slab_spin_lock(&magazine->busy);
+    if (magazine->n_rounds == WOLFSENTRY_SLAB_MAGAZINE_ROUNDS)
+        wolfsentry_slab_flush(slab_class, magazine);
+    magazine->rounds[magazine->n_rounds++] = ptr;
+    ++magazine->frees;
+    wolfsentry_slab_spin_unlock(&magazine->busy);
+
+    WOLFSENTRY_RETURN_VOID;
+}
+
+/* the classes are fitted to the objects this context will actually
+ * allocate: action list ents, IPv4 and IPv6 routes carrying the configured
+ * route private data, sized exactly as wolfsentry_route_new() sizes them, and
+ * events with short and maximal labels.  must be called before the context
+ * allocates any of them.
+ */
+WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_slab_init(WOLFSENTRY_CONTEXT_ARGS_IN) {
+    size_t sizes[5], alignments[5];
+    unsigned int n_sizes = 0, i, j;
+    struct wolfsentry_slab *slab;
+
+    sizes[n_sizes] = sizeof(struct wolfsentry_action_list_ent);
+    alignments[n_sizes++] = WOLFSENTRY_SLAB_OBJECT_ALIGNMENT;
+    if (wolfsentry->config.config.route_private_data_alignment == 0) {
+        /* routes start on a cache line, so that the header and the match key
+         * that follows it are exactly two lines, visited together by every
+         * lookup.
+         */
+        sizes[n_sizes] = WOLFSENTRY_ROUTE_ALLOC_SIZE(2 * WOLFSENTRY_BITS_TO_BYTES(32), wolfsentry->config.config.route_private_data_size);
+        alignments[n_sizes++] = WOLFSENTRY_SLAB_ROUTE_ALIGNMENT;
+        sizes[n_sizes] = WOLFSENTRY_ROUTE_ALLOC_SIZE(2 * WOLFSENTRY_BITS_TO_BYTES(128), wolfsentry->config.config.route_private_data_size);
+        alignments[n_sizes++] = WOLFSENTRY_SLAB_ROUTE_ALIGNMENT;
+    }
+    sizes[n_sizes] = sizeof(struct wolfsentry_event) + 16;
+    alignments[n_sizes++] = WOLFSENTRY_SLAB_OBJECT_ALIGNMENT;
+    sizes[n_sizes] = sizeof(struct wolfsentry_event) + WOLFSENTRY_MAX_LABEL_BYTES + 1;
+    alignments[n_sizes++] = WOLFSENTRY_SLAB_OBJECT_ALIGNMENT;
+
+    if ((slab = (struct wolfsentry_slab *)WOLFSENTRY_MALLOC(sizeof *slab)) == NULL)
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+    memset(slab, 0, sizeof *slab);
+
+    for (i = 0; i < n_sizes; ++i) {
+        size_t object_size = (sizes[i] + alignments[i] - 1) & ~(alignments[i] - 1);
+        for (j = 0; j < slab->n_classes; ++j) {
+            if (object_size <= slab->classes[j].object_size)
+                break;
+        }
+        if ((j < slab->n_classes) && (object_size == slab->classes[j].object_size)) {
+            if (alignments[i] > slab->classes[j].object_alignment)
+                slab->classes[j].object_alignment = alignments[i];
+            continue;
+        }
+        if (slab->n_classes == WOLFSENTRY_SLAB_MAX_CLASSES)
+            break;
+        memmove(&slab->classes[j + 1], &slab->classes[j], (slab->n_classes - j) * sizeof slab->classes[0]);
+        slab->classes[j].object_size = object_size;
+        slab->classes[j].object_alignment = alignments[i];
+        ++slab->n_classes;
+    }
+
+    wolfsentry->slab = slab;
+    WOLFSENTRY_RETURN_OK;
+}
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_slab_free_all(WOLFSENTRY_CONTEXT_ARGS_IN) {
+    unsigned int i;
+
+    if (wolfsentry->slab == NULL)
+        WOLFSENTRY_RETURN_VOID;
+    for (i = 0; i < wolfsentry->slab->n_classes; ++i) {
+        void *page = wolfsentry->slab->classes[i].pages;
+        while (page != NULL) {
+            void *next = WOLFSENTRY_SLAB_NEXT(page);
+            WOLFSENTRY_FREE(page);
+            page = next;
+        }
+    }
+    WOLFSENTRY_FREE(wolfsentry->slab);
+    wolfsentry->slab = NULL;
+    WOLFSENTRY_RETURN_VOID;
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_slab_get_stats(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_slab_stats *stats) {
+    struct wolfsentry_slab *slab = wolfsentry->slab;
+    unsigned int i, j;
+
+    WOLFSENTRY_CONTEXT_ARGS_NOT_USED;
+
+    if (stats == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    if (slab == NULL)
+        WOLFSENTRY_ERROR_RETURN(INCOMPATIBLE_STATE);
+
+    memset(stats, 0, sizeof *stats);
+    stats->n_classes = slab->n_classes;
+    for (i = 0; i < slab->n_classes; ++i) {
+        struct wolfsentry_slab_class *slab_class = &slab->classes[i];
+        stats->classes[i].object_size = slab_class->object_size;
+        stats->classes[i].object_alignment = slab_class->object_alignment;
+        wolfsentry_slab_spin_lock(&slab_class->depot_busy);
+        stats->classes[i].pages = slab_class->n_pages;
+        wolfsentry_slab_spin_unlock(&slab_class->depot_busy);
+        stats->page_bytes += stats->classes[i].pages * wolfsentry_slab_page_bytes(slab_class);
+        for (j = 0; j < WOLFSENTRY_SLAB_MAGAZINES; ++j) {
+            wolfsentry_slab_spin_lock(&slab_class->magazines[j].busy);
+            stats->classes[i].allocs += slab_class->magazines[j].allocs;
+            stats->classes[i].frees += slab_class->magazines[j].frees;
+            wolfsentry_slab_spin_unlock(&slab_class->magazines[j].busy);
+        }
+    }
+    stats->heap_allocs = WOLFSENTRY_ATOMIC_LOAD(slab->heap_allocs);
+    stats->heap_frees = WOLFSENTRY_ATOMIC_LOAD(slab->heap_frees);
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* WOLFSENTRY_SLAB_ALLOCATOR */
+
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_delete_1(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_ent_header *ent) {
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN();
 
     if (ent->parent_table == NULL)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
 
-    if (ent->prev)
-        ent->prev->next = ent->next;
-    else
-        ent->parent_table->head = ent->next;
-    if (ent->next)
-        ent->next->prev = ent->prev;
-    else
-        ent->parent_table->tail = ent->prev;
-    ent->prev = ent->next = NULL;
+    if (ent->parent_table->ent_type == WOLFSENTRY_OBJECT_TYPE_EVENT)
+        wolfsentry_event_label_index_delete((struct wolfsentry_event_table *)ent->parent_table, (struct wolfsentry_event *)ent);
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+    wolfsentry_table_ent_hitcount_release(ent);
+#endif
+    wolfsentry_table_rb_unlink(ent->parent_table, ent);
     --ent->parent_table->n_ents;
     ++ent->parent_table->n_deletes;
     ent->parent_table = NULL;
@@ -486,6 +1240,7 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_delete_1(WOLFSENTRY_C
 
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_delete(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_ent_header **ent) {
     struct wolfsentry_table_ent_header *i;
+    int c = -1;
 
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN();
 
@@ -494,20 +1249,11 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_delete(WOLFSENTRY_CON
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
     }
 
-    i = (*ent)->parent_table->head;
-    (void)wolfsentry;
-    while (i) {
-        int c = (*ent)->parent_table->cmp_fn(i, *ent);
-        if (c >= 0) {
-            if (c == 0) {
-                *ent = i;
-                WOLFSENTRY_ERROR_RERETURN(wolfsentry_table_ent_delete_1(WOLFSENTRY_CONTEXT_ARGS_OUT, i));
-            }
-            WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
-        }
-        i = i->next;
-    }
-    WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
+    i = wolfsentry_table_rb_lower_bound((*ent)->parent_table, *ent, &c);
+    if ((i == NULL) || (c != 0))
+        WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
+    *ent = i;
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_table_ent_delete_1(WOLFSENTRY_CONTEXT_ARGS_OUT, i));
 }
 
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_drop_reference(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_ent_header *ent, wolfsentry_action_res_t *action_results) {
@@ -537,6 +1283,8 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_free_ents(WOLFSENTRY_CONT
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN();
 
     WOLFSENTRY_TABLE_HEADER_RESET(*table);
+    if (table->ent_type == WOLFSENTRY_OBJECT_TYPE_EVENT)
+        wolfsentry_event_label_index_reset((struct wolfsentry_event_table *)table);
     /* coupled objects are freed as a pair, e.g. ents in
      * wolfsentry_addr_family_byname_table are freed when the corresponding
      * wolfsentry_addr_family_bynumber_table ents are freed.
@@ -547,6 +1295,9 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_free_ents(WOLFSENTRY_CONT
         next = i->next;
         ret = wolfsentry_table_ent_delete_by_id_1(WOLFSENTRY_CONTEXT_ARGS_OUT, i);
         WOLFSENTRY_RERETURN_IF_ERROR(ret);
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+        wolfsentry_table_ent_hitcount_release(i);
+#endif
         table->free_fn(WOLFSENTRY_CONTEXT_ARGS_OUT, i, NULL /* action_results */);
         i = next;
     }
@@ -567,15 +1318,12 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_cursor_init(WOLFSENTRY_CO
  * immediately after where the search ent would be.
  */
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_cursor_seek(const struct wolfsentry_table_header *table, const struct wolfsentry_table_ent_header *ent, struct wolfsentry_cursor *cursor, int *cursor_position) {
-    struct wolfsentry_table_ent_header *i = table->head;
-    while (i) {
-        int c = table->cmp_fn(i, ent);
-        if (c >= 0) {
-            cursor->point = i;
-            *cursor_position = c;
-            WOLFSENTRY_RETURN_OK;
-        }
-        i = i->next;
+    int c = -1;
+    struct wolfsentry_table_ent_header *i = wolfsentry_table_rb_lower_bound(table, ent, &c);
+    if (i) {
+        cursor->point = i;
+        *cursor_position = c;
+        WOLFSENTRY_RETURN_OK;
     }
     cursor->point = table->tail;
     *cursor_position = -1;
@@ -590,7 +1338,9 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_filter(
     wolfsentry_dropper_function_t dropper,
     void *dropper_context)
 {
-    /* with linked lists, this is easy, but it will be a lot trickier with red-black trees. */
+    /* the in-order thread is stable across deletion of other ents, so i_next
+     * remains valid after i is unlinked from the tree.
+     */
     wolfsentry_errcode_t ret = WOLFSENTRY_ERROR_ENCODE(OK);
     struct wolfsentry_table_ent_header *i, *i_next;
 
@@ -619,7 +1369,6 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_map(
     void *map_context,
     wolfsentry_action_res_t *action_results)
 {
-    /* with linked lists, this is easy, but it will be a lot trickier with red-black trees. */
     wolfsentry_errcode_t ret = WOLFSENTRY_ERROR_ENCODE(OK);
     struct wolfsentry_table_ent_header *i, *i_next;
 
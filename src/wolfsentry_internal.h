@@ -34,6 +34,17 @@ typedef uint32_t wolfsentry_refcount_t;
 
 #include "wolfsentry_ll.h"
 
+/* sharded hit counters only pay off when hits are counted concurrently, and
+ * rely on the GNU atomic builtins.
+ */
+#if defined(WOLFSENTRY_SHARDED_HITCOUNTS) && !(defined(WOLFSENTRY_THREADSAFE) && defined(WOLFSENTRY_HAVE_GNU_ATOMICS))
+    #undef WOLFSENTRY_SHARDED_HITCOUNTS
+#endif
+
+#ifndef WOLFSENTRY_CACHE_LINE_SIZE
+    #define WOLFSENTRY_CACHE_LINE_SIZE 64
+#endif
+
 #ifdef WOLFSENTRY_THREADSAFE
 
 #define WOLFSENTRY_THREAD_ID_SENT ~0UL /* lock handoff not yet implemented. */
@@ -46,6 +57,39 @@ enum wolfsentry_rwlock_state {
     WOLFSENTRY_LOCK_MAX = 0x7fffffff /* force enum to be 32 bits, for intrinsic atomicity. */
 };
 
+#ifdef WOLFSENTRY_HAVE_GNU_ATOMICS
+    #define WOLFSENTRY_LOCK_EPOCH_READERS
+#endif
+
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+
+#ifndef WOLFSENTRY_LOCK_EPOCH_READER_SLOTS
+    #define WOLFSENTRY_LOCK_EPOCH_READER_SLOTS 64 /* must be a power of 2. */
+#endif
+#ifndef WOLFSENTRY_LOCK_EPOCH_READER_PROBES
+    #define WOLFSENTRY_LOCK_EPOCH_READER_PROBES 4
+#endif
+#ifndef WOLFSENTRY_LOCK_EPOCH_BIAS_INHIBIT_COUNT
+    #define WOLFSENTRY_LOCK_EPOCH_BIAS_INHIBIT_COUNT 256 /* shared acquisitions that bypass the slots after a writer waited on readers. */
+#endif
+/* one slot per concurrent epoch reader, each on its own cache line, so that
+ * readers never write a line shared with another reader.
+ */
+struct wolfsentry_lock_epoch_reader {
+    union {
+        volatile wolfsentry_thread_id_t holder;
+        byte pad[WOLFSENTRY_CACHE_LINE_SIZE];
+    } u;
+};
+
+#endif /* WOLFSENTRY_LOCK_EPOCH_READERS */
+
+#if defined(WOLFSENTRY_HAVE_GNU_ATOMICS) && !defined(WOLFSENTRY_NO_LOCK_SHARED_FASTPATH)
+    #define WOLFSENTRY_LOCK_SHARED_FASTPATH
+    /* high bit of shared_fastpath -- set while the semaphore-based state machine owns the lock. */
+    #define WOLFSENTRY_LOCK_FASTPATH_CLOSED 0x80000000U
+#endif
+
 struct wolfsentry_rwlock {
     const struct wolfsentry_host_platform_interface *hpi;
     sem_t sem;
@@ -64,6 +108,19 @@ struct wolfsentry_rwlock {
     volatile enum wolfsentry_rwlock_state state;
     volatile int promoted_at_count;
     wolfsentry_lock_flags_t flags;
+#ifdef WOLFSENTRY_LOCK_SHARED_FASTPATH
+    volatile uint32_t shared_fastpath; /* count of shared holders that bypassed sem, or _FASTPATH_CLOSED. */
+#endif
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    struct wolfsentry_lock_epoch_reader *epoch_readers; /* cache-line-aligned slots, non-null iff WOLFSENTRY_LOCK_FLAG_EPOCH_READERS or _SCALABLE_READERS. */
+    void *epoch_readers_alloc; /* raw allocation backing epoch_readers. */
+    volatile int epoch_writer_active; /* nonzero while a mutex holder is (or is about to be) mutating. */
+    volatile int epoch_bias_inhibit; /* while positive, shared lockers skip the slots, decrementing it. */
+#endif
+#ifdef WOLFSENTRY_LOCK_STATS
+    struct wolfsentry_lock_stats stats;
+    wolfsentry_time_t mutex_acquired_at; /* written by the new mutex holder, read when it leaves _EXCLUSIVE. */
+#endif
 };
 
 struct wolfsentry_thread_context {
@@ -82,6 +139,7 @@ struct wolfsentry_thread_context {
     int recursion_of_tracked_lock; /* recursion count for outermost_shared_lock/current_shared_lock -- 1 if locked only once. */
     int shared_count; /* total count of shared locks held */
     int mutex_and_reservation_count;
+    int epoch_slot; /* 1 + index of the epoch reader slot held on tracked_shared_lock, or 0 if none. */
 };
 
 #define WOLFSENTRY_THREAD_GET_ID (thread ? thread->id : WOLFSENTRY_THREAD_GET_ID_HANDLER())
@@ -171,6 +229,84 @@ static_assert(__alignof__(struct wolfsentry_thread_context_public) >= __alignof_
 
 struct wolfsentry_table_header;
 
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+
+#ifndef WOLFSENTRY_HITCOUNT_SHARDS
+    #define WOLFSENTRY_HITCOUNT_SHARDS 16 /* must be a power of 2. */
+#endif
+#ifndef WOLFSENTRY_HITCOUNT_SHARD_SLOTS
+    #define WOLFSENTRY_HITCOUNT_SHARD_SLOTS 256 /* must be a multiple of 32, and less than 65536. */
+#endif
+#ifndef WOLFSENTRY_HITCOUNT_SHARD_PROMOTE_AT
+    #define WOLFSENTRY_HITCOUNT_SHARD_PROMOTE_AT 64 /* direct hits before an ent is given a slot. */
+#endif
+#ifndef WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT
+    #define WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT 4096 /* pending hits in one shard that trigger a fold into the ent header. */
+#endif
+
+/* per-table hit counter slab.  the hottest ents of the table are each given a
+ * slot, and hits on them are counted in the row for the calling thread's
+ * shard, so that threads counting hits on the same ent mostly write separate
+ * cache lines.  the ent header hitcount is the base, and the slot counters
+ * hold hits not yet folded into it.
+ */
+struct wolfsentry_hitcount_slab {
+    volatile uint32_t slots_in_use[WOLFSENTRY_HITCOUNT_SHARD_SLOTS / 32];
+    wolfsentry_hitcount_t *counters; /* _SHARDS rows of _SHARD_SLOTS counters, each row cache-line-aligned. */
+    void *counters_alloc; /* raw allocation backing counters. */
+};
+
+#endif /* WOLFSENTRY_SHARDED_HITCOUNTS */
+
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+
+#ifndef WOLFSENTRY_SLAB_PAGE_BYTES
+    #define WOLFSENTRY_SLAB_PAGE_BYTES 16384
+#endif
+#ifndef WOLFSENTRY_SLAB_MAGAZINE_ROUNDS
+    #define WOLFSENTRY_SLAB_MAGAZINE_ROUNDS 32 /* must be even. */
+#endif
+#ifndef WOLFSENTRY_SLAB_MAGAZINES
+    #ifdef WOLFSENTRY_THREADSAFE
+        #define WOLFSENTRY_SLAB_MAGAZINES 16 /* must be a power of 2. */
+    #else
+        #define WOLFSENTRY_SLAB_MAGAZINES 1
+    #endif
+#endif
+#define WOLFSENTRY_SLAB_OBJECT_ALIGNMENT 16
+#define WOLFSENTRY_SLAB_ROUTE_ALIGNMENT WOLFSENTRY_CACHE_LINE_SIZE
+
+/* a small stack of free objects, private to the threads that hash to it, so
+ * that most allocations and frees touch neither the depot nor another
+ * thread's cache lines.
+ */
+struct wolfsentry_slab_magazine {
+    volatile int busy;
+    unsigned int n_rounds;
+    wolfsentry_hitcount_t allocs;
+    wolfsentry_hitcount_t frees;
+    void *rounds[WOLFSENTRY_SLAB_MAGAZINE_ROUNDS];
+};
+
+struct wolfsentry_slab_class {
+    struct wolfsentry_slab_magazine magazines[WOLFSENTRY_SLAB_MAGAZINES];
+    size_t object_size;
+    size_t object_alignment; /* WOLFSENTRY_SLAB_OBJECT_ALIGNMENT, or WOLFSENTRY_SLAB_ROUTE_ALIGNMENT for routes. */
+    volatile int depot_busy;
+    void *depot; /* free objects beyond the magazines, chained through their first word. */
+    void *pages; /* every page carved for the class, chained through their first word. */
+    size_t n_pages;
+};
+
+struct wolfsentry_slab {
+    struct wolfsentry_slab_class classes[WOLFSENTRY_SLAB_MAX_CLASSES];
+    unsigned int n_classes; /* classes are in ascending order of object_size. */
+    wolfsentry_hitcount_t heap_allocs;
+    wolfsentry_hitcount_t heap_frees;
+};
+
+#endif /* WOLFSENTRY_SLAB_ALLOCATOR */
+
 #ifdef __arm__
 /* must be uint64-aligned to allow warning-free casts on ARM32. */
 struct attr_align_to(8) wolfsentry_table_ent_header
@@ -179,16 +315,31 @@ struct wolfsentry_table_ent_header
 #endif
 {
     struct wolfsentry_table_header *parent_table;
-    struct wolfsentry_table_ent_header *prev, *next; /* these will be replaced by red-black table elements later. */
-    struct wolfsentry_table_ent_header *prev_by_id, *next_by_id; /* these will be replaced by red-black table elements later. */
+    struct wolfsentry_table_ent_header *rb_parent, *rb_left, *rb_right; /* red-black tree linkage, ordered by parent_table->cmp_fn. */
+    struct wolfsentry_table_ent_header *prev, *next; /* in-order threading of the tree, for O(1) cursor traversal. */
+    struct wolfsentry_table_ent_header *prev_by_id, *next_by_id; /* chain within a wolfsentry_ent_id_index bucket. */
     wolfsentry_hitcount_t hitcount;
     wolfsentry_ent_id_t id;
-    uint32_t padding1;
+    byte rb_red;
+    byte ent_flags; /* WOLFSENTRY_TABLE_ENT_FLAG_* */
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+    uint16_t hitcount_slot; /* 1 + index of the ent's column in parent_table->hitcount_slab, or 0 if hits go straight to hitcount. */
+#else
+    byte padding1[2];
+#endif
     wolfsentry_refcount_t refcount;
 };
 
+/* the ent lives in caller-supplied storage (e.g. a dispatch target route on
+ * the stack), so nothing may take a reference to it.
+ */
+#define WOLFSENTRY_TABLE_ENT_FLAG_TRANSIENT 1U
+
 #define WOLFSENTRY_TABLE_ENT_HEADER_RESET(ent) do {                           \
         (ent).parent_table = NULL;                                            \
+        (ent).rb_parent = (ent).rb_left = (ent).rb_right = NULL;              \
+        (ent).rb_red = 0;                                                     \
+        (ent).ent_flags = 0;                                                  \
         (ent).prev = (ent).next = (ent).prev_by_id = (ent).next_by_id = NULL; \
         (ent).refcount = 1; }                                                 \
     while (0)
@@ -234,22 +385,42 @@ typedef wolfsentry_errcode_t (*wolfsentry_table_ent_clone_map_fn_t)(
     wolfsentry_clone_flags_t flags);
 
 struct wolfsentry_table_header {
-    struct wolfsentry_table_ent_header *head, *tail; /* these will be replaced by red-black table elements later. */
+    struct wolfsentry_table_ent_header *root; /* red-black tree, for O(log n) insert, seek, and delete. */
+    struct wolfsentry_table_ent_header *head, *tail; /* ends of the in-order thread through the tree. */
     wolfsentry_ent_cmp_fn_t cmp_fn;
     wolfsentry_ent_free_fn_t free_fn;
     wolfsentry_hitcount_t n_ents;
     wolfsentry_hitcount_t n_inserts;
     wolfsentry_hitcount_t n_deletes;
     wolfsentry_object_type_t ent_type;
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+    struct wolfsentry_hitcount_slab *hitcount_slab; /* non-null only for tables whose ents count hits. */
+#endif
 };
 
 #define WOLFSENTRY_TABLE_HEADER_RESET(table) do { \
+        (table).root = NULL;                      \
         (table).head = (table).tail = NULL;       \
         (table).n_ents = 0;                       \
         (table).n_inserts = 0;                    \
         (table).n_deletes = 0;                    \
     } while (0)
 
+/* hash index of every object in a context by ID, for O(1) get, insert, and
+ * delete.  see wolfsentry_ent_id_hash().
+ */
+struct wolfsentry_ent_id_index {
+    struct wolfsentry_table_ent_header **buckets;
+    uint32_t n_buckets; /* 0 until the first insert, then always a power of 2. */
+    wolfsentry_hitcount_t n_ents;
+    wolfsentry_hitcount_t n_inserts;
+    wolfsentry_hitcount_t n_deletes;
+};
+
+#ifndef WOLFSENTRY_ENT_ID_INDEX_INITIAL_BUCKETS
+#define WOLFSENTRY_ENT_ID_INDEX_INITIAL_BUCKETS 32
+#endif
+
 struct wolfsentry_cursor {
     struct wolfsentry_table_ent_header *point;
 };
@@ -304,29 +475,93 @@ struct wolfsentry_event {
 
     wolfsentry_priority_t priority;
 
+    struct wolfsentry_event *label_index_next; /* chain within the table's label_buckets. */
+    uint32_t label_hash;
+
     byte label_len;
     char label[WOLFSENTRY_FLEXIBLE_ARRAY_SIZE];
 };
 
+#ifndef WOLFSENTRY_EVENT_LABEL_INDEX_INITIAL_BUCKETS
+#define WOLFSENTRY_EVENT_LABEL_INDEX_INITIAL_BUCKETS 16
+#endif
+
 struct wolfsentry_event_table {
     struct wolfsentry_table_header header;
+    /* hash index by label, so that dispatch needn't string-compare its way
+     * down the tree.  null until the first insert, or if allocation failed,
+     * in which case lookups fall back to the tree.
+     */
+    struct wolfsentry_event **label_buckets;
+    uint32_t n_label_buckets; /* always a power of 2 when label_buckets is non-null. */
 };
 
+#ifndef WOLFSENTRY_ROUTE_ADDR_HEAD_BYTES
+#define WOLFSENTRY_ROUTE_ADDR_HEAD_BYTES 4
+#endif
+
+#ifdef WOLFSENTRY_ROUTE_SORT_KEYS
+/* the sort key is the family, each address zero-padded to the family's width
+ * and followed by its length, the proto, the ports, the interfaces, and the
+ * immutable flags, in wolfsentry_route_key_cmp_1() order, all big endian.
+ */
+#define WOLFSENTRY_ROUTE_SORT_KEY_ADDR_BYTES 16 /* IPv6 */
+#define WOLFSENTRY_ROUTE_SORT_KEY_MAX_BYTES ( \
+        sizeof(wolfsentry_addr_family_t) + \
+        (2 * (WOLFSENTRY_ROUTE_SORT_KEY_ADDR_BYTES + sizeof(wolfsentry_addr_bits_t))) + \
+        sizeof(wolfsentry_proto_t) + \
+        (2 * sizeof(wolfsentry_port_t)) + \
+        2 + \
+        sizeof(uint32_t))
+#endif
+
+/* the fields are grouped by temperature.  the match key -- everything read
+ * while comparing a route against a target, including the leading bytes of
+ * each address -- directly follows the header, so that on LP64 it occupies
+ * bytes 80-127, the second cache line of a line-aligned route, next to the
+ * header's hitcount and refcount.  bookkeeping that only insert, delete,
+ * purge and export touch, and the metadata updated after a match is decided,
+ * follow it.  with WOLFSENTRY_IPV4_FAST_ROUTES, the packed IPv4 key comes
+ * first, and the fields that IPv4 host route comparisons still read stay on
+ * that line.  with WOLFSENTRY_ROUTE_SORT_KEYS, the sort key ends the match
+ * key, so that ordering two routes in the table reads only the header and the
+ * line it starts on.
+ */
 struct wolfsentry_route {
     struct wolfsentry_table_ent_header header;
 
-    struct wolfsentry_list_ent_header purge_links;
-#define WOLFSENTRY_ROUTE_PURGE_HEADER_TO_TABLE_ENT_HEADER(purge_link) container_of(purge_link, struct wolfsentry_route, purge_links)
-
+    /* match key */
+#ifdef WOLFSENTRY_IPV4_FAST_ROUTES
+    uint64_t ipv4_key[2]; /* IPv4 host routes only -- addrs, ports, proto and interfaces, packed by wolfsentry_route_update_key_copies(). */
+#endif
+    struct wolfsentry_route *index_next; /* chain within tuple->buckets or trie_node->routes. */
     struct wolfsentry_event *parent_event; /* applicable config is parent_event->config or if null, wolfsentry->config */
-
     wolfsentry_route_flags_t flags;
-
+    uint32_t tuple_hash;
     wolfsentry_addr_family_t sa_family;
     wolfsentry_proto_t sa_proto;
+#ifdef WOLFSENTRY_IPV4_FAST_ROUTES
+    byte ipv4_key_p;
+#endif
     struct wolfsentry_route_endpoint remote, local;
+    byte remote_addr_head[WOLFSENTRY_ROUTE_ADDR_HEAD_BYTES]; /* leading bytes of the remote addr, zero-padded. */
+    byte local_addr_head[WOLFSENTRY_ROUTE_ADDR_HEAD_BYTES]; /* leading bytes of the local addr, zero-padded. */
     uint16_t data_addr_offset; /* 0 if there's no private_data */
+#ifdef WOLFSENTRY_ROUTE_SORT_KEYS
+    byte sort_key_len; /* 0 if the route has no sort key. */
+    byte sort_key[WOLFSENTRY_ROUTE_SORT_KEY_MAX_BYTES]; /* from wolfsentry_route_update_key_copies(). */
+#endif
+
+    /* cold bookkeeping */
     uint16_t data_addr_size;
+    uint16_t purge_wheel_slot; /* level * WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS + slot, valid while purge_after is nonzero. */
+    byte allocated_aligned; /* from WOLFSENTRY_MEMALIGN() -- parent_event can change after allocation, so its config can't be trusted to say. */
+
+    struct wolfsentry_list_ent_header purge_links;
+#define WOLFSENTRY_ROUTE_PURGE_HEADER_TO_TABLE_ENT_HEADER(purge_link) container_of(purge_link, struct wolfsentry_route, purge_links)
+
+    struct wolfsentry_route_tuple *tuple; /* tuple-space class this route is indexed in, or null. */
+    struct wolfsentry_route_trie_node *trie_node; /* prefix trie node this route is indexed in, or null. */
 
     struct {
         wolfsentry_time_t insert_time;
@@ -358,14 +593,265 @@ struct wolfsentry_route {
 #define WOLFSENTRY_ROUTE_LOCAL_PORT_COUNT(r) (1U + (r)->local.extra_port_count)
 #define WOLFSENTRY_ROUTE_REMOTE_EXTRA_PORTS(r) ((wolfsentry_port_t *)(r)->data + (((r)->data_addr_offset + (unsigned)WOLFSENTRY_ROUTE_REMOTE_ADDR_BYTES(r) + (unsigned)WOLFSENTRY_ROUTE_LOCAL_ADDR_BYTES(r) + 1U) / sizeof (r)->data[0]))
 #define WOLFSENTRY_ROUTE_LOCAL_EXTRA_PORTS(r) (WOLFSENTRY_ROUTE_REMOTE_EXTRA_PORTS(r) + (r)->remote.extra_port_count)
+/* the allocation size of a route with addr_bytes of addresses and
+ * private_data_size bytes of private data, rounded up to a whole data[] word.
+ * the slab classes for routes are sized with it too.
+ */
+#define WOLFSENTRY_ROUTE_ALLOC_SIZE(addr_bytes, private_data_size) \
+    ((offsetof(struct wolfsentry_route, data) + (size_t)(addr_bytes) + (size_t)(private_data_size) + 1U) & ~(size_t)1U)
 #define WOLFSENTRY_ROUTE_BUF_SIZE(r) (WOLFSENTRY_ROUTE_REMOTE_ADDR_BYTES(r) + WOLFSENTRY_ROUTE_LOCAL_ADDR_BYTES(r) + ((WOLFSENTRY_ROUTE_REMOTE_ADDR_BYTES(r) + WOLFSENTRY_ROUTE_LOCAL_ADDR_BYTES(r)) & 1) + (WOLFSENTRY_ROUTE_REMOTE_PORT_COUNT(r) * sizeof(wolfsentry_port_t)) + (WOLFSENTRY_ROUTE_LOCAL_PORT_COUNT(r) * sizeof(wolfsentry_port_t)))
 
+/* address prefix comparison.  wolfsentry_addr_common_prefix() returns how
+ * many leading bits, up to n_bits, two big endian addresses share, reading
+ * only the WOLFSENTRY_BITS_TO_BYTES(n_bits) bytes of each.  with the GNU
+ * builtins it compares 64 and 32 bit big endian words, and finds the first
+ * differing bit with count-leading-zeros, so that an IPv6 address takes two
+ * xors and an IPv4 address one.  wolfsentry_addr_common_prefix_scalar() is
+ * the byte and bit loop it replaces, kept for targets without the builtins
+ * and for cross-checking.
+ */
+
+#if defined(__GNUC__) && !defined(WOLFSENTRY_NO_BUILTIN_CLZ) && defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && defined(__ORDER_BIG_ENDIAN__)
+    #define WOLFSENTRY_ADDR_CMP_WORDS
+#endif
+
+static inline unsigned int wolfsentry_addr_common_prefix_scalar(const byte *a, const byte *b, unsigned int n_bits) {
+    unsigned int i;
+
+    for (i = 0; i + 8U <= n_bits; i += 8U) {
+        if (a[i >> 3U] != b[i >> 3U])
+            break;
+    }
+    for (; i < n_bits; ++i) {
+        if ((a[i >> 3U] ^ b[i >> 3U]) & (0x80U >> (i & 7U)))
+            break;
+    }
+    return i;
+}
+
+#ifdef WOLFSENTRY_ADDR_CMP_WORDS
+
+static inline uint64_t wolfsentry_load_be64(const byte *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof w);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+static inline uint32_t wolfsentry_load_be32(const byte *p) {
+    uint32_t w;
+    memcpy(&w, p, sizeof w);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    w = __builtin_bswap32(w);
+#endif
+    return w;
+}
+
+static inline unsigned int wolfsentry_addr_common_prefix(const byte *a, const byte *b, unsigned int n_bits) {
+    unsigned int i;
+
+    for (i = 0; i + 64U <= n_bits; i += 64U) {
+        uint64_t differ = wolfsentry_load_be64(a + (i >> 3U)) ^ wolfsentry_load_be64(b + (i >> 3U));
+        if (differ)
+            return i + (unsigned int)__builtin_clzll(differ);
+    }
+    if (i + 32U <= n_bits) {
+        uint32_t differ = wolfsentry_load_be32(a + (i >> 3U)) ^ wolfsentry_load_be32(b + (i >> 3U));
+        if (differ)
+            return i + (unsigned int)__builtin_clzl((unsigned long)differ) - (unsigned int)((sizeof(unsigned long) * 8U) - 32U);
+        i += 32U;
+    }
+    for (; i < n_bits; i += 8U) {
+        unsigned int differ = (unsigned int)(a[i >> 3U] ^ b[i >> 3U]);
+        if (differ) {
+            i += (unsigned int)__builtin_clz(differ) - (unsigned int)((sizeof(unsigned int) * 8U) - 8U);
+            break;
+        }
+    }
+    return (i < n_bits) ? i : n_bits;
+}
+
+#else /* !WOLFSENTRY_ADDR_CMP_WORDS */
+
+#define wolfsentry_addr_common_prefix(a, b, n_bits) wolfsentry_addr_common_prefix_scalar(a, b, n_bits)
+
+#endif /* WOLFSENTRY_ADDR_CMP_WORDS */
+
 #define WOLFSENTRY_ROUTE_REMOTE_PORT_GET(r, i) ((i) ? WOLFSENTRY_ROUTE_REMOTE_EXTRA_PORTS(r)[(i)-1] : (r)->remote.sa_port)
 #define WOLFSENTRY_ROUTE_LOCAL_PORT_GET(r, i) ((i) ? WOLFSENTRY_ROUTE_LOCAL_EXTRA_PORTS(r)[(i)-1] : (r)->local.sa_port)
 
+/* routes sharing the same wildcard flags and address prefix lengths form a
+ * tuple, within which the non-wildcard fields are hashed, so that a lookup
+ * costs one hash probe per tuple rather than a scan of the whole table.
+ */
+struct wolfsentry_route_tuple {
+    struct wolfsentry_list_ent_header header;
+    wolfsentry_route_flags_t wildcard_flags; /* masked with WOLFSENTRY_ROUTE_WILDCARD_FLAGS */
+    wolfsentry_route_flags_t hashed_fields; /* wildcard flag bits of fields that contribute to tuple_hash */
+    wolfsentry_addr_bits_t remote_addr_len, local_addr_len;
+    wolfsentry_hitcount_t n_routes;
+    uint32_t n_buckets; /* always a power of 2 */
+    struct wolfsentry_route **buckets;
+};
+
+#ifndef WOLFSENTRY_ROUTE_TUPLE_INITIAL_BUCKETS
+#define WOLFSENTRY_ROUTE_TUPLE_INITIAL_BUCKETS 8
+#endif
+
+/* routes with a literal address are instead indexed by prefix, in a
+ * path-compressed binary trie per address family -- keyed on the remote
+ * address, or on the local address for routes that wildcard the remote
+ * address.
+ */
+struct wolfsentry_route_trie_node {
+    struct wolfsentry_route_trie_node *parent, *child[2];
+    struct wolfsentry_route *routes; /* routes with exactly this prefix, chained through index_next. */
+    wolfsentry_addr_bits_t prefix_len;
+    byte prefix[WOLFSENTRY_FLEXIBLE_ARRAY_SIZE];
+};
+
+struct wolfsentry_route_trie {
+    struct wolfsentry_list_ent_header header;
+    wolfsentry_addr_family_t sa_family;
+    struct wolfsentry_route_trie_node *remote_root, *local_root;
+};
+
+/* normalized lookup key for the flow cache.  built in a zeroed buffer and
+ * compared with memcmp(), so padding must stay deterministic.
+ */
+struct wolfsentry_route_flow_cache_key {
+    uint32_t flags; /* target flags, masked to those that affect lookup. */
+    uint32_t action_results; /* filter bits presented to the lookup. */
+    wolfsentry_addr_family_t sa_family;
+    wolfsentry_proto_t sa_proto;
+    wolfsentry_port_t remote_port, local_port;
+    wolfsentry_addr_bits_t remote_addr_len, local_addr_len;
+    byte remote_interface, local_interface;
+    byte addrs[WOLFSENTRY_MAX_ADDR_BYTES * 2]; /* remote addr, then local addr. */
+};
+
+struct wolfsentry_route_flow_cache_ent {
+#ifdef WOLFSENTRY_THREADSAFE
+    uint32_t seq; /* odd while a writer is updating the slot. */
+#endif
+    uint32_t generation; /* route_table->generation at fill time, 0 if empty. */
+    union {
+        struct wolfsentry_route_flow_cache_key key;
+        /* for word-at-a-time atomic access.  the key's uint32_t members make
+         * its size a multiple of 4.
+         */
+        uint32_t key_words[sizeof(struct wolfsentry_route_flow_cache_key) / sizeof(uint32_t)];
+    } u;
+    struct wolfsentry_route *route; /* null for a cached miss. */
+    wolfsentry_route_flags_t inexact_matches;
+};
+
+struct wolfsentry_route_flow_cache {
+    uint32_t n_slots; /* always a power of 2. */
+    uint32_t hash_key[2];
+    struct wolfsentry_route_flow_cache_ent slots[WOLFSENTRY_FLEXIBLE_ARRAY_SIZE];
+};
+
+#ifndef WOLFSENTRY_ROUTE_FLOW_CACHE_MAX_SLOTS
+#define WOLFSENTRY_ROUTE_FLOW_CACHE_MAX_SLOTS (1U << 20U)
+#endif
+
+struct wolfsentry_route_negative_filter {
+    uint32_t n_blocks; /* always a power of 2. */
+    uint32_t n_keys; /* keys added since the last rebuild. */
+    uint32_t n_stale; /* deletions since the last rebuild. */
+    uint64_t blocks[WOLFSENTRY_FLEXIBLE_ARRAY_SIZE];
+};
+
+#ifndef WOLFSENTRY_ROUTE_NEGATIVE_FILTER_MIN_BLOCKS
+#define WOLFSENTRY_ROUTE_NEGATIVE_FILTER_MIN_BLOCKS 8
+#endif
+
+#ifndef WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEYS_PER_BLOCK
+#define WOLFSENTRY_ROUTE_NEGATIVE_FILTER_KEYS_PER_BLOCK 6 /* about 10 bits per key, ~1% false positives. */
+#endif
+
+#ifdef WOLFSENTRY_THREADSAFE
+
+#ifndef WOLFSENTRY_ROUTE_WRITE_BEHIND_LOG_ENTS
+#define WOLFSENTRY_ROUTE_WRITE_BEHIND_LOG_ENTS 15
+#endif
+#ifndef WOLFSENTRY_ROUTE_WRITE_BEHIND_PROBES
+#define WOLFSENTRY_ROUTE_WRITE_BEHIND_PROBES 2
+#endif
+#ifndef WOLFSENTRY_ROUTE_WRITE_BEHIND_MAX_LOGS
+#define WOLFSENTRY_ROUTE_WRITE_BEHIND_MAX_LOGS 1024
+#endif
+
+/* a deferred metadata update -- hits on a route, and the time of the latest. */
+struct wolfsentry_route_write_behind_ent {
+    wolfsentry_time_t last_hit_time;
+    wolfsentry_ent_id_t route_id; /* looked up again when applied, since the route may be gone by then. */
+    wolfsentry_hitcount_t hits;
+};
+
+/* each log is appended to by the threads that hash to it, under its busy
+ * flag, and emptied by the mutex holder.
+ */
+struct wolfsentry_route_write_behind_log {
+    volatile uint32_t busy;
+    uint32_t n_ents;
+    struct wolfsentry_route_write_behind_ent ents[WOLFSENTRY_ROUTE_WRITE_BEHIND_LOG_ENTS];
+};
+
+struct wolfsentry_route_write_behind {
+    uint32_t n_logs; /* always a power of 2. */
+    size_t log_stride; /* sizeof(struct wolfsentry_route_write_behind_log), rounded up to a whole number of cache lines. */
+    void *logs; /* cache-line-aligned. */
+    void *logs_alloc; /* raw allocation backing logs. */
+};
+
+#endif /* WOLFSENTRY_THREADSAFE */
+
+/* hierarchical timing wheel of purge deadlines.  level 0 has a slot per tick,
+ * and each level above has a slot per whole turn of the level below.  routes
+ * are filed by purge_after, and refiled lazily -- a hit that moves
+ * purge_after out leaves the route where it is, and it is refiled when its
+ * slot comes due, or cascades to a lower level.
+ */
+#ifndef WOLFSENTRY_ROUTE_PURGE_WHEEL_TICK_SHIFT
+#define WOLFSENTRY_ROUTE_PURGE_WHEEL_TICK_SHIFT 20 /* ticks of 2^20 wolfsentry_time_t units, about a second with the builtin microsecond clock. */
+#endif
+#define WOLFSENTRY_ROUTE_PURGE_WHEEL_LEVELS 4
+#define WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS 6
+#define WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS (1U << WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOT_BITS)
+
+struct wolfsentry_route_purge_wheel {
+    uint64_t current_tick; /* slots for earlier ticks are empty.  only moves forward while routes are filed. */
+    wolfsentry_hitcount_t len; /* routes filed, i.e. routes with a nonzero purge_after. */
+    uint64_t occupied[WOLFSENTRY_ROUTE_PURGE_WHEEL_LEVELS]; /* bitmaps of nonempty slots. */
+    struct wolfsentry_list_header slots[WOLFSENTRY_ROUTE_PURGE_WHEEL_LEVELS][WOLFSENTRY_ROUTE_PURGE_WHEEL_SLOTS];
+};
+
+#ifndef WOLFSENTRY_MAINTENANCE_SLICE_ITEMS
+#define WOLFSENTRY_MAINTENANCE_SLICE_ITEMS 32
+#endif
+
 struct wolfsentry_route_table {
     struct wolfsentry_table_header header;
-    struct wolfsentry_list_header purge_list;
+    struct wolfsentry_route_purge_wheel purge_wheel;
+    struct wolfsentry_list_header tuples;
+    struct wolfsentry_list_header tries;
+    struct wolfsentry_route_flow_cache *flow_cache; /* optional, see wolfsentry_route_table_flow_cache_configure(). */
+    uint32_t generation; /* bumped on every change that can alter a lookup result. */
+    wolfsentry_hitcount_t flow_cache_hits, flow_cache_misses, flow_cache_evictions;
+    struct wolfsentry_route_negative_filter *negative_filter; /* see wolfsentry_route_negative_filter_excludes(). */
+#ifdef WOLFSENTRY_THREADSAFE
+    struct wolfsentry_route_write_behind *write_behind; /* optional, see wolfsentry_route_table_write_behind_configure(). */
+#endif
+    wolfsentry_hitcount_t negative_filter_hits; /* lookups turned away by negative_filter. */
+    uint32_t n_filterable_routes, n_unfilterable_routes;
+    /* filterable routes by key, family index (IPv4, IPv6, other), and prefix length. */
+    uint32_t remote_prefix_len_counts[3][WOLFSENTRY_MAX_ADDR_BITS + 1];
+    uint32_t local_prefix_len_counts[3][WOLFSENTRY_MAX_ADDR_BITS + 1];
+    uint32_t n_local_port_keyed_routes[3];
     wolfsentry_hitcount_t max_purgeable_routes;
     struct wolfsentry_event *default_event; /* used as the parent_event by wolfsentry_route_dispatch() for a static route match with a null parent_event. */
     struct wolfsentry_route *fallthrough_route; /* used as the rule_route when no rule_route is matched or inserted. */
@@ -434,14 +920,23 @@ struct wolfsentry_context {
 #ifdef WOLFSENTRY_PROTOCOL_NAMES
     struct wolfsentry_addr_family_byname_table *addr_families_byname;
 #endif
-    struct wolfsentry_table_header ents_by_id;
+    struct wolfsentry_ent_id_index ents_by_id;
+#ifdef WOLFSENTRY_HAVE_MAINTENANCE_WORKER
+    struct wolfsentry_maintenance_worker *maintenance_worker; /* see wolfsentry_maintenance_worker_start(). */
+#endif
+#ifdef WOLFSENTRY_CLOCK_BUILTINS
+    int time_arith_is_builtin; /* hpi.timecbs does the builtin microsecond arithmetic, so it can be inlined. */
+#endif
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    struct wolfsentry_slab *slab; /* NULL until wolfsentry_slab_init(), and objects allocated meanwhile come from the heap. */
+#endif
 };
 
 #ifdef WOLFSENTRY_THREADSAFE
 
 #define WOLFSENTRY_MALLOC_1(allocator, size) ((allocator).malloc((allocator).context, thread, size))
 #define WOLFSENTRY_FREE_1(allocator, ptr) (allocator).free((allocator).context, thread, ptr)
-#define WOLFSENTRY_REALLOC_1(allocator, ptr, size) ((allocator).realloc(wolfsentry->hpi.allocator.context, thread, ptr, size))
+#define WOLFSENTRY_REALLOC_1(allocator, ptr, size) ((allocator).realloc((allocator).context, thread, ptr, size))
 #define WOLFSENTRY_MEMALIGN_1(allocator, alignment, size) ((allocator).memalign ? (allocator).memalign((allocator).context, thread, alignment, size) : NULL)
 #define WOLFSENTRY_FREE_ALIGNED_1(allocator, ptr) ((allocator).memalign ? (allocator).free_aligned((allocator).context, thread, ptr) : (void)NULL)
 
@@ -449,7 +944,7 @@ struct wolfsentry_context {
 
 #define WOLFSENTRY_MALLOC_1(allocator, size) ((allocator).malloc((allocator).context, size))
 #define WOLFSENTRY_FREE_1(allocator, ptr) (allocator).free((allocator).context, ptr)
-#define WOLFSENTRY_REALLOC_1(allocator, ptr, size) ((allocator).realloc(wolfsentry->hpi.allocator.context, ptr, size))
+#define WOLFSENTRY_REALLOC_1(allocator, ptr, size) ((allocator).realloc((allocator).context, ptr, size))
 #define WOLFSENTRY_MEMALIGN_1(allocator, alignment, size) ((allocator).memalign ? (allocator).memalign((allocator).context, alignment, size) : NULL)
 #define WOLFSENTRY_FREE_ALIGNED_1(allocator, ptr) ((allocator).memalign ? (allocator).free_aligned((allocator).context, ptr) : (void)NULL)
 
@@ -461,7 +956,33 @@ struct wolfsentry_context {
 #define WOLFSENTRY_MEMALIGN(alignment, size) WOLFSENTRY_MEMALIGN_1(wolfsentry->hpi.allocator, alignment, size)
 #define WOLFSENTRY_FREE_ALIGNED(ptr) WOLFSENTRY_FREE_ALIGNED_1(wolfsentry->hpi.allocator, ptr)
 
+/* for routes, events, and action list ents.  objects must be freed with the
+ * same size and alignment they were allocated with, and by the context that
+ * allocated them.  routes use the _ROUTE variants, which only draw from
+ * classes aligned to WOLFSENTRY_SLAB_ROUTE_ALIGNMENT.
+ */
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_slab_init(WOLFSENTRY_CONTEXT_ARGS_IN);
+WOLFSENTRY_LOCAL_VOID wolfsentry_slab_free_all(WOLFSENTRY_CONTEXT_ARGS_IN);
+WOLFSENTRY_LOCAL void *wolfsentry_slab_alloc(WOLFSENTRY_CONTEXT_ARGS_IN, size_t size, size_t alignment);
+WOLFSENTRY_LOCAL_VOID wolfsentry_slab_free(WOLFSENTRY_CONTEXT_ARGS_IN, void *ptr, size_t size, size_t alignment);
+#define WOLFSENTRY_SLAB_ALLOC_1(context, size) wolfsentry_slab_alloc(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(context), size, WOLFSENTRY_SLAB_OBJECT_ALIGNMENT)
+#define WOLFSENTRY_SLAB_FREE_1(context, ptr, size) wolfsentry_slab_free(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(context), ptr, size, WOLFSENTRY_SLAB_OBJECT_ALIGNMENT)
+#define WOLFSENTRY_SLAB_ALLOC_ROUTE_1(context, size) wolfsentry_slab_alloc(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(context), size, WOLFSENTRY_SLAB_ROUTE_ALIGNMENT)
+#define WOLFSENTRY_SLAB_FREE_ROUTE_1(context, ptr, size) wolfsentry_slab_free(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(context), ptr, size, WOLFSENTRY_SLAB_ROUTE_ALIGNMENT)
+#else
+#define WOLFSENTRY_SLAB_ALLOC_1(context, size) WOLFSENTRY_MALLOC_1((context)->hpi.allocator, size)
+#define WOLFSENTRY_SLAB_FREE_1(context, ptr, size) ((void)(size), WOLFSENTRY_FREE_1((context)->hpi.allocator, ptr))
+#define WOLFSENTRY_SLAB_ALLOC_ROUTE_1(context, size) WOLFSENTRY_SLAB_ALLOC_1(context, size)
+#define WOLFSENTRY_SLAB_FREE_ROUTE_1(context, ptr, size) WOLFSENTRY_SLAB_FREE_1(context, ptr, size)
+#endif
+#define WOLFSENTRY_SLAB_ALLOC(size) WOLFSENTRY_SLAB_ALLOC_1(wolfsentry, size)
+#define WOLFSENTRY_SLAB_FREE(ptr, size) WOLFSENTRY_SLAB_FREE_1(wolfsentry, ptr, size)
+#define WOLFSENTRY_SLAB_ALLOC_ROUTE(size) WOLFSENTRY_SLAB_ALLOC_ROUTE_1(wolfsentry, size)
+#define WOLFSENTRY_SLAB_FREE_ROUTE(ptr, size) WOLFSENTRY_SLAB_FREE_ROUTE_1(wolfsentry, ptr, size)
+
 #define WOLFSENTRY_GET_TIME_1(timecbs, time_p) ((timecbs).get_time((timecbs).context, time_p))
+#define WOLFSENTRY_GET_TIME_COARSE_1(timecbs, time_p) ((timecbs).get_time_coarse((timecbs).context, time_p))
 #define WOLFSENTRY_DIFF_TIME_1(timecbs, later, earlier) ((timecbs).diff_time(later, earlier))
 #define WOLFSENTRY_ADD_TIME_1(timecbs, start_time, time_interval) ((timecbs).add_time(start_time, time_interval))
 #define WOLFSENTRY_TO_EPOCH_TIME_1(timecbs, when, epoch_secs, epoch_nsecs) ((timecbs).to_epoch_time(when, epoch_secs, epoch_nsecs))
@@ -470,6 +991,44 @@ struct wolfsentry_context {
 #define WOLFSENTRY_INTERVAL_FROM_SECONDS_1(timecbs, howlong_secs, howlong_nsecs, howlong) ((timecbs).interval_from_seconds(howlong_secs, howlong_nsecs, howlong))
 
 #define WOLFSENTRY_GET_TIME(time_p) WOLFSENTRY_GET_TIME_1(wolfsentry->hpi.timecbs, time_p)
+#define WOLFSENTRY_GET_TIME_COARSE(time_p) WOLFSENTRY_GET_TIME_COARSE_1(wolfsentry->hpi.timecbs, time_p)
+
+#ifdef WOLFSENTRY_CLOCK_BUILTINS
+
+/* the builtin clock counts microseconds since the epoch.  these are its
+ * arithmetic callbacks, inlined into the context-level macros below when
+ * the context is using them, so that only user-supplied timecbs pay for
+ * the indirect call.  the conversions return 0 on overflow, for the macros
+ * to encode in the caller's source ID.
+ */
+
+static inline int wolfsentry_builtin_to_epoch_time_1(wolfsentry_time_t when, time_t *epoch_secs, long *epoch_nsecs) {
+    if (when / (wolfsentry_time_t)1000000 > MAX_SINT_OF(*epoch_secs))
+        return 0;
+    *epoch_secs = (time_t)(when / (wolfsentry_time_t)1000000);
+    *epoch_nsecs = (long)((when % (wolfsentry_time_t)1000000) * (wolfsentry_time_t)1000);
+    return 1;
+}
+
+static inline int wolfsentry_builtin_from_epoch_time_1(time_t epoch_secs, long epoch_nsecs, wolfsentry_time_t *when) {
+    if ((wolfsentry_time_t)epoch_secs > MAX_SINT_OF(*when) / (wolfsentry_time_t)1000000)
+        return 0;
+    *when = ((wolfsentry_time_t)epoch_secs * (wolfsentry_time_t)1000000) + ((wolfsentry_time_t)epoch_nsecs / (wolfsentry_time_t)1000);
+    return 1;
+}
+
+#define WOLFSENTRY_BUILTIN_TO_EPOCH_TIME(when, epoch_secs, epoch_nsecs) (wolfsentry_builtin_to_epoch_time_1(when, epoch_secs, epoch_nsecs) ? WOLFSENTRY_ERROR_ENCODE(OK) : WOLFSENTRY_ERROR_ENCODE(NUMERIC_ARG_TOO_BIG))
+#define WOLFSENTRY_BUILTIN_FROM_EPOCH_TIME(epoch_secs, epoch_nsecs, when) (wolfsentry_builtin_from_epoch_time_1(epoch_secs, epoch_nsecs, when) ? WOLFSENTRY_ERROR_ENCODE(OK) : WOLFSENTRY_ERROR_ENCODE(NUMERIC_ARG_TOO_BIG))
+
+#define WOLFSENTRY_DIFF_TIME(later, earlier) (wolfsentry->time_arith_is_builtin ? (wolfsentry_time_t)((later) - (earlier)) : WOLFSENTRY_DIFF_TIME_1(wolfsentry->hpi.timecbs, later, earlier))
+#define WOLFSENTRY_ADD_TIME(start_time, time_interval) (wolfsentry->time_arith_is_builtin ? (wolfsentry_time_t)((start_time) + (time_interval)) : WOLFSENTRY_ADD_TIME_1(wolfsentry->hpi.timecbs, start_time, time_interval))
+#define WOLFSENTRY_TO_EPOCH_TIME(when, epoch_secs, epoch_nsecs) (wolfsentry->time_arith_is_builtin ? WOLFSENTRY_BUILTIN_TO_EPOCH_TIME(when, epoch_secs, epoch_nsecs) : WOLFSENTRY_TO_EPOCH_TIME_1(wolfsentry->hpi.timecbs, when, epoch_secs, epoch_nsecs))
+#define WOLFSENTRY_FROM_EPOCH_TIME(epoch_secs, epoch_nsecs, when) (wolfsentry->time_arith_is_builtin ? WOLFSENTRY_BUILTIN_FROM_EPOCH_TIME(epoch_secs, epoch_nsecs, when) : WOLFSENTRY_FROM_EPOCH_TIME_1(wolfsentry->hpi.timecbs, epoch_secs, epoch_nsecs, when))
+#define WOLFSENTRY_INTERVAL_TO_SECONDS(howlong, howlong_secs, howlong_nsecs) (wolfsentry->time_arith_is_builtin ? WOLFSENTRY_BUILTIN_TO_EPOCH_TIME(howlong, howlong_secs, howlong_nsecs) : WOLFSENTRY_INTERVAL_TO_SECONDS_1(wolfsentry->hpi.timecbs, howlong, howlong_secs, howlong_nsecs))
+#define WOLFSENTRY_INTERVAL_FROM_SECONDS(howlong_secs, howlong_nsecs, howlong) (wolfsentry->time_arith_is_builtin ? WOLFSENTRY_BUILTIN_FROM_EPOCH_TIME(howlong_secs, howlong_nsecs, howlong) : WOLFSENTRY_INTERVAL_FROM_SECONDS_1(wolfsentry->hpi.timecbs, howlong_secs, howlong_nsecs, howlong))
+
+#else /* !WOLFSENTRY_CLOCK_BUILTINS */
+
 #define WOLFSENTRY_DIFF_TIME(later, earlier) WOLFSENTRY_DIFF_TIME_1(wolfsentry->hpi.timecbs, later, earlier)
 #define WOLFSENTRY_ADD_TIME(start_time, time_interval) WOLFSENTRY_ADD_TIME_1(wolfsentry->hpi.timecbs, start_time, time_interval)
 #define WOLFSENTRY_TO_EPOCH_TIME(when, epoch_secs, epoch_nsecs) WOLFSENTRY_TO_EPOCH_TIME_1(wolfsentry->hpi.timecbs, when, epoch_secs, epoch_nsecs)
@@ -477,6 +1036,8 @@ struct wolfsentry_context {
 #define WOLFSENTRY_INTERVAL_TO_SECONDS(howlong, howlong_secs, howlong_nsecs) WOLFSENTRY_INTERVAL_TO_SECONDS_1(wolfsentry->hpi.timecbs, howlong, howlong_secs, howlong_nsecs)
 #define WOLFSENTRY_INTERVAL_FROM_SECONDS(howlong_secs, howlong_nsecs, howlong) WOLFSENTRY_INTERVAL_FROM_SECONDS_1(wolfsentry->hpi.timecbs, howlong_secs, howlong_nsecs, howlong)
 
+#endif /* WOLFSENTRY_CLOCK_BUILTINS */
+
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_id_allocate(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_ent_header *ent);
 
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_label_is_builtin(const char *label, int label_len);
@@ -486,6 +1047,18 @@ WOLFSENTRY_LOCAL int wolfsentry_event_key_cmp(
     const struct wolfsentry_event *right);
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_event_table_init(
     struct wolfsentry_event_table *event_table);
+WOLFSENTRY_LOCAL_VOID wolfsentry_event_label_index_insert(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_event_table *event_table,
+    struct wolfsentry_event *event);
+WOLFSENTRY_LOCAL_VOID wolfsentry_event_label_index_delete(
+    struct wolfsentry_event_table *event_table,
+    struct wolfsentry_event *event);
+WOLFSENTRY_LOCAL_VOID wolfsentry_event_label_index_reset(
+    struct wolfsentry_event_table *event_table);
+WOLFSENTRY_LOCAL_VOID wolfsentry_event_label_index_free(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_event_table *event_table);
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_event_table_clone_header(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     struct wolfsentry_table_header *src_table,
@@ -560,6 +1133,25 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_insert_by_id(WOLFSENT
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_delete_by_id_1(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_ent_header *ent);
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_ent_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_IN, wolfsentry_ent_id_t id, struct wolfsentry_table_ent_header **ent);
 
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_hitcount_slab_init(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_header *table);
+WOLFSENTRY_LOCAL_VOID wolfsentry_table_hitcount_slab_free(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_header *table);
+WOLFSENTRY_LOCAL wolfsentry_hitcount_t wolfsentry_table_ent_hitcount_increment(struct wolfsentry_thread_context *thread, struct wolfsentry_table_ent_header *ent);
+WOLFSENTRY_LOCAL wolfsentry_hitcount_t wolfsentry_table_ent_hitcount_get(const struct wolfsentry_table_ent_header *ent);
+WOLFSENTRY_LOCAL_VOID wolfsentry_table_ent_hitcount_release(struct wolfsentry_table_ent_header *ent);
+#define WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT(ent, post) ((post) = wolfsentry_table_ent_hitcount_increment(thread, ent))
+#define WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT_WRAPPING(ent) ((void)wolfsentry_table_ent_hitcount_increment(thread, ent))
+#define WOLFSENTRY_TABLE_ENT_HITCOUNT_GET(ent) wolfsentry_table_ent_hitcount_get(ent)
+#else
+#define WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT(ent, post) WOLFSENTRY_ATOMIC_INCREMENT_UNSIGNED_SAFELY_BY_ONE((ent)->hitcount, post)
+#define WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT_WRAPPING(ent) ((void)WOLFSENTRY_ATOMIC_INCREMENT((ent)->hitcount, 1))
+#define WOLFSENTRY_TABLE_ENT_HITCOUNT_GET(ent) WOLFSENTRY_ATOMIC_LOAD((ent)->hitcount)
+#endif
+/* _HITCOUNT_INCREMENT() leaves 0 in post iff the ent's hit count is saturated,
+ * and is for route hit counts.  action hit counts wrap, and use
+ * _HITCOUNT_INCREMENT_WRAPPING().
+ */
+
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_clone(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     struct wolfsentry_table_header *src_table,
@@ -628,10 +1220,22 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_clone(
     struct wolfsentry_table_ent_header **new_ent,
     wolfsentry_clone_flags_t flags);
 
-WOLFSENTRY_LOCAL_VOID wolfsentry_route_purge_list_insert(
+WOLFSENTRY_LOCAL_VOID wolfsentry_route_purge_wheel_insert(
     struct wolfsentry_route_table *route_table,
     struct wolfsentry_route *route_to_insert);
 
+WOLFSENTRY_LOCAL_VOID wolfsentry_route_purge_wheel_delete(
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route_to_delete);
+
+WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_route_index_insert(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *route);
+
+WOLFSENTRY_LOCAL_VOID wolfsentry_route_table_generation_bump(
+    struct wolfsentry_route_table *route_table);
+
 WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_table_free_ents(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_table_header *table);
 
 static inline __wolfsentry_wur struct wolfsentry_table_ent_header *wolfsentry_table_first(const struct wolfsentry_table_header *table) {
@@ -972,8 +972,11 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_set_thread_readonly(struct wolfse
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_set_thread_readwrite(struct wolfsentry_thread_context *thread) {
     WOLFSENTRY_THREAD_ASSERT_INITED(thread);
 
-    if (thread->shared_count > thread->recursion_of_tracked_lock)
+    if ((thread->shared_count > thread->recursion_of_tracked_lock) ||
+        (thread->epoch_slot != 0))
+    {
         WOLFSENTRY_ERROR_RETURN(INCOMPATIBLE_STATE);
+    }
     WOLFSENTRY_CLEAR_BITS(thread->current_thread_flags, WOLFSENTRY_THREAD_FLAG_READONLY);
     WOLFSENTRY_RETURN_OK;
 }
@@ -1447,6 +1450,428 @@ static int freertos_sem_destroy( sem_t * sem )
 
 static const struct timespec timespec_deadline_now = {WOLFSENTRY_DEADLINE_NOW, WOLFSENTRY_DEADLINE_NOW};
 
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+
+/* epoch readers: a _THREAD_FLAG_READONLY thread (or with
+ * _LOCK_FLAG_SCALABLE_READERS, any thread) taking an outermost shared lock on a
+ * lock with epoch_readers claims a slot with a single CAS on a cache line
+ * private to it, then confirms no writer is active.  a writer, once it holds
+ * the lock exclusively, raises epoch_writer_active, then waits for every slot
+ * to empty.  both sides use sequentially consistent operations, so either the
+ * reader sees the writer's flag and backs out to the semaphore path, or the
+ * writer sees the reader's slot and waits for it.
+ */
+
+#ifdef WOLFSENTRY_USE_NATIVE_POSIX_THREADS
+    #include <sched.h>
+    #define WOLFSENTRY_LOCK_EPOCH_YIELD() (void)sched_yield()
+#else
+    #define WOLFSENTRY_LOCK_EPOCH_YIELD() do {} while (0)
+#endif
+
+static unsigned int wolfsentry_lock_epoch_slot_hash(wolfsentry_thread_id_t id) {
+    uint64_t h = (uint64_t)(uintptr_t)id * 0x9e3779b97f4a7c15ULL;
+    return (unsigned int)(h >> 32U) & (WOLFSENTRY_LOCK_EPOCH_READER_SLOTS - 1U);
+}
+
+/* returns nonzero if the caller is now inside an epoch read section. */
+static int wolfsentry_lock_epoch_enter(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread) {
+    unsigned int idx = wolfsentry_lock_epoch_slot_hash(thread->id);
+    unsigned int i;
+
+    if (__atomic_load_n(&lock->epoch_writer_active, __ATOMIC_SEQ_CST))
+        return 0;
+
+    /* reader bias is revoked for a while after a writer had to wait for
+     * readers, so that write-heavy phases don't pay for a drain every time.
+     */
+    if (WOLFSENTRY_ATOMIC_LOAD(lock->epoch_bias_inhibit) > 0) {
+        (void)WOLFSENTRY_ATOMIC_DECREMENT(lock->epoch_bias_inhibit, 1);
+        return 0;
+    }
+
+    for (i = 0; i < WOLFSENTRY_LOCK_EPOCH_READER_PROBES; ++i) {
+        wolfsentry_thread_id_t expected = WOLFSENTRY_THREAD_NO_ID;
+        if (WOLFSENTRY_ATOMIC_TEST_AND_SET(lock->epoch_readers[idx].u.holder, expected, thread->id))
+            break;
+        idx = (idx + 1U) & (WOLFSENTRY_LOCK_EPOCH_READER_SLOTS - 1U);
+    }
+    if (i == WOLFSENTRY_LOCK_EPOCH_READER_PROBES)
+        return 0;
+
+    if (__atomic_load_n(&lock->epoch_writer_active, __ATOMIC_SEQ_CST)) {
+        WOLFSENTRY_ATOMIC_STORE(lock->epoch_readers[idx].u.holder, WOLFSENTRY_THREAD_NO_ID);
+        return 0;
+    }
+
+    thread->epoch_slot = (int)idx + 1;
+    thread->tracked_shared_lock = lock;
+    thread->recursion_of_tracked_lock = 1;
+    ++thread->shared_count;
+
+    return 1;
+}
+
+static void wolfsentry_lock_epoch_exit(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread) {
+    --thread->shared_count;
+    if (--thread->recursion_of_tracked_lock == 0) {
+        WOLFSENTRY_ATOMIC_STORE(lock->epoch_readers[thread->epoch_slot - 1].u.holder, WOLFSENTRY_THREAD_NO_ID);
+        thread->epoch_slot = 0;
+        thread->tracked_shared_lock = NULL;
+    }
+}
+
+/* called by a new exclusive holder before it returns to its caller.  epoch
+ * readers never wait on this lock, so the drain is bounded by the longest read
+ * section in progress, but the caller's deadline still applies -- on expiry,
+ * BUSY or TIMED_OUT is returned with epoch_writer_active still raised, and the
+ * caller must give back the lock, which clears it.
+ */
+static wolfsentry_errcode_t wolfsentry_lock_epoch_drain(struct wolfsentry_rwlock *lock, const struct timespec *abs_timeout) {
+    int expected = 0;
+    int waited = 0;
+    wolfsentry_time_t deadline = 0, now;
+    unsigned int i;
+    wolfsentry_errcode_t ret = WOLFSENTRY_ERROR_ENCODE(OK);
+
+    /* already raised by a promotion nested in this same acquisition, which
+     * drained before returning.
+     */
+    if (! WOLFSENTRY_ATOMIC_TEST_AND_SET(lock->epoch_writer_active, expected, 1))
+        WOLFSENTRY_RETURN_OK;
+
+    if ((abs_timeout != NULL) &&
+        (abs_timeout != &timespec_deadline_now) &&
+        (abs_timeout->tv_sec != WOLFSENTRY_DEADLINE_NOW))
+    {
+        WOLFSENTRY_RERETURN_IF_ERROR(WOLFSENTRY_FROM_EPOCH_TIME_1(lock->hpi->timecbs, abs_timeout->tv_sec, abs_timeout->tv_nsec, &deadline));
+    }
+
+    for (i = 0; i < WOLFSENTRY_LOCK_EPOCH_READER_SLOTS; ++i) {
+        while (__atomic_load_n(&lock->epoch_readers[i].u.holder, __ATOMIC_SEQ_CST) != WOLFSENTRY_THREAD_NO_ID) {
+            waited = 1;
+            if (abs_timeout != NULL) {
+                if ((abs_timeout == &timespec_deadline_now) ||
+                    (abs_timeout->tv_sec == WOLFSENTRY_DEADLINE_NOW))
+                {
+                    ret = WOLFSENTRY_ERROR_ENCODE(BUSY);
+                    break;
+                }
+                if ((ret = WOLFSENTRY_GET_TIME_1(lock->hpi->timecbs, &now)) < 0)
+                    break;
+                if (WOLFSENTRY_DIFF_TIME_1(lock->hpi->timecbs, now, deadline) >= 0) {
+                    ret = WOLFSENTRY_ERROR_ENCODE(TIMED_OUT);
+                    break;
+                }
+            }
+            WOLFSENTRY_LOCK_EPOCH_YIELD();
+        }
+        if (ret < 0)
+            break;
+    }
+
+    if (waited)
+        WOLFSENTRY_ATOMIC_STORE(lock->epoch_bias_inhibit, WOLFSENTRY_LOCK_EPOCH_BIAS_INHIBIT_COUNT);
+
+    WOLFSENTRY_ERROR_RERETURN(ret);
+}
+
+/* called with lock->sem held, whenever the lock leaves _EXCLUSIVE state. */
+#define WOLFSENTRY_LOCK_EPOCH_WRITER_DONE(lock) do {                    \
+        if ((lock)->epoch_readers != NULL)                              \
+            WOLFSENTRY_ATOMIC_STORE((lock)->epoch_writer_active, 0);    \
+    } while (0)
+
+#else
+
+#define WOLFSENTRY_LOCK_EPOCH_WRITER_DONE(lock) do {} while (0)
+
+#endif /* WOLFSENTRY_LOCK_EPOCH_READERS */
+
+#ifdef WOLFSENTRY_LOCK_SHARED_FASTPATH
+
+/* shared fast path: while the lock is quiescent (unlocked, or held shared only
+ * by fast path holders, with no waiters and no reservation), shared lock and
+ * unlock are a single CAS on lock->shared_fastpath, with no semaphore
+ * operations.  any operation that needs the full state machine takes lock->sem
+ * as before, then closes the fast path, folding its holders into
+ * holder_count.read, so that they later unlock through the semaphore path.  the
+ * fast path is reopened by wolfsentry_lock_unlock() when the lock is again
+ * quiescent.  contended acquisitions still block on the semaphores, which are
+ * futex-based on Linux.
+ */
+
+static int wolfsentry_lock_fastpath_shared(struct wolfsentry_rwlock *lock) {
+    uint32_t fastpath = WOLFSENTRY_ATOMIC_LOAD(lock->shared_fastpath);
+    while (fastpath < WOLFSENTRY_LOCK_FASTPATH_CLOSED - 1U) {
+        if (WOLFSENTRY_ATOMIC_TEST_AND_SET(lock->shared_fastpath, fastpath, fastpath + 1U))
+            return 1;
+    }
+    return 0;
+}
+
+static int wolfsentry_lock_fastpath_unlock(struct wolfsentry_rwlock *lock) {
+    uint32_t fastpath = WOLFSENTRY_ATOMIC_LOAD(lock->shared_fastpath);
+    while ((fastpath > 0) && (! (fastpath & WOLFSENTRY_LOCK_FASTPATH_CLOSED))) {
+        if (WOLFSENTRY_ATOMIC_TEST_AND_SET(lock->shared_fastpath, fastpath, fastpath - 1U))
+            return 1;
+    }
+    return 0;
+}
+
+/* called with lock->sem held. */
+static void wolfsentry_lock_fastpath_close(struct wolfsentry_rwlock *lock) {
+    uint32_t fastpath = WOLFSENTRY_ATOMIC_LOAD(lock->shared_fastpath);
+    while (! (fastpath & WOLFSENTRY_LOCK_FASTPATH_CLOSED)) {
+        if (WOLFSENTRY_ATOMIC_TEST_AND_SET(lock->shared_fastpath, fastpath, WOLFSENTRY_LOCK_FASTPATH_CLOSED)) {
+            if (fastpath > 0) {
+                lock->holder_count.read += (int)fastpath;
+                WOLFSENTRY_ATOMIC_STORE(lock->state, WOLFSENTRY_LOCK_SHARED);
+            }
+            break;
+        }
+    }
+}
+
+/* called with lock->sem held. */
+static void wolfsentry_lock_fastpath_reopen(struct wolfsentry_rwlock *lock) {
+    if ((lock->state == WOLFSENTRY_LOCK_UNLOCKED) &&
+        (lock->read_waiter_count == 0) &&
+        (lock->write_waiter_count == 0) &&
+        (lock->read2write_reservation_holder == WOLFSENTRY_THREAD_NO_ID))
+    {
+        WOLFSENTRY_ATOMIC_STORE(lock->shared_fastpath, 0U);
+    }
+}
+
+/* a caller that may hold the lock via the fast path must close it before
+ * inspecting lock->state for its own holdings.
+ */
+static wolfsentry_errcode_t wolfsentry_lock_fastpath_close_for(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread) {
+    int ret;
+    if ((thread == NULL) ||
+        (thread->tracked_shared_lock != lock) ||
+        (WOLFSENTRY_ATOMIC_LOAD(lock->shared_fastpath) & WOLFSENTRY_LOCK_FASTPATH_CLOSED))
+    {
+        WOLFSENTRY_RETURN_OK;
+    }
+    do {
+        ret = sem_wait(&lock->sem);
+    } while ((ret < 0) && (errno == EINTR));
+    if (ret < 0)
+        WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+    wolfsentry_lock_fastpath_close(lock);
+    if (sem_post(&lock->sem) < 0)
+        WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+    WOLFSENTRY_RETURN_OK;
+}
+
+#define WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock) wolfsentry_lock_fastpath_close(lock)
+#define WOLFSENTRY_LOCK_FASTPATH_REOPEN(lock) wolfsentry_lock_fastpath_reopen(lock)
+#define WOLFSENTRY_LOCK_FASTPATH_CLOSE_FOR(lock, thread) WOLFSENTRY_RERETURN_IF_ERROR(wolfsentry_lock_fastpath_close_for(lock, thread))
+
+#else
+
+#define WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock) do {} while (0)
+#define WOLFSENTRY_LOCK_FASTPATH_REOPEN(lock) do {} while (0)
+#define WOLFSENTRY_LOCK_FASTPATH_CLOSE_FOR(lock, thread) do {} while (0)
+
+#endif /* WOLFSENTRY_LOCK_SHARED_FASTPATH */
+
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+
+/* before a read-write thread inside an epoch read section can promote or take
+ * a reservation, its hold is moved into holder_count.read, so that the
+ * semaphore state machine sees it.  if a writer already holds the lock, it is
+ * draining and waiting on this very reader, so the caller must unlock and
+ * retry, as with other promotion conflicts.
+ */
+static wolfsentry_errcode_t wolfsentry_lock_epoch_convert_for(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread) {
+    int ret;
+
+    if ((thread == NULL) || (thread->epoch_slot == 0) || (thread->tracked_shared_lock != lock))
+        WOLFSENTRY_RETURN_OK;
+
+    do {
+        ret = sem_wait(&lock->sem);
+    } while ((ret < 0) && (errno == EINTR));
+    if (ret < 0)
+        WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
+
+    if (lock->state == WOLFSENTRY_LOCK_EXCLUSIVE) {
+        if (sem_post(&lock->sem) < 0)
+            WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+        WOLFSENTRY_ERROR_RETURN(BUSY);
+    }
+
+    lock->holder_count.read += thread->recursion_of_tracked_lock;
+    if (lock->state == WOLFSENTRY_LOCK_UNLOCKED)
+        WOLFSENTRY_ATOMIC_STORE(lock->state, WOLFSENTRY_LOCK_SHARED);
+    WOLFSENTRY_ATOMIC_STORE(lock->epoch_readers[thread->epoch_slot - 1].u.holder, WOLFSENTRY_THREAD_NO_ID);
+    thread->epoch_slot = 0;
+
+    if (sem_post(&lock->sem) < 0)
+        WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#define WOLFSENTRY_LOCK_EPOCH_CONVERT_FOR(lock, thread) WOLFSENTRY_RERETURN_IF_ERROR(wolfsentry_lock_epoch_convert_for(lock, thread))
+
+#else
+
+#define WOLFSENTRY_LOCK_EPOCH_CONVERT_FOR(lock, thread) do {} while (0)
+
+#endif /* WOLFSENTRY_LOCK_EPOCH_READERS */
+
+#ifdef WOLFSENTRY_LOCK_STATS
+
+static wolfsentry_time_t wolfsentry_lock_stats_now(const struct wolfsentry_rwlock *lock) {
+    wolfsentry_time_t now;
+    if ((lock->hpi == NULL) || (WOLFSENTRY_GET_TIME_1(lock->hpi->timecbs, &now) < 0))
+        return 0;
+    return now;
+}
+
+static void wolfsentry_lock_stats_record_wait(const struct wolfsentry_rwlock *lock, wolfsentry_hitcount_t *contended, wolfsentry_time_t *wait_time, wolfsentry_hitcount_t *histogram, wolfsentry_time_t started) {
+    wolfsentry_time_t waited = 0, scaled;
+    unsigned int bucket = 0;
+
+    if (lock->hpi != NULL)
+        waited = WOLFSENTRY_DIFF_TIME_1(lock->hpi->timecbs, wolfsentry_lock_stats_now(lock), started);
+    if (waited < 0)
+        waited = 0;
+    for (scaled = waited; (scaled > 1) && (bucket < WOLFSENTRY_LOCK_STATS_HISTOGRAM_BUCKETS - 1); scaled >>= 1)
+        ++bucket;
+
+    (void)WOLFSENTRY_ATOMIC_INCREMENT(*contended, 1);
+    (void)WOLFSENTRY_ATOMIC_INCREMENT(*wait_time, waited);
+    (void)WOLFSENTRY_ATOMIC_INCREMENT(histogram[bucket], 1);
+}
+
+/* called with lock->sem held, whenever the lock leaves _EXCLUSIVE state. */
+static void wolfsentry_lock_stats_mutex_released(struct wolfsentry_rwlock *lock) {
+    wolfsentry_time_t held;
+
+    if (lock->hpi == NULL)
+        return;
+    held = WOLFSENTRY_DIFF_TIME_1(lock->hpi->timecbs, wolfsentry_lock_stats_now(lock), lock->mutex_acquired_at);
+    if (held > WOLFSENTRY_ATOMIC_LOAD(lock->stats.max_mutex_hold_time))
+        WOLFSENTRY_ATOMIC_STORE(lock->stats.max_mutex_hold_time, held);
+}
+
+#define WOLFSENTRY_LOCK_STATS_INCREMENT(lock, field) (void)WOLFSENTRY_ATOMIC_INCREMENT((lock)->stats.field, 1)
+#define WOLFSENTRY_LOCK_STATS_WAIT_DECL wolfsentry_time_t stats_wait_started;
+#define WOLFSENTRY_LOCK_STATS_WAIT_BEGIN(lock) (stats_wait_started = wolfsentry_lock_stats_now(lock))
+#define WOLFSENTRY_LOCK_STATS_WAIT_END(lock, mode) \
+    wolfsentry_lock_stats_record_wait(lock, &(lock)->stats.mode ## _contended, &(lock)->stats.mode ## _wait_time, (lock)->stats.mode ## _wait_histogram, stats_wait_started)
+#define WOLFSENTRY_LOCK_STATS_MUTEX_RELEASED(lock) wolfsentry_lock_stats_mutex_released(lock)
+
+#else
+
+#define WOLFSENTRY_LOCK_STATS_INCREMENT(lock, field) do {} while (0)
+#define WOLFSENTRY_LOCK_STATS_WAIT_DECL
+#define WOLFSENTRY_LOCK_STATS_WAIT_BEGIN(lock) do {} while (0)
+#define WOLFSENTRY_LOCK_STATS_WAIT_END(lock, mode) do {} while (0)
+#define WOLFSENTRY_LOCK_STATS_MUTEX_RELEASED(lock) do {} while (0)
+
+#endif /* WOLFSENTRY_LOCK_STATS */
+
+#if defined(WOLFSENTRY_LOCK_EPOCH_READERS) || defined(WOLFSENTRY_LOCK_STATS)
+
+/* called by the mutex and promotion entry points, when the caller newly holds
+ * the lock exclusively.  on failure, the caller still holds the lock, and must
+ * give it back.
+ */
+static wolfsentry_errcode_t wolfsentry_lock_mutex_obtained(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout) {
+#ifdef WOLFSENTRY_LOCK_STATS
+    lock->mutex_acquired_at = wolfsentry_lock_stats_now(lock);
+#endif
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    if (lock->epoch_readers != NULL) {
+        if ((abs_timeout == NULL) &&
+            thread &&
+            (thread->current_thread_flags & WOLFSENTRY_THREAD_FLAG_DEADLINE))
+        {
+            abs_timeout = &thread->deadline;
+        }
+        WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_epoch_drain(lock, abs_timeout));
+    }
+#endif
+    (void)thread;
+    (void)abs_timeout;
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif
+
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+
+/* backs out a promotion whose epoch drain failed, returning the caller to the
+ * shared hold (and with reservation_too, the reservation) it had on entry.
+ * this is wolfsentry_lock_mutex2shared() without its preconditions, and
+ * without taking over tracking of the lock when it wasn't tracked before.
+ */
+static wolfsentry_errcode_t wolfsentry_lock_epoch_unpromote(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, int was_tracked, int reservation_too) {
+    int ret;
+
+    do {
+        ret = sem_wait(&lock->sem);
+    } while ((ret < 0) && (errno == EINTR));
+    if (ret < 0)
+        WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+
+    WOLFSENTRY_ATOMIC_STORE(lock->state, WOLFSENTRY_LOCK_SHARED);
+    WOLFSENTRY_ATOMIC_STORE(lock->write_lock_holder, WOLFSENTRY_THREAD_NO_ID);
+    lock->promoted_at_count = 0;
+    WOLFSENTRY_LOCK_EPOCH_WRITER_DONE(lock);
+    WOLFSENTRY_LOCK_STATS_MUTEX_RELEASED(lock);
+
+    /* write count becomes read count again. */
+    thread->mutex_and_reservation_count -= lock->holder_count.write;
+    thread->shared_count += lock->holder_count.read;
+    if (was_tracked) {
+        thread->recursion_of_tracked_lock = lock->holder_count.read;
+        thread->tracked_shared_lock = lock;
+    }
+
+    if (reservation_too) {
+        WOLFSENTRY_ATOMIC_STORE(lock->read2write_reservation_holder, thread->id);
+        ++thread->mutex_and_reservation_count;
+        lock->read2write_waiter_read_count = lock->holder_count.read;
+        /* suppress posts to sem_read2write_waiters until the redemption is retried. */
+        ++lock->holder_count.read;
+    }
+
+    if ((lock->write_waiter_count == 0) &&
+        (lock->read_waiter_count > 0))
+    {
+        int read_waiter_count = lock->read_waiter_count;
+        lock->holder_count.read += lock->read_waiter_count;
+        lock->read_waiter_count = 0;
+        for (; read_waiter_count > 0; --read_waiter_count) {
+            if (sem_post(&lock->sem_read_waiters) < 0)
+                WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+        }
+    }
+
+    if (sem_post(&lock->sem) < 0)
+        WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#define WOLFSENTRY_LOCK_EPOCH_UNPROMOTE(lock, thread, was_tracked, reservation_too) \
+    WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_lock_epoch_unpromote(lock, thread, was_tracked, reservation_too))
+
+#else
+
+#define WOLFSENTRY_LOCK_EPOCH_UNPROMOTE(lock, thread, was_tracked, reservation_too) ((void)(was_tracked))
+
+#endif /* WOLFSENTRY_LOCK_EPOCH_READERS */
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_init(struct wolfsentry_host_platform_interface *hpi, struct wolfsentry_thread_context *thread, struct wolfsentry_rwlock *lock, wolfsentry_lock_flags_t flags) {
     wolfsentry_errcode_t ret;
 
@@ -1458,6 +1883,16 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_init(struct wolfsentry_host_
     if (flags & WOLFSENTRY_LOCK_FLAG_RETAIN_SEMAPHORE)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
 
+    if (flags & (WOLFSENTRY_LOCK_FLAG_EPOCH_READERS | WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS)) {
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+        /* the slots are process-local heap memory. */
+        if ((flags & WOLFSENTRY_LOCK_FLAG_PSHARED) || (hpi == NULL))
+            WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+#else
+        WOLFSENTRY_ERROR_RETURN(IMPLEMENTATION_MISSING);
+#endif
+    }
+
     memset(lock,0,sizeof *lock);
 
     lock->flags = flags;
@@ -1482,6 +1917,25 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_init(struct wolfsentry_host_
         goto free_write_waiters;
     }
 
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    if (flags & (WOLFSENTRY_LOCK_FLAG_EPOCH_READERS | WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS)) {
+        size_t alloc_size = (WOLFSENTRY_LOCK_EPOCH_READER_SLOTS * sizeof *lock->epoch_readers) + WOLFSENTRY_CACHE_LINE_SIZE - 1;
+        uintptr_t misalignment;
+        if ((lock->epoch_readers_alloc = WOLFSENTRY_MALLOC_1(hpi->allocator, alloc_size)) == NULL) {
+            (void)sem_destroy(&lock->sem_read2write_waiters);
+            (void)sem_destroy(&lock->sem_write_waiters);
+            (void)sem_destroy(&lock->sem_read_waiters);
+            (void)sem_destroy(&lock->sem);
+            WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+        }
+        /* WOLFSENTRY_THREAD_NO_ID is zero, so zeroed slots are free. */
+        memset(lock->epoch_readers_alloc, 0, alloc_size);
+        misalignment = (uintptr_t)lock->epoch_readers_alloc & (WOLFSENTRY_CACHE_LINE_SIZE - 1);
+        lock->epoch_readers = (struct wolfsentry_lock_epoch_reader *)(void *)
+            ((byte *)lock->epoch_readers_alloc + (misalignment ? WOLFSENTRY_CACHE_LINE_SIZE - misalignment : 0));
+    }
+#endif
+
     ret = WOLFSENTRY_ERROR_ENCODE(OK);
     lock->state = WOLFSENTRY_LOCK_UNLOCKED;
     goto out;
@@ -1540,6 +1994,22 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_destroy(struct wolfsentry_rw
         else
             WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
     }
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
+
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    if (lock->epoch_readers != NULL) {
+        unsigned int i;
+        for (i = 0; i < WOLFSENTRY_LOCK_EPOCH_READER_SLOTS; ++i) {
+            if (WOLFSENTRY_ATOMIC_LOAD(lock->epoch_readers[i].u.holder) != WOLFSENTRY_THREAD_NO_ID) {
+                if (sem_post(&lock->sem) < 0)
+                    WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+                else
+                    WOLFSENTRY_ERROR_RETURN(INCOMPATIBLE_STATE);
+            }
+        }
+    }
+#endif
+
     if (lock->state != WOLFSENTRY_LOCK_UNLOCKED) {
         WOLFSENTRY_WARN("attempt to destroy used lock {%u,%d,%d,%d,%d,%d,%d}\n", (unsigned int)lock->state, lock->holder_count.read, lock->read_waiter_count, lock->write_waiter_count, lock->read2write_waiter_read_count, lock->read2write_reservation_holder != WOLFSENTRY_THREAD_NO_ID, lock->promoted_at_count);
         if (sem_post(&lock->sem) < 0)
@@ -1582,6 +2052,14 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_destroy(struct wolfsentry_rw
     if (sem_destroy(&lock->sem_read2write_waiters) < 0)
         WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    if (lock->epoch_readers_alloc != NULL) {
+        WOLFSENTRY_FREE_1(lock->hpi->allocator, lock->epoch_readers_alloc);
+        lock->epoch_readers_alloc = NULL;
+        lock->epoch_readers = NULL;
+    }
+#endif
+
     lock->state = WOLFSENTRY_LOCK_UNINITED;
 
     WOLFSENTRY_RETURN_OK;
@@ -1606,8 +2084,15 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_free(struct wolfsentry_rwloc
 #define SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock) do {} while (0)
 #endif
 
-WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
+/* in instrumented builds, the public entry point is a counting wrapper, below. */
+#ifdef WOLFSENTRY_LOCK_STATS
+static wolfsentry_errcode_t wolfsentry_lock_shared_abstimed_1(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags)
+#else
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags)
+#endif
+{
     int ret;
+    WOLFSENTRY_LOCK_STATS_WAIT_DECL
 
     WOLFSENTRY_LOCK_ASSERT_INITED(lock);
 
@@ -1626,6 +2111,28 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfs
     if ((flags & WOLFSENTRY_LOCK_FLAG_NONRECURSIVE_SHARED) && (thread->tracked_shared_lock == lock))
         WOLFSENTRY_ERROR_RETURN(ALREADY);
 
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    if ((flags & (WOLFSENTRY_LOCK_FLAG_GET_RESERVATION_TOO | WOLFSENTRY_LOCK_FLAG_TRY_RESERVATION_TOO)) &&
+        (! (thread->current_thread_flags & WOLFSENTRY_THREAD_FLAG_READONLY)))
+    {
+        /* reservations live in the semaphore state machine. */
+        WOLFSENTRY_LOCK_EPOCH_CONVERT_FOR(lock, thread);
+    }
+    else if (thread->epoch_slot && (thread->tracked_shared_lock == lock)) {
+        ++thread->recursion_of_tracked_lock;
+        ++thread->shared_count;
+        WOLFSENTRY_RETURN_OK;
+    }
+    else if ((lock->epoch_readers != NULL) &&
+             ((thread->current_thread_flags & WOLFSENTRY_THREAD_FLAG_READONLY) ||
+              (lock->flags & WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS)) &&
+             (thread->tracked_shared_lock == NULL) &&
+             wolfsentry_lock_epoch_enter(lock, thread))
+    {
+        WOLFSENTRY_RETURN_OK;
+    }
+#endif
+
     if ((abs_timeout == NULL) &&
         (thread->current_thread_flags & WOLFSENTRY_THREAD_FLAG_DEADLINE))
     {
@@ -1645,6 +2152,22 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfs
         WOLFSENTRY_RERETURN_IF_ERROR(ret);
     }
 
+#ifdef WOLFSENTRY_LOCK_SHARED_FASTPATH
+    if (((! (flags & (WOLFSENTRY_LOCK_FLAG_GET_RESERVATION_TOO | WOLFSENTRY_LOCK_FLAG_TRY_RESERVATION_TOO))) ||
+         (thread->current_thread_flags & WOLFSENTRY_THREAD_FLAG_READONLY)) &&
+        wolfsentry_lock_fastpath_shared(lock))
+    {
+        ++thread->shared_count;
+        if (! thread->tracked_shared_lock) {
+            thread->tracked_shared_lock = lock;
+            thread->recursion_of_tracked_lock = 1;
+        }
+        else if (thread->tracked_shared_lock == lock)
+            ++thread->recursion_of_tracked_lock;
+        WOLFSENTRY_RETURN_OK;
+    }
+#endif
+
     if (abs_timeout == NULL) {
         for (;;) {
             ret = sem_wait(&lock->sem);
@@ -1670,6 +2193,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfs
         WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
     SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
 
     /* note, recursive shared locking bypasses the check on
      * lock->write_waiter_count, otherwise we'd need to return DEADLOCK_AVERTED
@@ -1688,6 +2212,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfs
         if (sem_post(&lock->sem) < 0)
             WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
+        WOLFSENTRY_LOCK_STATS_WAIT_BEGIN(lock);
+
         if (abs_timeout == NULL) {
             for (;;) {
                 ret = sem_wait(&lock->sem_read_waiters);
@@ -1726,6 +2252,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfs
             if (sem_trywait(&lock->sem_read_waiters) == 0) {
                 if (sem_post(&lock->sem) < 0)
                     WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+                WOLFSENTRY_LOCK_STATS_WAIT_END(lock, shared);
                 WOLFSENTRY_RETURN_OK;
             }
 
@@ -1737,6 +2264,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfs
             WOLFSENTRY_ERROR_RERETURN(ret);
         }
 
+        WOLFSENTRY_LOCK_STATS_WAIT_END(lock, shared);
+
         ++thread->shared_count;
         if (! thread->tracked_shared_lock) {
             thread->tracked_shared_lock = lock;
@@ -1839,6 +2368,23 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfs
         WOLFSENTRY_ERROR_RETURN(INTERNAL_CHECK_FATAL);
 }
 
+#ifdef WOLFSENTRY_LOCK_STATS
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
+    wolfsentry_errcode_t ret;
+    int is_writer;
+
+    if (lock == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+
+    /* the mutex holder is redirected to wolfsentry_lock_mutex_abstimed(), which does its own counting. */
+    is_writer = (WOLFSENTRY_ATOMIC_LOAD(lock->write_lock_holder) == WOLFSENTRY_THREAD_GET_ID);
+    ret = wolfsentry_lock_shared_abstimed_1(lock, thread, abs_timeout, flags);
+    if ((ret >= 0) && (! is_writer))
+        WOLFSENTRY_LOCK_STATS_INCREMENT(lock, shared_acquisitions);
+    WOLFSENTRY_ERROR_RERETURN(ret);
+}
+#endif /* WOLFSENTRY_LOCK_STATS */
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared_timed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, wolfsentry_time_t max_wait, wolfsentry_lock_flags_t flags) {
     wolfsentry_time_t now;
     struct timespec abs_timeout;
@@ -1860,8 +2406,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared(struct wolfsentry_rwl
     return wolfsentry_lock_shared_abstimed(lock, thread, NULL, flags);
 }
 
-WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
+static wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed_1(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
     wolfsentry_errcode_t ret;
+    WOLFSENTRY_LOCK_STATS_WAIT_DECL
 
     if (lock == NULL)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
@@ -1873,6 +2420,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed(struct wolfse
             WOLFSENTRY_ERROR_RETURN(NOT_PERMITTED);
     }
 
+    WOLFSENTRY_LOCK_EPOCH_CONVERT_FOR(lock, thread);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE_FOR(lock, thread);
+
     switch (WOLFSENTRY_ATOMIC_LOAD(lock->state)) {
     case WOLFSENTRY_LOCK_EXCLUSIVE:
         if (WOLFSENTRY_ATOMIC_LOAD(lock->write_lock_holder) == WOLFSENTRY_THREAD_GET_ID) {
@@ -1960,6 +2510,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed(struct wolfse
         WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
     SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
 
     if (lock->state != WOLFSENTRY_LOCK_UNLOCKED) {
         if (abs_timeout == &timespec_deadline_now) {
@@ -1973,6 +2524,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed(struct wolfse
         if (sem_post(&lock->sem) < 0)
             WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
+        WOLFSENTRY_LOCK_STATS_WAIT_BEGIN(lock);
+
         if (abs_timeout == NULL) {
             for (;;) {
                 ret = sem_wait(&lock->sem_write_waiters);
@@ -2014,6 +2567,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed(struct wolfse
                     WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
                 if (thread)
                     ++thread->mutex_and_reservation_count;
+                WOLFSENTRY_LOCK_STATS_WAIT_END(lock, mutex);
                 WOLFSENTRY_RETURN_OK;
             }
 
@@ -2025,6 +2579,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed(struct wolfse
             WOLFSENTRY_ERROR_RERETURN(ret);
         }
 
+        WOLFSENTRY_LOCK_STATS_WAIT_END(lock, mutex);
+
         WOLFSENTRY_ATOMIC_STORE(lock->write_lock_holder, WOLFSENTRY_THREAD_GET_ID);
         if (thread)
             ++thread->mutex_and_reservation_count;
@@ -2051,6 +2607,32 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed(struct wolfse
         WOLFSENTRY_RETURN_OK;
 }
 
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
+#if defined(WOLFSENTRY_LOCK_EPOCH_READERS) || defined(WOLFSENTRY_LOCK_STATS)
+    wolfsentry_errcode_t ret;
+    int was_holder;
+
+    if (lock == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+#ifndef WOLFSENTRY_LOCK_STATS
+    if (lock->epoch_readers == NULL)
+        WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_mutex_abstimed_1(lock, thread, abs_timeout, flags));
+#endif
+
+    was_holder = (WOLFSENTRY_ATOMIC_LOAD(lock->write_lock_holder) == WOLFSENTRY_THREAD_GET_ID);
+    ret = wolfsentry_lock_mutex_abstimed_1(lock, thread, abs_timeout, flags);
+    if ((ret >= 0) && (! was_holder)) {
+        if ((ret = wolfsentry_lock_mutex_obtained(lock, thread, abs_timeout)) < 0)
+            WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    }
+    if (ret >= 0)
+        WOLFSENTRY_LOCK_STATS_INCREMENT(lock, mutex_acquisitions);
+    WOLFSENTRY_ERROR_RERETURN(ret);
+#else
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_mutex_abstimed_1(lock, thread, abs_timeout, flags));
+#endif
+}
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex_timed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, wolfsentry_time_t max_wait, wolfsentry_lock_flags_t flags) {
     wolfsentry_time_t now;
     struct timespec abs_timeout;
@@ -2094,6 +2676,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex2shared(struct wolfsent
     }
 
     SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
 
     if (lock->state != WOLFSENTRY_LOCK_EXCLUSIVE) {
         if (sem_post(&lock->sem) < 0)
@@ -2131,6 +2714,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_mutex2shared(struct wolfsent
     WOLFSENTRY_ATOMIC_STORE(lock->state, WOLFSENTRY_LOCK_SHARED);
     WOLFSENTRY_ATOMIC_STORE(lock->write_lock_holder, WOLFSENTRY_THREAD_NO_ID);
     lock->promoted_at_count = 0;
+    WOLFSENTRY_LOCK_EPOCH_WRITER_DONE(lock);
+    WOLFSENTRY_LOCK_STATS_MUTEX_RELEASED(lock);
 
     /* writer count becomes reader count. */
 
@@ -2180,6 +2765,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_reserve(struct
     if (thread->current_thread_flags & WOLFSENTRY_THREAD_FLAG_READONLY)
         WOLFSENTRY_ERROR_RETURN(NOT_PERMITTED);
 
+    WOLFSENTRY_LOCK_EPOCH_CONVERT_FOR(lock, thread);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE_FOR(lock, thread);
+
     if (WOLFSENTRY_ATOMIC_LOAD(lock->state) == WOLFSENTRY_LOCK_EXCLUSIVE) {
         if (WOLFSENTRY_ATOMIC_LOAD(lock->write_lock_holder) == WOLFSENTRY_THREAD_GET_ID)
             WOLFSENTRY_ERROR_RETURN(ALREADY);
@@ -2198,6 +2786,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_reserve(struct
     }
 
     SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
 
     if (lock->state != WOLFSENTRY_LOCK_SHARED) {
         if (sem_post(&lock->sem) < 0)
@@ -2225,8 +2814,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_reserve(struct
 }
 
 /* if this returns BUSY or TIMED_OUT, the caller still owns a reservation, and must either retry the redemption, or abandon the reservation. */
-WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
+static wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_abstimed_1(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
     wolfsentry_errcode_t ret;
+    WOLFSENTRY_LOCK_STATS_WAIT_DECL
 
     (void)flags;
 
@@ -2270,6 +2860,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_abstimed
         WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
     SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
 
     if (lock->state != WOLFSENTRY_LOCK_SHARED) {
         if (sem_post(&lock->sem) < 0)
@@ -2335,6 +2926,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_abstimed
     if (sem_post(&lock->sem) < 0)
         WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
+    WOLFSENTRY_LOCK_STATS_WAIT_BEGIN(lock);
+
     if (abs_timeout == NULL) {
         for (;;) {
             ret = sem_wait(&lock->sem_read2write_waiters);
@@ -2375,6 +2968,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_abstimed
             if (sem_post(&lock->sem) < 0)
                 WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
             WOLFSENTRY_ATOMIC_STORE(lock->write_lock_holder, WOLFSENTRY_THREAD_GET_ID);
+            WOLFSENTRY_LOCK_STATS_WAIT_END(lock, promotion);
             WOLFSENTRY_RETURN_OK;
         }
 
@@ -2387,6 +2981,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_abstimed
             WOLFSENTRY_ERROR_RERETURN(ret);
     }
 
+    WOLFSENTRY_LOCK_STATS_WAIT_END(lock, promotion);
+
     WOLFSENTRY_ATOMIC_STORE(lock->write_lock_holder, WOLFSENTRY_THREAD_GET_ID);
     WOLFSENTRY_ATOMIC_STORE(lock->read2write_reservation_holder, WOLFSENTRY_THREAD_NO_ID);
 
@@ -2405,6 +3001,35 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_abstimed
     WOLFSENTRY_RETURN_OK;
 }
 
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
+#if defined(WOLFSENTRY_LOCK_EPOCH_READERS) || defined(WOLFSENTRY_LOCK_STATS)
+    wolfsentry_errcode_t ret;
+    int was_holder, was_tracked;
+
+    if (lock == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+#ifndef WOLFSENTRY_LOCK_STATS
+    if (lock->epoch_readers == NULL)
+        WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_shared2mutex_redeem_abstimed_1(lock, thread, abs_timeout, flags));
+#endif
+
+    was_holder = (WOLFSENTRY_ATOMIC_LOAD(lock->write_lock_holder) == WOLFSENTRY_THREAD_GET_ID);
+    was_tracked = (thread != NULL) && (thread->tracked_shared_lock == lock);
+    ret = wolfsentry_lock_shared2mutex_redeem_abstimed_1(lock, thread, abs_timeout, flags);
+    if ((ret >= 0) && (! was_holder)) {
+        if ((ret = wolfsentry_lock_mutex_obtained(lock, thread, abs_timeout)) < 0)
+            WOLFSENTRY_LOCK_EPOCH_UNPROMOTE(lock, thread, was_tracked, 1 /* reservation_too */);
+    }
+    if (ret >= 0)
+        WOLFSENTRY_LOCK_STATS_INCREMENT(lock, promotions);
+    else
+        WOLFSENTRY_LOCK_STATS_INCREMENT(lock, redeem_failures);
+    WOLFSENTRY_ERROR_RERETURN(ret);
+#else
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_shared2mutex_redeem_abstimed_1(lock, thread, abs_timeout, flags));
+#endif
+}
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_redeem_timed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, wolfsentry_time_t max_wait, wolfsentry_lock_flags_t flags) {
     wolfsentry_time_t now;
     struct timespec abs_timeout;
@@ -2452,6 +3077,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abandon(struct
     }
 
     SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
 
     if (lock->state != WOLFSENTRY_LOCK_SHARED) {
         if (sem_post(&lock->sem) < 0)
@@ -2476,8 +3102,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abandon(struct
  * deadlock, then reattempt its transaction with a fresh lock (ideally
  * with a _lock_mutex() at the open).
  */
-WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
+static wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed_1(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
     wolfsentry_errcode_t ret;
+    WOLFSENTRY_LOCK_STATS_WAIT_DECL
 
     if (lock == NULL)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
@@ -2487,6 +3114,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed(struct
     if (thread->current_thread_flags & WOLFSENTRY_THREAD_FLAG_READONLY)
         WOLFSENTRY_ERROR_RETURN(NOT_PERMITTED);
 
+    WOLFSENTRY_LOCK_EPOCH_CONVERT_FOR(lock, thread);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE_FOR(lock, thread);
+
     switch (WOLFSENTRY_ATOMIC_LOAD(lock->state)) {
     case WOLFSENTRY_LOCK_EXCLUSIVE:
         /* silently and cheaply tolerate repeat calls to _shared2mutex*(). */
@@ -2536,6 +3166,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed(struct
         WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
     SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
 
     if (lock->state != WOLFSENTRY_LOCK_SHARED) {
         if (sem_post(&lock->sem) < 0)
@@ -2592,6 +3223,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed(struct
     if (sem_post(&lock->sem) < 0)
         WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
 
+    WOLFSENTRY_LOCK_STATS_WAIT_BEGIN(lock);
+
     if (abs_timeout == NULL) {
         for (;;) {
             ret = sem_wait(&lock->sem_read2write_waiters);
@@ -2641,6 +3274,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed(struct
                 /* reservation count stays in thread->recursion_of_tracked_lock */
                 --thread->shared_count;
             }
+            WOLFSENTRY_LOCK_STATS_WAIT_END(lock, promotion);
             WOLFSENTRY_RETURN_OK;
         }
 
@@ -2654,6 +3288,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed(struct
             WOLFSENTRY_ERROR_RERETURN(ret);
     }
 
+    WOLFSENTRY_LOCK_STATS_WAIT_END(lock, promotion);
+
     WOLFSENTRY_ATOMIC_STORE(lock->write_lock_holder, lock->read2write_reservation_holder);
     WOLFSENTRY_ATOMIC_STORE(lock->read2write_reservation_holder, WOLFSENTRY_THREAD_NO_ID);
 
@@ -2670,6 +3306,35 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed(struct
     WOLFSENTRY_RETURN_OK;
 }
 
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_abstimed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, const struct timespec *abs_timeout, wolfsentry_lock_flags_t flags) {
+#if defined(WOLFSENTRY_LOCK_EPOCH_READERS) || defined(WOLFSENTRY_LOCK_STATS)
+    wolfsentry_errcode_t ret;
+    int was_holder, was_tracked;
+
+    if (lock == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+#ifndef WOLFSENTRY_LOCK_STATS
+    if (lock->epoch_readers == NULL)
+        WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_shared2mutex_abstimed_1(lock, thread, abs_timeout, flags));
+#endif
+
+    was_holder = (WOLFSENTRY_ATOMIC_LOAD(lock->write_lock_holder) == WOLFSENTRY_THREAD_GET_ID);
+    was_tracked = (thread != NULL) && (thread->tracked_shared_lock == lock);
+    ret = wolfsentry_lock_shared2mutex_abstimed_1(lock, thread, abs_timeout, flags);
+    if ((ret >= 0) && (! was_holder)) {
+        if ((ret = wolfsentry_lock_mutex_obtained(lock, thread, abs_timeout)) < 0)
+            WOLFSENTRY_LOCK_EPOCH_UNPROMOTE(lock, thread, was_tracked, 0 /* reservation_too */);
+    }
+    if (ret >= 0)
+        WOLFSENTRY_LOCK_STATS_INCREMENT(lock, promotions);
+    else
+        WOLFSENTRY_LOCK_STATS_INCREMENT(lock, promotion_failures);
+    WOLFSENTRY_ERROR_RERETURN(ret);
+#else
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_shared2mutex_abstimed_1(lock, thread, abs_timeout, flags));
+#endif
+}
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared2mutex_timed(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, wolfsentry_time_t max_wait, wolfsentry_lock_flags_t flags) {
     wolfsentry_time_t now;
     struct timespec abs_timeout;
@@ -2705,6 +3370,13 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_unlock(struct wolfsentry_rwl
 
     WOLFSENTRY_THREAD_ASSERT_NULL_OR_INITED(thread);
 
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    if (thread && thread->epoch_slot && (thread->tracked_shared_lock == lock)) {
+        wolfsentry_lock_epoch_exit(lock, thread);
+        WOLFSENTRY_RETURN_OK;
+    }
+#endif
+
     /* unlocking a recursive mutex, like recursively locking one, can be done lock-free. */
     if ((WOLFSENTRY_ATOMIC_LOAD(lock->write_lock_holder) == WOLFSENTRY_THREAD_GET_ID) &&
         (lock->holder_count.write > 1))
@@ -2715,6 +3387,18 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_unlock(struct wolfsentry_rwl
         WOLFSENTRY_RETURN_OK;
     }
 
+#ifdef WOLFSENTRY_LOCK_SHARED_FASTPATH
+    if (thread && (thread->shared_count > 0) && wolfsentry_lock_fastpath_unlock(lock)) {
+        --thread->shared_count;
+        if (thread->tracked_shared_lock == lock) {
+            --thread->recursion_of_tracked_lock;
+            if (thread->recursion_of_tracked_lock == 0)
+                thread->tracked_shared_lock = NULL;
+        }
+        WOLFSENTRY_RETURN_OK;
+    }
+#endif
+
     if (lock->flags & WOLFSENTRY_LOCK_FLAG_RETAIN_SEMAPHORE)
         WOLFSENTRY_CLEAR_BITS(lock->flags, WOLFSENTRY_LOCK_FLAG_RETAIN_SEMAPHORE);
     else {
@@ -2727,6 +3411,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_unlock(struct wolfsentry_rwl
     }
 
     SHARED_LOCKER_LIST_ASSERT_CONSISTENCY(lock);
+    WOLFSENTRY_LOCK_FASTPATH_CLOSE(lock);
 
     if (lock->state == WOLFSENTRY_LOCK_SHARED) {
         if (thread == NULL) {
@@ -2808,6 +3493,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_unlock(struct wolfsentry_rwl
             WOLFSENTRY_ATOMIC_STORE(lock->state, WOLFSENTRY_LOCK_UNLOCKED);
             WOLFSENTRY_ATOMIC_STORE(lock->write_lock_holder, WOLFSENTRY_THREAD_NO_ID);
             lock->promoted_at_count = 0;
+            WOLFSENTRY_LOCK_EPOCH_WRITER_DONE(lock);
+            WOLFSENTRY_LOCK_STATS_MUTEX_RELEASED(lock);
             ret = WOLFSENTRY_ERROR_ENCODE(OK);
             /* fall through to waiter notification phase. */
         } else {
@@ -2815,6 +3502,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_unlock(struct wolfsentry_rwl
                 lock->promoted_at_count = 0;
                 if ((flags & WOLFSENTRY_LOCK_FLAG_AUTO_DOWNGRADE) && (! thread->tracked_shared_lock)) {
                     WOLFSENTRY_ATOMIC_STORE(lock->state, WOLFSENTRY_LOCK_SHARED);
+                    WOLFSENTRY_LOCK_EPOCH_WRITER_DONE(lock);
+                    WOLFSENTRY_LOCK_STATS_MUTEX_RELEASED(lock);
                     if (flags & (WOLFSENTRY_LOCK_FLAG_TRY_RESERVATION_TOO | WOLFSENTRY_LOCK_FLAG_GET_RESERVATION_TOO)) {
                         WOLFSENTRY_ATOMIC_STORE(lock->read2write_reservation_holder, WOLFSENTRY_THREAD_GET_ID);
                         /* note, not incrementing write_waiter_count, to allow shared lockers to get locks until the redemption phase. */
@@ -2868,6 +3557,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_unlock(struct wolfsentry_rwl
 
   out:
 
+    WOLFSENTRY_LOCK_FASTPATH_REOPEN(lock);
+
     if (sem_post(&lock->sem) < 0)
         WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
     WOLFSENTRY_ERROR_RERETURN(ret);
@@ -2883,8 +3574,23 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_have_shared(struct wolfsentr
 
     (void)flags;
 
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    /* an epoch reader doesn't register in lock->state. */
+    if (thread->epoch_slot && (thread->tracked_shared_lock == lock))
+        WOLFSENTRY_SUCCESS_RETURN(HAVE_READ_LOCK);
+#endif
+
     lock_state = WOLFSENTRY_ATOMIC_LOAD(lock->state);
 
+#ifdef WOLFSENTRY_LOCK_SHARED_FASTPATH
+    /* fast path holders don't register in lock->state. */
+    if ((lock_state == WOLFSENTRY_LOCK_UNLOCKED) &&
+        ((WOLFSENTRY_ATOMIC_LOAD(lock->shared_fastpath) & ~WOLFSENTRY_LOCK_FASTPATH_CLOSED) != 0))
+    {
+        lock_state = WOLFSENTRY_LOCK_SHARED;
+    }
+#endif
+
     if (lock_state != WOLFSENTRY_LOCK_SHARED) {
         if (lock_state == WOLFSENTRY_LOCK_UNINITED)
             WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
@@ -2969,6 +3675,62 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_get_flags(struct wolfsentry_
     WOLFSENTRY_RETURN_OK;
 }
 
+#ifdef WOLFSENTRY_LOCK_STATS
+
+/* the counters are updated without lock->sem, so each field is read (and
+ * optionally cleared) atomically, but the snapshot as a whole isn't.
+ */
+static void wolfsentry_lock_stats_snapshot(struct wolfsentry_rwlock *lock, struct wolfsentry_lock_stats *stats, int reset) {
+    struct wolfsentry_lock_stats discard;
+    int i;
+
+    if (stats == NULL)
+        stats = &discard;
+
+#define WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(field) do {                \
+        if (reset)                                                      \
+            WOLFSENTRY_ATOMIC_RESET(lock->stats.field, &stats->field);  \
+        else                                                            \
+            stats->field = WOLFSENTRY_ATOMIC_LOAD(lock->stats.field);   \
+    } while (0)
+
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(shared_acquisitions);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(mutex_acquisitions);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(shared_contended);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(mutex_contended);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(promotion_contended);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(shared_wait_time);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(mutex_wait_time);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(promotion_wait_time);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(promotions);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(promotion_failures);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(redeem_failures);
+    WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(max_mutex_hold_time);
+    for (i = 0; i < WOLFSENTRY_LOCK_STATS_HISTOGRAM_BUCKETS; ++i) {
+        WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(shared_wait_histogram[i]);
+        WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(mutex_wait_histogram[i]);
+        WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD(promotion_wait_histogram[i]);
+    }
+
+#undef WOLFSENTRY_LOCK_STATS_SNAPSHOT_FIELD
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_get_stats(struct wolfsentry_rwlock *lock, struct wolfsentry_lock_stats *stats) {
+    WOLFSENTRY_LOCK_ASSERT_INITED(lock);
+    if (stats == NULL)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    wolfsentry_lock_stats_snapshot(lock, stats, 0 /* reset */);
+    WOLFSENTRY_RETURN_OK;
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_reset_stats(struct wolfsentry_rwlock *lock) {
+    WOLFSENTRY_LOCK_ASSERT_INITED(lock);
+    wolfsentry_lock_stats_snapshot(lock, NULL, 1 /* reset */);
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* WOLFSENTRY_LOCK_STATS */
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_lock_mutex(WOLFSENTRY_CONTEXT_ARGS_IN) {
     WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_mutex(&wolfsentry->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
 }
@@ -3047,6 +3809,25 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_unlock_and_abandon_reserv
     WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_unlock(&wolfsentry->lock, thread, WOLFSENTRY_LOCK_FLAG_ABANDON_RESERVATION_TOO));
 }
 
+#ifdef WOLFSENTRY_LOCK_STATS
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_lock_get_stats(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_lock_stats *stats)
+{
+    WOLFSENTRY_CONTEXT_ARGS_THREAD_NOT_USED;
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_get_stats(&wolfsentry->lock, stats));
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_lock_reset_stats(
+    WOLFSENTRY_CONTEXT_ARGS_IN)
+{
+    WOLFSENTRY_CONTEXT_ARGS_THREAD_NOT_USED;
+    WOLFSENTRY_ERROR_RERETURN(wolfsentry_lock_reset_stats(&wolfsentry->lock));
+}
+
+#endif /* WOLFSENTRY_LOCK_STATS */
+
 
 #endif /* WOLFSENTRY_THREADSAFE */
 
@@ -3075,6 +3856,23 @@ static wolfsentry_errcode_t wolfsentry_builtin_get_time(void *context, wolfsentr
     WOLFSENTRY_RETURN_OK;
 }
 
+#ifdef CLOCK_REALTIME_COARSE
+
+/* the kernel's tick-granular copy of the realtime clock, read from the vDSO
+ * without a syscall or a hardware counter read.
+ */
+#define WOLFSENTRY_HAVE_BUILTIN_GET_TIME_COARSE
+static wolfsentry_errcode_t wolfsentry_builtin_get_time_coarse(void *context, wolfsentry_time_t *now) {
+    struct timespec ts;
+    (void)context;
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) < 0)
+        WOLFSENTRY_ERROR_RETURN(SYS_OP_FATAL);
+    *now = ((wolfsentry_time_t)ts.tv_sec * (wolfsentry_time_t)1000000) + ((wolfsentry_time_t)ts.tv_nsec / (wolfsentry_time_t)1000);
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* CLOCK_REALTIME_COARSE */
+
 #endif /* FREERTOS */
 
 static wolfsentry_time_t wolfsentry_builtin_diff_time(wolfsentry_time_t later, wolfsentry_time_t earlier) {
@@ -3086,17 +3884,14 @@ static wolfsentry_time_t wolfsentry_builtin_add_time(wolfsentry_time_t start_tim
 }
 
 static wolfsentry_errcode_t wolfsentry_builtin_to_epoch_time(wolfsentry_time_t when, time_t *epoch_secs, long *epoch_nsecs) {
-    if (when / (wolfsentry_time_t)1000000 > MAX_SINT_OF(*epoch_secs))
+    if (! wolfsentry_builtin_to_epoch_time_1(when, epoch_secs, epoch_nsecs))
         WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
-    *epoch_secs = (time_t)(when / (wolfsentry_time_t)1000000);
-    *epoch_nsecs = (long)((when % (wolfsentry_time_t)1000000) * (wolfsentry_time_t)1000);
     WOLFSENTRY_RETURN_OK;
 }
 
 static wolfsentry_errcode_t wolfsentry_builtin_from_epoch_time(time_t epoch_secs, long epoch_nsecs, wolfsentry_time_t *when) {
-    if ((wolfsentry_time_t)epoch_secs > MAX_SINT_OF(*when) / (wolfsentry_time_t)1000000)
+    if (! wolfsentry_builtin_from_epoch_time_1(epoch_secs, epoch_nsecs, when))
         WOLFSENTRY_ERROR_RETURN(NUMERIC_ARG_TOO_BIG);
-    *when = ((wolfsentry_time_t)epoch_secs * (wolfsentry_time_t)1000000) + ((wolfsentry_time_t)epoch_nsecs / (wolfsentry_time_t)1000);
     WOLFSENTRY_RETURN_OK;
 }
 
@@ -3109,7 +3904,12 @@ static const struct wolfsentry_timecbs default_timecbs = {
     .to_epoch_time = wolfsentry_builtin_to_epoch_time,
     .from_epoch_time = wolfsentry_builtin_from_epoch_time,
     .interval_to_seconds = wolfsentry_builtin_to_epoch_time,
-    .interval_from_seconds = wolfsentry_builtin_from_epoch_time
+    .interval_from_seconds = wolfsentry_builtin_from_epoch_time,
+#ifdef WOLFSENTRY_HAVE_BUILTIN_GET_TIME_COARSE
+    .get_time_coarse = wolfsentry_builtin_get_time_coarse
+#else
+    .get_time_coarse = NULL
+#endif
 #else
     NULL,
     wolfsentry_builtin_get_time,
@@ -3118,7 +3918,12 @@ static const struct wolfsentry_timecbs default_timecbs = {
     wolfsentry_builtin_to_epoch_time,
     wolfsentry_builtin_from_epoch_time,
     wolfsentry_builtin_to_epoch_time,
-    wolfsentry_builtin_from_epoch_time
+    wolfsentry_builtin_from_epoch_time,
+#ifdef WOLFSENTRY_HAVE_BUILTIN_GET_TIME_COARSE
+    wolfsentry_builtin_get_time_coarse
+#else
+    NULL
+#endif
 #endif
 };
 
@@ -3194,31 +3999,41 @@ WOLFSENTRY_API_VOID wolfsentry_free_aligned(WOLFSENTRY_CONTEXT_ARGS_IN, void *pt
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_get_time(struct wolfsentry_context *wolfsentry, wolfsentry_time_t *time_p) {
     WOLFSENTRY_RETURN_VALUE(wolfsentry->hpi.timecbs.get_time(wolfsentry->hpi.timecbs.context, time_p));
 }
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_get_time_coarse(struct wolfsentry_context *wolfsentry, wolfsentry_time_t *time_p) {
+    WOLFSENTRY_RETURN_VALUE(wolfsentry->hpi.timecbs.get_time_coarse(wolfsentry->hpi.timecbs.context, time_p));
+}
 WOLFSENTRY_API wolfsentry_time_t wolfsentry_diff_time(struct wolfsentry_context *wolfsentry, wolfsentry_time_t later, wolfsentry_time_t earlier) {
-    WOLFSENTRY_RETURN_VALUE(wolfsentry->hpi.timecbs.diff_time(later, earlier));
+    WOLFSENTRY_RETURN_VALUE(WOLFSENTRY_DIFF_TIME(later, earlier));
 }
 WOLFSENTRY_API wolfsentry_time_t wolfsentry_add_time(struct wolfsentry_context *wolfsentry, wolfsentry_time_t start_time, wolfsentry_time_t time_interval) {
-    WOLFSENTRY_RETURN_VALUE(wolfsentry->hpi.timecbs.add_time(start_time, time_interval));
+    WOLFSENTRY_RETURN_VALUE(WOLFSENTRY_ADD_TIME(start_time, time_interval));
 }
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_to_epoch_time(struct wolfsentry_context *wolfsentry, wolfsentry_time_t when, time_t *epoch_secs, long *epoch_nsecs) {
-    WOLFSENTRY_RETURN_VALUE(wolfsentry->hpi.timecbs.to_epoch_time(when, epoch_secs, epoch_nsecs));
+    WOLFSENTRY_RETURN_VALUE(WOLFSENTRY_TO_EPOCH_TIME(when, epoch_secs, epoch_nsecs));
 }
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_from_epoch_time(struct wolfsentry_context *wolfsentry, time_t epoch_secs, long epoch_nsecs, wolfsentry_time_t *when) {
-    WOLFSENTRY_RETURN_VALUE(wolfsentry->hpi.timecbs.from_epoch_time(epoch_secs, epoch_nsecs, when));
+    WOLFSENTRY_RETURN_VALUE(WOLFSENTRY_FROM_EPOCH_TIME(epoch_secs, epoch_nsecs, when));
 }
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_interval_to_seconds(struct wolfsentry_context *wolfsentry, wolfsentry_time_t howlong, time_t *howlong_secs, long *howlong_nsecs) {
-    WOLFSENTRY_RETURN_VALUE(wolfsentry->hpi.timecbs.interval_to_seconds(howlong, howlong_secs, howlong_nsecs));
+    WOLFSENTRY_RETURN_VALUE(WOLFSENTRY_INTERVAL_TO_SECONDS(howlong, howlong_secs, howlong_nsecs));
 }
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_interval_from_seconds(struct wolfsentry_context *wolfsentry, time_t howlong_secs, long howlong_nsecs, wolfsentry_time_t *howlong) {
-    WOLFSENTRY_RETURN_VALUE(wolfsentry->hpi.timecbs.interval_from_seconds(howlong_secs, howlong_nsecs, howlong));
+    WOLFSENTRY_RETURN_VALUE(WOLFSENTRY_INTERVAL_FROM_SECONDS(howlong_secs, howlong_nsecs, howlong));
 }
 
 WOLFSENTRY_API wolfsentry_ent_id_t wolfsentry_get_object_id(const void *object) {
     WOLFSENTRY_RETURN_VALUE(((const struct wolfsentry_table_ent_header *)object)->id);
 }
 
+WOLFSENTRY_API wolfsentry_hitcount_t wolfsentry_get_object_hitcount(const void *object) {
+    WOLFSENTRY_RETURN_VALUE(WOLFSENTRY_TABLE_ENT_HITCOUNT_GET((const struct wolfsentry_table_ent_header *)object));
+}
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_object_checkout(void *object) {
     wolfsentry_errcode_t ret;
+    if (((struct wolfsentry_table_ent_header *)object)->ent_flags & WOLFSENTRY_TABLE_ENT_FLAG_TRANSIENT)
+        WOLFSENTRY_ERROR_RETURN(INCOMPATIBLE_STATE);
     WOLFSENTRY_REFCOUNT_INCREMENT(((struct wolfsentry_table_ent_header *)object)->refcount, ret);
     WOLFSENTRY_ERROR_RERETURN(ret);
 }
@@ -3322,6 +4137,8 @@ WOLFSENTRY_LOCAL wolfsentry_errcode_t wolfsentry_eventconfig_get_1(
     if (exported == NULL)
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
     *exported = internal->config;
+    /* report the size the caller asked for, so that a get/load round trip is idempotent. */
+    exported->route_private_data_size -= internal->route_private_data_padding;
     WOLFSENTRY_RETURN_OK;
 }
 
@@ -3360,10 +4177,18 @@ static wolfsentry_errcode_t wolfsentry_context_free_1(
     WOLFSENTRY_RERETURN_IF_ERROR(ret);
 #endif
 
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+    if ((*wolfsentry)->routes != NULL)
+        wolfsentry_table_hitcount_slab_free(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), &(*wolfsentry)->routes->header);
+    if ((*wolfsentry)->actions != NULL)
+        wolfsentry_table_hitcount_slab_free(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), &(*wolfsentry)->actions->header);
+#endif
     if ((*wolfsentry)->routes != NULL)
         wolfsentry_route_table_free(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), &(*wolfsentry)->routes);
-    if ((*wolfsentry)->events != NULL)
+    if ((*wolfsentry)->events != NULL) {
+        wolfsentry_event_label_index_free(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), (*wolfsentry)->events);
         WOLFSENTRY_FREE_1((*wolfsentry)->hpi.allocator, (*wolfsentry)->events);
+    }
     if ((*wolfsentry)->actions != NULL)
         WOLFSENTRY_FREE_1((*wolfsentry)->hpi.allocator, (*wolfsentry)->actions);
     if ((*wolfsentry)->user_values != NULL)
@@ -3374,6 +4199,11 @@ static wolfsentry_errcode_t wolfsentry_context_free_1(
     if ((*wolfsentry)->addr_families_byname != NULL)
         WOLFSENTRY_FREE_1((*wolfsentry)->hpi.allocator, (*wolfsentry)->addr_families_byname);
 #endif
+    if ((*wolfsentry)->ents_by_id.buckets != NULL)
+        WOLFSENTRY_FREE_1((*wolfsentry)->hpi.allocator, (*wolfsentry)->ents_by_id.buckets);
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    wolfsentry_slab_free_all(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry));
+#endif
 
 #ifdef WOLFSENTRY_THREADSAFE
     ret = wolfsentry_lock_unlock(&(*wolfsentry)->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE);
@@ -3436,6 +4266,15 @@ static wolfsentry_errcode_t wolfsentry_context_alloc_1(
     memset(*wolfsentry, 0, sizeof **wolfsentry);
 
     (*wolfsentry)->hpi = *hpi;
+#ifdef WOLFSENTRY_CLOCK_BUILTINS
+    (*wolfsentry)->time_arith_is_builtin =
+        (hpi->timecbs.diff_time == wolfsentry_builtin_diff_time) &&
+        (hpi->timecbs.add_time == wolfsentry_builtin_add_time) &&
+        (hpi->timecbs.to_epoch_time == wolfsentry_builtin_to_epoch_time) &&
+        (hpi->timecbs.from_epoch_time == wolfsentry_builtin_from_epoch_time) &&
+        (hpi->timecbs.interval_to_seconds == wolfsentry_builtin_to_epoch_time) &&
+        (hpi->timecbs.interval_from_seconds == wolfsentry_builtin_from_epoch_time);
+#endif
 
     if ((((*wolfsentry)->events = (struct wolfsentry_event_table *)WOLFSENTRY_MALLOC_1(hpi->allocator, sizeof *(*wolfsentry)->events)) == NULL) ||
         (((*wolfsentry)->actions = (struct wolfsentry_action_table *)WOLFSENTRY_MALLOC_1(hpi->allocator, sizeof *(*wolfsentry)->actions)) == NULL) ||
@@ -3447,6 +4286,16 @@ static wolfsentry_errcode_t wolfsentry_context_alloc_1(
 #endif
         )
     {
+        /* the event table owns its label index, and the action and route
+         * tables own their hit counter slabs, so they have to be zeroed before
+         * wolfsentry_context_free_1() looks at them.
+         */
+        if ((*wolfsentry)->events != NULL)
+            memset((*wolfsentry)->events, 0, sizeof *(*wolfsentry)->events);
+        if ((*wolfsentry)->actions != NULL)
+            memset((*wolfsentry)->actions, 0, sizeof *(*wolfsentry)->actions);
+        if ((*wolfsentry)->routes != NULL)
+            memset((*wolfsentry)->routes, 0, sizeof *(*wolfsentry)->routes);
         (void)wolfsentry_context_free_1(WOLFSENTRY_CONTEXT_ARGS_OUT);
         WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
     }
@@ -3473,6 +4322,15 @@ static wolfsentry_errcode_t wolfsentry_context_alloc_1(
         WOLFSENTRY_ERROR_RERETURN(ret);
     }
 
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+    if (((ret = wolfsentry_table_hitcount_slab_init(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), &(*wolfsentry)->actions->header)) < 0) ||
+        ((ret = wolfsentry_table_hitcount_slab_init(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), &(*wolfsentry)->routes->header)) < 0))
+    {
+        (void)wolfsentry_context_free_1(WOLFSENTRY_CONTEXT_ARGS_OUT);
+        WOLFSENTRY_ERROR_RERETURN(ret);
+    }
+#endif
+
     WOLFSENTRY_RETURN_OK;
 }
 
@@ -3543,6 +4401,8 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_init_ex(
         (hpi.timecbs.interval_to_seconds == NULL) ||
         (hpi.timecbs.interval_from_seconds == NULL))
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    if (hpi.timecbs.get_time_coarse == NULL)
+        hpi.timecbs.get_time_coarse = hpi.timecbs.get_time;
 
     if ((hpi.allocator.memalign == NULL) && config && (config->route_private_data_alignment > 0))
         WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
@@ -3550,6 +4410,10 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_init_ex(
 #ifdef WOLFSENTRY_THREADSAFE
     if (flags & WOLFSENTRY_INIT_FLAG_LOCK_SHARED_ERROR_CHECKING)
         lock_flags |= WOLFSENTRY_LOCK_FLAG_SHARED_ERROR_CHECKING;
+    if (flags & WOLFSENTRY_INIT_FLAG_EPOCH_READERS)
+        lock_flags |= WOLFSENTRY_LOCK_FLAG_EPOCH_READERS;
+    if (flags & WOLFSENTRY_INIT_FLAG_SCALABLE_READERS)
+        lock_flags |= WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS;
     if ((ret = wolfsentry_context_alloc_1(&hpi, thread, wolfsentry, lock_flags)) < 0)
         WOLFSENTRY_ERROR_RERETURN(ret);
 #else
@@ -3569,6 +4433,11 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_init_ex(
 
     (*wolfsentry)->config_at_creation = (*wolfsentry)->config;
 
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    if ((ret = wolfsentry_slab_init(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry))) < 0)
+        goto out;
+#endif
+
     if ((ret = wolfsentry_route_table_fallthrough_route_alloc(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), (*wolfsentry)->routes)) < 0)
         goto out;
 
@@ -3600,6 +4469,166 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_init(
             WOLFSENTRY_INIT_FLAG_NONE));
 }
 
+#ifdef WOLFSENTRY_HAVE_MAINTENANCE_WORKER
+
+struct wolfsentry_maintenance_worker {
+    struct wolfsentry_context *wolfsentry;
+    pthread_t thread_id;
+    pthread_mutex_t mutex; /* protects everything below. */
+    pthread_cond_t cond;
+    int stop_p;
+    time_t interval_secs;
+    long interval_nsecs;
+    wolfsentry_time_t budget;
+    wolfsentry_hitcount_t max_items_per_run;
+    struct wolfsentry_maintenance_report totals;
+    wolfsentry_errcode_t last_error;
+};
+
+static void *wolfsentry_maintenance_worker_routine(void *arg) {
+    struct wolfsentry_maintenance_worker *worker = (struct wolfsentry_maintenance_worker *)arg;
+    struct wolfsentry_context *wolfsentry = worker->wolfsentry;
+    WOLFSENTRY_THREAD_HEADER(WOLFSENTRY_THREAD_FLAG_NONE);
+
+    (void)pthread_mutex_lock(&worker->mutex);
+    if (WOLFSENTRY_THREAD_GET_ERROR < 0) {
+        worker->last_error = WOLFSENTRY_THREAD_GET_ERROR;
+        (void)pthread_mutex_unlock(&worker->mutex);
+        return NULL;
+    }
+
+    while (! worker->stop_p) {
+        struct wolfsentry_maintenance_report report;
+        struct timespec deadline;
+        wolfsentry_time_t budget = worker->budget;
+        wolfsentry_hitcount_t max_items = worker->max_items_per_run;
+        wolfsentry_errcode_t ret;
+
+        (void)pthread_mutex_unlock(&worker->mutex);
+        ret = wolfsentry_maintenance_run(WOLFSENTRY_CONTEXT_ARGS_OUT, budget, max_items, &report);
+        (void)pthread_mutex_lock(&worker->mutex);
+
+        if (ret < 0)
+            worker->last_error = ret;
+        else {
+            worker->totals.routes_purged += report.routes_purged;
+            worker->totals.slices += report.slices;
+            worker->totals.elapsed += report.elapsed;
+            worker->totals.complete = report.complete;
+        }
+
+        if (worker->stop_p)
+            break;
+        if (clock_gettime(CLOCK_REALTIME, &deadline) < 0)
+            break;
+        deadline.tv_sec += worker->interval_secs;
+        deadline.tv_nsec += worker->interval_nsecs;
+        if (deadline.tv_nsec >= 1000000000L) {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        /* wakes early on stop, or spuriously, either of which is harmless. */
+        (void)pthread_cond_timedwait(&worker->cond, &worker->mutex, &deadline);
+    }
+
+    (void)pthread_mutex_unlock(&worker->mutex);
+    (void)WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE);
+    return NULL;
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_maintenance_worker_start(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    wolfsentry_time_t interval,
+    wolfsentry_time_t budget,
+    wolfsentry_hitcount_t max_items_per_run)
+{
+    struct wolfsentry_maintenance_worker *worker;
+    time_t interval_secs;
+    long interval_nsecs;
+    wolfsentry_errcode_t ret;
+
+    if (interval <= 0)
+        WOLFSENTRY_ERROR_RETURN(INVALID_ARG);
+    if ((ret = wolfsentry_interval_to_seconds(wolfsentry, interval, &interval_secs, &interval_nsecs)) < 0)
+        WOLFSENTRY_ERROR_RERETURN(ret);
+
+    WOLFSENTRY_MUTEX_OR_RETURN();
+
+    if (wolfsentry->maintenance_worker != NULL)
+        WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(ALREADY);
+
+    if ((worker = (struct wolfsentry_maintenance_worker *)WOLFSENTRY_MALLOC(sizeof *worker)) == NULL)
+        WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(SYS_RESOURCE_FAILED);
+    memset(worker, 0, sizeof *worker);
+    worker->wolfsentry = wolfsentry;
+    worker->interval_secs = interval_secs;
+    worker->interval_nsecs = interval_nsecs;
+    worker->budget = budget;
+    worker->max_items_per_run = max_items_per_run;
+
+    if (pthread_mutex_init(&worker->mutex, NULL) != 0) {
+        WOLFSENTRY_FREE(worker);
+        WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(SYS_OP_FAILED);
+    }
+    if (pthread_cond_init(&worker->cond, NULL) != 0) {
+        (void)pthread_mutex_destroy(&worker->mutex);
+        WOLFSENTRY_FREE(worker);
+        WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(SYS_OP_FAILED);
+    }
+    if (pthread_create(&worker->thread_id, NULL, wolfsentry_maintenance_worker_routine, worker) != 0) {
+        (void)pthread_cond_destroy(&worker->cond);
+        (void)pthread_mutex_destroy(&worker->mutex);
+        WOLFSENTRY_FREE(worker);
+        WOLFSENTRY_ERROR_UNLOCK_AND_RETURN(SYS_OP_FAILED);
+    }
+
+    wolfsentry->maintenance_worker = worker;
+
+    WOLFSENTRY_UNLOCK_AND_RETURN_OK;
+}
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_maintenance_worker_stop(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_maintenance_report *totals)
+{
+    struct wolfsentry_maintenance_worker *worker;
+    wolfsentry_errcode_t ret;
+
+    /* the worker may be waiting for the lock, so joining it with the lock
+     * held would deadlock.
+     */
+    if (wolfsentry_lock_have_either(&wolfsentry->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE) >= 0)
+        WOLFSENTRY_ERROR_RETURN(INCOMPATIBLE_STATE);
+
+    WOLFSENTRY_MUTEX_OR_RETURN();
+    worker = wolfsentry->maintenance_worker;
+    wolfsentry->maintenance_worker = NULL;
+    WOLFSENTRY_UNLOCK_FOR_RETURN();
+
+    if (worker == NULL)
+        WOLFSENTRY_ERROR_RETURN(ITEM_NOT_FOUND);
+
+    (void)pthread_mutex_lock(&worker->mutex);
+    worker->stop_p = 1;
+    (void)pthread_cond_signal(&worker->cond);
+    (void)pthread_mutex_unlock(&worker->mutex);
+    (void)pthread_join(worker->thread_id, NULL);
+
+    if (totals != NULL)
+        *totals = worker->totals;
+    ret = worker->last_error;
+
+    (void)pthread_cond_destroy(&worker->cond);
+    (void)pthread_mutex_destroy(&worker->mutex);
+    WOLFSENTRY_FREE(worker);
+
+    if (ret < 0)
+        WOLFSENTRY_ERROR_RERETURN(ret);
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* WOLFSENTRY_HAVE_MAINTENANCE_WORKER */
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_flush(WOLFSENTRY_CONTEXT_ARGS_IN) {
     wolfsentry_errcode_t ret;
     wolfsentry_action_res_t action_results = WOLFSENTRY_ACTION_RES_NONE;
@@ -3623,6 +4652,11 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_free(WOLFSENTRY_CONTEXT_A
 
     WOLFSENTRY_HAVE_MUTEX_OR_RETURN_EX(*wolfsentry);
 
+#ifdef WOLFSENTRY_HAVE_MAINTENANCE_WORKER
+    if ((*wolfsentry)->maintenance_worker != NULL)
+        WOLFSENTRY_ERROR_RETURN(BUSY);
+#endif
+
     ret = wolfsentry_route_flush_table(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), (*wolfsentry)->routes, &action_results);
     WOLFSENTRY_RERETURN_IF_ERROR(ret);
     ret = wolfsentry_action_flush_all(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry));
@@ -3642,7 +4676,12 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_free(WOLFSENTRY_CONTEXT_A
 
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_IN_EX(struct wolfsentry_context **wolfsentry)) {
 #ifdef WOLFSENTRY_THREADSAFE
-    wolfsentry_errcode_t ret = WOLFSENTRY_MUTEX_EX(*wolfsentry);
+    wolfsentry_errcode_t ret;
+#ifdef WOLFSENTRY_HAVE_MAINTENANCE_WORKER
+    if ((*wolfsentry)->maintenance_worker != NULL)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_maintenance_worker_stop(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*wolfsentry), NULL /* totals */));
+#endif
+    ret = WOLFSENTRY_MUTEX_EX(*wolfsentry);
     WOLFSENTRY_RERETURN_IF_ERROR(ret);
     if ((*wolfsentry)->lock.holder_count.write != 1)
         WOLFSENTRY_ERROR_UNLOCK_AND_RETURN_EX(*wolfsentry, BUSY);
@@ -3716,7 +4755,10 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_clone(
         (*clone)->config_at_creation = wolfsentry->config_at_creation;
     }
 
-    WOLFSENTRY_TABLE_HEADER_RESET((*clone)->ents_by_id);
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    if ((ret = wolfsentry_slab_init(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(*clone))) < 0)
+        goto out;
+#endif
 
     if ((ret = wolfsentry_table_clone(WOLFSENTRY_CONTEXT_ARGS_OUT, &wolfsentry->actions->header, *clone, &(*clone)->actions->header, flags)) < 0)
         goto out;
@@ -3802,6 +4844,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_exchange(WOLFSENTRY_CONTE
     wolfsentry->addr_families_byname = wolfsentry2->addr_families_byname;
 #endif
     wolfsentry->ents_by_id = wolfsentry2->ents_by_id;
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    wolfsentry->slab = wolfsentry2->slab;
+#endif
 
     wolfsentry2->mk_id_cb_state = scratch.mk_id_cb_state;
     wolfsentry2->config = scratch.config;
@@ -3816,6 +4861,9 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_exchange(WOLFSENTRY_CONTE
 #endif
 
     wolfsentry2->ents_by_id = scratch.ents_by_id;
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    wolfsentry2->slab = scratch.slab;
+#endif
 
     ret = WOLFSENTRY_ERROR_ENCODE(OK);
 
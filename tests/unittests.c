@@ -248,6 +248,37 @@ static void *rd2wr_reserved_routine(struct rwlock_args *args) {
     return 0;
 }
 
+#ifdef WOLFSENTRY_HAVE_GNU_ATOMICS
+/* runs while the caller holds args->lock through an epoch read slot -- each
+ * deadline-bound acquisition gets the lock, then fails waiting for the slot to
+ * empty, and must leave the lock as it found it.
+ */
+static void *epoch_timed_wr_routine(struct rwlock_args *args) {
+    WOLFSENTRY_THREAD_HEADER(WOLFSENTRY_THREAD_FLAG_NONE);
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_GET_ERROR);
+
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(BUSY, wolfsentry_lock_mutex_timed(args->lock, thread, 0, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(TIMED_OUT, wolfsentry_lock_mutex_timed(args->lock, thread, args->max_wait, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(LACKING_MUTEX, wolfsentry_lock_have_mutex(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(TIMED_OUT, wolfsentry_lock_shared2mutex_timed(args->lock, thread, args->max_wait, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_READ_LOCK, wolfsentry_lock_have_shared(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(args->lock, thread, WOLFSENTRY_LOCK_FLAG_GET_RESERVATION_TOO));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(BUSY, wolfsentry_lock_shared2mutex_redeem_timed(args->lock, thread, 0, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(TIMED_OUT, wolfsentry_lock_shared2mutex_redeem_timed(args->lock, thread, args->max_wait, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_have_shared2mutex_reservation(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared2mutex_abandon(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+    INCREMENT_PHASE(args);
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+    return 0;
+}
+#endif
+
 #define MAX_WAIT 100000
 #define WAIT_FOR_PHASE(x, atleast) do { int cur_phase; WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_mutex_lock(&(x).thread_phase_lock)); cur_phase = (x).thread_phase; WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_mutex_unlock(&(x).thread_phase_lock)); if (cur_phase >= (atleast)) break; usleep(1000); } while(1)
 
@@ -650,6 +681,22 @@ usleep(10000);
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared2mutex_redeem_timed(lock, thread, 1000, WOLFSENTRY_LOCK_FLAG_NONE));
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
 
+    /* recursive shared lock, then promotion by a plain mutex call, from a
+     * quiescent lock (the shared fast path, where available).
+     */
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_READ_LOCK, wolfsentry_lock_have_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(INCOMPATIBLE_STATE, wolfsentry_lock_destroy(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_MUTEX, wolfsentry_lock_have_mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(LACKING_READ_LOCK, wolfsentry_lock_have_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
     /* cursory exercise of null thread calls. */
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_destroy(lock, NULL /* thread */, test_rw_locks_WOLFSENTRY_LOCK_FLAGS));
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_init(wolfsentry_get_hpi(wolfsentry), NULL /* thread */, lock,
@@ -664,6 +711,215 @@ usleep(10000);
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
 
+#ifdef WOLFSENTRY_HAVE_GNU_ATOMICS
+    /* epoch readers: a read-only thread holds the lock shared with no
+     * registration in the lock state, and a writer waits for it to leave.
+     */
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_destroy(lock, thread, test_rw_locks_WOLFSENTRY_LOCK_FLAGS));
+    TEST_INVALID_ARGS(wolfsentry_lock_init(wolfsentry_get_hpi(wolfsentry), thread, lock,
+                                           WOLFSENTRY_LOCK_FLAG_EPOCH_READERS | WOLFSENTRY_LOCK_FLAG_PSHARED));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_init(wolfsentry_get_hpi(wolfsentry), thread, lock,
+                                                    test_rw_locks_WOLFSENTRY_LOCK_FLAGS | WOLFSENTRY_LOCK_FLAG_EPOCH_READERS));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_set_thread_readonly(thread));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_READ_LOCK, wolfsentry_lock_have_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(NOT_PERMITTED, wolfsentry_lock_mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(INCOMPATIBLE_STATE, wolfsentry_set_thread_readwrite(thread));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(INCOMPATIBLE_STATE, wolfsentry_lock_destroy(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+    /* a writer with a deadline gives up on the epoch reader in time. */
+    thread3_args.thread_phase = 0;
+    thread3_args.max_wait = 1000;
+    WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_create(&thread3, 0 /* attr */, (void *(*)(void *))epoch_timed_wr_routine, (void *)&thread3_args));
+    WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_join(thread3, 0 /* retval */));
+    WAIT_FOR_PHASE(thread3_args, 1);
+
+    measured_sequence_i = 0;
+    thread4_args.thread_phase = 0;
+    thread4_args.max_wait = -1;
+    WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_create(&thread4, 0 /* attr */, (void *(*)(void *))wr_routine, (void *)&thread4_args));
+    WAIT_FOR_PHASE(thread4_args, 1);
+    usleep(20000);
+    {
+        int cur_phase;
+        WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_mutex_lock(&thread4_args.thread_phase_lock));
+        cur_phase = thread4_args.thread_phase;
+        WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_mutex_unlock(&thread4_args.thread_phase_lock));
+        if (cur_phase != 1) {
+            WOLFSENTRY_WARN("writer got mutex at phase %d while epoch reader held lock\n", cur_phase);
+            WOLFSENTRY_ERROR_RETURN(NOT_OK);
+        }
+    }
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_READ_LOCK, wolfsentry_lock_have_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_join(thread4, 0 /* retval */));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_set_thread_readwrite(thread));
+
+    /* read-write threads still take the semaphore path on an epoch lock. */
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared2mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_MUTEX, wolfsentry_lock_have_mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+    {
+        struct wolfsentry_context *epoch_wolfsentry;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_init_ex(wolfsentry_build_settings,
+                                                      WOLFSENTRY_TEST_HPI,
+                                                      thread,
+                                                      &config,
+                                                      &epoch_wolfsentry,
+                                                      test_rw_locks_WOLFSENTRY_INIT_FLAGS | WOLFSENTRY_INIT_FLAG_EPOCH_READERS));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_set_thread_readonly(thread));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(epoch_wolfsentry, thread));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(epoch_wolfsentry, thread));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_set_thread_readwrite(thread));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(&epoch_wolfsentry, thread));
+    }
+
+    /* scalable readers: read-write threads use the slots too, and are moved
+     * onto the semaphore path when they promote or reserve.
+     */
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_destroy(lock, thread, test_rw_locks_WOLFSENTRY_LOCK_FLAGS));
+    TEST_INVALID_ARGS(wolfsentry_lock_init(wolfsentry_get_hpi(wolfsentry), thread, lock,
+                                           WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS | WOLFSENTRY_LOCK_FLAG_PSHARED));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_init(wolfsentry_get_hpi(wolfsentry), thread, lock,
+                                                    test_rw_locks_WOLFSENTRY_LOCK_FLAGS | WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_READ_LOCK, wolfsentry_lock_have_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    /* a slot holder can't go read-write, which shows the hold is in a slot. */
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_set_thread_readonly(thread));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(INCOMPATIBLE_STATE, wolfsentry_set_thread_readwrite(thread));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_set_thread_readwrite(thread));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared2mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_MUTEX, wolfsentry_lock_have_mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(LACKING_READ_LOCK, wolfsentry_lock_have_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_GET_RESERVATION_TOO));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared2mutex_redeem(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_UNLESS_EXPECTED_SUCCESS(HAVE_MUTEX, wolfsentry_lock_have_mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    measured_sequence_i = 0;
+    thread4_args.thread_phase = 0;
+    thread4_args.max_wait = -1;
+    WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_create(&thread4, 0 /* attr */, (void *(*)(void *))wr_routine, (void *)&thread4_args));
+    WAIT_FOR_PHASE(thread4_args, 1);
+    usleep(20000);
+    {
+        int cur_phase;
+        WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_mutex_lock(&thread4_args.thread_phase_lock));
+        cur_phase = thread4_args.thread_phase;
+        WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_mutex_unlock(&thread4_args.thread_phase_lock));
+        if (cur_phase != 1) {
+            WOLFSENTRY_WARN("writer got mutex at phase %d while scalable reader held lock\n", cur_phase);
+            WOLFSENTRY_ERROR_RETURN(NOT_OK);
+        }
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_join(thread4, 0 /* retval */));
+
+    /* the writer had to wait, so reader bias is revoked for a while, and
+     * shared locks go through the semaphore path.
+     */
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_set_thread_readonly(thread));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_set_thread_readwrite(thread));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+    {
+        struct wolfsentry_context *scalable_wolfsentry;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_init_ex(wolfsentry_build_settings,
+                                                      WOLFSENTRY_TEST_HPI,
+                                                      thread,
+                                                      &config,
+                                                      &scalable_wolfsentry,
+                                                      test_rw_locks_WOLFSENTRY_INIT_FLAGS | WOLFSENTRY_INIT_FLAG_SCALABLE_READERS));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(scalable_wolfsentry, thread));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(scalable_wolfsentry, thread));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(&scalable_wolfsentry, thread));
+    }
+#endif /* WOLFSENTRY_HAVE_GNU_ATOMICS */
+
+#ifdef WOLFSENTRY_LOCK_STATS
+    {
+        struct wolfsentry_lock_stats stats;
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_destroy(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_init(wolfsentry_get_hpi(wolfsentry), thread, lock,
+                                                        test_rw_locks_WOLFSENTRY_LOCK_FLAGS));
+
+        TEST_INVALID_ARGS(wolfsentry_lock_get_stats(lock, NULL));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared2mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(INCOMPATIBLE_STATE, wolfsentry_lock_shared2mutex_redeem(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_get_stats(lock, &stats));
+        WOLFSENTRY_EXIT_ON_FALSE(stats.shared_acquisitions == 2);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.mutex_acquisitions == 1);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.promotions == 1);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.promotion_failures == 0);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.redeem_failures == 1);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.shared_contended == 0);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.mutex_contended == 0);
+
+        /* a shared locker waits out a writer that holds the lock for 10ms. */
+        measured_sequence_i = 0;
+        thread4_args.thread_phase = 0;
+        thread4_args.max_wait = -1;
+        WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_create(&thread4, 0 /* attr */, (void *(*)(void *))wr_routine, (void *)&thread4_args));
+        WAIT_FOR_PHASE(thread4_args, 2);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_join(thread4, 0 /* retval */));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_get_stats(lock, &stats));
+        WOLFSENTRY_EXIT_ON_FALSE(stats.shared_acquisitions == 3);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.mutex_acquisitions == 2);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.shared_contended == 1);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.shared_wait_time > 0);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.max_mutex_hold_time >= 5000);
+        {
+            int i;
+            wolfsentry_hitcount_t histogram_total = 0;
+            for (i = 0; i < WOLFSENTRY_LOCK_STATS_HISTOGRAM_BUCKETS; ++i)
+                histogram_total += stats.shared_wait_histogram[i];
+            WOLFSENTRY_EXIT_ON_FALSE(histogram_total == 1);
+        }
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_reset_stats(lock));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_get_stats(lock, &stats));
+        WOLFSENTRY_EXIT_ON_FALSE(stats.shared_acquisitions == 0);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.shared_contended == 0);
+        WOLFSENTRY_EXIT_ON_FALSE(stats.max_mutex_hold_time == 0);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_get_stats(WOLFSENTRY_CONTEXT_ARGS_OUT, &stats));
+        WOLFSENTRY_EXIT_ON_FALSE(stats.shared_acquisitions >= 1);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_reset_stats(WOLFSENTRY_CONTEXT_ARGS_OUT));
+    }
+#endif /* WOLFSENTRY_LOCK_STATS */
+
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_free(&lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
 
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(&wolfsentry, thread));
@@ -690,6 +946,270 @@ TEST_SKIP(test_rw_locks)
 #define PRIVATE_DATA_ALIGNMENT 16
 #endif
 
+/* allocator shim that counts calls through to the real allocator, to check
+ * that steady-state dispatch is allocation-free.  _wolfsentry_get_n_mallocs()
+ * only tracks outstanding allocations, so it can't see a malloc()/free() pair
+ * within a single call.
+ */
+static struct wolfsentry_allocator counted_allocator;
+static int n_allocator_calls = 0;
+
+static void *counting_malloc(WOLFSENTRY_CONTEXT_ARGS_IN_EX(void *context), size_t size) {
+    ++n_allocator_calls;
+    return counted_allocator.malloc(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(context), size);
+}
+
+static void *counting_realloc(WOLFSENTRY_CONTEXT_ARGS_IN_EX(void *context), void *ptr, size_t size) {
+    ++n_allocator_calls;
+    return counted_allocator.realloc(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(context), ptr, size);
+}
+
+static void *counting_memalign(WOLFSENTRY_CONTEXT_ARGS_IN_EX(void *context), size_t alignment, size_t size) {
+    ++n_allocator_calls;
+    return counted_allocator.memalign(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(context), alignment, size);
+}
+
+static void counting_allocator_install(struct wolfsentry_context *wolfsentry) {
+    counted_allocator = wolfsentry->hpi.allocator;
+    wolfsentry->hpi.allocator.malloc = counting_malloc;
+    if (counted_allocator.realloc)
+        wolfsentry->hpi.allocator.realloc = counting_realloc;
+    if (counted_allocator.memalign)
+        wolfsentry->hpi.allocator.memalign = counting_memalign;
+    n_allocator_calls = 0;
+}
+
+static void counting_allocator_remove(struct wolfsentry_context *wolfsentry) {
+    wolfsentry->hpi.allocator = counted_allocator;
+}
+
+/* tries to retain trigger_route, and records the result of the attempt. */
+static wolfsentry_errcode_t retain_trigger_route_ret;
+
+static wolfsentry_errcode_t retain_trigger_route_action(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    const struct wolfsentry_action *action,
+    void *handler_arg,
+    void *caller_arg,
+    const struct wolfsentry_event *trigger_event,
+    wolfsentry_action_type_t action_type,
+    const struct wolfsentry_route *trigger_route,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *rule_route,
+    wolfsentry_action_res_t *action_results)
+{
+    WOLFSENTRY_CONTEXT_ARGS_NOT_USED;
+    (void)action;
+    (void)handler_arg;
+    (void)caller_arg;
+    (void)trigger_event;
+    (void)action_type;
+    (void)route_table;
+    (void)rule_route;
+    (void)action_results;
+    retain_trigger_route_ret = wolfsentry_object_checkout((void *)(uintptr_t)trigger_route);
+    if (retain_trigger_route_ret >= 0)
+        WOLFSENTRY_WARN_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, (struct wolfsentry_route *)(uintptr_t)trigger_route, NULL /* action_results */));
+    WOLFSENTRY_RETURN_OK;
+}
+
+/* the accelerated address prefix comparison must agree with the scalar loop
+ * for a difference at every bit position, compared over every length, from
+ * an unaligned start.
+ */
+static wolfsentry_errcode_t test_addr_common_prefix(void) {
+    byte a_buf[17], b_buf[17];
+    byte *a = a_buf + 1, *b = b_buf + 1;
+    unsigned int flip, n_bits;
+
+    for (n_bits = 0; n_bits < 16; ++n_bits)
+        a[n_bits] = (byte)(0x5aU + (n_bits * 37U));
+    for (flip = 0; flip <= 128; ++flip) {
+        memcpy(b, a, 16);
+        if (flip < 128)
+            b[flip >> 3U] = (byte)(b[flip >> 3U] ^ (0x80U >> (flip & 7U)));
+        for (n_bits = 0; n_bits <= 128; ++n_bits) {
+            unsigned int expected = wolfsentry_addr_common_prefix_scalar(a, b, n_bits);
+            unsigned int common_ab = wolfsentry_addr_common_prefix(a, b, n_bits);
+            unsigned int common_ba = wolfsentry_addr_common_prefix(b, a, n_bits);
+            WOLFSENTRY_EXIT_ON_FALSE(expected == ((flip < n_bits) ? flip : n_bits));
+            WOLFSENTRY_EXIT_ON_FALSE((common_ab == expected) && (common_ba == expected));
+        }
+    }
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#ifdef WOLFSENTRY_ROUTE_SORT_KEYS
+
+/* the table order of two routes without parent events, field by field, as
+ * wolfsentry_route_key_cmp_1() defines it.
+ */
+static int test_route_exports_addr_cmp(const byte *a, wolfsentry_addr_bits_t a_len, const byte *b, wolfsentry_addr_bits_t b_len) {
+    wolfsentry_addr_bits_t min_len = (a_len < b_len) ? a_len : b_len;
+    int cmp = memcmp(a, b, WOLFSENTRY_BITS_TO_BYTES((size_t)min_len));
+    if (cmp)
+        return (cmp < 0) ? -1 : 1;
+    if (a_len == b_len)
+        return 0;
+    return (a_len < b_len) ? -1 : 1;
+}
+
+static int test_route_exports_cmp(const struct wolfsentry_route_exports *a, const struct wolfsentry_route_exports *b) {
+    int cmp;
+    if (a->sa_family != b->sa_family)
+        return (a->sa_family < b->sa_family) ? -1 : 1;
+    if ((cmp = test_route_exports_addr_cmp(a->remote_address, a->remote.addr_len, b->remote_address, b->remote.addr_len)))
+        return cmp;
+    if (a->sa_proto != b->sa_proto)
+        return (a->sa_proto < b->sa_proto) ? -1 : 1;
+    if (a->local.sa_port != b->local.sa_port)
+        return (a->local.sa_port < b->local.sa_port) ? -1 : 1;
+    if ((cmp = test_route_exports_addr_cmp(a->local_address, a->local.addr_len, b->local_address, b->local.addr_len)))
+        return cmp;
+    if (a->remote.sa_port != b->remote.sa_port)
+        return (a->remote.sa_port < b->remote.sa_port) ? -1 : 1;
+    if (a->remote.interface != b->remote.interface)
+        return (a->remote.interface < b->remote.interface) ? -1 : 1;
+    if (a->local.interface != b->local.interface)
+        return (a->local.interface < b->local.interface) ? -1 : 1;
+    if ((a->flags & WOLFSENTRY_ROUTE_IMMUTABLE_FLAGS) != (b->flags & WOLFSENTRY_ROUTE_IMMUTABLE_FLAGS))
+        return ((a->flags & WOLFSENTRY_ROUTE_IMMUTABLE_FLAGS) < (b->flags & WOLFSENTRY_ROUTE_IMMUTABLE_FLAGS)) ? -1 : 1;
+    return 0;
+}
+
+/* IPv4 and IPv6 routes are ordered by their sort keys, which must agree with
+ * the field-by-field order, across prefix lengths that differ only in
+ * trailing zero bytes, wildcarded fields, and a family-wildcard route that
+ * has no sort key.  every route must then be found again exactly.
+ */
+static wolfsentry_errcode_t test_route_sort_keys(void) {
+    static const wolfsentry_addr_bits_t ipv4_lens[] = { 0, 8, 12, 16, 24, 32 };
+    static const wolfsentry_addr_bits_t ipv6_lens[] = { 0, 8, 48, 64, 120, 128 };
+    wolfsentry_errcode_t ret;
+    struct wolfsentry_context *sort_context;
+    wolfsentry_action_res_t action_results;
+    struct wolfsentry_route_exports route_exports, prev_exports[2];
+    struct wolfsentry_cursor *cursor;
+    struct wolfsentry_route *route;
+    struct {
+        struct wolfsentry_sockaddr sa;
+        byte addr_buf[16];
+    } sort_remote, sort_local;
+    wolfsentry_ent_id_t sort_ids[300];
+    byte remote_addr[16], local_addr[16];
+    uint32_t prng = 11;
+    unsigned int n, i, n_inserted = 0, n_seen = 0;
+    WOLFSENTRY_THREAD_HEADER_CHECKED(WOLFSENTRY_THREAD_FLAG_NONE);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(
+        wolfsentry_init_ex(
+            wolfsentry_build_settings,
+            WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+            NULL /* config */,
+            &sort_context,
+            WOLFSENTRY_INIT_FLAG_NONE));
+
+    memset(&route_exports, 0, sizeof route_exports);
+    route_exports.remote_address = remote_addr;
+    route_exports.local_address = local_addr;
+
+    for (n = 0; n < length_of_array(sort_ids); ++n) {
+        /* few distinct values per field, so that ties reach every field. */
+        prng = (prng * 1103515245U) + 12345U;
+        memset(remote_addr, 0, sizeof remote_addr);
+        memset(local_addr, 0, sizeof local_addr);
+        if (n == 0) {
+            route_exports.flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN | WOLFSENTRY_ROUTE_FLAG_SA_FAMILY_WILDCARD | WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD | WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD | WOLFSENTRY_ROUTE_FLAG_SA_PROTO_WILDCARD | WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_PORT_WILDCARD | WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_PORT_WILDCARD;
+            route_exports.sa_family = AF_INET;
+            route_exports.remote.addr_len = route_exports.local.addr_len = 0;
+        } else {
+            route_exports.flags = ((prng >> 8U) & 0x1U) ? WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN : WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT;
+            if (((prng >> 9U) & 0x7U) == 0)
+                route_exports.flags |= WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_PORT_WILDCARD;
+            if ((prng >> 12U) & 0x1U) {
+                route_exports.sa_family = AF_INET;
+                route_exports.remote.addr_len = ipv4_lens[((prng >> 13U) & 0x7U) % length_of_array(ipv4_lens)];
+                route_exports.local.addr_len = ipv4_lens[((prng >> 16U) & 0x1U) ? 5 : 3];
+            } else {
+                route_exports.sa_family = AF_INET6;
+                route_exports.remote.addr_len = ipv6_lens[((prng >> 13U) & 0x7U) % length_of_array(ipv6_lens)];
+                route_exports.local.addr_len = ipv6_lens[((prng >> 16U) & 0x1U) ? 5 : 3];
+            }
+            /* the first byte and the last byte of the longest prefixes vary,
+             * and everything between is zero, so that a short prefix often
+             * matches the leading bytes of a longer one.
+             */
+            if (route_exports.remote.addr_len > 0) {
+                remote_addr[0] = (byte)(0x20U + ((prng >> 17U) & 0x1U));
+                if (route_exports.remote.addr_len % 32 == 0)
+                    remote_addr[(route_exports.remote.addr_len / 8U) - 1U] = (byte)((prng >> 18U) & 0x3U);
+            }
+            local_addr[0] = 0xc0;
+            local_addr[(route_exports.local.addr_len / 8U) - 1U] |= (byte)((prng >> 20U) & 0x1U);
+        }
+        route_exports.sa_proto = ((prng >> 21U) & 0x1U) ? IPPROTO_TCP : IPPROTO_UDP;
+        route_exports.local.sa_port = (wolfsentry_port_t)(((prng >> 22U) & 0x1U) ? 443 : 80);
+        route_exports.remote.sa_port = (wolfsentry_port_t)(1024U + ((prng >> 23U) & 0x3U));
+        route_exports.remote.interface = (byte)((prng >> 25U) & 0x1U);
+        ret = wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context), sort_context->routes, NULL /* caller_arg */, &route_exports, &sort_ids[n], &action_results);
+        if (ret < 0) {
+            WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(ret, ITEM_ALREADY_PRESENT));
+            sort_ids[n] = WOLFSENTRY_ENT_ID_NONE;
+        } else
+            ++n_inserted;
+    }
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context)));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_iterate_start(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context), sort_context->routes, &cursor));
+    for (ret = wolfsentry_route_table_iterate_current(sort_context->routes, cursor, &route);
+         ret >= 0;
+         ret = wolfsentry_route_table_iterate_next(sort_context->routes, cursor, &route)) {
+        struct wolfsentry_route_exports *cur_exports = &prev_exports[n_seen & 1U];
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_export(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context), route, cur_exports));
+        if (n_seen > 0)
+            WOLFSENTRY_EXIT_ON_FALSE(test_route_exports_cmp(&prev_exports[(n_seen - 1U) & 1U], cur_exports) < 0);
+        ++n_seen;
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_iterate_end(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context), sort_context->routes, &cursor));
+
+    memset(&sort_remote, 0, sizeof sort_remote);
+    memset(&sort_local, 0, sizeof sort_local);
+    for (n = 0; n < length_of_array(sort_ids); ++n) {
+        wolfsentry_route_flags_t sort_inexact_matches;
+        struct wolfsentry_route *found_route;
+        if (sort_ids[n] == WOLFSENTRY_ENT_ID_NONE)
+            continue;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context), sort_ids[n], (struct wolfsentry_table_ent_header **)&route));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_export(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context), route, &route_exports));
+        sort_remote.sa.sa_family = sort_local.sa.sa_family = route_exports.sa_family;
+        sort_remote.sa.sa_proto = sort_local.sa.sa_proto = route_exports.sa_proto;
+        sort_remote.sa.sa_port = route_exports.remote.sa_port;
+        sort_local.sa.sa_port = route_exports.local.sa_port;
+        sort_remote.sa.addr_len = route_exports.remote.addr_len;
+        sort_local.sa.addr_len = route_exports.local.addr_len;
+        sort_remote.sa.interface = route_exports.remote.interface;
+        sort_local.sa.interface = route_exports.local.interface;
+        i = WOLFSENTRY_BITS_TO_BYTES((unsigned int)route_exports.remote.addr_len);
+        memcpy(sort_remote.sa.addr, route_exports.remote_address, i);
+        i = WOLFSENTRY_BITS_TO_BYTES((unsigned int)route_exports.local.addr_len);
+        memcpy(sort_local.sa.addr, route_exports.local_address, i);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context), sort_context->routes, &sort_remote.sa, &sort_local.sa, route_exports.flags, NULL /* event_label */, 0 /* event_label_len */, 1 /* exact_p */, &sort_inexact_matches, &found_route));
+        WOLFSENTRY_EXIT_ON_FALSE(found_route == route);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context), found_route, NULL /* action_results */));
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(sort_context)));
+    WOLFSENTRY_EXIT_ON_FALSE(n_seen == n_inserted);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&sort_context)));
+
+    WOLFSENTRY_THREAD_TAILER_CHECKED(WOLFSENTRY_THREAD_FLAG_NONE);
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* WOLFSENTRY_ROUTE_SORT_KEYS */
+
 static int test_static_routes (void) {
 
     struct wolfsentry_context *wolfsentry;
@@ -737,6 +1257,8 @@ static int test_static_routes (void) {
     int prefixlen;
     byte *private_data;
     size_t private_data_size;
+    struct wolfsentry_event *pinned_event;
+    wolfsentry_refcount_t pinned_event_refcount;
 
     WOLFSENTRY_THREAD_HEADER_CHECKED(WOLFSENTRY_THREAD_FLAG_NONE);
 
@@ -889,6 +1411,106 @@ static int test_static_routes (void) {
             USED_FALLBACK));
     WOLFSENTRY_EXIT_ON_FALSE(inexact_matches == (WOLFSENTRY_ROUTE_WILDCARD_FLAGS | WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD));
 
+    /* every route so far has a literal remote address, so a target with an
+     * unrelated remote address is turned away by the negative filter, and
+     * the hits below must get past it.
+     */
+    WOLFSENTRY_EXIT_ON_FALSE((main_routes->negative_filter != NULL) && (main_routes->n_unfilterable_routes == 0));
+    memcpy(remote.sa.addr,"\11\11\11\11",sizeof remote.addr_buf);
+    WOLFSENTRY_EXIT_ON_FALSE(
+        WOLFSENTRY_SUCCESS_CODE_IS(
+            wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                            &route_id, &inexact_matches, &action_results),
+            USED_FALLBACK));
+
+    /* once warmed up, dispatch makes no allocator calls, either to a matching
+     * route or through to the fallthrough route.
+     */
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_event_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, "static-route-test-event", -1 /* label_len */, 10 /* priority */, NULL /* config */, WOLFSENTRY_EVENT_FLAG_NONE, NULL /* id */));
+    WOLFSENTRY_EXIT_ON_FALSE(wolfsentry->events->label_buckets != NULL);
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_event_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, "static-route-test-event", -1 /* label_len */, &pinned_event));
+    pinned_event_refcount = pinned_event->header.refcount;
+    counting_allocator_install(wolfsentry);
+    {
+        int i;
+        for (i = 0; i < 3; ++i) {
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, "static-route-test-event", -1 /* event_label_len */, NULL /* caller_arg */,
+                                                                   &route_id, &inexact_matches, &action_results));
+            WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(action_results, WOLFSENTRY_ACTION_RES_FALLTHROUGH));
+            WOLFSENTRY_EXIT_ON_FALSE(route_id == WOLFSENTRY_ENT_ID_NONE);
+
+            /* a pinned event handle gets the same result as its label. */
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch_with_event(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, pinned_event, NULL /* caller_arg */,
+                                                                              &route_id, &inexact_matches, &action_results));
+            WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(action_results, WOLFSENTRY_ACTION_RES_FALLTHROUGH));
+            WOLFSENTRY_EXIT_ON_FALSE(route_id == WOLFSENTRY_ENT_ID_NONE);
+            WOLFSENTRY_EXIT_ON_FALSE(pinned_event->header.refcount == pinned_event_refcount);
+
+            memcpy(remote.sa.addr,"\3\4\5\6",sizeof remote.addr_buf);
+            WOLFSENTRY_CLEAR_BITS(flags, WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN);
+            WOLFSENTRY_SET_BITS(flags, WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                   &route_id, &inexact_matches, &action_results));
+            WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(action_results, WOLFSENTRY_ACTION_RES_ACCEPT));
+            WOLFSENTRY_EXIT_ON_FALSE(route_id != WOLFSENTRY_ENT_ID_NONE);
+
+            memcpy(remote.sa.addr,"\11\11\11\11",sizeof remote.addr_buf);
+            WOLFSENTRY_CLEAR_BITS(flags, WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT);
+            WOLFSENTRY_SET_BITS(flags, WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN);
+        }
+    }
+    counting_allocator_remove(wolfsentry);
+    WOLFSENTRY_EXIT_ON_FALSE(n_allocator_calls == 0);
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_event_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, pinned_event, NULL /* action_results */));
+
+    /* an action can't retain the stack-built target route, and the dispatch is unaffected. */
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_action_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, "retain-trigger-route", -1 /* label_len */, WOLFSENTRY_ACTION_FLAG_NONE, retain_trigger_route_action, NULL /* handler_arg */, NULL /* id */));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_event_action_append(WOLFSENTRY_CONTEXT_ARGS_OUT, "static-route-test-event", -1 /* event_label_len */, WOLFSENTRY_ACTION_TYPE_POST, "retain-trigger-route", -1 /* action_label_len */));
+    retain_trigger_route_ret = WOLFSENTRY_ERROR_ENCODE(OK);
+    WOLFSENTRY_EXIT_ON_FAILURE(
+        wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, "static-route-test-event", -1 /* event_label_len */, NULL /* caller_arg */,
+                                        NULL /* id */, NULL /* inexact_matches */, &action_results));
+    WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(retain_trigger_route_ret, INCOMPATIBLE_STATE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_event_action_delete(WOLFSENTRY_CONTEXT_ARGS_OUT, "static-route-test-event", -1 /* event_label_len */, WOLFSENTRY_ACTION_TYPE_POST, "retain-trigger-route", -1 /* action_label_len */));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_action_delete(WOLFSENTRY_CONTEXT_ARGS_OUT, "retain-trigger-route", -1 /* label_len */, NULL /* action_results */));
+
+    /* a batch gets the same per-target results as separate dispatches. */
+    {
+        struct {
+            struct wolfsentry_sockaddr sa;
+            byte addr_buf[4];
+        } batch_remotes[2];
+        const struct wolfsentry_sockaddr *batch_remote_ptrs[2], *batch_local_ptrs[2];
+        wolfsentry_route_flags_t batch_flags[2];
+        wolfsentry_ent_id_t batch_ids[2];
+        wolfsentry_route_flags_t batch_inexact_matches[2];
+        wolfsentry_action_res_t batch_action_results[2];
+        wolfsentry_errcode_t batch_results[2];
+
+        memcpy(&batch_remotes[0], &remote, sizeof batch_remotes[0]);
+        memcpy(&batch_remotes[1], &remote, sizeof batch_remotes[1]);
+        memcpy(batch_remotes[0].sa.addr,"\3\4\5\6",sizeof remote.addr_buf);
+        batch_remote_ptrs[0] = &batch_remotes[0].sa;
+        batch_remote_ptrs[1] = &batch_remotes[1].sa;
+        batch_local_ptrs[0] = batch_local_ptrs[1] = &local.sa;
+        batch_flags[0] = batch_flags[1] = flags;
+        WOLFSENTRY_CLEAR_BITS(batch_flags[0], WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN);
+        WOLFSENTRY_SET_BITS(batch_flags[0], WOLFSENTRY_ROUTE_FLAG_DIRECTION_OUT);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch_batch(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* route_table */, batch_remote_ptrs, batch_local_ptrs, batch_flags, 2 /* n_targets */,
+                                                                     NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                     batch_ids, batch_inexact_matches, batch_action_results, batch_results));
+        WOLFSENTRY_EXIT_ON_FAILURE(batch_results[0]);
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(batch_action_results[0], WOLFSENTRY_ACTION_RES_ACCEPT));
+        WOLFSENTRY_EXIT_ON_FALSE(batch_ids[0] == route_id);
+        WOLFSENTRY_EXIT_ON_FALSE(batch_inexact_matches[0] == 0);
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_SUCCESS_CODE_IS(batch_results[1], USED_FALLBACK));
+        WOLFSENTRY_EXIT_ON_FALSE(batch_ids[1] == WOLFSENTRY_ENT_ID_NONE);
+        WOLFSENTRY_EXIT_ON_FALSE(batch_inexact_matches[1] == (WOLFSENTRY_ROUTE_WILDCARD_FLAGS | WOLFSENTRY_ROUTE_FLAG_PARENT_EVENT_WILDCARD));
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_event_delete(WOLFSENTRY_CONTEXT_ARGS_OUT, "static-route-test-event", -1 /* label_len */, NULL /* action_results */));
+    WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(wolfsentry_event_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, "static-route-test-event", -1 /* label_len */, &pinned_event), ITEM_NOT_FOUND));
+
     memcpy(remote.sa.addr,"\2\3\4\5",sizeof remote.addr_buf);
     memcpy(local.sa.addr,"\373\372\371\370",sizeof local.addr_buf);
 
@@ -1400,59 +2022,963 @@ static int test_static_routes (void) {
                                    route_ref,
                                    NULL /* action_results */));
 
-    /* leave the route in the table, to be cleaned up by wolfsentry_shutdown(). */
+    /* nested subnets and a block of host routes, spread over several tuples
+     * of the lookup classifier.  each probe must land on the most specific
+     * route covering it, including after the host routes are deleted.
+     */
+    {
+        wolfsentry_ent_id_t subnet_ids[4], host_ids[256], local_subnet_id;
+        byte host_addr[4];
+        static const struct {
+            byte addr[4];
+            int expected_subnet; /* index into subnet_ids, or -1 for the host route */
+        } probes[] = {
+            { { 10, 1, 2, 3 }, 3 },
+            { { 10, 1, 3, 3 }, 2 },
+            { { 10, 1, 17, 1 }, 1 },
+            { { 10, 9, 9, 9 }, 0 },
+            { { 10, 2, 7, 8 }, 0 },
+            { { 10, 2, 7, 7 }, -1 }
+        };
+        static const wolfsentry_addr_bits_t subnet_lens[4] = { 8, 16, 20, 24 };
+        unsigned int n;
 
-    printf("all subtests succeeded -- %d distinct ents inserted and deleted.\n",wolfsentry->mk_id_cb_state.id_counter);
+        flags = WOLFSENTRY_ROUTE_FLAG_TCPLIKE_PORT_NUMBERS | WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+        remote.sa.sa_port = 12345;
+        local.sa.addr_len = remote.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        memcpy(local.sa.addr,"\377\376\375\374",sizeof local.addr_buf);
 
-    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+        for (n = 0; n < length_of_array(subnet_ids); ++n) {
+            memcpy(remote.sa.addr,"\12\1\2\0",sizeof remote.addr_buf);
+            remote.sa.addr_len = subnet_lens[n];
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags, 0 /* event_label_len */, 0 /* event_label */, &subnet_ids[n], &action_results));
+        }
 
-    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+        remote.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        for (n = 0; n < length_of_array(host_ids); ++n) {
+            host_addr[0] = 10;
+            host_addr[1] = 2;
+            host_addr[2] = (byte)n;
+            host_addr[3] = (byte)n;
+            memcpy(remote.sa.addr, host_addr, sizeof remote.addr_buf);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags, 0 /* event_label_len */, 0 /* event_label */, &host_ids[n], &action_results));
+        }
 
-    WOLFSENTRY_RETURN_OK;
-}
+        /* enough objects to have grown the ID index several times over. */
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        for (n = 0; n < length_of_array(host_ids); ++n) {
+            struct wolfsentry_table_ent_header *ent;
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, host_ids[n], &ent));
+            WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_id(ent) == host_ids[n]);
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
 
-#undef PRIVATE_DATA_SIZE
-#undef PRIVATE_DATA_ALIGNMENT
+        for (n = 0; n < length_of_array(probes) * 2; ++n) {
+            int expected_subnet = probes[n % length_of_array(probes)].expected_subnet;
 
-#endif /* TEST_STATIC_ROUTES */
+            if (n == length_of_array(probes)) {
+                unsigned int i;
+                for (i = 0; i < length_of_array(host_ids); ++i)
+                    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, host_ids[i], NULL /* event_label */, 0 /* event_label_len */, &action_results));
+            }
+            if ((n >= length_of_array(probes)) && (expected_subnet == -1))
+                expected_subnet = 0;
+
+            memcpy(remote.sa.addr, probes[n % length_of_array(probes)].addr, sizeof remote.addr_buf);
+
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_reference(
+                                           WOLFSENTRY_CONTEXT_ARGS_OUT,
+                                           main_routes,
+                                           &remote.sa,
+                                           &local.sa,
+                                           flags,
+                                           0 /* event_label_len */,
+                                           0 /* event_label */,
+                                           0 /* exact_p */,
+                                           &inexact_matches,
+                                           &route_ref));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+
+            if (expected_subnet >= 0)
+                WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_id(route_ref) == subnet_ids[expected_subnet]);
+            else
+                WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_id(route_ref) == host_ids[7]);
+            WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(inexact_matches, WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD) == (expected_subnet >= 0));
 
-#ifdef TEST_DYNAMIC_RULES
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(
+                                           WOLFSENTRY_CONTEXT_ARGS_OUT,
+                                           route_ref,
+                                           NULL /* action_results */));
+        }
 
-#define PRIVATE_DATA_SIZE 32
-#define PRIVATE_DATA_ALIGNMENT 8
+        for (n = 0; n < length_of_array(subnet_ids); ++n)
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, subnet_ids[n], NULL /* event_label */, 0 /* event_label_len */, &action_results));
 
-static wolfsentry_errcode_t wolfsentry_action_dummy_callback(
-    WOLFSENTRY_CONTEXT_ARGS_IN,
-    const struct wolfsentry_action *action,
-    void *handler_context,
-    void *caller_arg,
-    const struct wolfsentry_event *event,
-    wolfsentry_action_type_t action_type,
-    const struct wolfsentry_route *target_route,
-    struct wolfsentry_route_table *route_table,
-    struct wolfsentry_route *rule_route,
-    wolfsentry_action_res_t *action_results)
-{
-    WOLFSENTRY_CONTEXT_ARGS_NOT_USED;
-    (void)action;
-    (void)handler_context;
-    (void)caller_arg;
-    (void)event;
-    (void)action_type;
-    (void)target_route;
-    (void)route_table;
-    (void)rule_route;
-    (void)action_results;
+        /* a wildcard remote with a literal local prefix is found by local address. */
+        remote.sa.addr_len = 0;
+        memcpy(local.sa.addr,"\300\250\0\0",sizeof local.addr_buf);
+        local.sa.addr_len = 23;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags | WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD, 0 /* event_label_len */, 0 /* event_label */, &local_subnet_id, &action_results));
 
-    WOLFSENTRY_RETURN_OK;
-}
+        memcpy(remote.sa.addr,"\13\0\0\1",sizeof remote.addr_buf);
+        remote.sa.addr_len = local.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        for (n = 0; n < 2; ++n) {
+            wolfsentry_errcode_t ret;
+            memcpy(local.sa.addr, n ? "\300\250\2\5" : "\300\250\1\5", sizeof local.addr_buf);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+            ret = wolfsentry_route_get_reference(
+                WOLFSENTRY_CONTEXT_ARGS_OUT,
+                main_routes,
+                &remote.sa,
+                &local.sa,
+                flags,
+                0 /* event_label_len */,
+                0 /* event_label */,
+                0 /* exact_p */,
+                &inexact_matches,
+                &route_ref);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+            if (n == 0) {
+                WOLFSENTRY_EXIT_ON_FAILURE(ret);
+                WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_id(route_ref) == local_subnet_id);
+                WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(
+                                               WOLFSENTRY_CONTEXT_ARGS_OUT,
+                                               route_ref,
+                                               NULL /* action_results */));
+            } else {
+                /* 192.168.2.5 is outside 192.168.0.0/23. */
+                WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(ret, ITEM_NOT_FOUND) || (wolfsentry_get_object_id(route_ref) != local_subnet_id));
+                if (ret >= 0)
+                    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(
+                                                   WOLFSENTRY_CONTEXT_ARGS_OUT,
+                                                   route_ref,
+                                                   NULL /* action_results */));
+            }
+        }
 
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, local_subnet_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+    }
 
-static int test_dynamic_rules (void) {
+    /* with the flow cache enabled, repeat dispatches are served from the
+     * cache, route changes invalidate it, and hits still reach the rule
+     * route's metadata.
+     */
+    {
+        static const uint32_t flow_cache_key[2] = { 0x01234567U, 0x89abcdefU };
+        struct wolfsentry_route_flow_cache_stats flow_cache_stats;
+        struct wolfsentry_table_ent_header *ent;
+        struct wolfsentry_route_metadata_exports metadata;
+        wolfsentry_ent_id_t wide_id, narrow_id, dispatched_id;
+        unsigned int n;
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_flow_cache_configure(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, 50, flow_cache_key));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_flow_cache_stats_get(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &flow_cache_stats));
+        WOLFSENTRY_EXIT_ON_FALSE(flow_cache_stats.n_slots == 64);
+
+        memcpy(remote.sa.addr,"\12\3\0\0",sizeof remote.addr_buf);
+        remote.sa.addr_len = 16;
+        memcpy(local.sa.addr,"\377\376\375\374",sizeof local.addr_buf);
+        local.sa.addr_len = sizeof local.addr_buf * BITS_PER_BYTE;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags, 0 /* event_label_len */, 0 /* event_label */, &wide_id, &action_results));
+
+        memcpy(remote.sa.addr,"\12\3\1\1",sizeof remote.addr_buf);
+        remote.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        for (n = 0; n < 3; ++n) {
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                       &dispatched_id, &inexact_matches, &action_results));
+            WOLFSENTRY_EXIT_ON_FALSE(dispatched_id == wide_id);
+            WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(inexact_matches, WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD));
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_flow_cache_stats_get(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &flow_cache_stats));
+        WOLFSENTRY_EXIT_ON_FALSE((flow_cache_stats.misses == 1) && (flow_cache_stats.hits == 2));
 
-    struct wolfsentry_context *wolfsentry;
-#if 0
-    wolfsentry_action_res_t action_results;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, wide_id, &ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_metadata((struct wolfsentry_route *)ent, &metadata));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FALSE(metadata.hit_count == 3);
+
+        /* a more specific route must supersede the cached verdict. */
+        remote.sa.addr_len = 24;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags, 0 /* event_label_len */, 0 /* event_label */, &narrow_id, &action_results));
+        remote.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                   &dispatched_id, &inexact_matches, &action_results));
+        WOLFSENTRY_EXIT_ON_FALSE(dispatched_id == narrow_id);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, narrow_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                   &dispatched_id, &inexact_matches, &action_results));
+        WOLFSENTRY_EXIT_ON_FALSE(dispatched_id == wide_id);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_flow_cache_stats_get(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &flow_cache_stats));
+        WOLFSENTRY_EXIT_ON_FALSE((flow_cache_stats.misses == 3) && (flow_cache_stats.hits == 2));
+
+        /* batched dispatch goes through the same cache. */
+        {
+            const struct wolfsentry_sockaddr *batch_remote_ptrs[2];
+            const struct wolfsentry_sockaddr *batch_local_ptrs[2];
+            wolfsentry_route_flags_t batch_flags[2];
+            wolfsentry_ent_id_t batch_ids[2];
+            wolfsentry_action_res_t batch_action_results[2];
+
+            batch_remote_ptrs[0] = batch_remote_ptrs[1] = &remote.sa;
+            batch_local_ptrs[0] = batch_local_ptrs[1] = &local.sa;
+            batch_flags[0] = batch_flags[1] = flags;
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch_batch(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, batch_remote_ptrs, batch_local_ptrs, batch_flags, 2 /* n_targets */,
+                                                                         NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                         batch_ids, NULL /* inexact_matches */, batch_action_results, NULL /* results */));
+            WOLFSENTRY_EXIT_ON_FALSE((batch_ids[0] == wide_id) && (batch_ids[1] == wide_id));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_flow_cache_stats_get(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &flow_cache_stats));
+            WOLFSENTRY_EXIT_ON_FALSE((flow_cache_stats.misses == 3) && (flow_cache_stats.hits == 4));
+        }
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, wide_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_flow_cache_configure(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, 0, NULL));
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(wolfsentry_route_table_flow_cache_stats_get(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &flow_cache_stats), ITEM_NOT_FOUND));
+    }
+
+    /* hit counts survive sharding, folding, deletion, and cloning, and
+     * saturation still sets _DONT_COUNT_HITS.
+     */
+    {
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+        const unsigned int n_hits = WOLFSENTRY_HITCOUNT_SHARD_PROMOTE_AT + WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT + 10;
+        const unsigned int max_hits_to_saturate = WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT;
+#else
+        const unsigned int n_hits = 100;
+        const unsigned int max_hits_to_saturate = 1;
+#endif
+        struct wolfsentry_context *ctx_clone;
+        struct wolfsentry_table_ent_header *ent;
+        struct wolfsentry_route_metadata_exports metadata;
+        wolfsentry_route_flags_t route_flags;
+        wolfsentry_ent_id_t hot_id, dispatched_id;
+        unsigned int n;
+
+        memcpy(remote.sa.addr,"\12\4\0\0",sizeof remote.addr_buf);
+        remote.sa.addr_len = 16;
+        memcpy(local.sa.addr,"\377\376\375\374",sizeof local.addr_buf);
+        local.sa.addr_len = sizeof local.addr_buf * BITS_PER_BYTE;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags, 0 /* event_label_len */, 0 /* event_label */, &hot_id, &action_results));
+
+        remote.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        for (n = 0; n < n_hits; ++n) {
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                       &dispatched_id, &inexact_matches, &action_results));
+            WOLFSENTRY_EXIT_ON_FALSE(dispatched_id == hot_id);
+        }
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, hot_id, &ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_metadata((struct wolfsentry_route *)ent, &metadata));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FALSE(metadata.hit_count == n_hits);
+        WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_hitcount(ent) == n_hits);
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+        /* one fold has happened, and the last few hits are still pending. */
+        WOLFSENTRY_EXIT_ON_FALSE(ent->hitcount_slot != 0);
+        WOLFSENTRY_EXIT_ON_FALSE(ent->hitcount == WOLFSENTRY_HITCOUNT_SHARD_PROMOTE_AT + WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT);
+#endif
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_clone(WOLFSENTRY_CONTEXT_ARGS_OUT, &ctx_clone, WOLFSENTRY_CLONE_FLAG_NONE));
+        {
+            struct wolfsentry_table_ent_header *cloned_ent;
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(ctx_clone)));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(ctx_clone), hot_id, &cloned_ent));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(ctx_clone)));
+            WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_hitcount(cloned_ent) == n_hits);
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_free(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&ctx_clone)));
+
+        /* drive the count to saturation. */
+        ent->hitcount = (wolfsentry_hitcount_t)MAX_UINT_OF(ent->hitcount);
+        for (n = 0; n < max_hits_to_saturate; ++n) {
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                       &dispatched_id, &inexact_matches, &action_results));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_flags((struct wolfsentry_route *)ent, &route_flags));
+            if (WOLFSENTRY_CHECK_BITS(route_flags, WOLFSENTRY_ROUTE_FLAG_DONT_COUNT_HITS))
+                break;
+        }
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(route_flags, WOLFSENTRY_ROUTE_FLAG_DONT_COUNT_HITS));
+        WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_hitcount(ent) == MAX_UINT_OF(ent->hitcount));
+
+        /* a deleted route keeps its count. */
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_object_checkout(ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, hot_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+        WOLFSENTRY_EXIT_ON_FALSE(ent->hitcount_slot == 0);
+#endif
+        WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_hitcount(ent) == MAX_UINT_OF(ent->hitcount));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, (struct wolfsentry_route *)ent, &action_results));
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(action_results, WOLFSENTRY_ACTION_RES_DEALLOCATED));
+    }
+
+    /* purge deadlines spread across every level of the purge wheel, and past
+     * it, expire exactly when due, and a full table gives up the route with
+     * the earliest deadline.
+     */
+    {
+        static const time_t purge_after_seconds[] = { 0, 0, 10, 3600, 3 * 86400, 400 * 86400 };
+        wolfsentry_ent_id_t purge_ids[length_of_array(purge_after_seconds)], forced_id;
+        struct wolfsentry_route_exports route_exports;
+        struct wolfsentry_table_ent_header *ent;
+        wolfsentry_hitcount_t saved_max_purgeable_routes;
+        wolfsentry_time_t now, interval;
+        byte remote_addr[4], local_addr[4];
+        size_t n;
+
+        memset(&route_exports, 0, sizeof route_exports);
+        route_exports.flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+        route_exports.sa_family = AF_INET;
+        route_exports.sa_proto = IPPROTO_TCP;
+        route_exports.remote.addr_len = route_exports.local.addr_len = sizeof remote_addr * BITS_PER_BYTE;
+        route_exports.remote_address = remote_addr;
+        route_exports.local_address = local_addr;
+        memcpy(remote_addr, "\12\6\0\0", sizeof remote_addr);
+        memcpy(local_addr, "\377\376\375\374", sizeof local_addr);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &now));
+        for (n = 0; n < length_of_array(purge_after_seconds); ++n) {
+            /* the first two are due after a brief sleep. */
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_interval_from_seconds(wolfsentry, purge_after_seconds[n], purge_after_seconds[n] ? 0 : 200000000L, &interval));
+            route_exports.meta.purge_after = now + interval;
+            remote_addr[3] = (byte)n;
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, NULL /* caller_arg */, &route_exports, &purge_ids[n], &action_results));
+        }
+        WOLFSENTRY_EXIT_ON_FALSE(main_routes->purge_wheel.len == length_of_array(purge_after_seconds));
+
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(wolfsentry_route_stale_purge(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &action_results), ALREADY));
+        usleep(400000);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_stale_purge(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &action_results));
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(wolfsentry_route_stale_purge(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &action_results), ALREADY));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        for (n = 0; n < length_of_array(purge_after_seconds); ++n) {
+            if (purge_after_seconds[n] == 0)
+                WOLFSENTRY_EXIT_ON_SUCCESS(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, purge_ids[n], &ent));
+            else
+                WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, purge_ids[n], &ent));
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FALSE(main_routes->purge_wheel.len == length_of_array(purge_after_seconds) - 2);
+
+        /* with the table full, the next insert forces out the 10 second route. */
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_max_purgeable_routes_get(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, &saved_max_purgeable_routes));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_max_purgeable_routes_set(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, main_routes->purge_wheel.len));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_interval_from_seconds(wolfsentry, 7200, 0, &interval));
+        route_exports.meta.purge_after = now + interval;
+        remote_addr[3] = (byte)n;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, NULL /* caller_arg */, &route_exports, &forced_id, &action_results));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_SUCCESS(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, purge_ids[2], &ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+
+        for (n = 3; n < length_of_array(purge_after_seconds); ++n)
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, purge_ids[n], NULL /* event_label */, 0 /* event_label_len */, &action_results));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, forced_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+        WOLFSENTRY_EXIT_ON_FALSE(main_routes->purge_wheel.len == 0);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_max_purgeable_routes_set(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, saved_max_purgeable_routes));
+    }
+
+#ifdef WOLFSENTRY_THREADSAFE
+    /* with write-behind, dispatches without the mutex leave the rule route's
+     * metadata alone until the logs are applied, and logged hits on deleted
+     * routes are dropped.
+     */
+    {
+        struct wolfsentry_table_ent_header *ent;
+        struct wolfsentry_route_metadata_exports metadata_before, metadata;
+        struct wolfsentry_route_write_behind_log *wb_log;
+        wolfsentry_ent_id_t wb_id, dispatched_id;
+        unsigned int n;
+        uint32_t i;
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_write_behind_configure(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, 3));
+
+        memcpy(remote.sa.addr,"\12\5\0\0",sizeof remote.addr_buf);
+        remote.sa.addr_len = 16;
+        memcpy(local.sa.addr,"\377\376\375\374",sizeof local.addr_buf);
+        local.sa.addr_len = sizeof local.addr_buf * BITS_PER_BYTE;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags, 0 /* event_label_len */, 0 /* event_label */, &wb_id, &action_results));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, wb_id, &ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_object_checkout(ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_metadata((struct wolfsentry_route *)ent, &metadata_before));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+
+        remote.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        for (n = 0; n < 5; ++n) {
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                       &dispatched_id, &inexact_matches, &action_results));
+            WOLFSENTRY_EXIT_ON_FALSE(dispatched_id == wb_id);
+        }
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_metadata((struct wolfsentry_route *)ent, &metadata));
+        WOLFSENTRY_EXIT_ON_FALSE(metadata.hit_count == metadata_before.hit_count);
+        WOLFSENTRY_EXIT_ON_FALSE(metadata.last_hit_time == metadata_before.last_hit_time);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_write_behind_flush(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_metadata((struct wolfsentry_route *)ent, &metadata));
+        WOLFSENTRY_EXIT_ON_FALSE(metadata.hit_count == metadata_before.hit_count + 5);
+        WOLFSENTRY_EXIT_ON_FALSE(metadata.last_hit_time > metadata_before.last_hit_time);
+        metadata_before = metadata;
+
+        for (n = 0; n < 2; ++n) {
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                       &dispatched_id, &inexact_matches, &action_results));
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, wb_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_write_behind_flush(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_metadata((struct wolfsentry_route *)ent, &metadata));
+        WOLFSENTRY_EXIT_ON_FALSE(metadata.hit_count == metadata_before.hit_count);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, (struct wolfsentry_route *)ent, &action_results));
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(action_results, WOLFSENTRY_ACTION_RES_DEALLOCATED));
+
+        /* a dispatch that falls through logs nothing, since its interim rule
+         * route isn't in the table.
+         */
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_event_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, "write-behind-test-event", -1 /* label_len */, 10 /* priority */, NULL /* config */, WOLFSENTRY_EVENT_FLAG_NONE, NULL /* id */));
+        memcpy(remote.sa.addr,"\376\1\2\3",sizeof remote.addr_buf);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, "write-behind-test-event", -1 /* event_label_len */, NULL /* caller_arg */,
+                                                                   NULL /* id */, NULL /* inexact_matches */, &action_results));
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_CHECK_BITS(action_results, WOLFSENTRY_ACTION_RES_FALLTHROUGH));
+        for (n = 0; n < main_routes->write_behind->n_logs; ++n) {
+            wb_log = (struct wolfsentry_route_write_behind_log *)(void *)((byte *)main_routes->write_behind->logs + (n * main_routes->write_behind->log_stride));
+            for (i = 0; i < wb_log->n_ents; ++i)
+                WOLFSENTRY_EXIT_ON_FALSE(wb_log->ents[i].route_id != WOLFSENTRY_ENT_ID_NONE);
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_event_delete(WOLFSENTRY_CONTEXT_ARGS_OUT, "write-behind-test-event", -1 /* label_len */, NULL /* action_results */));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_write_behind_configure(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, 0));
+    }
+#endif /* WOLFSENTRY_THREADSAFE */
+
+    /* with opportunistic purges disabled, expired routes stay put through
+     * dispatch, until wolfsentry_maintenance_run() or the worker collects
+     * them, in bounded runs.
+     */
+    {
+        struct wolfsentry_maintenance_report report;
+        struct wolfsentry_route_exports route_exports;
+        struct wolfsentry_table_ent_header *ent;
+        wolfsentry_ent_id_t expiring_ids[3], permanent_id, dispatched_id;
+        wolfsentry_time_t now, interval;
+        byte remote_addr[4], local_addr[4];
+        size_t n;
+
+        memset(&route_exports, 0, sizeof route_exports);
+        route_exports.flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+        route_exports.sa_family = AF_INET;
+        route_exports.sa_proto = IPPROTO_TCP;
+        route_exports.remote.addr_len = route_exports.local.addr_len = sizeof remote_addr * BITS_PER_BYTE;
+        route_exports.remote_address = remote_addr;
+        route_exports.local_address = local_addr;
+        memcpy(remote_addr, "\12\7\0\0", sizeof remote_addr);
+        memcpy(local_addr, "\377\376\375\374", sizeof local_addr);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &now));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_interval_from_seconds(wolfsentry, 0, 200000000L, &interval));
+        route_exports.meta.purge_after = now + interval;
+        for (n = 0; n < length_of_array(expiring_ids); ++n) {
+            remote_addr[3] = (byte)n;
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, NULL /* caller_arg */, &route_exports, &expiring_ids[n], &action_results));
+        }
+
+        memcpy(remote.sa.addr,"\12\10\0\0",sizeof remote.addr_buf);
+        remote.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        memcpy(local.sa.addr,"\377\376\375\374",sizeof local.addr_buf);
+        local.sa.addr_len = sizeof local.addr_buf * BITS_PER_BYTE;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags, 0 /* event_label_len */, 0 /* event_label */, &permanent_id, &action_results));
+
+        usleep(400000);
+
+        WOLFSENTRY_SET_BITS(wolfsentry->config.config.flags, WOLFSENTRY_EVENTCONFIG_FLAG_NO_OPPORTUNISTIC_PURGE);
+        for (n = 0; n < 5; ++n) {
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                       &dispatched_id, &inexact_matches, &action_results));
+            WOLFSENTRY_EXIT_ON_FALSE(dispatched_id == permanent_id);
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        for (n = 0; n < length_of_array(expiring_ids); ++n)
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, expiring_ids[n], &ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_maintenance_run(WOLFSENTRY_CONTEXT_ARGS_OUT, 0 /* budget */, 1 /* max_items */, &report));
+        WOLFSENTRY_EXIT_ON_FALSE((report.routes_purged == 1) && (! report.complete) && (report.slices == 1));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_maintenance_run(WOLFSENTRY_CONTEXT_ARGS_OUT, 0 /* budget */, 0 /* max_items */, &report));
+        WOLFSENTRY_EXIT_ON_FALSE((report.routes_purged == length_of_array(expiring_ids) - 1) && report.complete);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_maintenance_run(WOLFSENTRY_CONTEXT_ARGS_OUT, 0 /* budget */, 0 /* max_items */, &report));
+        WOLFSENTRY_EXIT_ON_FALSE((report.routes_purged == 0) && report.complete);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        for (n = 0; n < length_of_array(expiring_ids); ++n)
+            WOLFSENTRY_EXIT_ON_SUCCESS(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, expiring_ids[n], &ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+
+#ifdef WOLFSENTRY_HAVE_MAINTENANCE_WORKER
+        {
+            struct wolfsentry_maintenance_report totals;
+
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &now));
+            route_exports.meta.purge_after = now + interval;
+            remote_addr[3] = (byte)n;
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, NULL /* caller_arg */, &route_exports, &expiring_ids[0], &action_results));
+
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_interval_from_seconds(wolfsentry, 0, 50000000L, &interval));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_maintenance_worker_start(WOLFSENTRY_CONTEXT_ARGS_OUT, interval, 0 /* budget */, 0 /* max_items_per_run */));
+            WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(wolfsentry_maintenance_worker_start(WOLFSENTRY_CONTEXT_ARGS_OUT, interval, 0 /* budget */, 0 /* max_items_per_run */), ALREADY));
+            usleep(500000);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_maintenance_worker_stop(WOLFSENTRY_CONTEXT_ARGS_OUT, &totals));
+            WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(wolfsentry_maintenance_worker_stop(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* totals */), ITEM_NOT_FOUND));
+            WOLFSENTRY_EXIT_ON_FALSE((totals.routes_purged == 1) && (totals.slices > 1));
+
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+            WOLFSENTRY_EXIT_ON_SUCCESS(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, expiring_ids[0], &ent));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        }
+#endif /* WOLFSENTRY_HAVE_MAINTENANCE_WORKER */
+
+        WOLFSENTRY_CLEAR_BITS(wolfsentry->config.config.flags, WOLFSENTRY_EVENTCONFIG_FLAG_NO_OPPORTUNISTIC_PURGE);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, permanent_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+    }
+
+    /* the coarse clock trails the precise one by no more than a tick or so,
+     * and dispatch under a COARSE_TIME config stamps hits with it.
+     */
+    {
+        struct wolfsentry_table_ent_header *ent;
+        struct wolfsentry_route_metadata_exports metadata;
+        wolfsentry_ent_id_t coarse_id, dispatched_id;
+        wolfsentry_time_t coarse_before, precise_after, slop;
+
+        memcpy(remote.sa.addr,"\12\11\0\0",sizeof remote.addr_buf);
+        remote.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+        memcpy(local.sa.addr,"\377\376\375\374",sizeof local.addr_buf);
+        local.sa.addr_len = sizeof local.addr_buf * BITS_PER_BYTE;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, &remote.sa, &local.sa, flags, 0 /* event_label_len */, 0 /* event_label */, &coarse_id, &action_results));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_interval_from_seconds(wolfsentry, 0, 100000000L, &slop));
+        WOLFSENTRY_SET_BITS(wolfsentry->config.config.flags, WOLFSENTRY_EVENTCONFIG_FLAG_COARSE_TIME);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time_coarse(wolfsentry, &coarse_before));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, flags, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                   &dispatched_id, &inexact_matches, &action_results));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &precise_after));
+        WOLFSENTRY_CLEAR_BITS(wolfsentry->config.config.flags, WOLFSENTRY_EVENTCONFIG_FLAG_COARSE_TIME);
+        WOLFSENTRY_EXIT_ON_FALSE(dispatched_id == coarse_id);
+        WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_diff_time(wolfsentry, precise_after, coarse_before) < slop);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, coarse_id, &ent));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_metadata((struct wolfsentry_route *)ent, &metadata));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT));
+        WOLFSENTRY_EXIT_ON_FALSE((metadata.last_hit_time >= coarse_before) && (metadata.last_hit_time <= precise_after));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, coarse_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+    }
+
+    /* on a dual-stack table, with routes keyed on remote addresses, on local
+     * addresses behind wildcard remote addresses, and on local ports behind
+     * wildcard addresses, the negative filter still turns away targets in
+     * both families that can't match, and lets the ones that can through.
+     */
+    {
+        struct wolfsentry_context *filter_context;
+        struct wolfsentry_route_table *filter_routes;
+        struct {
+            struct wolfsentry_sockaddr sa;
+            byte addr_buf[16];
+        } filter_remote, filter_local;
+        struct wolfsentry_route *filter_route;
+        wolfsentry_route_flags_t filter_flags, filter_inexact_matches;
+        wolfsentry_hitcount_t filter_hits;
+        byte filter_addr[16];
+        unsigned int n;
+
+        WOLFSENTRY_EXIT_ON_FAILURE(
+            wolfsentry_init_ex(
+                wolfsentry_build_settings,
+                WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+                NULL /* config */,
+                &filter_context,
+                WOLFSENTRY_INIT_FLAG_NONE));
+        filter_routes = filter_context->routes;
+
+        memset(&filter_remote, 0, sizeof filter_remote);
+        memset(&filter_local, 0, sizeof filter_local);
+        filter_remote.sa.sa_proto = filter_local.sa.sa_proto = IPPROTO_TCP;
+        filter_local.sa.sa_port = 443;
+        filter_flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN | WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_PORT_WILDCARD;
+
+        /* IPv4 host routes, and IPv6 host and /48 routes, keyed on the remote address. */
+        filter_remote.sa.sa_family = filter_local.sa.sa_family = AF_INET;
+        filter_remote.sa.addr_len = filter_local.sa.addr_len = 32;
+        memcpy(filter_local.sa.addr, "\300\250\0\1", 4);
+        for (n = 0; n < 8; ++n) {
+            memcpy(filter_addr, "\12\0\0\0", 4);
+            filter_addr[3] = (byte)n;
+            memcpy(filter_remote.sa.addr, filter_addr, 4);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), NULL /* caller_arg */, &filter_remote.sa, &filter_local.sa, filter_flags, 0 /* event_label_len */, 0 /* event_label */, NULL /* id */, &action_results));
+        }
+        filter_remote.sa.sa_family = filter_local.sa.sa_family = AF_INET6;
+        filter_remote.sa.addr_len = filter_local.sa.addr_len = 128;
+        memcpy(filter_local.sa.addr, "\40\1\15\270\0\0\0\0\0\0\0\0\0\0\0\1", 16);
+        for (n = 0; n < 8; ++n) {
+            memcpy(filter_addr, "\40\1\15\270\0\0\0\0\0\0\0\0\0\0\0\0", 16);
+            filter_addr[15] = (byte)(0x10U + n);
+            memcpy(filter_remote.sa.addr, filter_addr, 16);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), NULL /* caller_arg */, &filter_remote.sa, &filter_local.sa, filter_flags, 0 /* event_label_len */, 0 /* event_label */, NULL /* id */, &action_results));
+        }
+        filter_remote.sa.addr_len = 48;
+        memcpy(filter_remote.sa.addr, "\40\1\15\270\0\1", 6);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), NULL /* caller_arg */, &filter_remote.sa, &filter_local.sa, filter_flags, 0 /* event_label_len */, 0 /* event_label */, NULL /* id */, &action_results));
+
+        /* an IPv4 route keyed on its local address. */
+        filter_remote.sa.sa_family = filter_local.sa.sa_family = AF_INET;
+        filter_remote.sa.addr_len = 0;
+        filter_local.sa.addr_len = 32;
+        memcpy(filter_local.sa.addr, "\300\250\7\7", 4);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), NULL /* caller_arg */, &filter_remote.sa, &filter_local.sa, filter_flags | WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD, 0 /* event_label_len */, 0 /* event_label */, NULL /* id */, &action_results));
+
+        /* an IPv6 route keyed on its local port. */
+        filter_remote.sa.sa_family = filter_local.sa.sa_family = AF_INET6;
+        filter_remote.sa.addr_len = filter_local.sa.addr_len = 0;
+        filter_local.sa.sa_port = 22;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), NULL /* caller_arg */, &filter_remote.sa, &filter_local.sa, filter_flags | WOLFSENTRY_ROUTE_FLAG_SA_REMOTE_ADDR_WILDCARD | WOLFSENTRY_ROUTE_FLAG_SA_LOCAL_ADDR_WILDCARD, 0 /* event_label_len */, 0 /* event_label */, NULL /* id */, &action_results));
+
+        WOLFSENTRY_EXIT_ON_FALSE((filter_routes->negative_filter != NULL) && (filter_routes->n_unfilterable_routes == 0));
+
+        filter_flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+        filter_local.sa.sa_port = 80;
+        filter_remote.sa.sa_port = 40000;
+
+        /* misses in both families are turned away by the filter. */
+        filter_remote.sa.sa_family = filter_local.sa.sa_family = AF_INET;
+        filter_remote.sa.addr_len = filter_local.sa.addr_len = 32;
+        memcpy(filter_remote.sa.addr, "\12\11\11\11", 4);
+        memcpy(filter_local.sa.addr, "\300\250\0\2", 4);
+        filter_hits = filter_routes->negative_filter_hits;
+        WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(ITEM_NOT_FOUND, wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_routes, &filter_remote.sa, &filter_local.sa, filter_flags, NULL /* event_label */, 0 /* event_label_len */, 0 /* exact_p */, &filter_inexact_matches, &filter_route));
+        WOLFSENTRY_EXIT_ON_FALSE(filter_routes->negative_filter_hits == filter_hits + 1);
+
+        filter_remote.sa.sa_family = filter_local.sa.sa_family = AF_INET6;
+        filter_remote.sa.addr_len = filter_local.sa.addr_len = 128;
+        memcpy(filter_remote.sa.addr, "\40\1\15\270\0\2\0\0\0\0\0\0\0\0\0\1", 16);
+        memcpy(filter_local.sa.addr, "\40\1\15\270\0\0\0\0\0\0\0\0\0\0\0\2", 16);
+        WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(ITEM_NOT_FOUND, wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_routes, &filter_remote.sa, &filter_local.sa, filter_flags, NULL /* event_label */, 0 /* event_label_len */, 0 /* exact_p */, &filter_inexact_matches, &filter_route));
+        WOLFSENTRY_EXIT_ON_FALSE(filter_routes->negative_filter_hits == filter_hits + 2);
+
+        /* each kind of key lets its matches through: the /48, the local
+         * port, an IPv4 host route, and the local address.
+         */
+        memcpy(filter_remote.sa.addr, "\40\1\15\270\0\1\0\0\0\0\0\0\0\0\0\1", 16);
+        memcpy(filter_local.sa.addr, "\40\1\15\270\0\0\0\0\0\0\0\0\0\0\0\1", 16);
+        filter_local.sa.sa_port = 443;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_routes, &filter_remote.sa, &filter_local.sa, filter_flags, NULL /* event_label */, 0 /* event_label_len */, 0 /* exact_p */, &filter_inexact_matches, &filter_route));
+        WOLFSENTRY_EXIT_ON_FALSE(filter_route->remote.addr_len == 48);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_route, NULL /* action_results */));
+
+        memcpy(filter_remote.sa.addr, "\40\1\15\270\0\2\0\0\0\0\0\0\0\0\0\1", 16);
+        filter_local.sa.sa_port = 22;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_routes, &filter_remote.sa, &filter_local.sa, filter_flags, NULL /* event_label */, 0 /* event_label_len */, 0 /* exact_p */, &filter_inexact_matches, &filter_route));
+        WOLFSENTRY_EXIT_ON_FALSE(filter_route->local.sa_port == 22);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_route, NULL /* action_results */));
+
+        filter_remote.sa.sa_family = filter_local.sa.sa_family = AF_INET;
+        filter_remote.sa.addr_len = filter_local.sa.addr_len = 32;
+        memcpy(filter_remote.sa.addr, "\12\0\0\3", 4);
+        memcpy(filter_local.sa.addr, "\300\250\0\1", 4);
+        filter_local.sa.sa_port = 443;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_routes, &filter_remote.sa, &filter_local.sa, filter_flags, NULL /* event_label */, 0 /* event_label_len */, 0 /* exact_p */, &filter_inexact_matches, &filter_route));
+        WOLFSENTRY_EXIT_ON_FALSE(filter_route->remote.addr_len == 32);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_route, NULL /* action_results */));
+
+        memcpy(filter_remote.sa.addr, "\12\11\11\11", 4);
+        memcpy(filter_local.sa.addr, "\300\250\7\7", 4);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_routes, &filter_remote.sa, &filter_local.sa, filter_flags, NULL /* event_label */, 0 /* event_label_len */, 0 /* exact_p */, &filter_inexact_matches, &filter_route));
+        WOLFSENTRY_EXIT_ON_FALSE(filter_route->remote.addr_len == 0);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(filter_context), filter_route, NULL /* action_results */));
+
+        WOLFSENTRY_EXIT_ON_FALSE(filter_routes->negative_filter_hits == filter_hits + 2);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&filter_context)));
+    }
+
+    WOLFSENTRY_EXIT_ON_FAILURE(test_addr_common_prefix());
+#ifdef WOLFSENTRY_ROUTE_SORT_KEYS
+    WOLFSENTRY_EXIT_ON_FAILURE(test_route_sort_keys());
+#endif
+
+#ifdef WOLFSENTRY_IPV4_FAST_ROUTES
+    /* IPv4 host routes compare by their packed keys, which must order them
+     * exactly as the generic field-by-field comparison would, alongside an
+     * IPv4 subnet route and an IPv6 route that take the generic path.
+     */
+    {
+        wolfsentry_errcode_t ret;
+        struct wolfsentry_context *fast_context;
+        struct wolfsentry_route_exports route_exports;
+        struct wolfsentry_cursor *cursor;
+        struct wolfsentry_route *route;
+        struct {
+            struct wolfsentry_sockaddr sa;
+            byte addr_buf[4];
+        } fast_remote, fast_local;
+        wolfsentry_ent_id_t fast_ids[200], mixed_id;
+        byte remote_addr[16], local_addr[16], prev_remote_addr[4], prev_local_addr[4];
+        wolfsentry_proto_t prev_proto = 0;
+        wolfsentry_port_t prev_local_port = 0, prev_remote_port = 0;
+        int have_prev = 0;
+        uint32_t prng = 7;
+        unsigned int n, n_seen = 0;
+
+        WOLFSENTRY_EXIT_ON_FAILURE(
+            wolfsentry_init_ex(
+                wolfsentry_build_settings,
+                WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+                NULL /* config */,
+                &fast_context,
+                WOLFSENTRY_INIT_FLAG_NONE));
+
+        memset(&route_exports, 0, sizeof route_exports);
+        route_exports.flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+        route_exports.sa_family = AF_INET;
+        route_exports.remote.addr_len = route_exports.local.addr_len = 32;
+        route_exports.remote_address = remote_addr;
+        route_exports.local_address = local_addr;
+
+        for (n = 0; n < length_of_array(fast_ids); ++n) {
+            /* few distinct values per field, so that ties reach every field. */
+            prng = (prng * 1103515245U) + 12345U;
+            memcpy(remote_addr, "\12\0\0\0", 4);
+            remote_addr[2] = (byte)((prng >> 8U) & 0x3U);
+            remote_addr[3] = (byte)(((prng >> 10U) & 0x3U) << 6U);
+            memcpy(local_addr, "\300\250\0\0", 4);
+            local_addr[3] = (byte)((prng >> 12U) & 0x1U);
+            route_exports.sa_proto = ((prng >> 13U) & 0x1U) ? IPPROTO_TCP : IPPROTO_UDP;
+            route_exports.local.sa_port = (wolfsentry_port_t)(((prng >> 14U) & 0x1U) ? 443 : 80);
+            route_exports.remote.sa_port = (wolfsentry_port_t)(1024U + n);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context), fast_context->routes, NULL /* caller_arg */, &route_exports, &fast_ids[n], &action_results));
+        }
+
+        route_exports.sa_proto = IPPROTO_TCP;
+        route_exports.remote.addr_len = 24;
+        remote_addr[3] = 0;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context), fast_context->routes, NULL /* caller_arg */, &route_exports, &mixed_id, &action_results));
+        route_exports.sa_family = AF_INET6;
+        route_exports.remote.addr_len = route_exports.local.addr_len = 128;
+        memset(remote_addr, 0xfd, sizeof remote_addr);
+        memset(local_addr, 0xfe, sizeof local_addr);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context), fast_context->routes, NULL /* caller_arg */, &route_exports, &mixed_id, &action_results));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context)));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_iterate_start(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context), fast_context->routes, &cursor));
+        for (ret = wolfsentry_route_table_iterate_current(fast_context->routes, cursor, &route);
+             ret >= 0;
+             ret = wolfsentry_route_table_iterate_next(fast_context->routes, cursor, &route)) {
+            int cmp;
+            ++n_seen;
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_export(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context), route, &route_exports));
+            if ((route_exports.sa_family != AF_INET) || (route_exports.remote.addr_len != 32))
+                continue;
+            if (have_prev) {
+                if ((cmp = memcmp(prev_remote_addr, route_exports.remote_address, 4)) == 0) {
+                    if (prev_proto != route_exports.sa_proto)
+                        cmp = (prev_proto < route_exports.sa_proto) ? -1 : 1;
+                    else if (prev_local_port != route_exports.local.sa_port)
+                        cmp = (prev_local_port < route_exports.local.sa_port) ? -1 : 1;
+                    else if ((cmp = memcmp(prev_local_addr, route_exports.local_address, 4)) == 0)
+                        cmp = (prev_remote_port < route_exports.remote.sa_port) ? -1 : 1;
+                }
+                WOLFSENTRY_EXIT_ON_FALSE(cmp < 0);
+            }
+            memcpy(prev_remote_addr, route_exports.remote_address, 4);
+            memcpy(prev_local_addr, route_exports.local_address, 4);
+            prev_proto = route_exports.sa_proto;
+            prev_local_port = route_exports.local.sa_port;
+            prev_remote_port = route_exports.remote.sa_port;
+            have_prev = 1;
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_table_iterate_end(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context), fast_context->routes, &cursor));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context)));
+        WOLFSENTRY_EXIT_ON_FALSE(n_seen == length_of_array(fast_ids) + 2);
+
+        /* every host route is still found exactly, through the packed keys. */
+        memset(&fast_remote, 0, sizeof fast_remote);
+        memset(&fast_local, 0, sizeof fast_local);
+        fast_remote.sa.sa_family = fast_local.sa.sa_family = AF_INET;
+        fast_remote.sa.addr_len = fast_local.sa.addr_len = 32;
+        prng = 7;
+        for (n = 0; n < length_of_array(fast_ids); ++n) {
+            wolfsentry_route_flags_t fast_inexact_matches;
+            prng = (prng * 1103515245U) + 12345U;
+            memcpy(remote_addr, "\12\0\0\0", 4);
+            remote_addr[2] = (byte)((prng >> 8U) & 0x3U);
+            remote_addr[3] = (byte)(((prng >> 10U) & 0x3U) << 6U);
+            memcpy(fast_remote.sa.addr, remote_addr, sizeof fast_remote.addr_buf);
+            memcpy(local_addr, "\300\250\0\0", 4);
+            local_addr[3] = (byte)((prng >> 12U) & 0x1U);
+            memcpy(fast_local.sa.addr, local_addr, sizeof fast_local.addr_buf);
+            fast_remote.sa.sa_proto = fast_local.sa.sa_proto = ((prng >> 13U) & 0x1U) ? IPPROTO_TCP : IPPROTO_UDP;
+            fast_local.sa.sa_port = (wolfsentry_port_t)(((prng >> 14U) & 0x1U) ? 443 : 80);
+            fast_remote.sa.sa_port = (wolfsentry_port_t)(1024U + n);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context), fast_context->routes, &fast_remote.sa, &fast_local.sa, WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN, NULL /* event_label */, 0 /* event_label_len */, 1 /* exact_p */, &fast_inexact_matches, &route));
+            WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_id(route) == fast_ids[n]);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(fast_context), route, NULL /* action_results */));
+        }
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&fast_context)));
+    }
+#endif /* WOLFSENTRY_IPV4_FAST_ROUTES */
+
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    /* routes without private data alignment are carved from the slab class
+     * fitted to them, and recycled there, so a second round of the same
+     * routes needs no new pages.  the aligned routes of the main context
+     * bypass the slabs entirely.
+     */
+    {
+        struct wolfsentry_context *slab_context;
+        struct wolfsentry_slab_stats stats, stats_before;
+        struct wolfsentry_route_exports route_exports;
+        wolfsentry_ent_id_t slab_ids[100], aligned_id;
+        byte remote_addr[4], local_addr[4];
+        size_t route_size = offsetof(struct wolfsentry_route, data) + (2 * sizeof remote_addr);
+        unsigned int route_class, n, round;
+        size_t pages_after_first_round = 0;
+
+        WOLFSENTRY_EXIT_ON_FAILURE(
+            wolfsentry_init_ex(
+                wolfsentry_build_settings,
+                WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+                NULL /* config */,
+                &slab_context,
+                WOLFSENTRY_INIT_FLAG_NONE));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_slab_get_stats(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(slab_context), &stats_before));
+        WOLFSENTRY_EXIT_ON_FALSE((stats_before.n_classes > 0) && (stats_before.n_classes <= WOLFSENTRY_SLAB_MAX_CLASSES));
+        for (n = 1; n < stats_before.n_classes; ++n)
+            WOLFSENTRY_EXIT_ON_FALSE(stats_before.classes[n].object_size > stats_before.classes[n - 1].object_size);
+        /* an event class may fall between route_size and the route class, and
+         * must be passed over.
+         */
+        for (route_class = 0; route_class < stats_before.n_classes; ++route_class) {
+            if ((stats_before.classes[route_class].object_size >= route_size) &&
+                (stats_before.classes[route_class].object_alignment >= WOLFSENTRY_CACHE_LINE_SIZE))
+                break;
+        }
+        WOLFSENTRY_EXIT_ON_FALSE(route_class < stats_before.n_classes);
+        /* route classes are rounded up to whole cache lines. */
+        WOLFSENTRY_EXIT_ON_FALSE(stats_before.classes[route_class].object_size < route_size + WOLFSENTRY_CACHE_LINE_SIZE);
+        WOLFSENTRY_EXIT_ON_FALSE((stats_before.classes[route_class].object_size % WOLFSENTRY_CACHE_LINE_SIZE) == 0);
+
+        memset(&route_exports, 0, sizeof route_exports);
+        route_exports.flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+        route_exports.sa_family = AF_INET;
+        route_exports.sa_proto = IPPROTO_TCP;
+        route_exports.remote.addr_len = route_exports.local.addr_len = sizeof remote_addr * BITS_PER_BYTE;
+        route_exports.remote_address = remote_addr;
+        route_exports.local_address = local_addr;
+        memcpy(remote_addr, "\12\14\0\0", sizeof remote_addr);
+        memcpy(local_addr, "\377\376\375\374", sizeof local_addr);
+
+        for (round = 0; round < 2; ++round) {
+            for (n = 0; n < length_of_array(slab_ids); ++n) {
+                remote_addr[3] = (byte)n;
+                WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(slab_context), slab_context->routes, NULL /* caller_arg */, &route_exports, &slab_ids[n], &action_results));
+            }
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_slab_get_stats(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(slab_context), &stats));
+            WOLFSENTRY_EXIT_ON_FALSE((stats.classes[route_class].allocs - stats.classes[route_class].frees) ==
+                                     (stats_before.classes[route_class].allocs - stats_before.classes[route_class].frees) + length_of_array(slab_ids));
+            WOLFSENTRY_EXIT_ON_FALSE(stats.classes[route_class].pages > 0);
+            WOLFSENTRY_EXIT_ON_FALSE(stats.heap_allocs == stats_before.heap_allocs);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_lock_shared(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(slab_context)));
+            for (n = 0; n < length_of_array(slab_ids); ++n) {
+                struct wolfsentry_table_ent_header *ent;
+                WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_table_ent_get_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(slab_context), slab_ids[n], &ent));
+                WOLFSENTRY_EXIT_ON_FALSE(((uintptr_t)ent & (WOLFSENTRY_CACHE_LINE_SIZE - 1)) == 0);
+            }
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_context_unlock(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(slab_context)));
+            if (round == 0)
+                pages_after_first_round = stats.classes[route_class].pages;
+            else
+                WOLFSENTRY_EXIT_ON_FALSE(stats.classes[route_class].pages == pages_after_first_round);
+
+            for (n = 0; n < length_of_array(slab_ids); ++n)
+                WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(slab_context), NULL /* caller_arg */, slab_ids[n], NULL /* event_label */, 0 /* event_label_len */, &action_results));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_slab_get_stats(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(slab_context), &stats));
+            WOLFSENTRY_EXIT_ON_FALSE((stats.classes[route_class].allocs - stats.classes[route_class].frees) ==
+                                     (stats_before.classes[route_class].allocs - stats_before.classes[route_class].frees));
+        }
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&slab_context)));
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_slab_get_stats(WOLFSENTRY_CONTEXT_ARGS_OUT, &stats_before));
+        remote_addr[3] = 0;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, main_routes, NULL /* caller_arg */, &route_exports, &aligned_id, &action_results));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, aligned_id, NULL /* event_label */, 0 /* event_label_len */, &action_results));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_slab_get_stats(WOLFSENTRY_CONTEXT_ARGS_OUT, &stats));
+        WOLFSENTRY_EXIT_ON_FALSE(memcmp(&stats, &stats_before, sizeof stats) == 0);
+    }
+#endif /* WOLFSENTRY_SLAB_ALLOCATOR */
+
+    /* leave the route in the table, to be cleaned up by wolfsentry_shutdown(). */
+
+    printf("all subtests succeeded -- %d distinct ents inserted and deleted.\n",wolfsentry->mk_id_cb_state.id_counter);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#undef PRIVATE_DATA_SIZE
+#undef PRIVATE_DATA_ALIGNMENT
+
+#endif /* TEST_STATIC_ROUTES */
+
+#ifdef TEST_DYNAMIC_RULES
+
+#define PRIVATE_DATA_SIZE 32
+#define PRIVATE_DATA_ALIGNMENT 8
+
+static wolfsentry_errcode_t wolfsentry_action_dummy_callback(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    const struct wolfsentry_action *action,
+    void *handler_context,
+    void *caller_arg,
+    const struct wolfsentry_event *event,
+    wolfsentry_action_type_t action_type,
+    const struct wolfsentry_route *target_route,
+    struct wolfsentry_route_table *route_table,
+    struct wolfsentry_route *rule_route,
+    wolfsentry_action_res_t *action_results)
+{
+    WOLFSENTRY_CONTEXT_ARGS_NOT_USED;
+    (void)action;
+    (void)handler_context;
+    (void)caller_arg;
+    (void)event;
+    (void)action_type;
+    (void)target_route;
+    (void)route_table;
+    (void)rule_route;
+    (void)action_results;
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+
+static int test_dynamic_rules (void) {
+
+    struct wolfsentry_context *wolfsentry;
+#if 0
+    wolfsentry_action_res_t action_results;
     int n_deleted;
     int ret;
     struct {
@@ -1939,6 +3465,26 @@ static int test_dynamic_rules (void) {
                 &flags));
         WOLFSENTRY_EXIT_ON_FALSE(flags == WOLFSENTRY_ACTION_FLAG_NONE);
 
+        /* action hit counts wrap, rather than saturating like route hit
+         * counts, including through a fold of sharded counts.
+         */
+        action->header.hitcount = (wolfsentry_hitcount_t)MAX_UINT_OF(action->header.hitcount);
+        WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT_WRAPPING(&action->header);
+        WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_hitcount(action) == 0);
+#ifdef WOLFSENTRY_SHARDED_HITCOUNTS
+        {
+            unsigned int n;
+            action->header.hitcount = WOLFSENTRY_HITCOUNT_SHARD_PROMOTE_AT - 1;
+            WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT_WRAPPING(&action->header);
+            WOLFSENTRY_EXIT_ON_FALSE(action->header.hitcount_slot != 0);
+            action->header.hitcount = (wolfsentry_hitcount_t)MAX_UINT_OF(action->header.hitcount);
+            for (n = 0; n < WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT; ++n)
+                WOLFSENTRY_TABLE_ENT_HITCOUNT_INCREMENT_WRAPPING(&action->header);
+            WOLFSENTRY_EXIT_ON_FALSE(action->header.hitcount == WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT - 1);
+            WOLFSENTRY_EXIT_ON_FALSE(wolfsentry_get_object_hitcount(action) == WOLFSENTRY_HITCOUNT_SHARD_FOLD_AT - 1);
+        }
+#endif
+
         WOLFSENTRY_EXIT_ON_FAILURE(
             wolfsentry_action_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, action, NULL));
     }
@@ -2059,6 +3605,47 @@ static int test_dynamic_rules (void) {
 
 #endif /* TEST_DYNAMIC_RULES */
 
+#if defined(TEST_USER_VALUES) || defined(TEST_TABLE_BENCHMARK)
+
+/* returns the black height of the subtree, or -1 if it violates a red-black
+ * or ordering invariant.
+ */
+static int table_rb_subtree_check(const struct wolfsentry_table_header *table, const struct wolfsentry_table_ent_header *ent, const struct wolfsentry_table_ent_header **in_order_cursor, wolfsentry_hitcount_t *count) {
+    int left_height, right_height;
+    if (ent == NULL)
+        return 1;
+    if (ent->rb_red && ((ent->rb_left && ent->rb_left->rb_red) || (ent->rb_right && ent->rb_right->rb_red)))
+        return -1;
+    if ((ent->rb_left && (ent->rb_left->rb_parent != ent)) || (ent->rb_right && (ent->rb_right->rb_parent != ent)))
+        return -1;
+    if ((left_height = table_rb_subtree_check(table, ent->rb_left, in_order_cursor, count)) < 0)
+        return -1;
+    /* the in-order walk of the tree must visit the ents in the same order as the prev/next thread. */
+    if (*in_order_cursor != ent)
+        return -1;
+    if (ent->next && (table->cmp_fn(ent, ent->next) >= 0))
+        return -1;
+    *in_order_cursor = ent->next;
+    ++*count;
+    if ((right_height = table_rb_subtree_check(table, ent->rb_right, in_order_cursor, count)) < 0)
+        return -1;
+    if (left_height != right_height)
+        return -1;
+    return left_height + (ent->rb_red ? 0 : 1);
+}
+
+static int table_rb_check(const struct wolfsentry_table_header *table) {
+    const struct wolfsentry_table_ent_header *in_order_cursor = table->head;
+    wolfsentry_hitcount_t count = 0;
+    if (table->root && (table->root->rb_red || table->root->rb_parent))
+        return 0;
+    if (table_rb_subtree_check(table, table->root, &in_order_cursor, &count) < 0)
+        return 0;
+    return (in_order_cursor == NULL) && (count == table->n_ents);
+}
+
+#endif /* TEST_USER_VALUES || TEST_TABLE_BENCHMARK */
+
 #ifdef TEST_USER_VALUES
 
 #include <math.h>
@@ -2489,6 +4076,61 @@ static int test_user_values (void) {
         }
     }
 
+    {
+        /* exercise rebalancing on insert and delete, checking the tree invariants along the way. */
+        char key[32];
+        unsigned int i;
+        for (i = 0; i < 257; ++i) {
+            snprintf(key, sizeof key, "rb_%08x", i * 2654435761U);
+            WOLFSENTRY_EXIT_ON_FAILURE(
+                wolfsentry_user_value_store_uint(
+                    WOLFSENTRY_CONTEXT_ARGS_OUT,
+                    key,
+                    WOLFSENTRY_LENGTH_NULL_TERMINATED,
+                    i,
+                    0));
+        }
+        WOLFSENTRY_EXIT_ON_FALSE(table_rb_check(&wolfsentry->user_values->header));
+        for (i = 0; i < 257; i += 3) {
+            snprintf(key, sizeof key, "rb_%08x", i * 2654435761U);
+            WOLFSENTRY_EXIT_ON_FAILURE(
+                wolfsentry_user_value_delete(
+                    WOLFSENTRY_CONTEXT_ARGS_OUT,
+                    key,
+                    WOLFSENTRY_LENGTH_NULL_TERMINATED));
+        }
+        WOLFSENTRY_EXIT_ON_FALSE(table_rb_check(&wolfsentry->user_values->header));
+        for (i = 0; i < 257; ++i) {
+            uint64_t value;
+            snprintf(key, sizeof key, "rb_%08x", i * 2654435761U);
+            if (i % 3 == 0) {
+                WOLFSENTRY_EXIT_UNLESS_EXPECTED_FAILURE(
+                    ITEM_NOT_FOUND,
+                    wolfsentry_user_value_get_uint(
+                        WOLFSENTRY_CONTEXT_ARGS_OUT,
+                        key,
+                        WOLFSENTRY_LENGTH_NULL_TERMINATED,
+                        &value));
+                continue;
+            }
+            WOLFSENTRY_EXIT_ON_FAILURE(
+                wolfsentry_user_value_get_uint(
+                    WOLFSENTRY_CONTEXT_ARGS_OUT,
+                    key,
+                    WOLFSENTRY_LENGTH_NULL_TERMINATED,
+                    &value));
+            WOLFSENTRY_EXIT_ON_FALSE(value == i);
+            WOLFSENTRY_EXIT_ON_FAILURE(
+                wolfsentry_user_value_delete(
+                    WOLFSENTRY_CONTEXT_ARGS_OUT,
+                    key,
+                    WOLFSENTRY_LENGTH_NULL_TERMINATED));
+            if (i % 16 == 0)
+                WOLFSENTRY_EXIT_ON_FALSE(table_rb_check(&wolfsentry->user_values->header));
+        }
+        WOLFSENTRY_EXIT_ON_FALSE(table_rb_check(&wolfsentry->user_values->header));
+    }
+
     WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
 
     WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
@@ -3854,9 +5496,64 @@ static int test_json(const char *fname, const char *extra_fname) {
         WOLFSENTRY_EXIT_ON_FALSE(action_results == (WOLFSENTRY_ACTION_RES_REJECT | WOLFSENTRY_ACTION_RES_FALLTHROUGH | (WOLFSENTRY_ACTION_RES_USER_BASE << 5U)));
     }
 
-    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+    /* a routes array long enough to go through the bulk insert path, in
+     * descending order, then one with a duplicate past the bulk threshold.
+     */
+    {
+        static char bulk_json[65536];
+        size_t bulk_json_len;
+        char err_buf[512];
+        wolfsentry_hitcount_t n_ents_before;
+        int i;
 
-    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+        bulk_json_len = (size_t)snprintf(bulk_json, sizeof bulk_json, "{ \"wolfsentry-config-version\" : 1, \"static-routes-insert\" : [");
+        for (i = 299; i >= 0; --i)
+            bulk_json_len += (size_t)snprintf(bulk_json + bulk_json_len, sizeof bulk_json - bulk_json_len,
+                                              "%s{ \"direction-in\" : true, \"family\" : \"inet\", \"remote\" : { \"address\" : \"10.123.%d.%d\", \"prefix-bits\" : 32 } }",
+                                              i == 299 ? "" : ",", i / 256, i % 256);
+        bulk_json_len += (size_t)snprintf(bulk_json + bulk_json_len, sizeof bulk_json - bulk_json_len, "] }");
+        WOLFSENTRY_EXIT_ON_FALSE(bulk_json_len < sizeof bulk_json);
+
+        n_ents_before = wolfsentry->routes->header.n_ents;
+        ret = wolfsentry_config_json_oneshot(
+            WOLFSENTRY_CONTEXT_ARGS_OUT,
+            (const unsigned char *)bulk_json,
+            bulk_json_len,
+            WOLFSENTRY_CONFIG_LOAD_FLAG_NO_FLUSH,
+            err_buf,
+            sizeof err_buf);
+        if (ret < 0) {
+            fprintf(stderr, "%.*s\n", (int)sizeof err_buf, err_buf);
+            WOLFSENTRY_EXIT_ON_FAILURE(ret);
+        }
+        WOLFSENTRY_EXIT_ON_FALSE(wolfsentry->routes->header.n_ents == n_ents_before + 300);
+
+        bulk_json_len = (size_t)snprintf(bulk_json, sizeof bulk_json, "{ \"wolfsentry-config-version\" : 1, \"static-routes-insert\" : [");
+        for (i = 0; i < 200; ++i)
+            bulk_json_len += (size_t)snprintf(bulk_json + bulk_json_len, sizeof bulk_json - bulk_json_len,
+                                              "%s{ \"direction-in\" : true, \"family\" : \"inet\", \"remote\" : { \"address\" : \"10.124.%d.%d\", \"prefix-bits\" : 32 } }",
+                                              i == 0 ? "" : ",", (i == 199) ? 0 : (i / 256), (i == 199) ? 150 : (i % 256));
+        bulk_json_len += (size_t)snprintf(bulk_json + bulk_json_len, sizeof bulk_json - bulk_json_len, "] }");
+        WOLFSENTRY_EXIT_ON_FALSE(bulk_json_len < sizeof bulk_json);
+
+        n_ents_before = wolfsentry->routes->header.n_ents;
+        ret = wolfsentry_config_json_oneshot(
+            WOLFSENTRY_CONTEXT_ARGS_OUT,
+            (const unsigned char *)bulk_json,
+            bulk_json_len,
+            WOLFSENTRY_CONFIG_LOAD_FLAG_NO_FLUSH,
+            err_buf,
+            sizeof err_buf);
+        WOLFSENTRY_EXIT_ON_FALSE(WOLFSENTRY_ERROR_CODE_IS(ret, ITEM_ALREADY_PRESENT));
+        /* routes ahead of the bulk threshold are inserted one by one as they
+         * stream in, but nothing from the bulk portion is.
+         */
+        WOLFSENTRY_EXIT_ON_FALSE(wolfsentry->routes->header.n_ents < n_ents_before + 199);
+    }
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
 
     WOLFSENTRY_RETURN_OK;
 }
@@ -4066,6 +5763,583 @@ static int test_json_corpus(void) {
 
 #endif /* TEST_JSON_CORPUS */
 
+#ifdef TEST_TABLE_BENCHMARK
+
+/* compares the red-black table against the linear walk that the sorted-list
+ * implementation did, at a range of table sizes, to show the crossover.  note
+ * the insert figures include ID allocation in the ents_by_id index.
+ */
+static int test_table_benchmark(void) {
+    static const unsigned int table_sizes[] = { 4, 16, 64, 256, 1024, 4096, 16384 };
+    size_t size_i;
+
+    WOLFSENTRY_THREAD_HEADER_CHECKED(WOLFSENTRY_THREAD_FLAG_NONE);
+
+    printf("%8s %14s %14s %14s\n", "n_ents", "rb insert us", "rb get us", "list seek us");
+
+    for (size_i = 0; size_i < length_of_array(table_sizes); ++size_i) {
+        struct wolfsentry_context *wolfsentry;
+        const struct wolfsentry_table_header *table;
+        unsigned int n = table_sizes[size_i], i, n_probes;
+        wolfsentry_time_t t0, t1, t2, t3;
+        char key[32];
+        uint64_t value;
+
+        WOLFSENTRY_EXIT_ON_FAILURE(
+            wolfsentry_init_ex(
+                wolfsentry_build_settings,
+                WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+                NULL /* config */,
+                &wolfsentry,
+                WOLFSENTRY_INIT_FLAG_NONE));
+
+        table = &wolfsentry->user_values->header;
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t0));
+        for (i = 0; i < n; ++i) {
+            snprintf(key, sizeof key, "bench_%08x", i * 2654435761U);
+            WOLFSENTRY_EXIT_ON_FAILURE(
+                wolfsentry_user_value_store_uint(
+                    WOLFSENTRY_CONTEXT_ARGS_OUT,
+                    key,
+                    WOLFSENTRY_LENGTH_NULL_TERMINATED,
+                    i,
+                    0));
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t1));
+
+        WOLFSENTRY_EXIT_ON_FALSE(table_rb_check(table));
+
+        for (i = 0; i < n; ++i) {
+            snprintf(key, sizeof key, "bench_%08x", i * 2654435761U);
+            WOLFSENTRY_EXIT_ON_FAILURE(
+                wolfsentry_user_value_get_uint(
+                    WOLFSENTRY_CONTEXT_ARGS_OUT,
+                    key,
+                    WOLFSENTRY_LENGTH_NULL_TERMINATED,
+                    &value));
+            WOLFSENTRY_EXIT_ON_FALSE(value == i);
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t2));
+
+        /* the list walk is quadratic overall, so cap the number of probes,
+         * spreading them evenly through the table.
+         */
+        n_probes = n < 1024 ? n : 1024;
+        {
+            const struct wolfsentry_table_ent_header *probe = table->head;
+            unsigned int stride = n / n_probes, k;
+            for (i = 0; i < n_probes; ++i) {
+                const struct wolfsentry_table_ent_header *j = table->head;
+                while (j && (table->cmp_fn(j, probe) < 0))
+                    j = j->next;
+                WOLFSENTRY_EXIT_ON_FALSE(j == probe);
+                for (k = 0; k < stride; ++k)
+                    probe = probe->next ? probe->next : table->head;
+            }
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t3));
+
+        printf("%8u %14.3f %14.3f %14.3f\n",
+               n,
+               (double)wolfsentry_diff_time(wolfsentry, t1, t0) / (double)n,
+               (double)wolfsentry_diff_time(wolfsentry, t2, t1) / (double)n,
+               (double)wolfsentry_diff_time(wolfsentry, t3, t2) / (double)n_probes);
+
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+    }
+
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* TEST_TABLE_BENCHMARK */
+
+#ifdef TEST_RWLOCK_BENCHMARK
+
+#if defined(WOLFSENTRY_THREADSAFE)
+
+/* measures lock/unlock cycles on struct wolfsentry_rwlock, single-threaded
+ * (uncontended) and with several threads cycling the same lock (contended,
+ * optionally with an occasional writer).  to compare against the
+ * semaphore-only implementation, rebuild with
+ * EXTRA_CFLAGS=-DWOLFSENTRY_NO_LOCK_SHARED_FASTPATH.
+ */
+
+#define RWLOCK_BENCHMARK_ITERATIONS 1000000
+#define RWLOCK_BENCHMARK_THREADS 4
+
+struct rwlock_benchmark_args {
+    struct wolfsentry_rwlock *lock;
+    int n_iterations;
+    int write_every; /* 0 for shared only. */
+    wolfsentry_thread_flags_t thread_flags;
+};
+
+static void *rwlock_benchmark_routine(struct rwlock_benchmark_args *args) {
+    int i;
+    WOLFSENTRY_THREAD_HEADER(args->thread_flags);
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_GET_ERROR);
+    for (i = 0; i < args->n_iterations; ++i) {
+        if (args->write_every && ((i % args->write_every) == 0))
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_mutex(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        else
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(args->lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(args->thread_flags));
+    return 0;
+}
+
+static double rwlock_benchmark_run(struct wolfsentry_context *wolfsentry, struct wolfsentry_rwlock *lock, int n_threads, int write_every, wolfsentry_thread_flags_t thread_flags) {
+    pthread_t threads[RWLOCK_BENCHMARK_THREADS];
+    struct rwlock_benchmark_args args;
+    wolfsentry_time_t t0, t1;
+    int i;
+
+    args.lock = lock;
+    args.n_iterations = RWLOCK_BENCHMARK_ITERATIONS / n_threads;
+    args.write_every = write_every;
+    args.thread_flags = thread_flags;
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t0));
+    for (i = 0; i < n_threads; ++i)
+        WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_create(&threads[i], 0 /* attr */, (void *(*)(void *))rwlock_benchmark_routine, (void *)&args));
+    for (i = 0; i < n_threads; ++i)
+        WOLFSENTRY_EXIT_ON_FAILURE_PTHREAD(pthread_join(threads[i], 0 /* retval */));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t1));
+
+    /* ns per lock-unlock cycle, aggregated over all threads. */
+    return (double)wolfsentry_diff_time(wolfsentry, t1, t0) * 1000.0 / (double)(args.n_iterations * n_threads);
+}
+
+static int test_rwlock_benchmark(void) {
+    struct wolfsentry_context *wolfsentry;
+    struct wolfsentry_rwlock *lock;
+    wolfsentry_time_t t0, t1;
+    int i;
+
+    WOLFSENTRY_THREAD_HEADER_CHECKED(WOLFSENTRY_THREAD_FLAG_NONE);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(
+        wolfsentry_init_ex(
+            wolfsentry_build_settings,
+            WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+            NULL /* config */,
+            &wolfsentry,
+            WOLFSENTRY_INIT_FLAG_NONE));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_alloc(wolfsentry_get_hpi(wolfsentry), thread, &lock, WOLFSENTRY_LOCK_FLAG_NONE));
+
+#ifdef WOLFSENTRY_LOCK_SHARED_FASTPATH
+    printf("rwlock implementation: shared fast path\n");
+#else
+    printf("rwlock implementation: semaphores only\n");
+#endif
+    printf("%-36s %10s\n", "scenario", "ns/cycle");
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t0));
+    for (i = 0; i < RWLOCK_BENCHMARK_ITERATIONS; ++i) {
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_shared(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t1));
+    printf("%-36s %10.1f\n", "uncontended shared", (double)wolfsentry_diff_time(wolfsentry, t1, t0) * 1000.0 / RWLOCK_BENCHMARK_ITERATIONS);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t0));
+    for (i = 0; i < RWLOCK_BENCHMARK_ITERATIONS; ++i) {
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_mutex(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_unlock(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t1));
+    printf("%-36s %10.1f\n", "uncontended mutex", (double)wolfsentry_diff_time(wolfsentry, t1, t0) * 1000.0 / RWLOCK_BENCHMARK_ITERATIONS);
+
+    printf("%-36s %10.1f\n", "contended shared, " _q(RWLOCK_BENCHMARK_THREADS) " threads",
+           rwlock_benchmark_run(wolfsentry, lock, RWLOCK_BENCHMARK_THREADS, 0, WOLFSENTRY_THREAD_FLAG_NONE));
+    printf("%-36s %10.1f\n", "contended, 1/64 mutex, " _q(RWLOCK_BENCHMARK_THREADS) " threads",
+           rwlock_benchmark_run(wolfsentry, lock, RWLOCK_BENCHMARK_THREADS, 64, WOLFSENTRY_THREAD_FLAG_NONE));
+
+#ifdef WOLFSENTRY_LOCK_EPOCH_READERS
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_destroy(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_init(wolfsentry_get_hpi(wolfsentry), thread, lock, WOLFSENTRY_LOCK_FLAG_EPOCH_READERS));
+    printf("%-36s %10.1f\n", "contended epoch readers, " _q(RWLOCK_BENCHMARK_THREADS) " threads",
+           rwlock_benchmark_run(wolfsentry, lock, RWLOCK_BENCHMARK_THREADS, 0, WOLFSENTRY_THREAD_FLAG_READONLY));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_destroy(lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_init(wolfsentry_get_hpi(wolfsentry), thread, lock, WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS));
+    printf("%-36s %10.1f\n", "contended scalable, " _q(RWLOCK_BENCHMARK_THREADS) " threads",
+           rwlock_benchmark_run(wolfsentry, lock, RWLOCK_BENCHMARK_THREADS, 0, WOLFSENTRY_THREAD_FLAG_NONE));
+    printf("%-36s %10.1f\n", "scalable, 1/64 mutex, " _q(RWLOCK_BENCHMARK_THREADS) " threads",
+           rwlock_benchmark_run(wolfsentry, lock, RWLOCK_BENCHMARK_THREADS, 64, WOLFSENTRY_THREAD_FLAG_NONE));
+#endif
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_lock_free(&lock, thread, WOLFSENTRY_LOCK_FLAG_NONE));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#else
+
+TEST_SKIP(test_rwlock_benchmark)
+
+#endif /* WOLFSENTRY_THREADSAFE */
+
+#endif /* TEST_RWLOCK_BENCHMARK */
+
+#ifdef TEST_DISPATCH_BENCHMARK
+
+/* times dispatch to a purgeable route, with the builtin clock (whose time
+ * arithmetic is inlined), and again with equivalent user-supplied
+ * arithmetic callbacks, which are called through timecbs.
+ */
+
+#define DISPATCH_BENCHMARK_ITERATIONS 1000000
+#define DISPATCH_BENCHMARK_TRIALS 5
+
+static wolfsentry_time_t dispatch_benchmark_diff_time(wolfsentry_time_t later, wolfsentry_time_t earlier) {
+    return later - earlier;
+}
+
+static wolfsentry_time_t dispatch_benchmark_add_time(wolfsentry_time_t start_time, wolfsentry_time_t time_interval) {
+    return start_time + time_interval;
+}
+
+static wolfsentry_errcode_t dispatch_benchmark_to_epoch_time(wolfsentry_time_t when, time_t *epoch_secs, long *epoch_nsecs) {
+    *epoch_secs = (time_t)(when / 1000000);
+    *epoch_nsecs = (long)((when % 1000000) * 1000);
+    WOLFSENTRY_RETURN_OK;
+}
+
+static wolfsentry_errcode_t dispatch_benchmark_from_epoch_time(time_t epoch_secs, long epoch_nsecs, wolfsentry_time_t *when) {
+    *when = ((wolfsentry_time_t)epoch_secs * 1000000) + ((wolfsentry_time_t)epoch_nsecs / 1000);
+    WOLFSENTRY_RETURN_OK;
+}
+
+static double dispatch_benchmark_run(WOLFSENTRY_CONTEXT_ARGS_IN_EX(const struct wolfsentry_host_platform_interface *hpi)) {
+    struct wolfsentry_context *wolfsentry;
+    struct wolfsentry_route_exports route_exports;
+    struct {
+        struct wolfsentry_sockaddr sa;
+        byte addr_buf[4];
+    } remote, local;
+    wolfsentry_ent_id_t id;
+    wolfsentry_route_flags_t inexact_matches;
+    wolfsentry_action_res_t action_results;
+    wolfsentry_time_t t0, t1;
+    double ns_per_dispatch;
+    unsigned int i;
+
+    WOLFSENTRY_EXIT_ON_FAILURE(
+        wolfsentry_init_ex(
+            wolfsentry_build_settings,
+            WOLFSENTRY_CONTEXT_ARGS_OUT_EX(hpi),
+            NULL /* config */,
+            &wolfsentry,
+            WOLFSENTRY_INIT_FLAG_NONE));
+
+    memset(&remote, 0, sizeof remote);
+    memset(&local, 0, sizeof local);
+    remote.sa.sa_family = local.sa.sa_family = AF_INET;
+    remote.sa.sa_proto = local.sa.sa_proto = IPPROTO_TCP;
+    remote.sa.addr_len = local.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+    memcpy(remote.sa.addr, "\12\0\0\1", sizeof remote.addr_buf);
+    memcpy(local.sa.addr, "\12\0\0\2", sizeof local.addr_buf);
+
+    /* a purge deadline far in the future, so that every dispatch refreshes
+     * it, but nothing is ever purged.
+     */
+    memset(&route_exports, 0, sizeof route_exports);
+    route_exports.flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+    route_exports.sa_family = AF_INET;
+    route_exports.sa_proto = IPPROTO_TCP;
+    route_exports.remote.addr_len = route_exports.local.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+    route_exports.remote_address = remote.sa.addr;
+    route_exports.local_address = local.sa.addr;
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_time_now_plus_delta(wolfsentry, (wolfsentry_time_t)86400 * 1000000, &route_exports.meta.purge_after));
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, wolfsentry->routes, NULL /* caller_arg */, &route_exports, &id, &action_results));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t0));
+    for (i = 0; i < DISPATCH_BENCHMARK_ITERATIONS; ++i) {
+        wolfsentry_ent_id_t dispatched_id;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_event_dispatch(WOLFSENTRY_CONTEXT_ARGS_OUT, &remote.sa, &local.sa, WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN, NULL /* event_label */, 0 /* event_label_len */, NULL /* caller_arg */,
+                                                                   &dispatched_id, &inexact_matches, &action_results));
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t1));
+    ns_per_dispatch = (double)wolfsentry_diff_time(wolfsentry, t1, t0) * 1000.0 / (double)DISPATCH_BENCHMARK_ITERATIONS;
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+
+    return ns_per_dispatch;
+}
+
+static int test_dispatch_benchmark(void) {
+    struct wolfsentry_host_platform_interface user_hpi;
+    struct wolfsentry_context *wolfsentry;
+    double builtin_ns = 0.0, user_ns = 0.0;
+    int trial;
+
+    WOLFSENTRY_THREAD_HEADER_CHECKED(WOLFSENTRY_THREAD_FLAG_NONE);
+
+    /* borrow the builtin get_time, and substitute the arithmetic. */
+    WOLFSENTRY_EXIT_ON_FAILURE(
+        wolfsentry_init_ex(
+            wolfsentry_build_settings,
+            WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+            NULL /* config */,
+            &wolfsentry,
+            WOLFSENTRY_INIT_FLAG_NONE));
+    memset(&user_hpi, 0, sizeof user_hpi);
+    user_hpi.timecbs = *wolfsentry_get_timecbs(wolfsentry);
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+    user_hpi.timecbs.diff_time = dispatch_benchmark_diff_time;
+    user_hpi.timecbs.add_time = dispatch_benchmark_add_time;
+    user_hpi.timecbs.to_epoch_time = dispatch_benchmark_to_epoch_time;
+    user_hpi.timecbs.from_epoch_time = dispatch_benchmark_from_epoch_time;
+    user_hpi.timecbs.interval_to_seconds = dispatch_benchmark_to_epoch_time;
+    user_hpi.timecbs.interval_from_seconds = dispatch_benchmark_from_epoch_time;
+
+    /* interleave the trials and keep the best of each, to factor out
+     * warmup and scheduling noise.
+     */
+    for (trial = 0; trial < DISPATCH_BENCHMARK_TRIALS; ++trial) {
+        double ns = dispatch_benchmark_run(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI));
+        if ((trial == 0) || (ns < builtin_ns))
+            builtin_ns = ns;
+        ns = dispatch_benchmark_run(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&user_hpi));
+        if ((trial == 0) || (ns < user_ns))
+            user_ns = ns;
+    }
+
+    printf("%-36s %10s\n", "timecbs", "ns/dispatch");
+    printf("%-36s %10.1f\n", "builtin", builtin_ns);
+    printf("%-36s %10.1f\n", "user-supplied arithmetic", user_ns);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* TEST_DISPATCH_BENCHMARK */
+
+#ifdef TEST_ROUTE_CHURN_BENCHMARK
+
+#include <sys/resource.h>
+
+/* holds a population of routes and continuously replaces random members of
+ * it, reporting the insert+delete latency and peak RSS.  build with and
+ * without SLAB_ALLOCATOR=1 to compare.
+ */
+
+#define ROUTE_CHURN_BENCHMARK_POPULATION 50000
+#define ROUTE_CHURN_BENCHMARK_REPLACEMENTS 1000000
+
+static int test_route_churn_benchmark(void) {
+    struct wolfsentry_context *wolfsentry;
+    struct wolfsentry_route_exports route_exports;
+    wolfsentry_ent_id_t *ids;
+    wolfsentry_action_res_t action_results;
+    byte remote_addr[16], local_addr[16];
+    wolfsentry_time_t t0, t1;
+    struct rusage ru;
+    uint32_t prng = 1;
+    uint32_t serial;
+    unsigned int i;
+
+    WOLFSENTRY_THREAD_HEADER_CHECKED(WOLFSENTRY_THREAD_FLAG_NONE);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(
+        wolfsentry_init_ex(
+            wolfsentry_build_settings,
+            WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+            NULL /* config */,
+            &wolfsentry,
+            WOLFSENTRY_INIT_FLAG_NONE));
+
+    if ((ids = (wolfsentry_ent_id_t *)malloc(ROUTE_CHURN_BENCHMARK_POPULATION * sizeof *ids)) == NULL)
+        WOLFSENTRY_ERROR_RETURN(SYS_RESOURCE_FAILED);
+
+    memset(&route_exports, 0, sizeof route_exports);
+    route_exports.flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+    route_exports.sa_proto = IPPROTO_TCP;
+    route_exports.remote_address = remote_addr;
+    route_exports.local_address = local_addr;
+    memset(remote_addr, 0, sizeof remote_addr);
+    memset(local_addr, 0, sizeof local_addr);
+    local_addr[0] = 10;
+
+    /* serial numbers make every address unique, and alternate the family, so
+     * that both route shapes churn together.
+     */
+#define ROUTE_CHURN_BENCHMARK_ADDRESS(serial) do {                          \
+        if ((serial) & 1U) {                                                \
+            route_exports.sa_family = AF_INET6;                             \
+            route_exports.remote.addr_len = route_exports.local.addr_len = 128; \
+        } else {                                                            \
+            route_exports.sa_family = AF_INET;                              \
+            route_exports.remote.addr_len = route_exports.local.addr_len = 32; \
+        }                                                                   \
+        remote_addr[0] = 11;                                                \
+        remote_addr[1] = (byte)((serial) >> 16U);                           \
+        remote_addr[2] = (byte)((serial) >> 8U);                            \
+        remote_addr[3] = (byte)(serial);                                    \
+    } while (0)
+
+    for (serial = 0; serial < ROUTE_CHURN_BENCHMARK_POPULATION; ++serial) {
+        ROUTE_CHURN_BENCHMARK_ADDRESS(serial);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, wolfsentry->routes, NULL /* caller_arg */, &route_exports, &ids[serial], &action_results));
+    }
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t0));
+    for (i = 0; i < ROUTE_CHURN_BENCHMARK_REPLACEMENTS; ++i, ++serial) {
+        unsigned int victim;
+        prng = (prng * 1103515245U) + 12345U;
+        victim = (prng >> 8U) % ROUTE_CHURN_BENCHMARK_POPULATION;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_delete_by_id(WOLFSENTRY_CONTEXT_ARGS_OUT, NULL /* caller_arg */, ids[victim], NULL /* event_label */, 0 /* event_label_len */, &action_results));
+        ROUTE_CHURN_BENCHMARK_ADDRESS(serial & 0xffffffU);
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, wolfsentry->routes, NULL /* caller_arg */, &route_exports, &ids[victim], &action_results));
+    }
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t1));
+
+#undef ROUTE_CHURN_BENCHMARK_ADDRESS
+
+    if (getrusage(RUSAGE_SELF, &ru) < 0)
+        WOLFSENTRY_ERROR_RETURN(SYS_OP_FAILED);
+
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    printf("%-36s\n", "allocator: slab");
+#else
+    printf("%-36s\n", "allocator: hpi");
+#endif
+    printf("%-36s %10.1f\n", "ns/replacement (delete+insert)", (double)wolfsentry_diff_time(wolfsentry, t1, t0) * 1000.0 / (double)ROUTE_CHURN_BENCHMARK_REPLACEMENTS);
+    printf("%-36s %10ld\n", "peak RSS (KiB)", (long)ru.ru_maxrss);
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+    {
+        struct wolfsentry_slab_stats stats;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_slab_get_stats(WOLFSENTRY_CONTEXT_ARGS_OUT, &stats));
+        printf("%-36s %10lu\n", "slab page bytes", (unsigned long)stats.page_bytes);
+        for (i = 0; i < stats.n_classes; ++i)
+            printf("  class %4lu bytes: %6lu pages, %10lu allocs, %10lu frees\n", (unsigned long)stats.classes[i].object_size, (unsigned long)stats.classes[i].pages, (unsigned long)stats.classes[i].allocs, (unsigned long)stats.classes[i].frees);
+    }
+#endif
+
+    free(ids);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* TEST_ROUTE_CHURN_BENCHMARK */
+
+#ifdef TEST_ROUTE_LOOKUP_BENCHMARK
+
+/* looks up random targets in a table too big for the data caches, with
+ * several routes per remote address that differ only in remote port, so that
+ * each lookup rejects a few candidates before confirming its match.
+ */
+
+#define ROUTE_LOOKUP_BENCHMARK_ADDRS 65536
+#define ROUTE_LOOKUP_BENCHMARK_PORTS_PER_ADDR 4
+#define ROUTE_LOOKUP_BENCHMARK_LOOKUPS 2000000
+#define ROUTE_LOOKUP_BENCHMARK_TRIALS 3
+
+static int test_route_lookup_benchmark(void) {
+    struct wolfsentry_context *wolfsentry;
+    struct wolfsentry_route_exports route_exports;
+    struct {
+        struct wolfsentry_sockaddr sa;
+        byte addr_buf[4];
+    } remote, local;
+    wolfsentry_ent_id_t id;
+    wolfsentry_action_res_t action_results;
+    byte remote_addr[4], local_addr[4];
+    wolfsentry_time_t t0, t1;
+    double best_ns = 0.0;
+    uint32_t prng = 1;
+    unsigned int i, port;
+    int trial;
+
+    WOLFSENTRY_THREAD_HEADER_CHECKED(WOLFSENTRY_THREAD_FLAG_NONE);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(
+        wolfsentry_init_ex(
+            wolfsentry_build_settings,
+            WOLFSENTRY_CONTEXT_ARGS_OUT_EX(WOLFSENTRY_TEST_HPI),
+            NULL /* config */,
+            &wolfsentry,
+            WOLFSENTRY_INIT_FLAG_NONE));
+
+    memset(&route_exports, 0, sizeof route_exports);
+    route_exports.flags = WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN;
+    route_exports.sa_family = AF_INET;
+    route_exports.sa_proto = IPPROTO_TCP;
+    route_exports.remote.addr_len = route_exports.local.addr_len = sizeof remote_addr * BITS_PER_BYTE;
+    route_exports.local.sa_port = 443;
+    route_exports.remote_address = remote_addr;
+    route_exports.local_address = local_addr;
+    memcpy(local_addr, "\12\0\0\1", sizeof local_addr);
+
+    for (i = 0; i < ROUTE_LOOKUP_BENCHMARK_ADDRS; ++i) {
+        remote_addr[0] = 11;
+        remote_addr[1] = (byte)(i >> 16U);
+        remote_addr[2] = (byte)(i >> 8U);
+        remote_addr[3] = (byte)i;
+        for (port = 0; port < ROUTE_LOOKUP_BENCHMARK_PORTS_PER_ADDR; ++port) {
+            route_exports.remote.sa_port = (wolfsentry_port_t)(1024U + port);
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_insert_by_exports_into_table(WOLFSENTRY_CONTEXT_ARGS_OUT, wolfsentry->routes, NULL /* caller_arg */, &route_exports, &id, &action_results));
+        }
+    }
+
+    memset(&remote, 0, sizeof remote);
+    memset(&local, 0, sizeof local);
+    remote.sa.sa_family = local.sa.sa_family = AF_INET;
+    remote.sa.sa_proto = local.sa.sa_proto = IPPROTO_TCP;
+    remote.sa.addr_len = local.sa.addr_len = sizeof remote.addr_buf * BITS_PER_BYTE;
+    local.sa.sa_port = 443;
+    memcpy(local.sa.addr, local_addr, sizeof local.addr_buf);
+
+    for (trial = 0; trial < ROUTE_LOOKUP_BENCHMARK_TRIALS; ++trial) {
+        double ns;
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t0));
+        for (i = 0; i < ROUTE_LOOKUP_BENCHMARK_LOOKUPS; ++i) {
+            struct wolfsentry_route *route;
+            wolfsentry_route_flags_t inexact_matches;
+            uint32_t n;
+            prng = (prng * 1103515245U) + 12345U;
+            n = prng >> 8U;
+            remote.sa.addr[0] = 11;
+            remote.sa.addr[1] = 0;
+            remote.sa.addr[2] = (byte)(n >> 8U);
+            remote.sa.addr[3] = (byte)n;
+            remote.sa.sa_port = (wolfsentry_port_t)(1024U + ((n >> 16U) % ROUTE_LOOKUP_BENCHMARK_PORTS_PER_ADDR));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_get_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, wolfsentry->routes, &remote.sa, &local.sa, WOLFSENTRY_ROUTE_FLAG_DIRECTION_IN, NULL /* event_label */, 0 /* event_label_len */, 0 /* exact_p */, &inexact_matches, &route));
+            WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_route_drop_reference(WOLFSENTRY_CONTEXT_ARGS_OUT, route, NULL /* action_results */));
+        }
+        WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_get_time(wolfsentry, &t1));
+        ns = (double)wolfsentry_diff_time(wolfsentry, t1, t0) * 1000.0 / (double)ROUTE_LOOKUP_BENCHMARK_LOOKUPS;
+        if ((trial == 0) || (ns < best_ns))
+            best_ns = ns;
+    }
+
+    printf("%-36s %10d\n", "routes", ROUTE_LOOKUP_BENCHMARK_ADDRS * ROUTE_LOOKUP_BENCHMARK_PORTS_PER_ADDR);
+    printf("%-36s %10lu\n", "bytes/route (IPv4, no private data)", (unsigned long)(offsetof(struct wolfsentry_route, data) + (2 * sizeof remote_addr)));
+    printf("%-36s %10.1f\n", "ns/lookup", best_ns);
+    printf("%-36s %10.0f\n", "lookups/s", 1e9 / best_ns);
+
+    WOLFSENTRY_EXIT_ON_FAILURE(wolfsentry_shutdown(WOLFSENTRY_CONTEXT_ARGS_OUT_EX(&wolfsentry)));
+
+    WOLFSENTRY_EXIT_ON_FAILURE(WOLFSENTRY_THREAD_TAILER(WOLFSENTRY_THREAD_FLAG_NONE));
+
+    WOLFSENTRY_RETURN_OK;
+}
+
+#endif /* TEST_ROUTE_LOOKUP_BENCHMARK */
+
 int main (int argc, char* argv[]) {
     wolfsentry_errcode_t ret = 0;
     int err = 0;
@@ -4144,6 +6418,46 @@ int main (int argc, char* argv[]) {
     }
 #endif
 
+#ifdef TEST_TABLE_BENCHMARK
+    ret = test_table_benchmark();
+    if (! WOLFSENTRY_ERROR_CODE_IS(ret, OK)) {
+        printf("test_table_benchmark failed, " WOLFSENTRY_ERROR_FMT "\n", WOLFSENTRY_ERROR_FMT_ARGS(ret));
+        err = 1;
+    }
+#endif
+
+#ifdef TEST_RWLOCK_BENCHMARK
+    ret = test_rwlock_benchmark();
+    if (! WOLFSENTRY_ERROR_CODE_IS(ret, OK)) {
+        printf("test_rwlock_benchmark failed, " WOLFSENTRY_ERROR_FMT "\n", WOLFSENTRY_ERROR_FMT_ARGS(ret));
+        err = 1;
+    }
+#endif
+
+#ifdef TEST_DISPATCH_BENCHMARK
+    ret = test_dispatch_benchmark();
+    if (! WOLFSENTRY_ERROR_CODE_IS(ret, OK)) {
+        printf("test_dispatch_benchmark failed, " WOLFSENTRY_ERROR_FMT "\n", WOLFSENTRY_ERROR_FMT_ARGS(ret));
+        err = 1;
+    }
+#endif
+
+#ifdef TEST_ROUTE_CHURN_BENCHMARK
+    ret = test_route_churn_benchmark();
+    if (! WOLFSENTRY_ERROR_CODE_IS(ret, OK)) {
+        printf("test_route_churn_benchmark failed, " WOLFSENTRY_ERROR_FMT "\n", WOLFSENTRY_ERROR_FMT_ARGS(ret));
+        err = 1;
+    }
+#endif
+
+#ifdef TEST_ROUTE_LOOKUP_BENCHMARK
+    ret = test_route_lookup_benchmark();
+    if (! WOLFSENTRY_ERROR_CODE_IS(ret, OK)) {
+        printf("test_route_lookup_benchmark failed, " WOLFSENTRY_ERROR_FMT "\n", WOLFSENTRY_ERROR_FMT_ARGS(ret));
+        err = 1;
+    }
+#endif
+
 #ifdef TEST_JSON_CORPUS
     ret = test_json_corpus();
     if (! WOLFSENTRY_ERROR_CODE_IS(ret, OK)) {
@@ -52,7 +52,9 @@ struct wolfsentry_thread_context;
 
 typedef enum {
     WOLFSENTRY_INIT_FLAG_NONE = 0,
-    WOLFSENTRY_INIT_FLAG_LOCK_SHARED_ERROR_CHECKING = 1<<0
+    WOLFSENTRY_INIT_FLAG_LOCK_SHARED_ERROR_CHECKING = 1<<0,
+    WOLFSENTRY_INIT_FLAG_EPOCH_READERS = 1<<1,
+    WOLFSENTRY_INIT_FLAG_SCALABLE_READERS = 1<<2
 } wolfsentry_init_flags_t;
 
 #ifdef WOLFSENTRY_THREADSAFE
@@ -99,6 +101,11 @@ struct wolfsentry_timecbs {
     wolfsentry_from_epoch_time_cb_t from_epoch_time;
     wolfsentry_interval_to_seconds_cb_t interval_to_seconds;
     wolfsentry_interval_from_seconds_cb_t interval_from_seconds;
+    /* optional -- a cheaper, lower resolution (a few milliseconds) reading of
+     * the same clock as get_time, used for route idle and purge timing where
+     * configured.  if null, get_time is used.
+     */
+    wolfsentry_get_time_cb_t get_time_coarse;
 };
 
 #ifdef WOLFSENTRY_THREADSAFE
@@ -211,7 +218,9 @@ typedef enum {
     WOLFSENTRY_LOCK_FLAG_ABANDON_RESERVATION_TOO = 1<<6,
     WOLFSENTRY_LOCK_FLAG_AUTO_DOWNGRADE = 1<<7,
     WOLFSENTRY_LOCK_FLAG_READONLY = 1<<8,
-    WOLFSENTRY_LOCK_FLAG_RETAIN_SEMAPHORE = 1<<9
+    WOLFSENTRY_LOCK_FLAG_RETAIN_SEMAPHORE = 1<<9,
+    WOLFSENTRY_LOCK_FLAG_EPOCH_READERS = 1<<10, /* let _THREAD_FLAG_READONLY threads take the lock shared without writing any shared lock state. */
+    WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS = 1<<11 /* like _EPOCH_READERS, but for all threads. */
 } wolfsentry_lock_flags_t;
 
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_init_thread_context(struct wolfsentry_thread_context *thread_context, wolfsentry_thread_flags_t init_thread_flags, void *user_context);
@@ -230,6 +239,28 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_set_thread_readwrite(struct wolfs
 
 struct wolfsentry_rwlock;
 
+/* a lock initialized with WOLFSENTRY_LOCK_FLAG_EPOCH_READERS (or a context
+ * initialized with WOLFSENTRY_INIT_FLAG_EPOCH_READERS) gives threads set
+ * read-only with wolfsentry_set_thread_readonly() an epoch-style shared lock:
+ * the outermost acquisition claims a private cache-line slot in the lock, with
+ * no semaphore operations and no writes to shared lock state, so that
+ * dispatch on many cores doesn't serialize on the lock.  mutex acquisition
+ * (including promotion) waits for all slots to drain before returning, so
+ * writers still see a quiescent table, and anything they unlink can be freed
+ * immediately.  read-write threads, and read-only threads that already hold
+ * another shared lock, take the normal path.
+ *
+ * WOLFSENTRY_LOCK_FLAG_SCALABLE_READERS (WOLFSENTRY_INIT_FLAG_SCALABLE_READERS)
+ * extends the slots to read-write threads, big-reader-lock style.  such a
+ * reader that then promotes or reserves is first moved onto the semaphore
+ * path, and gets BUSY if a writer is already waiting for it to leave.  after a
+ * writer has had to wait for readers, reader bias is revoked for the next
+ * WOLFSENTRY_LOCK_EPOCH_BIAS_INHIBIT_COUNT shared acquisitions.
+ *
+ * both flags are incompatible with WOLFSENTRY_LOCK_FLAG_PSHARED, and need GNU
+ * atomics.
+ */
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_init(struct wolfsentry_host_platform_interface *hpi, struct wolfsentry_thread_context *thread, struct wolfsentry_rwlock *lock, wolfsentry_lock_flags_t flags);
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_alloc(struct wolfsentry_host_platform_interface *hpi, struct wolfsentry_thread_context *thread, struct wolfsentry_rwlock **lock, wolfsentry_lock_flags_t flags);
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_shared(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, wolfsentry_lock_flags_t flags);
@@ -256,6 +287,47 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_unlock(struct wolfsentry_rwl
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_destroy(struct wolfsentry_rwlock *lock, struct wolfsentry_thread_context *thread, wolfsentry_lock_flags_t flags);
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_free(struct wolfsentry_rwlock **lock, struct wolfsentry_thread_context *thread, wolfsentry_lock_flags_t flags);
 
+#ifdef WOLFSENTRY_LOCK_STATS
+
+/* contention instrumentation, built in with WOLFSENTRY_LOCK_STATS (make
+ * LOCK_STATS=1).  times are in wolfsentry_time_t units, from the timecbs of
+ * the hpi passed to wolfsentry_lock_init().  an acquisition is contended if
+ * the caller had to wait behind a conflicting holder.  wait histogram bucket 0
+ * counts waits shorter than 2 time units, bucket n counts waits from 2^n up to
+ * 2^(n+1), and the last bucket also counts everything longer.  promotions
+ * cover both wolfsentry_lock_shared2mutex*() and
+ * wolfsentry_lock_shared2mutex_redeem*().  each successful shared acquisition
+ * increments a counter shared by all threads, so reader scalability is
+ * reduced in instrumented builds.
+ */
+
+#ifndef WOLFSENTRY_LOCK_STATS_HISTOGRAM_BUCKETS
+#define WOLFSENTRY_LOCK_STATS_HISTOGRAM_BUCKETS 20
+#endif
+
+struct wolfsentry_lock_stats {
+    wolfsentry_hitcount_t shared_acquisitions;
+    wolfsentry_hitcount_t mutex_acquisitions;
+    wolfsentry_hitcount_t shared_contended;
+    wolfsentry_hitcount_t mutex_contended;
+    wolfsentry_hitcount_t promotion_contended;
+    wolfsentry_time_t shared_wait_time;
+    wolfsentry_time_t mutex_wait_time;
+    wolfsentry_time_t promotion_wait_time;
+    wolfsentry_hitcount_t promotions;
+    wolfsentry_hitcount_t promotion_failures;
+    wolfsentry_hitcount_t redeem_failures;
+    wolfsentry_time_t max_mutex_hold_time;
+    wolfsentry_hitcount_t shared_wait_histogram[WOLFSENTRY_LOCK_STATS_HISTOGRAM_BUCKETS];
+    wolfsentry_hitcount_t mutex_wait_histogram[WOLFSENTRY_LOCK_STATS_HISTOGRAM_BUCKETS];
+    wolfsentry_hitcount_t promotion_wait_histogram[WOLFSENTRY_LOCK_STATS_HISTOGRAM_BUCKETS];
+};
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_get_stats(struct wolfsentry_rwlock *lock, struct wolfsentry_lock_stats *stats);
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_lock_reset_stats(struct wolfsentry_rwlock *lock);
+
+#endif /* WOLFSENTRY_LOCK_STATS */
+
 #else /* !WOLFSENTRY_THREADSAFE */
 
 #define WOLFSENTRY_CONTEXT_ARGS_IN struct wolfsentry_context *wolfsentry
@@ -372,6 +444,7 @@ struct wolfsentry_table_header;
 struct wolfsentry_table_ent_header;
 struct wolfsentry_route;
 struct wolfsentry_route_table;
+struct wolfsentry_route_bulk_insert;
 struct wolfsentry_event;
 struct wolfsentry_event_table;
 struct wolfsentry_action;
@@ -380,6 +453,12 @@ struct wolfsentry_action_list;
 struct wolfsentry_action_list_ent;
 struct wolfsentry_cursor;
 
+/* trigger_route is valid only for the duration of the callback -- the
+ * dispatch paths may build it on their own stack.  callbacks must copy out
+ * anything they need after returning, and wolfsentry_object_checkout() on a
+ * stack-built trigger_route fails with INCOMPATIBLE_STATE.  rule_route may be
+ * retained as usual.
+ */
 typedef wolfsentry_errcode_t (*wolfsentry_action_callback_t)(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     const struct wolfsentry_action *action,
@@ -484,7 +563,9 @@ typedef enum {
     WOLFSENTRY_EVENTCONFIG_FLAG_NONE = 0U,
     WOLFSENTRY_EVENTCONFIG_FLAG_DEROGATORY_THRESHOLD_IGNORE_COMMENDABLE = 1U << 0U,
     WOLFSENTRY_EVENTCONFIG_FLAG_COMMENDABLE_CLEARS_DEROGATORY = 1U << 1U,
-    WOLFSENTRY_EVENTCONFIG_FLAG_INHIBIT_ACTIONS = 1U << 2U
+    WOLFSENTRY_EVENTCONFIG_FLAG_INHIBIT_ACTIONS = 1U << 2U,
+    WOLFSENTRY_EVENTCONFIG_FLAG_NO_OPPORTUNISTIC_PURGE = 1U << 3U, /* honored in the context's default config -- dispatch never purges, leaving it to wolfsentry_maintenance_run() and friends. */
+    WOLFSENTRY_EVENTCONFIG_FLAG_COARSE_TIME = 1U << 4U /* dispatches under this config timestamp hits, and time penalty boxes, with timecbs.get_time_coarse. */
 } wolfsentry_eventconfig_flags_t;
 
 struct wolfsentry_eventconfig {
@@ -537,6 +618,7 @@ WOLFSENTRY_API int _wolfsentry_get_n_mallocs(void);
 #endif
 
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_get_time(struct wolfsentry_context *wolfsentry, wolfsentry_time_t *time_p);
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_get_time_coarse(struct wolfsentry_context *wolfsentry, wolfsentry_time_t *time_p);
 WOLFSENTRY_API wolfsentry_time_t wolfsentry_diff_time(struct wolfsentry_context *wolfsentry, wolfsentry_time_t later, wolfsentry_time_t earlier);
 WOLFSENTRY_API wolfsentry_time_t wolfsentry_add_time(struct wolfsentry_context *wolfsentry, wolfsentry_time_t start_time, wolfsentry_time_t time_interval);
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_to_epoch_time(struct wolfsentry_context *wolfsentry, wolfsentry_time_t when, time_t *epoch_secs, long *epoch_nsecs);
@@ -553,6 +635,43 @@ WOLFSENTRY_API struct wolfsentry_host_platform_interface *wolfsentry_get_hpi(str
 WOLFSENTRY_API struct wolfsentry_allocator *wolfsentry_get_allocator(struct wolfsentry_context *wolfsentry);
 WOLFSENTRY_API struct wolfsentry_timecbs *wolfsentry_get_timecbs(struct wolfsentry_context *wolfsentry);
 
+#ifdef WOLFSENTRY_SLAB_ALLOCATOR
+
+/* routes, events, and action list entries are carved from size-class slabs,
+ * built in with WOLFSENTRY_SLAB_ALLOCATOR (make SLAB_ALLOCATOR=1).  the
+ * classes are fixed when the context is created, from the route private data
+ * size in its default config.  objects larger than every class are passed
+ * through to the allocator and counted as heap_allocs/heap_frees.  routes
+ * with a nonzero route_private_data_alignment bypass the slabs entirely;
+ * the others come only from classes whose object_alignment is a whole cache
+ * line, so they start on one.  slab pages are retained by the context until
+ * it is freed.
+ */
+
+#ifndef WOLFSENTRY_SLAB_MAX_CLASSES
+#define WOLFSENTRY_SLAB_MAX_CLASSES 8
+#endif
+
+struct wolfsentry_slab_class_stats {
+    size_t object_size;
+    size_t object_alignment;
+    size_t pages;
+    wolfsentry_hitcount_t allocs;
+    wolfsentry_hitcount_t frees;
+};
+
+struct wolfsentry_slab_stats {
+    unsigned int n_classes;
+    struct wolfsentry_slab_class_stats classes[WOLFSENTRY_SLAB_MAX_CLASSES];
+    size_t page_bytes;
+    wolfsentry_hitcount_t heap_allocs;
+    wolfsentry_hitcount_t heap_frees;
+};
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_slab_get_stats(WOLFSENTRY_CONTEXT_ARGS_IN, struct wolfsentry_slab_stats *stats);
+
+#endif /* WOLFSENTRY_SLAB_ALLOCATOR */
+
 /* must return _BUFFER_TOO_SMALL and set *addr_internal_bits to an
  * accurate value when supplied with a NULL output buf ptr.
  * whenever _BUFFER_TOO_SMALL is returned, *addr_*_bits must be set to an
@@ -703,6 +822,14 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_unlock(
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_unlock_and_abandon_reservation(
     WOLFSENTRY_CONTEXT_ARGS_IN);
 
+#ifdef WOLFSENTRY_LOCK_STATS
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_lock_get_stats(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_lock_stats *stats);
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_lock_reset_stats(
+    WOLFSENTRY_CONTEXT_ARGS_IN);
+#endif
+
 #else /* !WOLFSENTRY_THREADSAFE */
 
 #define wolfsentry_context_lock_mutex(x) WOLFSENTRY_ERROR_ENCODE(OK)
@@ -719,6 +846,7 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_context_unlock_and_abandon_reserv
 #define WOLFSENTRY_LENGTH_NULL_TERMINATED (-1)
 
 WOLFSENTRY_API wolfsentry_ent_id_t wolfsentry_get_object_id(const void *object);
+WOLFSENTRY_API wolfsentry_hitcount_t wolfsentry_get_object_hitcount(const void *object);
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_table_ent_get_by_id(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     wolfsentry_ent_id_t id,
@@ -804,6 +932,41 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_insert_by_exports_and_check
     struct wolfsentry_route **route,
     wolfsentry_action_res_t *action_results);
 
+/* bulk route loading, for large route sets (e.g. a blocklist).  routes added
+ * with wolfsentry_route_bulk_insert_add() are held aside, then sorted and
+ * inserted together by wolfsentry_route_bulk_insert_commit(), in O(n log n)
+ * overall.  n_routes_hint, if nonzero, presizes the batch.  route_table can be
+ * null for the main table.  commit fails with ITEM_ALREADY_PRESENT, inserting
+ * nothing, if the batch duplicates itself or the table.  if an insert action
+ * fails, the routes already inserted remain, and *n_inserted (if non-null)
+ * counts them.  commit and abort both release *bulk.
+ */
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_bulk_insert_begin(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    unsigned int n_routes_hint,
+    struct wolfsentry_route_bulk_insert **bulk);
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_bulk_insert_add(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_bulk_insert *bulk,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    const char *event_label,
+    int event_label_len);
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_bulk_insert_commit(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_bulk_insert **bulk,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    unsigned int *n_inserted,
+    wolfsentry_action_res_t *action_results);
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_bulk_insert_abort(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_bulk_insert **bulk);
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_delete_from_table(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     struct wolfsentry_route_table *route_table,
@@ -1000,6 +1163,57 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_with_inited_
     wolfsentry_route_flags_t *inexact_matches,
     wolfsentry_action_res_t *action_results);
 
+/* dispatches n_targets targets under a single lock acquisition and a single
+ * event lookup.  remotes, locals, flags, and action_results (and ids,
+ * inexact_matches, and results, if non-null) are parallel arrays of n_targets
+ * elements.  results[i] receives what wolfsentry_route_event_dispatch() would
+ * have returned for target i.  the return value is the first error, or OK if
+ * every target was dispatched.  route_table can be null for the main table.
+ */
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_batch(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    const struct wolfsentry_sockaddr * const *remotes,
+    const struct wolfsentry_sockaddr * const *locals,
+    const wolfsentry_route_flags_t *flags,
+    unsigned int n_targets,
+    const char *event_label,
+    int event_label_len,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    wolfsentry_ent_id_t *ids,
+    wolfsentry_route_flags_t *inexact_matches,
+    wolfsentry_action_res_t *action_results,
+    wolfsentry_errcode_t *results);
+
+/* like wolfsentry_route_event_dispatch() and
+ * wolfsentry_route_event_dispatch_with_table(), but with an event handle that
+ * the caller has pinned with wolfsentry_event_get_reference() (and will release
+ * with wolfsentry_event_drop_reference()), in place of a label.  trigger_event
+ * can be null.
+ */
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_with_table_with_event(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *route_table,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    struct wolfsentry_event *trigger_event,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    wolfsentry_ent_id_t *id,
+    wolfsentry_route_flags_t *inexact_matches,
+    wolfsentry_action_res_t *action_results);
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_with_event(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    const struct wolfsentry_sockaddr *remote,
+    const struct wolfsentry_sockaddr *local,
+    wolfsentry_route_flags_t flags,
+    struct wolfsentry_event *trigger_event,
+    void *caller_arg, /* passed to action callback(s) as the caller_arg. */
+    wolfsentry_ent_id_t *id,
+    wolfsentry_route_flags_t *inexact_matches,
+    wolfsentry_action_res_t *action_results);
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_event_dispatch_by_id(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     wolfsentry_ent_id_t id,
@@ -1046,6 +1260,47 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_max_purgeable_routes_
     struct wolfsentry_route_table *table,
     wolfsentry_hitcount_t max_purgeable_routes);
 
+struct wolfsentry_route_flow_cache_stats {
+    unsigned int n_slots;
+    wolfsentry_hitcount_t hits;
+    wolfsentry_hitcount_t misses;
+    wolfsentry_hitcount_t evictions; /* valid entries displaced by a different flow. */
+};
+
+/* the flow cache memoizes the rule route (or lack of one) matched by each
+ * distinct dispatch target.  n_slots is rounded up to a power of 2, and 0
+ * disables the cache.  hash_key is 2 words of secret key material for the
+ * slot hash -- if null, a weaker key is derived internally.  reconfiguring
+ * discards cached entries and resets the stats.
+ */
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_flow_cache_configure(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *table,
+    unsigned int n_slots,
+    const uint32_t *hash_key);
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_flow_cache_stats_get(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *table,
+    struct wolfsentry_route_flow_cache_stats *stats);
+
+/* with write-behind, dispatches by callers not holding the mutex log their
+ * route hit counts and hit times to per-thread logs, rather than writing the
+ * shared routes.  the logs are applied by the next dispatch holding the
+ * mutex, by stale purges, and by wolfsentry_route_table_write_behind_flush(),
+ * so until then, hitcounts and last_hit_time read from the table lag.  n_logs
+ * is rounded up to a power of 2, and 0 disables write-behind after applying
+ * anything pending.  only supported in thread-safe builds.
+ */
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_write_behind_configure(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *table,
+    unsigned int n_logs);
+
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_table_write_behind_flush(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_route_table *table);
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_stale_purge(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     struct wolfsentry_route_table *table,
@@ -1056,6 +1311,49 @@ WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_stale_purge_one(
     struct wolfsentry_route_table *table,
     wolfsentry_action_res_t *action_results);
 
+struct wolfsentry_maintenance_report {
+    wolfsentry_hitcount_t routes_purged;
+    wolfsentry_hitcount_t slices; /* times the mutex was taken. */
+    wolfsentry_time_t elapsed;
+    int complete; /* nonzero if nothing that was due was left undone. */
+};
+
+/* purges expired routes, and applies write-behind logs, in slices of at most
+ * WOLFSENTRY_MAINTENANCE_SLICE_ITEMS routes, releasing the mutex between
+ * slices so that dispatch can interleave.  stops when nothing is due, when
+ * max_items routes have been purged, or when budget has elapsed, checked
+ * between slices.  0 means no limit for either.
+ */
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_maintenance_run(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    wolfsentry_time_t budget,
+    wolfsentry_hitcount_t max_items,
+    struct wolfsentry_maintenance_report *report);
+
+#if defined(WOLFSENTRY_THREADSAFE) && defined(WOLFSENTRY_USE_NATIVE_POSIX_THREADS)
+
+#define WOLFSENTRY_HAVE_MAINTENANCE_WORKER
+
+/* starts a thread that calls wolfsentry_maintenance_run() every interval,
+ * with the given limits.  one worker per context.  it must be stopped before
+ * wolfsentry_context_free(), and is stopped by wolfsentry_shutdown().
+ */
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_maintenance_worker_start(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    wolfsentry_time_t interval,
+    wolfsentry_time_t budget,
+    wolfsentry_hitcount_t max_items_per_run);
+
+/* stops and joins the worker, and if totals is non-null, sums its runs into
+ * it.  the caller mustn't hold a lock on the context.  returns the worker's
+ * last error, if any.
+ */
+WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_maintenance_worker_stop(
+    WOLFSENTRY_CONTEXT_ARGS_IN,
+    struct wolfsentry_maintenance_report *totals);
+
+#endif
+
 WOLFSENTRY_API wolfsentry_errcode_t wolfsentry_route_flush_table(
     WOLFSENTRY_CONTEXT_ARGS_IN,
     struct wolfsentry_route_table *table,
@@ -129,6 +129,13 @@
 
 #endif /* !WOLFSENTRY_SINGLETHREADED */
 
+/* the slab allocator's magazines are guarded with the GNU atomic builtins in
+ * multithreaded builds.
+ */
+#if defined(WOLFSENTRY_SLAB_ALLOCATOR) && defined(WOLFSENTRY_THREADSAFE) && !defined(WOLFSENTRY_HAVE_GNU_ATOMICS)
+    #error WOLFSENTRY_SLAB_ALLOCATOR with WOLFSENTRY_THREADSAFE requires the GNU atomic builtins.
+#endif
+
 #ifndef WOLFSENTRY_NO_CLOCK_BUILTIN
     #define WOLFSENTRY_CLOCK_BUILTINS
 #endif
@@ -48,6 +48,14 @@
 #endif
 #endif
 
+#ifndef ctz64
+#ifdef __GNUC__
+#define ctz64(x) __builtin_ctzll(x) /* no cast -- long long is an error with -std=c89 -pedantic. */
+#else
+#error Must supply binding for ctz64() on non-__GNUC__ targets.
+#endif
+#endif
+
 #if defined(__GNUC__) && !defined(WOLFSENTRY_NO_BUILTIN_CLZ)
 #ifndef LOG2_32
 #define LOG2_32(x) (31 - __builtin_clz((unsigned int)(x)))
@@ -57,6 +65,14 @@
 #endif
 #endif
 
+#ifndef WOLFSENTRY_PREFETCH
+#ifdef __GNUC__
+#define WOLFSENTRY_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define WOLFSENTRY_PREFETCH(addr) do {} while (0)
+#endif
+#endif
+
 #define streq(vs,fs,vs_len) (((vs_len) == strlen(fs)) && (memcmp(vs,fs,vs_len) == 0))
 #define strcaseeq(vs,fs,vs_len) (((vs_len) == strlen(fs)) && (strncasecmp(vs,fs,vs_len) == 0))
 
@@ -102,6 +118,7 @@
 #define WOLFSENTRY_ATOMIC_POSTDECREMENT(i, x) __atomic_fetch_sub(&(i),x,__ATOMIC_SEQ_CST)
 #define WOLFSENTRY_ATOMIC_STORE(i, x) __atomic_store_n(&(i), x, __ATOMIC_RELEASE)
 #define WOLFSENTRY_ATOMIC_LOAD(i) __atomic_load_n(&(i), __ATOMIC_CONSUME)
+#define WOLFSENTRY_ATOMIC_LOAD_ACQUIRE(i) __atomic_load_n(&(i), __ATOMIC_ACQUIRE)
 
 /* caution, _TEST_AND_SET() alters arg2 (and returns false) on failure. */
 #define WOLFSENTRY_ATOMIC_TEST_AND_SET(i, expected, intended)           \
@@ -111,7 +128,7 @@
         intended,                                                       \
         0 /* weak */,                                                   \
         __ATOMIC_SEQ_CST /* success_memmodel */,                        \
-        __ATOMIC_SEQ_CST /* failure_memmodel */);
+        __ATOMIC_SEQ_CST /* failure_memmodel */)
 
 #define WOLFSENTRY_ATOMIC_UPDATE_FLAGS(i, set_i, clear_i, pre_i, post_i)\
 do {                                                                    \
@@ -212,6 +229,7 @@ do {                                                                    \
 #define WOLFSENTRY_ATOMIC_DECREMENT_BY_ONE(i) (--(i))
 #define WOLFSENTRY_ATOMIC_STORE(i, x) ((i)=(x))
 #define WOLFSENTRY_ATOMIC_LOAD(i) (i)
+#define WOLFSENTRY_ATOMIC_LOAD_ACQUIRE(i) (i)
 
 #define WOLFSENTRY_ATOMIC_UPDATE_FLAGS(i, set_i, clear_i, pre_i, post_i)\
 do {                                                                    \